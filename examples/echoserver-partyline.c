@@ -77,10 +77,11 @@ main(int argc, char** argv)
 
 
 void send_to(gpointer data, gpointer user_data){
-   struct _GConn* conn = (struct _GConn*) data;
-   gchar* buf = (gchar*) user_data;
-   gchar* buf2 = g_memdup (buf, (guint) strlen(buf)+1);
-   gnet_conn_write( conn, buf2, (gint) strlen(buf2));
+   GConn* conn = (GConn*) data;
+   GConnBytes* bytes = (GConnBytes*) user_data;
+
+   /* the message is shared, not copied, by all the connections */
+   gnet_conn_write_bytes (conn, bytes);
 }
 
 
@@ -105,15 +106,15 @@ ob_server_func (GServer* server, GConn* conn, gpointer user_data)
 static void
 ob_client_func (GConn* conn, GConnEvent* event, gpointer user_data)
 {
-  gchar* buf2;
+  GConnBytes* bytes;
   switch (event->type)
     {
     case GNET_CONN_READ:
       {
 		event->buffer[event->length-1] = '\n';
-		buf2= g_memdup (event->buffer, event->length+1);
-		buf2[event->length]='\0';
-		g_list_foreach(connection_list,send_to,buf2);
+		bytes = gnet_conn_bytes_new (event->buffer, event->length);
+		g_list_foreach(connection_list,send_to,bytes);
+		gnet_conn_bytes_unref (bytes);
 
 		gnet_conn_readline (conn);
 		break;
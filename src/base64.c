@@ -29,11 +29,9 @@
  *
  ***********************************************************************/
 
-/* FIXME: use new GLib functions once we depend on GLib >= 2.12 */
-
+#include "gnet-private.h"
 #include "base64.h"
 #include <string.h>
-#include <ctype.h>
 
 
 static const gchar gnet_Base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -57,54 +55,419 @@ static const guchar gnet_Base64_rank[256] = {
 	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0xf0-0xff	*/
 };
 
+/* base64url (RFC 4648), for URLs and file names */
+static const gchar gnet_Base64_url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+static const guchar gnet_Base64_url_rank[256] = {
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0x00-0x0f	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0x10-0x1f	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255, 62,255,255, /*	0x20-0x2f	*/
+	 52, 53, 54, 55, 56, 57, 58, 59, 60, 61,255,255,255,255,255,255, /*	0x30-0x3f	*/
+	255,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, /*	0x40-0x4f	*/
+	 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,255,255,255,255, 63, /*	0x50-0x5f	*/
+	255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, /*	0x60-0x6f	*/
+	 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,255,255,255,255,255, /*	0x70-0x7f	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0x80-0x8f	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0x90-0x9f	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0xa0-0xaf	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0xb0-0xbf	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0xc0-0xcf	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0xd0-0xdf	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0xe0-0xef	*/
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255, /*	0xf0-0xff	*/
+};
 
+/* Characters per line in strict (RFC 2045) mode */
+#define BASE64_LINE	72
 
-/**
- *  gnet_base64_encode
- *  @src: source buffer
- *  @srclen: length of the source buffer
- *  @dstlenp: length of the buffer returned (including the terminating \0)
- *  @strict: insert new lines as required by RFC 2045
- *
- *  Convert a buffer from binary to base64 representation.  Set
- *  @strict to TRUE to insert a newline every 72th character.  This is
- *  required by RFC 2045, but some applications don't require this.
- *
- *  If @srclen is 0, an empty string will be returned (not NULL).
- *
- *  Returns: a newly-allocated and NUL-terminated string containing the
- *  input data in base64 coding. Free with g_free() when no longer needed.
- *
- **/
-gchar*
-gnet_base64_encode (const gchar* src, gint srclen, gint* dstlenp, gboolean strict) 
+/* Lines the strict encoder encodes at once */
+#define BASE64_BATCH_LINES	16
+
+
+/* An alphabet and the tables the vector code needs for it.  The
+   encoder finds the character of each 6-bit value by adding
+   encode_shift[] of its range (A-Z, a-z, 0-9, and each of the last
+   two) to it.  The decoder checks characters by their nibbles: a
+   character is in the alphabet if decode_lo[low nibble] and
+   decode_hi[high nibble] have no bit in common.  Its value is the
+   character plus decode_shift[high nibble], except for @special,
+   which is 63. */
+typedef struct _Base64Alphabet
 {
-  gchar* dst;
-  gint dstpos;
-  guchar input[3];
-  guchar output[4];
-  gint ocnt;
-  gint i;
+  const gchar*	chars;
+  const guchar*	rank;
+  gint8		encode_shift[16];
+  gint8		decode_lo[16];
+  gint8		decode_hi[16];
+  gint8		decode_shift[16];
+  guchar	special;
+
+} Base64Alphabet;
+
+static const Base64Alphabet base64_standard =
+{
+  gnet_Base64,
+  gnet_Base64_rank,
+  { 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 65, 0, 0 },
+  { 0x0b, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x03, 0x03, 0x07, 0x15, 0x17, 0x17, 0x17, 0x15 },
+  { 0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x08, 0x10,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 },
+  { 0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 },
+  '/'
+};
+
+static const Base64Alphabet base64_url =
+{
+  gnet_Base64_url,
+  gnet_Base64_url_rank,
+  { 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -17, 32, 65, 0, 0 },
+  { 0x0b, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x03, 0x03, 0x07, 0x37, 0x37, 0x35, 0x37, 0x27 },
+  { 0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x08, 0x20,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 },
+  { 0, 0, 17, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0 },
+  '_'
+};
+
+#define BASE64_ALPHABET(flags)	\
+  (((flags) & GNET_BASE64_FLAG_URL) ? &base64_url : &base64_standard)
+
+
+struct _GBase64Encoder
+{
+  const Base64Alphabet*	alphabet;
+  gboolean		strict;
+  gboolean		pad;
+  guint			column;		/* characters on the line */
+  guint8		tail[3];	/* bytes short of a group */
+  guint			n_tail;
+};
+
+struct _GBase64Decoder
+{
+  const Base64Alphabet*	alphabet;
+  gboolean		pad;		/* padding needed */
+  guint			state;		/* characters of the quantum seen */
+  guint8		res;		/* bits of the next byte */
+  gboolean		padded;		/* seen the = that ends the data */
+  gboolean		failed;
+};
+
+
+#ifdef HAVE_X86_SIMD
+
+/* The vector code converts 12 bytes to 16 characters and back in each
+   128-bit lane.  The encoder spreads the 6-bit values of each 3 bytes
+   over 4 bytes with a shuffle and two multiplies, then adds the shift
+   of each value's range.  The decoder checks a whole vector against
+   the alphabet with two nibble lookups, maps the characters to values
+   and packs them with two multiply-adds.  It skips a line break or
+   other junk between quanta, but leaves padding and junk inside a
+   quantum to the portable code. */
+
+#include <immintrin.h>
+#include "cpu-private.h"
+
+
+__attribute__ ((target ("ssse3")))
+static __m128i
+base64_encode_x16 (__m128i in, __m128i shift)
+{
+  __m128i v, range;
+
+  in = _mm_shuffle_epi8 (in, _mm_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4,
+					    7, 6, 8, 7, 10, 9, 11, 10));
+  v = _mm_or_si128
+    (_mm_mulhi_epu16 (_mm_and_si128 (in, _mm_set1_epi32 (0x0fc0fc00)),
+		      _mm_set1_epi32 (0x04000040)),
+     _mm_mullo_epi16 (_mm_and_si128 (in, _mm_set1_epi32 (0x003f03f0)),
+		      _mm_set1_epi32 (0x01000010)));
+
+  /* 0-25 to 13, 26-51 to 0, 52-63 to 1-12 */
+  range = _mm_subs_epu8 (v, _mm_set1_epi8 (51));
+  range = _mm_or_si128 (range, _mm_and_si128 (_mm_cmpgt_epi8 (_mm_set1_epi8 (26), v),
+					      _mm_set1_epi8 (13)));
+
+  return _mm_add_epi8 (v, _mm_shuffle_epi8 (shift, range));
+}
+
+
+__attribute__ ((target ("avx2")))
+static __m256i
+base64_encode_x32 (__m256i in, __m256i shift)
+{
+  __m256i v, range;
+
+  in = _mm256_shuffle_epi8 (in, _mm256_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4,
+						  7, 6, 8, 7, 10, 9, 11, 10,
+						  1, 0, 2, 1, 4, 3, 5, 4,
+						  7, 6, 8, 7, 10, 9, 11, 10));
+  v = _mm256_or_si256
+    (_mm256_mulhi_epu16 (_mm256_and_si256 (in, _mm256_set1_epi32 (0x0fc0fc00)),
+			 _mm256_set1_epi32 (0x04000040)),
+     _mm256_mullo_epi16 (_mm256_and_si256 (in, _mm256_set1_epi32 (0x003f03f0)),
+			 _mm256_set1_epi32 (0x01000010)));
+
+  range = _mm256_subs_epu8 (v, _mm256_set1_epi8 (51));
+  range = _mm256_or_si256 (range,
+			   _mm256_and_si256 (_mm256_cmpgt_epi8 (_mm256_set1_epi8 (26), v),
+					     _mm256_set1_epi8 (13)));
+
+  return _mm256_add_epi8 (v, _mm256_shuffle_epi8 (shift, range));
+}
+
+
+/* Each step reads 16 bytes and uses 12 */
+__attribute__ ((target ("ssse3")))
+static gsize
+base64_encode_ssse3 (const Base64Alphabet* alphabet, const guint8* src,
+		     gsize srclen, gchar* dst)
+{
+  __m128i shift = _mm_loadu_si128 ((const __m128i*) alphabet->encode_shift);
+  gsize done;
+
+  for (done = 0; done + 16 <= srclen; done += 12)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i*) (src + done));
+
+      _mm_storeu_si128 ((__m128i*) (dst + done / 3 * 4),
+			base64_encode_x16 (v, shift));
+    }
+
+  return done;
+}
+
+
+/* Each step reads 12 bytes into each lane, 28 in all, and uses 24 */
+__attribute__ ((target ("avx2")))
+static gsize
+base64_encode_avx2 (const Base64Alphabet* alphabet, const guint8* src,
+		    gsize srclen, gchar* dst)
+{
+  __m256i shift = _mm256_broadcastsi128_si256
+    (_mm_loadu_si128 ((const __m128i*) alphabet->encode_shift));
+  gsize done;
+
+  for (done = 0; done + 28 <= srclen; done += 24)
+    {
+      __m256i v;
+
+      v = _mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i*) (src + done)));
+      v = _mm256_inserti128_si256 (v, _mm_loadu_si128 ((const __m128i*) (src + done + 12)), 1);
+      _mm256_storeu_si256 ((__m256i*) (dst + done / 3 * 4),
+			   base64_encode_x32 (v, shift));
+    }
+
+  return done;
+}
+
+
+/* Encodes whole groups of @srclen; returns the bytes done */
+static gsize
+base64_encode_simd (const Base64Alphabet* alphabet, const guint8* src,
+		    gsize srclen, gchar* dst)
+{
+  guint features = _gnet_cpu_get_features ();
+  gsize done = 0;
+
+  if (features & GNET_CPU_AVX2)
+    done = base64_encode_avx2 (alphabet, src, srclen, dst);
+  if (features & GNET_CPU_SSSE3)
+    done += base64_encode_ssse3 (alphabet, src + done, srclen - done,
+				 dst + done / 3 * 4);
+
+  return done;
+}
+
+
+/* Decodes 16 characters to 12 bytes in the low 12 bytes.  Returns a
+   mask of the characters that are not in the alphabet; the bytes of
+   their quanta are garbage. */
+__attribute__ ((target ("ssse3")))
+static guint
+base64_decode_x16 (__m128i in, const Base64Alphabet* alphabet, __m128i* out)
+{
+  __m128i lo, hi, bad, special, v;
+
+  hi = _mm_and_si128 (_mm_srli_epi32 (in, 4), _mm_set1_epi8 (0x0f));
+  lo = _mm_and_si128 (in, _mm_set1_epi8 (0x0f));
+  bad = _mm_and_si128
+    (_mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i*) alphabet->decode_lo), lo),
+     _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i*) alphabet->decode_hi), hi));
+
+  v = _mm_add_epi8 (in, _mm_shuffle_epi8
+		    (_mm_loadu_si128 ((const __m128i*) alphabet->decode_shift), hi));
+  special = _mm_cmpeq_epi8 (in, _mm_set1_epi8 ((gchar) alphabet->special));
+  v = _mm_or_si128 (_mm_andnot_si128 (special, v),
+		    _mm_and_si128 (special, _mm_set1_epi8 (63)));
+
+  /* aaaaaa bbbbbb cccccc dddddd to aaaaaabb bbbbcccc ccdddddd */
+  v = _mm_maddubs_epi16 (v, _mm_set1_epi32 (0x01400140));
+  v = _mm_madd_epi16 (v, _mm_set1_epi32 (0x00011000));
+  *out = _mm_shuffle_epi8 (v, _mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9,
+					     8, 14, 13, 12, -1, -1, -1, -1));
+
+  return ~_mm_movemask_epi8 (_mm_cmpeq_epi8 (bad, _mm_setzero_si128 ())) & 0xFFFF;
+}
+
+
+/* Decodes 32 characters to 24 bytes in the low 24 bytes */
+__attribute__ ((target ("avx2")))
+static guint
+base64_decode_x32 (__m256i in, const Base64Alphabet* alphabet, __m256i* out)
+{
+  __m256i lo, hi, bad, special, v;
+
+#define LUT(t)	_mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i*) (t)))
+  hi = _mm256_and_si256 (_mm256_srli_epi32 (in, 4), _mm256_set1_epi8 (0x0f));
+  lo = _mm256_and_si256 (in, _mm256_set1_epi8 (0x0f));
+  bad = _mm256_and_si256 (_mm256_shuffle_epi8 (LUT (alphabet->decode_lo), lo),
+			  _mm256_shuffle_epi8 (LUT (alphabet->decode_hi), hi));
+
+  v = _mm256_add_epi8 (in, _mm256_shuffle_epi8 (LUT (alphabet->decode_shift), hi));
+#undef LUT
+  special = _mm256_cmpeq_epi8 (in, _mm256_set1_epi8 ((gchar) alphabet->special));
+  v = _mm256_blendv_epi8 (v, _mm256_set1_epi8 (63), special);
+
+  v = _mm256_maddubs_epi16 (v, _mm256_set1_epi32 (0x01400140));
+  v = _mm256_madd_epi16 (v, _mm256_set1_epi32 (0x00011000));
+  v = _mm256_shuffle_epi8 (v, _mm256_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9,
+						8, 14, 13, 12, -1, -1, -1, -1,
+						2, 1, 0, 6, 5, 4, 10, 9,
+						8, 14, 13, 12, -1, -1, -1, -1));
+  /* The 24 bytes together */
+  *out = _mm256_permutevar8x32_epi32 (v, _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 7, 7));
+
+  return ~(guint) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (bad, _mm256_setzero_si256 ()));
+}
 
-  g_return_val_if_fail (src != NULL, NULL);
-  g_return_val_if_fail (srclen >= 0, NULL);
-  g_return_val_if_fail (dstlenp != NULL, NULL);
 
-  if (srclen == 0) 
-    return g_strdup ("");
+/* Handles a vector with a character outside the alphabet at @pos.
+   The quanta before it are decoded; @decoded holds their bytes.  If
+   it starts a quantum and is not padding, as a line break does, it is
+   skipped and the vector code goes on after it.  Returns the
+   characters done, and 0 in @more if the portable code takes over. */
+static gsize
+base64_decode_skip (const guint8* src, guint pos, const guint8* decoded,
+		    guint8** out, gboolean* more)
+{
+  memcpy (*out, decoded, pos / 4 * 3);
+  *out += pos / 4 * 3;
+
+  *more = ((pos & 3) == 0 && src[pos] != gnet_Pad64);
+
+  return *more ? pos + 1 : pos & ~3;
+}
 
-  /* Calculate required length of dst.  4 bytes of dst are needed for
-     every 3 bytes of src. */
-  *dstlenp = (((srclen + 2) / 3) * 4)+5;
-  if (strict)
-    *dstlenp += (*dstlenp / 72);	/* Handle trailing \n */
 
-  dst = g_new(gchar, *dstlenp );
+/* Each step reads 16 characters and writes exactly 12 bytes */
+__attribute__ ((target ("ssse3")))
+static gsize
+base64_decode_ssse3 (const Base64Alphabet* alphabet, const guint8* src,
+		     gsize srclen, guint8** out)
+{
+  gboolean more = TRUE;
+  gsize done = 0;
 
-  /* bulk encoding */
-  dstpos = 0;
-  ocnt = 0;
-  while (srclen >= 3) 
+  while (more && done + 16 <= srclen)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i*) (src + done));
+      guint bad = base64_decode_x16 (v, alphabet, &v);
+
+      if (G_LIKELY (!bad))
+	{
+	  guint32 word = _mm_cvtsi128_si32 (_mm_srli_si128 (v, 8));
+
+	  _mm_storel_epi64 ((__m128i*) *out, v);
+	  memcpy (*out + 8, &word, 4);
+	  *out += 12;
+	  done += 16;
+	}
+      else
+	{
+	  guint8 decoded[16];
+
+	  _mm_storeu_si128 ((__m128i*) decoded, v);
+	  done += base64_decode_skip (src + done, __builtin_ctz (bad),
+				      decoded, out, &more);
+	}
+    }
+
+  return done;
+}
+
+
+/* Each step reads 32 characters and writes exactly 24 bytes */
+__attribute__ ((target ("avx2")))
+static gsize
+base64_decode_avx2 (const Base64Alphabet* alphabet, const guint8* src,
+		    gsize srclen, guint8** out)
+{
+  gboolean more = TRUE;
+  gsize done = 0;
+
+  while (more && done + 32 <= srclen)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i*) (src + done));
+      guint bad = base64_decode_x32 (v, alphabet, &v);
+
+      if (G_LIKELY (!bad))
+	{
+	  _mm_storeu_si128 ((__m128i*) *out, _mm256_castsi256_si128 (v));
+	  _mm_storel_epi64 ((__m128i*) (*out + 16), _mm256_extracti128_si256 (v, 1));
+	  *out += 24;
+	  done += 32;
+	}
+      else
+	{
+	  guint8 decoded[32];
+
+	  _mm256_storeu_si256 ((__m256i*) decoded, v);
+	  done += base64_decode_skip (src + done, __builtin_ctz (bad),
+				      decoded, out, &more);
+	}
+    }
+
+  return done;
+}
+
+
+/* Decodes whole quanta, skipping line breaks and other junk between
+   them, up to padding or anything else it cannot handle.  Returns
+   the characters done and moves @out past the bytes written. */
+static gsize
+base64_decode_simd (const Base64Alphabet* alphabet, const guint8* src,
+		    gsize srclen, guint8** out)
+{
+  guint features = _gnet_cpu_get_features ();
+  gsize done = 0;
+
+  if (features & GNET_CPU_AVX2)
+    done = base64_decode_avx2 (alphabet, src, srclen, out);
+  if (features & GNET_CPU_SSSE3)
+    done += base64_decode_ssse3 (alphabet, src + done, srclen - done, out);
+
+  return done;
+}
+
+#endif /* HAVE_X86_SIMD */
+
+
+/* Encodes @srclen bytes, a multiple of 3, to @srclen / 3 * 4
+   characters */
+static void
+base64_encode_groups (const Base64Alphabet* alphabet, const guint8* src,
+		      gsize srclen, gchar* dst)
+{
+  const gchar* chars = alphabet->chars;
+  gsize done = 0;
+
+#ifdef HAVE_X86_SIMD
+  done = base64_encode_simd (alphabet, src, srclen, dst);
+  dst += done / 3 * 4;
+#endif
+
+  for (; done < srclen; done += 3)
     {
       /*
 	Convert 3 bytes of src to 4 bytes of output
@@ -115,59 +478,370 @@ gnet_base64_encode (const gchar* src, gint srclen, gint* dstlenp, gboolean stric
 	output[3] = input[1] 5:0
 
        */
-      input[0] = *src++;
-      input[1] = *src++;
-      input[2] = *src++;
-      srclen -= 3;
-
-      output[0] = (input[0] >> 2);
-      output[1] = ((input[0] & 0x03) << 4) + (input[1] >> 4);
-      output[2] = ((input[1] & 0x0f) << 2) + (input[2] >> 6);
-      output[3] = (input[2] & 0x3f);
-
-      g_assert ((dstpos + 4) < *dstlenp);
-
-      /* Map output to the Base64 alphabet */
-      dst[dstpos++] = gnet_Base64[(guint) output[0]];
-      dst[dstpos++] = gnet_Base64[(guint) output[1]];
-      dst[dstpos++] = gnet_Base64[(guint) output[2]];
-      dst[dstpos++] = gnet_Base64[(guint) output[3]];
-
-      /* Add a newline if strict and  */
-      if (strict)
-	if ((++ocnt % (72/4)) == 0) 
-	  dst[dstpos++] = '\n';
+      guint input = (src[done] << 16) | (src[done + 1] << 8) | src[done + 2];
+
+      *dst++ = chars[input >> 18];
+      *dst++ = chars[(input >> 12) & 0x3f];
+      *dst++ = chars[(input >> 6) & 0x3f];
+      *dst++ = chars[input & 0x3f];
+    }
+}
+
+
+/* Encodes @n_groups whole groups, breaking the lines if strict.
+   Returns the characters written. */
+static gsize
+base64_encoder_put (GBase64Encoder* encoder, const guint8* src,
+		    gsize n_groups, gchar* dst)
+{
+  gchar* start = dst;
+
+  if (!encoder->strict)
+    {
+      base64_encode_groups (encoder->alphabet, src, n_groups * 3, dst);
+      return n_groups * 4;
     }
 
-  /* Now worry about padding with remaining 1 or 2 bytes */
-  if (srclen != 0) 
+  while (n_groups > 0)
     {
-      input[0] = input[1] = input[2] = '\0';
-      for (i = 0; i < srclen; i++) 
-	input[i] = *src++;
+      gsize n;
 
-      output[0] = (input[0] >> 2);
-      output[1] = ((input[0] & 0x03) << 4) + (input[1] >> 4);
-      output[2] = ((input[1] & 0x0f) << 2) + (input[2] >> 6);
+      /* Whole lines a batch at a time, so the vector code gets long
+	 runs */
+      if (encoder->column == 0 && n_groups >= BASE64_LINE / 4)
+	{
+	  gchar lines[BASE64_BATCH_LINES * BASE64_LINE];
+	  gsize i;
 
-      g_assert ((dstpos + 4) < *dstlenp);
+	  n = MIN (n_groups / (BASE64_LINE / 4), BASE64_BATCH_LINES);
+	  base64_encode_groups (encoder->alphabet, src, n * BASE64_LINE / 4 * 3,
+				lines);
+	  for (i = 0; i < n; ++i)
+	    {
+	      memcpy (dst, lines + i * BASE64_LINE, BASE64_LINE);
+	      dst[BASE64_LINE] = '\n';
+	      dst += BASE64_LINE + 1;
+	    }
+	  src += n * BASE64_LINE / 4 * 3;
+	  n_groups -= n * BASE64_LINE / 4;
+	  continue;
+	}
 
-      dst[dstpos++] = gnet_Base64[(guint) output[0]];
-      dst[dstpos++] = gnet_Base64[(guint) output[1]];
+      /* The rest of a line.  A line break follows every full line,
+	 even the last. */
+      n = MIN (n_groups, (BASE64_LINE - encoder->column) / 4);
+      base64_encode_groups (encoder->alphabet, src, n * 3, dst);
+      src += n * 3;
+      dst += n * 4;
+      n_groups -= n;
 
-      if (srclen == 1)
-	dst[dstpos++] = gnet_Pad64;
-      else
-	dst[dstpos++] = gnet_Base64[(guint) output[2]];
+      encoder->column += n * 4;
+      if (encoder->column == BASE64_LINE)
+	{
+	  *dst++ = '\n';
+	  encoder->column = 0;
+	}
+    }
+
+  return dst - start;
+}
+
+
+static void
+base64_encoder_init (GBase64Encoder* encoder, GBase64Flags flags)
+{
+  encoder->alphabet = BASE64_ALPHABET (flags);
+  encoder->strict = (flags & GNET_BASE64_FLAG_STRICT) != 0;
+  encoder->pad = (flags & GNET_BASE64_FLAG_URL) == 0;
+  encoder->column = 0;
+  encoder->n_tail = 0;
+}
+
+
+static gsize
+base64_encoder_update (GBase64Encoder* encoder, const guint8* src,
+		       gsize srclen, gchar* dst)
+{
+  gsize written = 0;
+
+  /* Finish the group the last update left */
+  if (encoder->n_tail > 0)
+    {
+      while (encoder->n_tail < 3 && srclen > 0)
+	{
+	  encoder->tail[encoder->n_tail++] = *src++;
+	  --srclen;
+	}
+      if (encoder->n_tail < 3)
+	return 0;
+
+      written = base64_encoder_put (encoder, encoder->tail, 1, dst);
+      encoder->n_tail = 0;
+    }
+
+  written += base64_encoder_put (encoder, src, srclen / 3, dst + written);
+
+  encoder->n_tail = srclen % 3;
+  memcpy (encoder->tail, src + srclen - encoder->n_tail, encoder->n_tail);
+
+  return written;
+}
+
+
+/* Encodes the last 1 or 2 bytes, padded unless the alphabet is
+   base64url, without a line break after them */
+static gsize
+base64_encoder_final (GBase64Encoder* encoder, gchar* dst)
+{
+  const gchar* chars = encoder->alphabet->chars;
+  gsize written = 0;
+
+  if (encoder->n_tail > 0)
+    {
+      guint8 b0 = encoder->tail[0];
+      guint8 b1 = (encoder->n_tail > 1) ? encoder->tail[1] : 0;
+
+      dst[written++] = chars[b0 >> 2];
+      dst[written++] = chars[((b0 & 0x03) << 4) | (b1 >> 4)];
+      if (encoder->n_tail > 1)
+	dst[written++] = chars[(b1 & 0x0f) << 2];
+      else if (encoder->pad)
+	dst[written++] = gnet_Pad64;
+      if (encoder->pad)
+	dst[written++] = gnet_Pad64;
+    }
 
-      dst[dstpos++] = gnet_Pad64;
+  encoder->column = 0;
+  encoder->n_tail = 0;
+
+  return written;
+}
+
+
+static void
+base64_decoder_init (GBase64Decoder* decoder, GBase64Flags flags)
+{
+  decoder->alphabet = BASE64_ALPHABET (flags);
+  decoder->pad = (flags & GNET_BASE64_FLAG_URL) == 0;
+  decoder->state = 0;
+  decoder->res = 0;
+  decoder->padded = FALSE;
+  decoder->failed = FALSE;
+}
+
+
+/* Decodes what it can of @src into @dst and sets @dstlenp to the
+   bytes written.  Characters outside the alphabet are skipped.  An =
+   ends the data if it follows the second or third character of a
+   quantum; it is an error anywhere else, as is data after it. */
+static gboolean
+base64_decoder_update (GBase64Decoder* decoder, const guint8* src,
+		       gsize srclen, guint8* dst, gsize* dstlenp)
+{
+  const guchar* rank = decoder->alphabet->rank;
+  const guint8* end = src + srclen;
+  guint8* start = dst;
+  guint state = decoder->state;
+  guint8 res = decoder->res;
+
+  if (decoder->failed)
+    return FALSE;
+
+  while (src < end)
+    {
+      gboolean skipped = FALSE;
+
+      /* Whole quanta, if the last update did not stop in one */
+      if (state == 0 && !decoder->padded)
+	{
+#ifdef HAVE_X86_SIMD
+	  src += base64_decode_simd (decoder->alphabet, src, end - src, &dst);
+#endif
+
+	  while (end - src >= 4)
+	    {
+	      guint a = rank[src[0]], b = rank[src[1]];
+	      guint c = rank[src[2]], d = rank[src[3]];
+
+	      if ((a | b | c | d) > 63)
+		break;
+	      dst[0] = (a << 2) | (b >> 4);
+	      dst[1] = (b << 4) | (c >> 2);
+	      dst[2] = (c << 6) | d;
+	      src += 4;
+	      dst += 3;
+	    }
+	}
+
+      /* One character at a time past the next character outside the
+	 alphabet, and on to the end of the quantum */
+      while (src < end && !(skipped && state == 0))
+	{
+	  guchar ch = *src++;
+	  guchar pos = rank[ch];
+
+	  if (pos == 255)
+	    {
+	      skipped = TRUE;
+	      if (ch != gnet_Pad64 || decoder->padded)
+		continue;
+
+	      /* Invalid = in first or second position */
+	      if (state < 2)
+		goto fail;
+	      decoder->padded = TRUE;
+	      continue;
+	    }
+
+	  if (decoder->padded)
+	    goto fail;
+
+	  switch (state)
+	    {
+	    case 0:
+	      res = pos << 2;
+	      state = 1;
+	      break;
+	    case 1:
+	      *dst++ = res | (pos >> 4);
+	      res = (pos & 0x0f) << 4;
+	      state = 2;
+	      break;
+	    case 2:
+	      *dst++ = res | (pos >> 2);
+	      res = (pos & 0x03) << 6;
+	      state = 3;
+	      break;
+	    case 3:
+	      *dst++ = res | pos;
+	      state = 0;
+	      break;
+	    }
+	}
     }
 
-  g_assert (dstpos <= *dstlenp);
+  decoder->state = state;
+  decoder->res = res;
+  *dstlenp = dst - start;
+
+  return TRUE;
+
+ fail:
+  decoder->failed = TRUE;
+  *dstlenp = dst - start;
+
+  return FALSE;
+}
+
+
+/* Checks that the data ended on a byte boundary, or was padded if it
+   needs to be, and that the bits past the last byte are zero.  If we
+   didn't check them, they would become a subliminal channel. */
+static gboolean
+base64_decoder_final (GBase64Decoder* decoder)
+{
+  gboolean ok;
+
+  if (decoder->failed)
+    ok = FALSE;
+  else if (decoder->padded || (!decoder->pad && decoder->state >= 2))
+    ok = (decoder->res == 0);
+  else
+    ok = (decoder->state == 0);
+
+  decoder->state = 0;
+  decoder->res = 0;
+  decoder->padded = FALSE;
+  decoder->failed = FALSE;
+
+  return ok;
+}
+
+
+
+static gsize
+base64_encode_length (gsize srclen, GBase64Flags flags)
+{
+  gsize length;
+
+  /* 4 characters for every 3 bytes, fewer for the last bytes if
+     there is no padding */
+  if (flags & GNET_BASE64_FLAG_URL)
+    length = srclen / 3 * 4 + (srclen % 3 ? srclen % 3 + 1 : 0);
+  else
+    length = (srclen + 2) / 3 * 4;
+
+  /* A newline after every 18 whole groups if strict */
+  if (flags & GNET_BASE64_FLAG_STRICT)
+    length += srclen / 3 / (BASE64_LINE / 4);
+
+  return length;
+}
+
+
+static gsize
+base64_encode (const gchar* src, gsize srclen, gchar* dst,
+	       GBase64Flags flags)
+{
+  GBase64Encoder encoder;
+  gsize dstlen;
+
+  base64_encoder_init (&encoder, flags);
+  dstlen = base64_encoder_update (&encoder, (const guint8*) src, srclen, dst);
+  dstlen += base64_encoder_final (&encoder, dst + dstlen);
+
+  return dstlen;
+}
+
+
+static gboolean
+base64_decode (const gchar* src, gsize srclen, gchar* dst, gsize* dstlenp,
+	       GBase64Flags flags)
+{
+  GBase64Decoder decoder;
+
+  base64_decoder_init (&decoder, flags);
+
+  return base64_decoder_update (&decoder, (const guint8*) src, srclen,
+				(guint8*) dst, dstlenp) &&
+    base64_decoder_final (&decoder);
+}
+
+
+
+/**
+ *  gnet_base64_encode
+ *  @src: source buffer
+ *  @srclen: length of the source buffer
+ *  @dstlenp: length of the buffer returned (including the terminating \0)
+ *  @strict: insert new lines as required by RFC 2045
+ *
+ *  Convert a buffer from binary to base64 representation.  Set
+ *  @strict to TRUE to insert a newline every 72th character.  This is
+ *  required by RFC 2045, but some applications don't require this.
+ *
+ *  If @srclen is 0, an empty string will be returned (not NULL).
+ *
+ *  Returns: a newly-allocated and NUL-terminated string containing the
+ *  input data in base64 coding. Free with g_free() when no longer needed.
+ *
+ **/
+gchar*
+gnet_base64_encode (const gchar* src, gint srclen, gint* dstlenp, gboolean strict) 
+{
+  GBase64Flags flags = strict ? GNET_BASE64_FLAG_STRICT : 0;
+  gchar* dst;
+  gsize dstlen;
+
+  g_return_val_if_fail (src != NULL, NULL);
+  g_return_val_if_fail (srclen >= 0, NULL);
+  g_return_val_if_fail (dstlenp != NULL, NULL);
 
-  dst[dstpos] = '\0';
+  dst = g_new (gchar, base64_encode_length (srclen, flags) + 1);
+  dstlen = base64_encode (src, srclen, dst, flags);
+  dst[dstlen] = '\0';
 
-  *dstlenp = dstpos + 1;
+  *dstlenp = dstlen + 1;
 
   return dst;
 }
@@ -181,20 +855,27 @@ gnet_base64_encode (const gchar* src, gint srclen, gint* dstlenp, gboolean stric
  *
  *  Convert a buffer from base64 to binary representation.  This
  *  function is liberal in what it will accept.  It ignores non-base64
- *  symbols.
+ *  symbols, such as line breaks and spaces, anywhere in @src.
+ *
+ *  Padding ends the data.  A = may only follow the second or third
+ *  character of a group of four, and only non-base64 symbols may
+ *  follow the padding.  Data that does not end on a whole group must
+ *  be padded, and the bits of its last character that do not make up
+ *  a byte must be zero.  Before 2.0.9, = was skipped like any other
+ *  non-base64 symbol, so "QUJD=QUJD" decoded to "ABCABC", and a
+ *  padded buffer was only accepted if its last character was =, so
+ *  "QQ==\n" was rejected.
  *
  *  Returns: newly-allocated buffer. Free with g_free() when no longer
  *  needed. The integer pointed to by @dstlenp is set to the length of
- *  that buffer. 
+ *  that buffer.  NULL if @src is not valid base64.
  *
  **/
 gchar* 
 gnet_base64_decode (const gchar* src, gint srclen, gint* dstlenp)
 {
   gchar* dst;
-  gint   dstidx, state, ch = 0;
-  gchar  res;
-  guchar pos;
+  gsize dstlen;
 
   g_return_val_if_fail (src != NULL, NULL);
   g_return_val_if_fail (dstlenp != NULL, NULL);
@@ -202,132 +883,340 @@ gnet_base64_decode (const gchar* src, gint srclen, gint* dstlenp)
   if (srclen <= 0) 
     srclen = strlen(src);
 
-  state = 0;
-  dstidx = 0;
-  res = 0;
+  dst = g_new (gchar, srclen / 4 * 3 + 3);
 
-  dst = g_new(gchar, srclen+1);
-  *dstlenp = srclen+1;
-
-  while (srclen-- > 0) 
+  if (!base64_decode (src, srclen, dst, &dstlen, 0))
     {
-      ch = *src++;
-      if (gnet_Base64_rank[ch]==255) /* Skip any non-base64 anywhere */
-	continue;
-      if (ch == gnet_Pad64) 
-	break;
+      g_free (dst);
+      *dstlenp = 0;
+      return NULL;
+    }
 
-      pos = gnet_Base64_rank[ch];
+  dst[dstlen] = 0;
+  *dstlenp = dstlen;
 
-      switch (state) 
-	{
-	case 0:
-	  if (dst != NULL) 
-	    {
-	      dst[dstidx] = (pos << 2);
-	    }
-	  state = 1;
-	  break;
-	case 1:
-	  if (dst != NULL) 
-	    {
-	      dst[dstidx] |= (pos >> 4);
-	      res = ((pos & 0x0f) << 4);
-	    }
-	  dstidx++;
-	  state = 2;
-	  break;
-	case 2:
-	  if (dst != NULL) 
-	    {
-	      dst[dstidx] = res | (pos >> 2);
-	      res = (pos & 0x03) << 6;
-	    }
-	  dstidx++;
-	  state = 3;
-	  break;
-	case 3:
-	  if (dst != NULL) 
-	    {
-	      dst[dstidx] = res | pos;
-	    }
-	  dstidx++;
-	  state = 0;
-	  break;
-	default:
-	  break;
-	}
-    }
-  /*
-   * We are done decoding Base-64 chars.  Let's see if we ended
-   * on a byte boundary, and/or with erroneous trailing characters.
-   */
-  if (ch == gnet_Pad64)           /* We got a pad char. */
-    {
-      switch (state) 
-	{
-	case 0:             /* Invalid = in first position */
-	case 1:             /* Invalid = in second position */
-	  return NULL;
-	case 2:             /* Valid, means one byte of info */
-                                /* Skip any number of spaces. */
-	  while (srclen-- > 0) 
-	    {
-	      ch = *src++;
-	      if (gnet_Base64_rank[ch] != 255) break;
-	    }
-                                /* Make sure there is another trailing = sign. */
-	  if (ch != gnet_Pad64) 
-	    {
-	      g_free(dst);
-	      *dstlenp = 0;
-	      return NULL;
-	    }
-                                /* FALLTHROUGH */
-	case 3:             /* Valid, means two bytes of info */
-                                /*
-                                 * We know this char is an =.  Is there anything but
-                                 * whitespace after it?
-                                 */
-	  while (srclen-- > 0) 
-	    {
-	      ch = *src++;
-	      if (gnet_Base64_rank[ch] != 255) 
-		{
-		  g_free(dst);
-		  *dstlenp = 0;
-		  return NULL;
-		}
-	    }
-                                /*
-                                 * Now make sure for cases 2 and 3 that the "extra"
-                                 * bits that slopped past the last full byte were
-                                 * zeros.  If we don't check them, they become a
-                                 * subliminal channel.
-                                 */
-	  if (dst != NULL && res != 0) 
-	    {
-	      g_free(dst);
-	      *dstlenp = 0;
-	      return NULL;
-	    }
-	default:
-	  break;
-	}
-    } else 
-      {
-	/*
-	 * We ended by seeing the end of the string.  Make sure we
-	 * have no partial bytes lying around.
-	 */
-	if (state != 0) 
-	  {
-	    g_free(dst);
-	    *dstlenp = 0;
-	    return NULL;
-	  }
-      }
-  dst[dstidx]=0;
-  *dstlenp = dstidx;
   return dst;
 }
+
+
+/**
+ *  gnet_base64_encode_length
+ *  @srclen: length of the data
+ *  @flags: #GBase64Flags
+ *
+ *  Gets the number of characters gnet_base64_encode_into() writes
+ *  for @srclen bytes, without a terminating NUL.
+ *
+ *  Returns: the length of the base64 encoding.
+ *
+ *  Since: 2.0.9
+ **/
+gsize
+gnet_base64_encode_length (gsize srclen, GBase64Flags flags)
+{
+  return base64_encode_length (srclen, flags);
+}
+
+
+/**
+ *  gnet_base64_encode_into
+ *  @src: source buffer
+ *  @srclen: length of @src
+ *  @dst: buffer for the base64 characters
+ *  @flags: #GBase64Flags
+ *
+ *  Encodes @src to base64 in @dst, which the caller provides.  @dst
+ *  must have room for gnet_base64_encode_length() characters.  It is
+ *  not NUL-terminated.
+ *
+ *  Returns: the number of characters written to @dst.
+ *
+ *  Since: 2.0.9
+ **/
+gsize
+gnet_base64_encode_into (const gchar* src, gsize srclen, gchar* dst,
+			 GBase64Flags flags)
+{
+  g_return_val_if_fail (src || !srclen, 0);
+  g_return_val_if_fail (dst, 0);
+
+  return base64_encode (src, srclen, dst, flags);
+}
+
+
+/**
+ *  gnet_base64_decode_length
+ *  @src: base64 characters
+ *  @srclen: length of @src
+ *  @flags: #GBase64Flags
+ *
+ *  Gets the number of bytes gnet_base64_decode_into() writes for
+ *  @src if it is valid.  The characters outside the alphabet are not
+ *  counted, so this reads all of @src.  (@srclen / 4 + 1) * 3 bytes
+ *  are always enough.
+ *
+ *  Returns: the length of the decoded data.
+ *
+ *  Since: 2.0.9
+ **/
+gsize
+gnet_base64_decode_length (const gchar* src, gsize srclen,
+			   GBase64Flags flags)
+{
+  const guchar* rank = BASE64_ALPHABET (flags)->rank;
+  gsize n = 0;
+  gsize i;
+
+  g_return_val_if_fail (src || !srclen, 0);
+
+  for (i = 0; i < srclen; ++i)
+    n += (rank[(guchar) src[i]] != 255);
+
+  return n / 4 * 3 + (n % 4 ? n % 4 - 1 : 0);
+}
+
+
+/**
+ *  gnet_base64_decode_into
+ *  @src: base64 characters
+ *  @srclen: length of @src
+ *  @dst: buffer for the decoded bytes
+ *  @dstlenp: where to return the number of bytes written to @dst
+ *  @flags: #GBase64Flags
+ *
+ *  Decodes @src into @dst, which the caller provides.  @dst must have
+ *  room for gnet_base64_decode_length() bytes.  Like
+ *  gnet_base64_decode(), this ignores non-base64 symbols.  base64url
+ *  (with #GNET_BASE64_FLAG_URL) may or may not be padded.
+ *
+ *  Returns: FALSE if @src is not valid base64.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_base64_decode_into (const gchar* src, gsize srclen, gchar* dst,
+			 gsize* dstlenp, GBase64Flags flags)
+{
+  g_return_val_if_fail (src || !srclen, FALSE);
+  g_return_val_if_fail (dst, FALSE);
+  g_return_val_if_fail (dstlenp, FALSE);
+
+  return base64_decode (src, srclen, dst, dstlenp, flags);
+}
+
+
+/**
+ *  gnet_base64_encoder_new
+ *  @strict: insert new lines as required by RFC 2045
+ *
+ *  Creates a #GBase64Encoder, which encodes data to base64 a piece at
+ *  a time, for example as it is read from or written to a #GConn.
+ *  The result is the same as gnet_base64_encode() of all the data.
+ *
+ *  Returns: a new #GBase64Encoder.
+ *
+ *  Since: 2.0.9
+ **/
+GBase64Encoder*
+gnet_base64_encoder_new (gboolean strict)
+{
+  return gnet_base64_encoder_new_full (strict ? GNET_BASE64_FLAG_STRICT : 0);
+}
+
+
+/**
+ *  gnet_base64_encoder_new_full
+ *  @flags: #GBase64Flags
+ *
+ *  Creates a #GBase64Encoder like gnet_base64_encoder_new(), with the
+ *  line breaks and alphabet of @flags.
+ *
+ *  Returns: a new #GBase64Encoder.
+ *
+ *  Since: 2.0.9
+ **/
+GBase64Encoder*
+gnet_base64_encoder_new_full (GBase64Flags flags)
+{
+  GBase64Encoder* encoder;
+
+  encoder = g_new (GBase64Encoder, 1);
+  base64_encoder_init (encoder, flags);
+
+  return encoder;
+}
+
+
+/**
+ *  gnet_base64_encoder_delete
+ *  @encoder: a #GBase64Encoder
+ *
+ *  Deletes a #GBase64Encoder.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_base64_encoder_delete (GBase64Encoder* encoder)
+{
+  g_free (encoder);
+}
+
+
+/**
+ *  gnet_base64_encoder_update
+ *  @encoder: a #GBase64Encoder
+ *  @src: source buffer
+ *  @srclen: length of @src
+ *  @dst: buffer for the base64 characters
+ *
+ *  Encodes @src, which follows the data of the earlier updates.  Up
+ *  to two bytes are kept until the next update or
+ *  gnet_base64_encoder_final().  @dst must have room for (@srclen /
+ *  3 + 1) * 4 bytes, and @srclen / 54 + 1 more if @encoder is strict.
+ *  It is not NUL-terminated.
+ *
+ *  Returns: the number of characters written to @dst.
+ *
+ *  Since: 2.0.9
+ **/
+gsize
+gnet_base64_encoder_update (GBase64Encoder* encoder, const gchar* src,
+			    gsize srclen, gchar* dst)
+{
+  g_return_val_if_fail (encoder, 0);
+  g_return_val_if_fail (src || !srclen, 0);
+  g_return_val_if_fail (dst, 0);
+
+  return base64_encoder_update (encoder, (const guint8*) src, srclen, dst);
+}
+
+
+/**
+ *  gnet_base64_encoder_final
+ *  @encoder: a #GBase64Encoder
+ *  @dst: buffer for the last base64 characters, at least 4 bytes
+ *
+ *  Encodes the bytes kept by the last update, with padding unless
+ *  the encoder is for base64url.  @dst is not NUL-terminated.
+ *  @encoder can then be used for new data.
+ *
+ *  Returns: the number of characters written to @dst.
+ *
+ *  Since: 2.0.9
+ **/
+gsize
+gnet_base64_encoder_final (GBase64Encoder* encoder, gchar* dst)
+{
+  g_return_val_if_fail (encoder, 0);
+  g_return_val_if_fail (dst, 0);
+
+  return base64_encoder_final (encoder, dst);
+}
+
+
+/**
+ *  gnet_base64_decoder_new
+ *
+ *  Creates a #GBase64Decoder, which decodes base64 data a piece at a
+ *  time.  Like gnet_base64_decode(), it ignores non-base64 symbols,
+ *  such as line breaks.
+ *
+ *  Returns: a new #GBase64Decoder.
+ *
+ *  Since: 2.0.9
+ **/
+GBase64Decoder*
+gnet_base64_decoder_new (void)
+{
+  return gnet_base64_decoder_new_full (0);
+}
+
+
+/**
+ *  gnet_base64_decoder_new_full
+ *  @flags: #GBase64Flags
+ *
+ *  Creates a #GBase64Decoder like gnet_base64_decoder_new(), for the
+ *  alphabet of @flags.  #GNET_BASE64_FLAG_STRICT makes no difference.
+ *
+ *  Returns: a new #GBase64Decoder.
+ *
+ *  Since: 2.0.9
+ **/
+GBase64Decoder*
+gnet_base64_decoder_new_full (GBase64Flags flags)
+{
+  GBase64Decoder* decoder;
+
+  decoder = g_new (GBase64Decoder, 1);
+  base64_decoder_init (decoder, flags);
+
+  return decoder;
+}
+
+
+/**
+ *  gnet_base64_decoder_delete
+ *  @decoder: a #GBase64Decoder
+ *
+ *  Deletes a #GBase64Decoder.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_base64_decoder_delete (GBase64Decoder* decoder)
+{
+  g_free (decoder);
+}
+
+
+/**
+ *  gnet_base64_decoder_update
+ *  @decoder: a #GBase64Decoder
+ *  @src: base64 characters
+ *  @srclen: length of @src
+ *  @dst: buffer for the decoded bytes
+ *  @dstlenp: where to return the number of bytes written to @dst
+ *
+ *  Decodes @src, which follows the characters of the earlier updates.
+ *  @dst must have room for (@srclen / 4 + 1) * 3 bytes.  Once this
+ *  fails, so does every update until gnet_base64_decoder_final().
+ *
+ *  Returns: FALSE if the data is not valid base64: there is padding
+ *  where there can be none, or data after it.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_base64_decoder_update (GBase64Decoder* decoder, const gchar* src,
+			    gsize srclen, gchar* dst, gsize* dstlenp)
+{
+  g_return_val_if_fail (decoder, FALSE);
+  g_return_val_if_fail (src || !srclen, FALSE);
+  g_return_val_if_fail (dst, FALSE);
+  g_return_val_if_fail (dstlenp, FALSE);
+
+  return base64_decoder_update (decoder, (const guint8*) src, srclen,
+				(guint8*) dst, dstlenp);
+}
+
+
+/**
+ *  gnet_base64_decoder_final
+ *  @decoder: a #GBase64Decoder
+ *
+ *  Checks the end of the data.  @decoder can then be used for new
+ *  data.
+ *
+ *  Returns: TRUE if all the data was valid base64 and it did not end
+ *  part way through a byte.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_base64_decoder_final (GBase64Decoder* decoder)
+{
+  g_return_val_if_fail (decoder, FALSE);
+
+  return base64_decoder_final (decoder);
+}
@@ -26,10 +26,69 @@
 
 G_BEGIN_DECLS
 
+/**
+ *  GBase64Flags
+ *  @GNET_BASE64_FLAG_STRICT: insert new lines as required by RFC 2045
+ *  @GNET_BASE64_FLAG_URL: use the base64url alphabet of RFC 4648,
+ *  with - and _ for + and /, and no padding
+ *
+ *  Flags for the base64 functions.
+ *
+ *  Since: 2.0.9
+ **/
+typedef enum
+{
+  GNET_BASE64_FLAG_STRICT	= 1 << 0,
+  GNET_BASE64_FLAG_URL		= 1 << 1
+} GBase64Flags;
+
+/**
+ *  GBase64Encoder
+ *
+ *  Base64 encoder state for data that comes a piece at a time.
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GBase64Encoder GBase64Encoder;
+
+/**
+ *  GBase64Decoder
+ *
+ *  Base64 decoder state for data that comes a piece at a time.
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GBase64Decoder GBase64Decoder;
+
 gchar * gnet_base64_encode (const gchar * src, gint srclen, gint * dstlenp, gboolean strict);
 
 gchar * gnet_base64_decode (const gchar * src, gint srclen, gint * dstlenp);
 
+gsize    gnet_base64_encode_length (gsize srclen, GBase64Flags flags);
+gsize    gnet_base64_encode_into (const gchar * src, gsize srclen, gchar * dst,
+                                  GBase64Flags flags);
+
+gsize    gnet_base64_decode_length (const gchar * src, gsize srclen,
+                                    GBase64Flags flags);
+gboolean gnet_base64_decode_into (const gchar * src, gsize srclen, gchar * dst,
+                                  gsize * dstlenp, GBase64Flags flags);
+
+GBase64Encoder * gnet_base64_encoder_new (gboolean strict);
+GBase64Encoder * gnet_base64_encoder_new_full (GBase64Flags flags);
+void             gnet_base64_encoder_delete (GBase64Encoder * encoder);
+gsize            gnet_base64_encoder_update (GBase64Encoder * encoder,
+                                             const gchar * src, gsize srclen,
+                                             gchar * dst);
+gsize            gnet_base64_encoder_final (GBase64Encoder * encoder, gchar * dst);
+
+GBase64Decoder * gnet_base64_decoder_new (void);
+GBase64Decoder * gnet_base64_decoder_new_full (GBase64Flags flags);
+void             gnet_base64_decoder_delete (GBase64Decoder * decoder);
+gboolean         gnet_base64_decoder_update (GBase64Decoder * decoder,
+                                             const gchar * src, gsize srclen,
+                                             gchar * dst, gsize * dstlenp);
+gboolean         gnet_base64_decoder_final (GBase64Decoder * decoder);
+
 G_END_DECLS
 
 #endif /* _GNET_BASE64_H */
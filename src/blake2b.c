@@ -0,0 +1,571 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#include "gnet-private.h"
+#include "blake2b.h"
+#include "hash-private.h"
+
+#include <string.h>
+
+
+/* BLAKE2b (RFC 7693), unkeyed, with a 64-byte digest */
+
+#define BLAKE2B_BLOCK	128
+#define BLAKE2B_ROUNDS	12
+
+typedef struct _BLAKE2bContext
+{
+  guint64	h[8];
+  guint64	t[2];			/* bytes compressed, 128-bit */
+  guint8	buffer[BLAKE2B_BLOCK];	/* last block, full or not */
+  gsize		used;			/* bytes in buffer */
+
+} BLAKE2bContext;
+
+/* Compresses one block into @h.  @t is the byte count including this
+   block; @last is TRUE for the final block. */
+typedef void (*BLAKE2bCompressFunc) (guint64* h, const guint8* block,
+				     const guint64* t, gboolean last);
+
+/* The SHA-512 initial values */
+static const guint64 blake2b_iv[8] =
+{
+  G_GUINT64_CONSTANT (0x6a09e667f3bcc908), G_GUINT64_CONSTANT (0xbb67ae8584caa73b),
+  G_GUINT64_CONSTANT (0x3c6ef372fe94f82b), G_GUINT64_CONSTANT (0xa54ff53a5f1d36f1),
+  G_GUINT64_CONSTANT (0x510e527fade682d1), G_GUINT64_CONSTANT (0x9b05688c2b3e6c1f),
+  G_GUINT64_CONSTANT (0x1f83d9abfb41bd6b), G_GUINT64_CONSTANT (0x5be0cd19137e2179)
+};
+
+/* Message word order of each round; rounds 10 and 11 repeat 0 and 1 */
+static const guint8 blake2b_sigma[10][16] =
+{
+  {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+  { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+  { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+  {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+  {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+  {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+  { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+  { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+  {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+  { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 }
+};
+
+
+#define ROTR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+#define G(a, b, c, d, x, y)			\
+  G_STMT_START {				\
+    a = a + b + (x);				\
+    d = ROTR64 (d ^ a, 32);			\
+    c = c + d;					\
+    b = ROTR64 (b ^ c, 24);			\
+    a = a + b + (y);				\
+    d = ROTR64 (d ^ a, 16);			\
+    c = c + d;					\
+    b = ROTR64 (b ^ c, 63);			\
+  } G_STMT_END
+
+
+static void
+blake2b_compress (guint64* h, const guint8* block, const guint64* t,
+		  gboolean last)
+{
+  guint64 v[16];
+  guint64 m[16];
+  guint i;
+
+  for (i = 0; i < 16; ++i)
+    {
+      memcpy (&m[i], block + 8 * i, 8);
+      m[i] = GUINT64_FROM_LE (m[i]);
+    }
+
+  memcpy (v, h, 8 * sizeof (guint64));
+  memcpy (v + 8, blake2b_iv, 8 * sizeof (guint64));
+  v[12] ^= t[0];
+  v[13] ^= t[1];
+  if (last)
+    v[14] = ~v[14];
+
+  for (i = 0; i < BLAKE2B_ROUNDS; ++i)
+    {
+      const guint8* s = blake2b_sigma[i % 10];
+
+      G (v[0], v[4], v[ 8], v[12], m[s[ 0]], m[s[ 1]]);
+      G (v[1], v[5], v[ 9], v[13], m[s[ 2]], m[s[ 3]]);
+      G (v[2], v[6], v[10], v[14], m[s[ 4]], m[s[ 5]]);
+      G (v[3], v[7], v[11], v[15], m[s[ 6]], m[s[ 7]]);
+      G (v[0], v[5], v[10], v[15], m[s[ 8]], m[s[ 9]]);
+      G (v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+      G (v[2], v[7], v[ 8], v[13], m[s[12]], m[s[13]]);
+      G (v[3], v[4], v[ 9], v[14], m[s[14]], m[s[15]]);
+    }
+
+  for (i = 0; i < 8; ++i)
+    h[i] ^= v[i] ^ v[i + 8];
+}
+
+
+#ifdef HAVE_X86_SIMD
+
+/* BLAKE2b with AVX2.  The four rows of v are kept in four vectors, so
+   the four column G's are done at once; rotating the rows by one,
+   two and three words lines the diagonals up for the next four.  The
+   rotations by 32, 24 and 16 bits are byte shuffles. */
+
+#include <immintrin.h>
+#include "cpu-private.h"
+
+#define G_AVX2(a, b, c, d, x, y)					\
+  G_STMT_START {							\
+    a = _mm256_add_epi64 (_mm256_add_epi64 (a, b), x);			\
+    d = _mm256_shuffle_epi32 (_mm256_xor_si256 (d, a), 0xB1);		\
+    c = _mm256_add_epi64 (c, d);					\
+    b = _mm256_shuffle_epi8 (_mm256_xor_si256 (b, c), rot24);		\
+    a = _mm256_add_epi64 (_mm256_add_epi64 (a, b), y);			\
+    d = _mm256_shuffle_epi8 (_mm256_xor_si256 (d, a), rot16);		\
+    c = _mm256_add_epi64 (c, d);					\
+    b = _mm256_xor_si256 (b, c);					\
+    b = _mm256_xor_si256 (_mm256_srli_epi64 (b, 63),			\
+			  _mm256_add_epi64 (b, b));			\
+  } G_STMT_END
+
+#define BLAKE2B_LOAD(s, i, j, k, l)					\
+  _mm256_set_epi64x ((gint64) m[s[l]], (gint64) m[s[k]],		\
+		     (gint64) m[s[j]], (gint64) m[s[i]])
+
+__attribute__ ((target ("avx2")))
+static void
+blake2b_compress_avx2 (guint64* h, const guint8* block, const guint64* t,
+		       gboolean last)
+{
+  const __m256i rot24 = _mm256_setr_epi8 (3, 4, 5, 6, 7, 0, 1, 2,
+					  11, 12, 13, 14, 15, 8, 9, 10,
+					  3, 4, 5, 6, 7, 0, 1, 2,
+					  11, 12, 13, 14, 15, 8, 9, 10);
+  const __m256i rot16 = _mm256_setr_epi8 (2, 3, 4, 5, 6, 7, 0, 1,
+					  10, 11, 12, 13, 14, 15, 8, 9,
+					  2, 3, 4, 5, 6, 7, 0, 1,
+					  10, 11, 12, 13, 14, 15, 8, 9);
+  __m256i a, b, c, d, h0, h1;
+  guint64 m[16];
+  guint i;
+
+  memcpy (m, block, BLAKE2B_BLOCK);
+
+  a = h0 = _mm256_loadu_si256 ((const __m256i*) h);
+  b = h1 = _mm256_loadu_si256 ((const __m256i*) (h + 4));
+  c = _mm256_loadu_si256 ((const __m256i*) blake2b_iv);
+  d = _mm256_xor_si256 (_mm256_loadu_si256 ((const __m256i*) (blake2b_iv + 4)),
+			_mm256_set_epi64x (0, last ? -1 : 0,
+					   (gint64) t[1], (gint64) t[0]));
+
+  for (i = 0; i < BLAKE2B_ROUNDS; ++i)
+    {
+      const guint8* s = blake2b_sigma[i % 10];
+
+      /* Columns */
+      G_AVX2 (a, b, c, d, BLAKE2B_LOAD (s, 0, 2, 4, 6),
+	      BLAKE2B_LOAD (s, 1, 3, 5, 7));
+
+      /* Diagonals */
+      b = _mm256_permute4x64_epi64 (b, _MM_SHUFFLE (0, 3, 2, 1));
+      c = _mm256_permute4x64_epi64 (c, _MM_SHUFFLE (1, 0, 3, 2));
+      d = _mm256_permute4x64_epi64 (d, _MM_SHUFFLE (2, 1, 0, 3));
+      G_AVX2 (a, b, c, d, BLAKE2B_LOAD (s, 8, 10, 12, 14),
+	      BLAKE2B_LOAD (s, 9, 11, 13, 15));
+      b = _mm256_permute4x64_epi64 (b, _MM_SHUFFLE (2, 1, 0, 3));
+      c = _mm256_permute4x64_epi64 (c, _MM_SHUFFLE (1, 0, 3, 2));
+      d = _mm256_permute4x64_epi64 (d, _MM_SHUFFLE (0, 3, 2, 1));
+    }
+
+  _mm256_storeu_si256 ((__m256i*) h,
+		       _mm256_xor_si256 (h0, _mm256_xor_si256 (a, c)));
+  _mm256_storeu_si256 ((__m256i*) (h + 4),
+		       _mm256_xor_si256 (h1, _mm256_xor_si256 (b, d)));
+}
+
+#endif /* HAVE_X86_SIMD */
+
+
+/* Picks the fastest compression function the CPU has */
+static BLAKE2bCompressFunc
+blake2b_get_compress (void)
+{
+#ifdef HAVE_X86_SIMD
+  if (_gnet_cpu_get_features () & GNET_CPU_AVX2)
+    return blake2b_compress_avx2;
+#endif
+
+  return blake2b_compress;
+}
+
+
+static void
+blake2b_init (BLAKE2bContext* ctx)
+{
+  memcpy (ctx->h, blake2b_iv, sizeof (ctx->h));
+  /* Parameter block: digest length, no key, fanout 1, depth 1 */
+  ctx->h[0] ^= 0x01010000 | GNET_BLAKE2B_HASH_LENGTH;
+  ctx->t[0] = ctx->t[1] = 0;
+  ctx->used = 0;
+}
+
+
+static void
+blake2b_count (BLAKE2bContext* ctx, gsize n)
+{
+  ctx->t[0] += n;
+  if (ctx->t[0] < n)
+    ctx->t[1]++;
+}
+
+
+/* The last block is compressed differently, so a block is only
+   compressed once more data follows it */
+static void
+blake2b_update (BLAKE2bContext* ctx, const guint8* data, gsize length)
+{
+  BLAKE2bCompressFunc compress = blake2b_get_compress ();
+
+  if (ctx->used + length > BLAKE2B_BLOCK)
+    {
+      if (ctx->used)
+	{
+	  gsize n = BLAKE2B_BLOCK - ctx->used;
+
+	  memcpy (ctx->buffer + ctx->used, data, n);
+	  data += n;
+	  length -= n;
+	  blake2b_count (ctx, BLAKE2B_BLOCK);
+	  compress (ctx->h, ctx->buffer, ctx->t, FALSE);
+	  ctx->used = 0;
+	}
+
+      /* Whole blocks but the last are compressed in place */
+      while (length > BLAKE2B_BLOCK)
+	{
+	  blake2b_count (ctx, BLAKE2B_BLOCK);
+	  compress (ctx->h, data, ctx->t, FALSE);
+	  data += BLAKE2B_BLOCK;
+	  length -= BLAKE2B_BLOCK;
+	}
+    }
+
+  memcpy (ctx->buffer + ctx->used, data, length);
+  ctx->used += length;
+}
+
+
+static void
+blake2b_final (BLAKE2bContext* ctx, guint8* digest)
+{
+  guint i;
+
+  blake2b_count (ctx, ctx->used);
+  memset (ctx->buffer + ctx->used, 0, BLAKE2B_BLOCK - ctx->used);
+  blake2b_get_compress () (ctx->h, ctx->buffer, ctx->t, TRUE);
+
+  for (i = 0; i < 8; ++i)
+    {
+      guint64 word = GUINT64_TO_LE (ctx->h[i]);
+
+      memcpy (digest + 8 * i, &word, 8);
+    }
+}
+
+
+/* ************************************************************ */
+
+struct _GBLAKE2b
+{
+  BLAKE2bContext	ctx;
+  guint8	digest[GNET_BLAKE2B_HASH_LENGTH];
+};
+
+
+/**
+ *  gnet_blake2b_new:
+ *  @buffer: buffer to hash
+ *  @length: length of @buffer
+ *
+ *  Creates a #GBLAKE2b from @buffer.
+ *
+ *  Returns: a new #GBLAKE2b.
+ *
+ *  Since: 2.0.9
+ **/
+GBLAKE2b*
+gnet_blake2b_new (const gchar* buffer, gsize length)
+{
+  GBLAKE2b* blake2b;
+
+  blake2b = g_new0 (GBLAKE2b, 1);
+  blake2b_init (&blake2b->ctx);
+  blake2b_update (&blake2b->ctx, (const guint8*) buffer, length);
+  blake2b_final (&blake2b->ctx, blake2b->digest);
+
+  return blake2b;
+}
+
+
+/**
+ *  gnet_blake2b_new_string:
+ *  @str: hexadecimal string
+ *
+ *  Creates a #GBLAKE2b from @str.  @str is a hexadecimal string
+ *  representing the digest.
+ *
+ *  Returns: a new #GBLAKE2b.
+ *
+ *  Since: 2.0.9
+ **/
+GBLAKE2b*
+gnet_blake2b_new_string (const gchar* str)
+{
+  GBLAKE2b* blake2b;
+
+  g_return_val_if_fail (str, NULL);
+  g_return_val_if_fail (strlen (str) >= GNET_BLAKE2B_HASH_LENGTH * 2, NULL);
+
+  blake2b = g_new0 (GBLAKE2b, 1);
+  if (!_gnet_hash_digest_from_string (str, blake2b->digest, GNET_BLAKE2B_HASH_LENGTH))
+    {
+      g_free (blake2b);
+      g_return_val_if_fail (FALSE, NULL);
+    }
+
+  return blake2b;
+}
+
+
+/**
+ *  gnet_blake2b_clone:
+ *  @blake2b: a #GBLAKE2b
+ *
+ *  Copies a #GBLAKE2b.
+ *
+ *  Returns: a copy of @blake2b.
+ *
+ *  Since: 2.0.9
+ **/
+GBLAKE2b*
+gnet_blake2b_clone (const GBLAKE2b* blake2b)
+{
+  g_return_val_if_fail (blake2b, NULL);
+
+  return g_memdup (blake2b, sizeof (GBLAKE2b));
+}
+
+
+/**
+ *  gnet_blake2b_delete:
+ *  @blake2b: a #GBLAKE2b
+ *
+ *  Deletes a #GBLAKE2b.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_blake2b_delete (GBLAKE2b* blake2b)
+{
+  g_free (blake2b);
+}
+
+
+/**
+ *  gnet_blake2b_new_incremental:
+ *
+ *  Creates a #GBLAKE2b incrementally.  After creating a #GBLAKE2b, call
+ *  gnet_blake2b_update() one or more times to hash data.  Finally, call
+ *  gnet_blake2b_final() to compute the final hash value.
+ *
+ *  Returns: a new #GBLAKE2b.
+ *
+ *  Since: 2.0.9
+ **/
+GBLAKE2b*
+gnet_blake2b_new_incremental (void)
+{
+  GBLAKE2b* blake2b;
+
+  blake2b = g_new0 (GBLAKE2b, 1);
+  blake2b_init (&blake2b->ctx);
+
+  return blake2b;
+}
+
+
+/**
+ *  gnet_blake2b_update:
+ *  @blake2b: a #GBLAKE2b
+ *  @buffer: buffer to add
+ *  @length: length of @buffer
+ *
+ *  Updates the hash with @buffer.  This may be called several times
+ *  on a hash created by gnet_blake2b_new_incremental() before being
+ *  finalized by calling gnet_blake2b_final().
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_blake2b_update (GBLAKE2b* blake2b, const gchar* buffer, gsize length)
+{
+  g_return_if_fail (blake2b);
+
+  blake2b_update (&blake2b->ctx, (const guint8*) buffer, length);
+}
+
+
+/**
+ *  gnet_blake2b_final:
+ *  @blake2b: a #GBLAKE2b
+ *
+ *  Calculates the final hash value of a #GBLAKE2b.  This should only be
+ *  called on a #GBLAKE2b created by gnet_blake2b_new_incremental().
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_blake2b_final (GBLAKE2b* blake2b)
+{
+  g_return_if_fail (blake2b);
+
+  blake2b_final (&blake2b->ctx, blake2b->digest);
+}
+
+
+/**
+ *  gnet_blake2b_equal:
+ *  @p1: a #GBLAKE2b
+ *  @p2: another #GBLAKE2b
+ *
+ *  Compares two #GBLAKE2b's for equality.
+ *
+ *  Returns: TRUE if they are equal; FALSE otherwise.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_blake2b_equal (gconstpointer p1, gconstpointer p2)
+{
+  const GBLAKE2b* blake2ba = (const GBLAKE2b*) p1;
+  const GBLAKE2b* blake2bb = (const GBLAKE2b*) p2;
+
+  return memcmp (blake2ba->digest, blake2bb->digest, GNET_BLAKE2B_HASH_LENGTH) == 0;
+}
+
+
+/**
+ *  gnet_blake2b_hash:
+ *  @p: a #GBLAKE2b
+ *
+ *  Creates a hash code for a #GBLAKE2b for use with GHashTable.  This
+ *  hash value is not the same as the BLAKE2b digest.
+ *
+ *  Returns: the hash code for @p.
+ *
+ *  Since: 2.0.9
+ **/
+guint
+gnet_blake2b_hash (gconstpointer p)
+{
+  const GBLAKE2b* blake2b = (const GBLAKE2b*) p;
+  guint32 word;
+  guint hash = 0;
+  guint i;
+
+  g_return_val_if_fail (blake2b, 0);
+
+  for (i = 0; i < GNET_BLAKE2B_HASH_LENGTH; i += 4)
+    {
+      memcpy (&word, blake2b->digest + i, 4);
+      hash ^= word;
+    }
+
+  return hash;
+}
+
+
+/**
+ *  gnet_blake2b_get_digest:
+ *  @blake2b: a #GBLAKE2b
+ *
+ *  Gets the raw BLAKE2b digest.
+ *
+ *  Returns: a callee-owned buffer containing the BLAKE2b hash digest.
+ *  The buffer is %GNET_BLAKE2B_HASH_LENGTH bytes long.
+ *
+ *  Since: 2.0.9
+ **/
+gchar*
+gnet_blake2b_get_digest (const GBLAKE2b* blake2b)
+{
+  g_return_val_if_fail (blake2b, NULL);
+
+  return (gchar*) blake2b->digest;
+}
+
+
+/**
+ *  gnet_blake2b_get_string:
+ *  @blake2b: a #GBLAKE2b
+ *
+ *  Gets the digest represented as a human-readable string.
+ *
+ *  Returns: a hexadecimal string representing the digest.  The string
+ *  is 2 * %GNET_BLAKE2B_HASH_LENGTH bytes long and NULL terminated.  The
+ *  string is caller owned.
+ *
+ *  Since: 2.0.9
+ **/
+gchar*
+gnet_blake2b_get_string (const GBLAKE2b* blake2b)
+{
+  gchar* str;
+
+  g_return_val_if_fail (blake2b, NULL);
+
+  str = g_new (gchar, GNET_BLAKE2B_HASH_LENGTH * 2 + 1);
+  _gnet_hash_digest_to_string (blake2b->digest, GNET_BLAKE2B_HASH_LENGTH, str);
+  str[GNET_BLAKE2B_HASH_LENGTH * 2] = '\0';
+
+  return str;
+}
+
+
+/**
+ *  gnet_blake2b_copy_string:
+ *  @blake2b: a #GBLAKE2b
+ *  @buffer: buffer at least 2 * %GNET_BLAKE2B_HASH_LENGTH bytes long
+ *
+ *  Copies the digest, represented as a string, into @buffer.  The
+ *  string is not NULL terminated.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_blake2b_copy_string (const GBLAKE2b* blake2b, gchar* buffer)
+{
+  g_return_if_fail (blake2b);
+  g_return_if_fail (buffer);
+
+  _gnet_hash_digest_to_string (blake2b->digest, GNET_BLAKE2B_HASH_LENGTH, buffer);
+}
@@ -0,0 +1,73 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+
+#ifndef _GNET_BLAKE2B_H
+#define _GNET_BLAKE2B_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ *  GBLAKE2b
+ *
+ *  GBLAKE2b is a BLAKE2b hash (RFC 7693) with a 64-byte digest and
+ *  no key.  It is faster than SHA-256 and SHA-512 in software and at
+ *  least as strong.
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GBLAKE2b GBLAKE2b;
+
+/**
+ *  GNET_BLAKE2B_HASH_LENGTH
+ *
+ *  Length of the BLAKE2b hash in bytes.
+ *
+ *  Since: 2.0.9
+ **/
+#define GNET_BLAKE2B_HASH_LENGTH	64
+
+
+GBLAKE2b* gnet_blake2b_new (const gchar* buffer, gsize length);
+GBLAKE2b* gnet_blake2b_new_string (const gchar* str);
+GBLAKE2b* gnet_blake2b_clone (const GBLAKE2b* blake2b);
+void     gnet_blake2b_delete (GBLAKE2b* blake2b);
+
+GBLAKE2b* gnet_blake2b_new_incremental (void);
+void     gnet_blake2b_update (GBLAKE2b* blake2b, const gchar* buffer, gsize length);
+void     gnet_blake2b_final (GBLAKE2b* blake2b);
+
+gboolean gnet_blake2b_equal (gconstpointer p1, gconstpointer p2);
+guint    gnet_blake2b_hash (gconstpointer p);
+
+gchar*   gnet_blake2b_get_digest (const GBLAKE2b* blake2b);
+gchar*   gnet_blake2b_get_string (const GBLAKE2b* blake2b);
+
+void     gnet_blake2b_copy_string (const GBLAKE2b* blake2b, gchar* buffer);
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _GNET_BLAKE2B_H */
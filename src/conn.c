@@ -27,6 +27,8 @@
 #include <string.h> /* needed for g_memmove/memmove */
 
 #include "gnet-private.h"
+#include "timer-private.h"
+#include "scheduler.h"
 
 #define IS_CONNECTED(C)  ((C)->socket != NULL)
 #define BUFFER_LEN	 1024
@@ -37,45 +39,93 @@
 #define ADD_WATCH(C, FLAG)	do {			\
   if (!IS_WATCHING(C,FLAG)) 	{			\
     (C)->watch_flags |= (FLAG);				\
-    if ((C)->iochannel) {				\
-      if ((C)->watch)					\
-        _gnet_source_remove ((C)->context, (C)->watch);	\
-      (C)->watch = _gnet_io_watch_add_full ((C)->context,\
-          G_PRIORITY_DEFAULT, (C)->iochannel,		\
-          (C)->watch_flags, async_cb, (C), NULL);	\
- }}} while (0)
+    if ((C)->iochannel)					\
+      (C)->watch = _gnet_io_watch_update ((C)->context,	\
+          (C)->watch, (C)->iochannel, (C)->watch_flags,	\
+          async_cb, (C));				\
+ }} while (0)
 
 #define REMOVE_WATCH(C, FLAG)	do {			\
   if (IS_WATCHING(C,FLAG)) 	{			\
     (C)->watch_flags &= ~(FLAG);			\
-    if ((C)->iochannel) {				\
-      if ((C)->watch)					\
-        _gnet_source_remove ((C)->context, (C)->watch);	\
-        (C)->watch = 0;					\
-      if ((C)->watch_flags != 0)			\
-        (C)->watch = _gnet_io_watch_add_full ((C)->context, \
-            G_PRIORITY_DEFAULT, (C)->iochannel,		\
-            (C)->watch_flags, async_cb, (C), NULL);	\
- }}} while (0)
+    if ((C)->iochannel)					\
+      (C)->watch = _gnet_io_watch_update ((C)->context,	\
+          (C)->watch, (C)->iochannel, (C)->watch_flags,	\
+          async_cb, (C));				\
+ }} while (0)
 
 #define UNSET_WATCH (C, FLAG)
 
 
+struct _GConnBytes
+{
+  gchar*	data;
+  gint		length;
+  gint		ref_count;
+  gboolean	owns_data;	/* data was taken, not stored inline */
+};
+
+
 typedef struct _Write
 {
   gchar* 	buffer;
   gint 		length;
   GDestroyNotify buffer_destroy_cb;
+  GConnBytes*	bytes;		/* shared buffer, or NULL */
 } Write;
 
 
 typedef struct _Read
 {
-  gint mode;
+  gint mode;		/* bytes; 0 any, -1 line, -2 in place */
+
+  /* In-place reads, set while the callback runs */
+  gint length;		/* bytes handed to the callback */
+  gint consumed;
+  gint needed;
 
 } Read;
 
 
+/* Each direction of a rate limited GConn has its own scheduler, whose
+   parent is the group's.  A GConn waiting for its turn is not watched
+   for that direction. */
+struct _GConnRate
+{
+  Scheduler*	read;
+  Scheduler*	write;
+  Schedulee	read_schedulee;
+  Schedulee	write_schedulee;
+  GConnRateGroup* group;
+};
+
+
+struct _GConnRateGroup
+{
+  guint		ref_count;
+  Scheduler*	read;
+  Scheduler*	write;
+};
+
+/* TRUE if main contexts @A and @B are the same; NULL is the default
+   context */
+#define SAME_CONTEXT(A, B) \
+  (((A) ? (A) : g_main_context_default ()) == \
+   ((B) ? (B) : g_main_context_default ()))
+
+#define RATE_LIMITED(S) \
+  ((S)->max_ups != SCHEDULER_UNLIMITED_UNITS || (S)->parent != NULL)
+#define READ_LIMITED(C)  ((C)->rate && RATE_LIMITED ((C)->rate->read))
+#define WRITE_LIMITED(C) ((C)->rate && RATE_LIMITED ((C)->rate->write))
+#define READ_WAITING(C)  ((C)->rate && (C)->rate->read_schedulee.queued)
+#define WRITE_WAITING(C) ((C)->rate && (C)->rate->write_schedulee.queued)
+
+/* Reads and writes are io_uring operations, if the backend runs them,
+   unless the user handles that direction or it is rate limited */
+#define URING_READS(C)	 (!(C)->watch_readable && !READ_LIMITED (C))
+#define URING_WRITES(C)	 (!(C)->watch_writable && !WRITE_LIMITED (C))
+
+
 
 static void 	ref_internal (GConn* conn);
 static void 	unref_internal (GConn* conn);
@@ -93,16 +143,38 @@ static gboolean async_cb (GIOChannel* iochannel, GIOCondition condition,
 
 static void	conn_read_full (GConn* conn, gint mode);
 static void	conn_check_read_queue (GConn* conn);
-static void     conn_read_async_cb (GConn* conn);
+static void	conn_wait_read (GConn* conn);
+static gint     conn_read_async_cb (GConn* conn, gint max_bytes);
+static gint	conn_read_done (GConn* conn, gint bytes_read);
+static void	conn_recv_done (gint result, gpointer buffer, gpointer data);
 static gboolean process_read_buffer_cb (gpointer data);
+static void	conn_dispatch_reads (GConn* conn);
+static void	conn_dispatch_cancel (GConn* conn);
 static gint	bytes_processable (GConn* conn);
 static gint	process_read_buffer (GConn* conn);
 
 
-static void 	conn_write_async_cb (GConn* conn);
+static void 	conn_write_queue_append (GConn* conn, Write* write);
+static gint 	conn_write_async_cb (GConn* conn, gint max_bytes);
+static gint	conn_write_done (GConn* conn, gint bytes_written);
+static void	conn_send_done (gint result, gpointer buffer, gpointer data);
 static void 	conn_check_write_queue (GConn* conn);
 
 static gboolean conn_timeout_cb (gpointer data);
+static void	conn_timer_set (GConn* conn, guint timeout);
+static void	conn_idle_reset (GConn* conn);
+
+static struct _GConnRate* conn_rate_get (GConn* conn);
+static void	conn_rate_update (GConn* conn);
+static void	conn_rate_free (GConn* conn);
+static gint	conn_read_scheduled (gpointer data, gint max_bytes);
+static gint	conn_write_scheduled (gpointer data, gint max_bytes);
+
+/* Restart the idle timer, if any, after data was read or written */
+#define CONN_ACTIVITY(CONN) G_STMT_START {	\
+    if ((CONN)->idle_timeout)			\
+      conn_idle_reset (CONN);			\
+  } G_STMT_END
 
 
 
@@ -236,6 +308,10 @@ gnet_conn_set_main_context (GConn * conn, GMainContext * context)
    * be okay if the socket is connected but no watches set up yet */
   g_return_val_if_fail (conn->connect_id == 0 && conn->new_id == 0, FALSE);
   g_return_val_if_fail (conn->watch == 0, FALSE);
+  g_return_val_if_fail (conn->recv_op == 0 && conn->send_op == 0, FALSE);
+  /* The context of a rate group is fixed when it is created */
+  g_return_val_if_fail (!conn->rate || !conn->rate->group ||
+      SAME_CONTEXT (conn->rate->group->read->context, context), FALSE);
 
   if (conn->context != context) {
     if (conn->context)
@@ -244,6 +320,11 @@ gnet_conn_set_main_context (GConn * conn, GMainContext * context)
       conn->context = g_main_context_ref (context);
     else
       conn->context = NULL;
+
+    if (conn->rate) {
+      scheduler_set_context (conn->rate->read, context);
+      scheduler_set_context (conn->rate->write, context);
+    }
   }
 
   return TRUE;
@@ -310,6 +391,11 @@ gnet_conn_unref (GConn* conn)
 
   g_free (conn->buffer);
 
+  conn_rate_free (conn);
+
+  if (conn->options)
+    g_array_free (conn->options, TRUE);
+
   g_free (conn);
 }
 
@@ -362,6 +448,30 @@ gnet_conn_set_callback (GConn* conn, GConnFunc func, gpointer user_data)
 
 
 
+/**
+ *  gnet_conn_set_fast_open
+ *  @conn: a #GConn
+ *  @enable: whether to use TCP Fast Open
+ *
+ *  Sets whether gnet_conn_connect() uses TCP Fast Open.  With Fast
+ *  Open, data written before or in the %GNET_CONN_CONNECT event is
+ *  sent in the SYN if the client has a cookie for the server, so a
+ *  short request costs no extra round trip.  Without a cookie, or if
+ *  Fast Open is not supported, the connection is made normally.  See
+ *  gnet_tcp_socket_new_async_fast_open_full() for the protocols Fast
+ *  Open is suitable for.  Disabled by default.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_set_fast_open (GConn* conn, gboolean enable)
+{
+  g_return_if_fail (conn != NULL);
+
+  conn->fast_open = enable;
+}
+
+
 /**
  *  gnet_conn_connect
  *  @conn: a #GConn
@@ -381,15 +491,16 @@ gnet_conn_connect (GConn * conn)
   if (conn->connect_id != 0 || conn->new_id != 0 || conn->socket != NULL)
     return;
 
-  /* Make asynchronous connection */
+  /* Make asynchronous connection.  The options are set on the new
+     socket before it connects. */
   if (conn->inetaddr) {
-    conn->new_id = gnet_tcp_socket_new_async_full (conn->inetaddr,
+    conn->new_id = _gnet_tcp_socket_new_async (conn->inetaddr,
         conn_new_cb, conn, (GDestroyNotify) NULL, conn->context,
-        G_PRIORITY_DEFAULT);
+        G_PRIORITY_DEFAULT, conn->fast_open, conn->options);
   } else if (conn->hostname) {
-    conn->connect_id = gnet_tcp_socket_connect_async_full (conn->hostname,
+    conn->connect_id = _gnet_tcp_socket_connect_async (conn->hostname,
         conn->port, conn_connect_cb, conn, (GDestroyNotify) NULL,
-        conn->context, G_PRIORITY_DEFAULT);
+        conn->context, G_PRIORITY_DEFAULT, conn->fast_open, conn->options);
   } else {
     g_return_if_reached ();
   }
@@ -411,6 +522,10 @@ conn_new_cb (GTcpSocket* socket, gpointer user_data)
       conn->socket = socket;
       conn->iochannel = gnet_tcp_socket_get_io_channel (socket);
 
+      /* The options could not be set before SOCKS connected */
+      if (gnet_socks_get_enabled ())
+	_gnet_socket_set_options (socket->sockfd, conn->options);
+
       conn_check_write_queue (conn);
       conn_check_read_queue (conn);
       if (conn->watch_flags) ADD_WATCH(conn, 0);
@@ -446,6 +561,10 @@ conn_connect_cb (GTcpSocket* socket,
       conn->inetaddr = gnet_tcp_socket_get_remote_inetaddr (socket);
       conn->iochannel = gnet_tcp_socket_get_io_channel (socket);
 
+      /* The options could not be set before SOCKS connected */
+      if (gnet_socks_get_enabled ())
+	_gnet_socket_set_options (socket->sockfd, conn->options);
+
       conn_check_write_queue (conn);
       conn_check_read_queue (conn);
       if (conn->watch_flags) ADD_WATCH(conn, 0);
@@ -468,6 +587,8 @@ conn_write_free(Write *write)
 {
   if (write->buffer_destroy_cb)
     write->buffer_destroy_cb(write->buffer);
+  if (write->bytes)
+    gnet_conn_bytes_unref (write->bytes);
   g_free (write);
 }
 
@@ -490,7 +611,7 @@ gnet_conn_disconnect (GConn* conn)
 
   if (conn->watch)
     {
-      _gnet_source_remove (conn->context, conn->watch);
+      _gnet_io_watch_remove (conn->context, conn->watch);
       conn->watch = 0;
     }
   conn->watch_flags = 0;
@@ -498,6 +619,30 @@ gnet_conn_disconnect (GConn* conn)
   conn->watch_readable = FALSE;
   conn->watch_writable = FALSE;
 
+  if (conn->rate)
+    {
+      scheduler_remove (conn->rate->read, &conn->rate->read_schedulee);
+      scheduler_remove (conn->rate->write, &conn->rate->write_schedulee);
+    }
+
+  /* Cancel the operations before the socket is closed.  A send still
+     uses the buffer of the first queued write, which is freed once
+     the kernel is done with it. */
+  if (conn->recv_op)
+    {
+      _gnet_io_cancel (conn->context, conn->recv_op, NULL, NULL);
+      conn->recv_op = 0;
+    }
+  if (conn->send_op)
+    {
+      Write* write = conn->write_queue->data;
+
+      conn->write_queue = g_list_remove (conn->write_queue, write);
+      _gnet_io_cancel (conn->context, conn->send_op,
+		       (GDestroyNotify) conn_write_free, write);
+      conn->send_op = 0;
+    }
+
   if (conn->iochannel)
     conn->iochannel = NULL;	/* do not unref */
 
@@ -536,17 +681,16 @@ gnet_conn_disconnect (GConn* conn)
   conn->read_queue = NULL;
   conn->bytes_read = 0;
   conn->read_eof = FALSE;
-  if (conn->process_buffer_timeout)
+  conn->read_wanted = 0;
+  if (conn->dispatch_queued)
     {
-      _gnet_source_remove (conn->context, conn->process_buffer_timeout);
-      conn->process_buffer_timeout = 0;
+      conn_dispatch_cancel (conn);
+      conn->dispatch_queued = FALSE;
     }
 
-  if (conn->timer)
-    {
-      _gnet_source_remove (conn->context, conn->timer);
-      conn->timer = 0;
-    }
+  _gnet_timer_remove (conn->context, conn->timer);
+  conn->timer = 0;
+  conn->idle_timeout = 0;
 }
 
 
@@ -606,9 +750,14 @@ async_cb (GIOChannel* iochannel, GIOCondition condition, gpointer data)
 	  g_return_val_if_fail (conn->func, FALSE);
 	  (conn->func) (conn, &event, conn->user_data);
 	}
+      else if (READ_LIMITED (conn))	/* READ when our turn comes */
+	{
+	  REMOVE_WATCH (conn, G_IO_IN);
+	  scheduler_add (conn->rate->read, &conn->rate->read_schedulee);
+	}
       else
 	{
-	  conn_read_async_cb (conn);	/* READ? */
+	  conn_read_async_cb (conn, G_MAXINT);	/* READ? */
 	}
 
       if (conn->ref_count == 0 || !IS_CONNECTED(conn))
@@ -632,9 +781,14 @@ async_cb (GIOChannel* iochannel, GIOCondition condition, gpointer data)
 	  g_return_val_if_fail (conn->func, FALSE);
 	  (conn->func) (conn, &event, conn->user_data);
 	}
+      else if (WRITE_LIMITED (conn))	/* WRITE when our turn comes */
+	{
+	  REMOVE_WATCH (conn, G_IO_OUT);
+	  scheduler_add (conn->rate->write, &conn->rate->write_schedulee);
+	}
       else				/* WRITE? */
 	{
-	  conn_write_async_cb (conn);
+	  conn_write_async_cb (conn, G_MAXINT);
 	}
 
       if (conn->ref_count == 0 || !IS_CONNECTED(conn))
@@ -729,6 +883,90 @@ gnet_conn_readline (GConn* conn)
 }
 
 
+/**
+ *  gnet_conn_read_in_place:
+ *  @conn: a #GConn
+ *
+ *  Begins an asynchronous read of whatever is buffered, without
+ *  consuming it.  The connection callback gets all the buffered data
+ *  in the event, in place, and tells with gnet_conn_read_consume()
+ *  how much of it it used; the rest stays buffered for the next read.
+ *  This lets a protocol parser decode every whole message it has
+ *  been sent in one callback, and leave a partial one for later,
+ *  usually with a #GPackCursor:
+ *
+ *  <informalexample>
+ *  <programlisting>
+ *  GPackCursor cursor;
+ *  guint16 type, length;
+ *  const gchar* body;
+ *  &space;
+ *  gnet_pack_cursor_init (&amp;cursor, event->buffer, event->length);
+ *  while (gnet_pack_cursor_unpack (&amp;cursor, header, &amp;type, &amp;length) &amp;&amp;
+ *         (body = gnet_pack_cursor_read (&amp;cursor, length)) != NULL)
+ *    {
+ *      handle_message (type, body, length);
+ *      gnet_pack_cursor_commit (&amp;cursor);
+ *    }
+ *  gnet_conn_read_consume (conn, gnet_pack_cursor_get_committed (&amp;cursor),
+ *                          gnet_pack_cursor_get_needed (&amp;cursor));
+ *  gnet_conn_read_in_place (conn);
+ *  </programlisting>
+ *  </informalexample>
+ *
+ *  The next in-place read is not called back until the number of
+ *  bytes asked for with gnet_conn_read_consume() have arrived.  This
+ *  function may be called again before the asynchronous read
+ *  completes.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_read_in_place (GConn* conn)
+{
+  g_return_if_fail (conn);
+  g_return_if_fail (conn->func);
+
+  conn_read_full (conn, -2);
+}
+
+
+/**
+ *  gnet_conn_read_consume:
+ *  @conn: a #GConn
+ *  @consumed: number of bytes used
+ *  @needed: number of bytes, beyond those in the event, needed before
+ *  the next in-place read
+ *
+ *  Removes the first @consumed bytes of the event buffer from the
+ *  buffer of @conn, once the callback of an in-place read returns.
+ *  Call it from that callback only.  Without it, nothing is consumed.
+ *
+ *  The next read made with gnet_conn_read_in_place() is called back
+ *  when at least @needed bytes more than the event had are buffered.
+ *  If nothing is consumed, at least one more byte is needed.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_read_consume (GConn* conn, gint consumed, gint needed)
+{
+  Read* read;
+
+  g_return_if_fail (conn);
+  g_return_if_fail (conn->read_queue);
+
+  /* The read being called back is the first in the queue */
+  read = (Read*) conn->read_queue->data;
+  g_return_if_fail (read->mode == -2 && read->length > 0);
+  g_return_if_fail (consumed >= 0 && consumed <= read->length);
+  g_return_if_fail (needed >= 0);
+
+  read->consumed = consumed;
+  read->needed = (consumed == 0) ? MAX (needed, 1) : needed;
+}
+
+
 
 static void
 conn_read_full (GConn* conn, gint mode)
@@ -762,8 +1000,19 @@ conn_check_read_queue (GConn* conn)
   if (!IS_CONNECTED(conn) || !conn->read_queue)
     return;
 
-  /* Ignore if we will process the buffer or are already watch IN */
-  if (conn->process_buffer_timeout || IS_WATCHING(conn, G_IO_IN))
+  /* Ignore if we will process the buffer or are already reading */
+  if (conn->dispatch_queued || IS_WATCHING(conn, G_IO_IN) ||
+      conn->recv_op)
+    return;
+
+  /* Ignore if we are waiting for our turn to read */
+  if (READ_WAITING (conn))
+    return;
+
+  /* Ignore if we are called from a read callback.  The read is
+     handled by the loop processing the buffer, without a trip through
+     the main loop. */
+  if (conn->processing_reads)
     return;
 
 
@@ -777,24 +1026,86 @@ conn_check_read_queue (GConn* conn)
      processed given the data we have and we would need to read in
      more data.  We watch IO_IN in this case.  */
   if ((conn->bytes_read && bytes_processable(conn) > 0) || conn->read_eof) {
-    conn->process_buffer_timeout = _gnet_timeout_add_full (conn->context,
-        G_PRIORITY_DEFAULT, 0, process_read_buffer_cb, conn, NULL);
+    conn_dispatch_reads (conn);
   } else {
   /* Otherwise, if there is no read watch, set one, so we can read
    * more bytes */
-    ADD_WATCH(conn, G_IO_IN);
+    conn_wait_read (conn);
   }
 }
 
 
+/* Receives more bytes, or watches for them */
+static void
+conn_wait_read (GConn* conn)
+{
+  if (conn->recv_op)
+    return;
+
+  if (URING_READS (conn))
+    conn->recv_op = _gnet_io_recv (conn->context, (gint) conn->socket->sockfd,
+				   conn_recv_done, conn);
+  if (!conn->recv_op)
+    ADD_WATCH (conn, G_IO_IN);
+}
+
+
+/* Completion of the receive of conn_wait_read() */
 static void
-conn_read_async_cb (GConn* conn)
+conn_recv_done (gint result, gpointer buffer, gpointer data)
+{
+  GConn* conn = (GConn*) data;
+
+  conn->recv_op = 0;
+
+  if (result == -EAGAIN || result == -EINTR)
+    {
+      conn_check_read_queue (conn);
+      return;
+    }
+
+  /* Append to the read buffer, which can hold any amount */
+  if (result > 0)
+    {
+      if (!conn->buffer)
+	{
+	  conn->buffer = g_malloc (BUFFER_LEN);
+	  conn->length = BUFFER_LEN;
+	  conn->bytes_read = 0;
+	}
+      if (conn->length - conn->bytes_read < (guint) result)
+	{
+	  while (conn->length - conn->bytes_read < (guint) result)
+	    conn->length *= 2;
+	  conn->buffer = g_realloc (conn->buffer, conn->length);
+	}
+      memcpy (&conn->buffer[conn->bytes_read], buffer, result);
+    }
+
+  ref_internal (conn);
+  conn_read_done (conn, (result < 0) ? -1 : result);
+
+  /* Receive more, unless conn was disconnected or deleted */
+  if (conn->ref_count > 0)
+    conn_check_read_queue (conn);
+  unref_internal (conn);
+}
+
+
+/* Reads up to @max_bytes and processes the read buffer.  Returns the
+   number of bytes read. */
+static gint
+conn_read_async_cb (GConn* conn, gint max_bytes)
 {
   guint  bytes_to_read;
   gchar* buffer_start;
   GIOError error;
   gsize  bytes_read;
-  
+
+  /* A receive in flight gets the next bytes */
+  if (conn->recv_op)
+    return 0;
+
   /* Resize the buffer if it's full. */
   if (conn->length == conn->bytes_read)
     {
@@ -803,9 +1114,9 @@ conn_read_async_cb (GConn* conn)
     }
 
   /* Calculate buffer start and length */
-  bytes_to_read = conn->length - conn->bytes_read;
+  bytes_to_read = MIN (conn->length - conn->bytes_read, (guint) max_bytes);
   buffer_start = &conn->buffer[conn->bytes_read];
-  g_return_if_fail (bytes_to_read > 0);
+  g_return_val_if_fail (bytes_to_read > 0, 0);
 
   /* Read data into buffer */
   error = g_io_channel_read (conn->iochannel, buffer_start,
@@ -813,10 +1124,25 @@ conn_read_async_cb (GConn* conn)
 
   /* Try again later if necessary */
   if (error == G_IO_ERROR_AGAIN)
-    return;
+    return 0;
+
+  return conn_read_done (conn, (error != G_IO_ERROR_NONE) ? -1 :
+			 (gint) bytes_read);
+}
+
+
+/* Handles a read of @bytes_read bytes, which are at the end of the
+   read buffer: -1 is an error and 0 is EOF.  Processes the read
+   buffer and returns the number of bytes read. */
+static gint
+conn_read_done (GConn* conn, gint bytes_read)
+{
+  gint   processed;
+  gint   received = 0;
+  gboolean processing_reads;
 
   /* Fail if this is an error */
-  else if (error != G_IO_ERROR_NONE)
+  if (bytes_read < 0)
     {
       GConnEvent event = {GNET_CONN_ERROR, NULL, 0};
 
@@ -827,7 +1153,7 @@ conn_read_async_cb (GConn* conn)
 
       unref_internal (conn);
 
-      return;
+      return 0;
     }
 
   /* If we read nothing, that means EOF and we're done.  We do not
@@ -841,26 +1167,35 @@ conn_read_async_cb (GConn* conn)
   else
     {
       conn->bytes_read += bytes_read;
+      received = bytes_read;
+      CONN_ACTIVITY (conn);
+
+      if (conn->socket->fast_open)
+	_gnet_tcp_socket_check_fast_open (conn->socket);
     }
 
   /*** Process what we read *** */
 
   /* Process the read buffer */
   ref_internal (conn);
+  processing_reads = conn->processing_reads;
+  conn->processing_reads = TRUE;
   do
     {
       /* Process data */
-      bytes_read = process_read_buffer (conn);
+      processed = process_read_buffer (conn);
       /* conn may be disconnected at this point */
 
       /* Stop if conn deleted */
       if (conn->ref_count == 0)	
 	{
+	  conn->processing_reads = processing_reads;
 	  unref_internal (conn);
-	  return;
+	  return received;
 	}
 
-    } while (bytes_read > 0);
+    } while (processed > 0);
+  conn->processing_reads = processing_reads;
 
   unref_internal (conn);	
   /* conn is still good (though possibly disconnected).  Otherwise, we
@@ -881,7 +1216,7 @@ conn_read_async_cb (GConn* conn)
 
       gnet_conn_disconnect (conn);
       (conn->func) (conn, &event, conn->user_data);
-      return;	/* we're done with conn for now */
+      return received;	/* we're done with conn for now */
     }
 
   /* Remove read watch if no more reads */
@@ -889,6 +1224,30 @@ conn_read_async_cb (GConn* conn)
     {
       REMOVE_WATCH(conn, G_IO_IN);
     }
+
+  return received;
+}
+
+
+/* Called by the read scheduler when it is our turn to read */
+static gint
+conn_read_scheduled (gpointer data, gint max_bytes)
+{
+  GConn* conn = (GConn*) data;
+  gint received;
+
+  if (!IS_CONNECTED(conn) || !conn->read_queue)
+    return 0;
+
+  ref_internal (conn);
+  received = conn_read_async_cb (conn, max_bytes);
+
+  /* Wait for more data, unless conn was disconnected or deleted */
+  if (conn->ref_count > 0)
+    conn_check_read_queue (conn);
+  unref_internal (conn);
+
+  return received;
 }
 
 
@@ -899,10 +1258,11 @@ process_read_buffer_cb (gpointer data)
 {
   GConn* conn = (GConn*) data;
   gint bytes_read;
+  gboolean processing_reads;
 
   g_return_val_if_fail (conn, FALSE);
 
-  conn->process_buffer_timeout = 0;
+  conn->dispatch_queued = FALSE;
 
   /* Ignore if nothing to read */
   if (conn->bytes_read == 0 || conn->read_queue == NULL)
@@ -910,6 +1270,8 @@ process_read_buffer_cb (gpointer data)
 
   /* Process reads */
   ref_internal (conn);
+  processing_reads = conn->processing_reads;
+  conn->processing_reads = TRUE;
   do
     {
       /* Process data */
@@ -919,10 +1281,12 @@ process_read_buffer_cb (gpointer data)
       /* Stop if conn deleted */
       if (conn->ref_count == 0)	
 	{
+	  conn->processing_reads = processing_reads;
 	  unref_internal (conn);
 	  return FALSE;
 	}
     } while (bytes_read > 0);
+  conn->processing_reads = processing_reads;
 
   unref_internal (conn);
   /* conn is still good (though possibly disconnected).  Otherwise, we
@@ -941,13 +1305,168 @@ process_read_buffer_cb (gpointer data)
   /* Set read watch if we're still connected and there's more to read */
   if (IS_CONNECTED(conn) && conn->read_queue)
     {
-      ADD_WATCH (conn, G_IO_IN);
+      conn_wait_read (conn);
     }
 
   return FALSE;
 }
 
 
+/* **************************************** */
+/* Read dispatcher  */
+
+/* GConns with buffered data to hand to a new read are queued on one
+   GSource per main context, instead of each adding a zero-delay
+   timeout.  All queued GConns are dispatched in the same main loop
+   iteration. */
+
+typedef struct _ReadDispatcher
+{
+  GSource	source;
+  GMainContext* context;
+  GQueue*	conns;
+
+} ReadDispatcher;
+
+static gboolean read_dispatcher_prepare  (GSource* source, gint* timeout);
+static gboolean read_dispatcher_check    (GSource* source);
+static gboolean read_dispatcher_dispatch (GSource* source,
+					  GSourceFunc callback,
+					  gpointer user_data);
+static void	read_dispatcher_finalize (GSource* source);
+
+static GSourceFuncs read_dispatcher_funcs =
+{
+  read_dispatcher_prepare,
+  read_dispatcher_check,
+  read_dispatcher_dispatch,
+  read_dispatcher_finalize,
+  NULL,
+  NULL
+};
+
+/* GMainContext -> ReadDispatcher */
+static GHashTable* read_dispatchers = NULL;
+G_LOCK_DEFINE_STATIC (read_dispatchers);
+
+
+static ReadDispatcher*
+read_dispatcher_get (GMainContext* context, gboolean create)
+{
+  ReadDispatcher* rd;
+
+  if (context == NULL)
+    context = g_main_context_default ();
+
+  G_LOCK (read_dispatchers);
+
+  if (read_dispatchers == NULL)
+    read_dispatchers = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  rd = g_hash_table_lookup (read_dispatchers, context);
+  if (rd == NULL && create)
+    {
+      rd = (ReadDispatcher*) g_source_new (&read_dispatcher_funcs,
+					   sizeof (ReadDispatcher));
+      rd->context = context;
+      rd->conns = g_queue_new ();
+
+      g_source_attach ((GSource*) rd, context);
+      g_source_unref ((GSource*) rd);	/* context owns it now */
+
+      g_hash_table_insert (read_dispatchers, context, rd);
+    }
+
+  G_UNLOCK (read_dispatchers);
+
+  return rd;
+}
+
+
+static gboolean
+read_dispatcher_prepare (GSource* source, gint* timeout)
+{
+  ReadDispatcher* rd = (ReadDispatcher*) source;
+
+  *timeout = -1;
+  return !g_queue_is_empty (rd->conns);
+}
+
+
+static gboolean
+read_dispatcher_check (GSource* source)
+{
+  ReadDispatcher* rd = (ReadDispatcher*) source;
+
+  return !g_queue_is_empty (rd->conns);
+}
+
+
+static gboolean
+read_dispatcher_dispatch (GSource* source, GSourceFunc callback,
+			  gpointer user_data)
+{
+  ReadDispatcher* rd = (ReadDispatcher*) source;
+  guint n;
+
+  /* GConns queued by the callbacks wait for the next iteration, like
+     they would have with a timeout */
+  for (n = rd->conns->length; n > 0; --n)
+    {
+      GConn* conn = g_queue_pop_head (rd->conns);
+
+      if (conn == NULL)		/* canceled by an earlier callback */
+	break;
+
+      process_read_buffer_cb (conn);
+    }
+
+  return TRUE;
+}
+
+
+static void
+read_dispatcher_finalize (GSource* source)
+{
+  ReadDispatcher* rd = (ReadDispatcher*) source;
+  GList* i;
+
+  G_LOCK (read_dispatchers);
+  if (read_dispatchers &&
+      g_hash_table_lookup (read_dispatchers, rd->context) == rd)
+    g_hash_table_remove (read_dispatchers, rd->context);
+  G_UNLOCK (read_dispatchers);
+
+  for (i = rd->conns->head; i != NULL; i = i->next)
+    ((GConn*) i->data)->dispatch_queued = FALSE;
+  g_queue_free (rd->conns);
+}
+
+
+/* Queues @conn for process_read_buffer_cb() */
+static void
+conn_dispatch_reads (GConn* conn)
+{
+  ReadDispatcher* rd;
+
+  rd = read_dispatcher_get (conn->context, TRUE);
+  g_queue_push_tail (rd->conns, conn);
+  conn->dispatch_queued = TRUE;
+}
+
+
+static void
+conn_dispatch_cancel (GConn* conn)
+{
+  ReadDispatcher* rd;
+
+  rd = read_dispatcher_get (conn->context, FALSE);
+  if (rd)
+    g_queue_remove (rd->conns, conn);
+}
+
+
+
 /* Calculate number of bytes that can be processed by the top read */
 static gint
 bytes_processable (GConn* conn)
@@ -999,6 +1518,14 @@ bytes_processable (GConn* conn)
 	break;
       }
 
+      /* Read in place */
+    case -2:
+      {
+	if (conn->bytes_read >= MAX (conn->read_wanted, 1))
+	  return conn->bytes_read;
+	break;
+      }
+
     default:		/* Read n */
       {
 	if (conn->bytes_read >= read->mode)
@@ -1011,13 +1538,15 @@ bytes_processable (GConn* conn)
 }
 
 
-/* Return bytes read */
+/* Return bytes read, or for an in-place read the bytes handed to the
+   callback */
 static gint
 process_read_buffer (GConn* conn)
 {
   Read* read;
   gint bytes_processed = 0;
   gint bytes_read = 0;
+  gboolean in_place = FALSE;
 
   g_return_val_if_fail (conn, FALSE);
 
@@ -1087,6 +1616,22 @@ process_read_buffer (GConn* conn)
 	break;
       }
 
+      /* Read in place.  The callback decides how much is
+	 processed. */
+    case -2:
+      {
+	if (conn->bytes_read >= MAX (conn->read_wanted, 1))
+	  {
+	    bytes_read = conn->bytes_read;
+	    in_place = TRUE;
+	    read->length = bytes_read;
+	    read->consumed = 0;
+	    read->needed = 1;
+	  }
+
+	break;
+      }
+
     default:		/* Read n */
       {
 	if (conn->bytes_read >= read->mode)
@@ -1108,9 +1653,17 @@ process_read_buffer (GConn* conn)
     }
   /* Note: User may have disconnected after the callback */
 
+  /* An in-place read processes what the callback consumed, even if
+     that is nothing */
+  if (in_place && IS_CONNECTED(conn))
+    {
+      bytes_processed = read->consumed;
+      conn->read_wanted = read->length + read->needed;
+    }
+
   /* If read successful and we're still connected, move bytes over and
      remove read */
-  if (bytes_processed && IS_CONNECTED(conn))
+  if ((bytes_processed || in_place) && IS_CONNECTED(conn))
     {
       g_assert (conn->bytes_read >= bytes_processed);/* Sanity check */
 
@@ -1118,6 +1671,10 @@ process_read_buffer (GConn* conn)
       g_memmove (conn->buffer, &conn->buffer[bytes_processed], 
 		 conn->bytes_read - bytes_processed);
       conn->bytes_read -= bytes_processed;
+      if (conn->read_wanted > (guint) bytes_processed)
+	conn->read_wanted -= bytes_processed;
+      else
+	conn->read_wanted = 0;
 
       /* Remove read from queue */
       conn->read_queue = g_list_remove (conn->read_queue, read);
@@ -1126,7 +1683,7 @@ process_read_buffer (GConn* conn)
 
   unref_internal (conn);
       
-  return bytes_processed;
+  return in_place ? bytes_read : bytes_processed;
 }
 
 
@@ -1168,9 +1725,7 @@ gnet_conn_write_direct (GConn* conn, gchar* buffer, gint length,
   write->buffer = buffer;
   write->length = length;
   write->buffer_destroy_cb = buffer_destroy_cb;
-  conn->write_queue = g_list_append (conn->write_queue, write);
-
-  conn_check_write_queue (conn);
+  conn_write_queue_append (conn, write);
 }
 
 /**
@@ -1201,55 +1756,167 @@ gnet_conn_write (GConn* conn, gchar* buffer, gint length)
 }
 
 
-static void
-conn_check_write_queue (GConn* conn)
+/**
+ *  gnet_conn_write_bytes
+ *  @conn: a #GConn
+ *  @bytes: shared buffer to write from
+ *
+ *  Sets up an asynchronous write to @conn from @bytes.  The data is
+ *  not copied; a reference to @bytes is held until the write
+ *  completes or the connection is disconnected.  Use this to write the
+ *  same data to many connections without a copy per connection.  This
+ *  function can be called again before the asynchronous write
+ *  completes.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_write_bytes (GConn* conn, GConnBytes* bytes)
 {
-  /* Ignore if we are unconnected or there is no writes */
-  if (!IS_CONNECTED(conn) || !conn->write_queue)
-    return;
+  Write* write;
 
-  /* Ignore if we are already watching OUT */
-  if (IS_WATCHING(conn, G_IO_OUT))
+  g_return_if_fail (conn != NULL);
+  g_return_if_fail (bytes != NULL);
+
+  if (bytes->length == 0)
     return;
 
-  /* Watch for write */
-  ADD_WATCH (conn, G_IO_OUT);
+  write = g_new0 (Write, 1);
+  write->buffer = bytes->data;
+  write->length = bytes->length;
+  write->bytes = gnet_conn_bytes_ref (bytes);
+  conn_write_queue_append (conn, write);
+}
+
+
+static void
+conn_write_queue_append (GConn* conn, Write* write)
+{
+  conn->write_queue = g_list_append (conn->write_queue, write);
+
+  conn_check_write_queue (conn);
+}
+
+
+static void
+conn_check_write_queue (GConn* conn)
+{
+  /* Ignore if we are unconnected or there is no writes */
+  if (!IS_CONNECTED(conn) || !conn->write_queue)
+    return;
+
+  /* Ignore if we are already watching OUT, sending or waiting for our
+     turn */
+  if (IS_WATCHING(conn, G_IO_OUT) || conn->send_op || WRITE_WAITING (conn))
+    return;
+
+  /* Send the rest of the first write */
+  if (URING_WRITES (conn))
+    {
+      Write* write = (Write*) conn->write_queue->data;
+
+      conn->send_op = _gnet_io_send (conn->context,
+				     (gint) conn->socket->sockfd,
+				     &write->buffer[conn->bytes_written],
+				     write->length - conn->bytes_written,
+				     conn_send_done, conn);
+      if (conn->send_op)
+	return;
+    }
+
+  /* Watch for write */
+  ADD_WATCH (conn, G_IO_OUT);
 }
 
 
+/* Completion of the send of conn_check_write_queue() */
 static void
-conn_write_async_cb (GConn* conn)
+conn_send_done (gint result, gpointer buffer, gpointer data)
+{
+  GConn* conn = (GConn*) data;
+
+  conn->send_op = 0;
+
+  if (result == -EAGAIN || result == -EINTR)
+    {
+      conn_check_write_queue (conn);
+      return;
+    }
+
+  ref_internal (conn);
+  conn_write_done (conn, (result < 0) ? -1 : result);
+
+  /* Send the next write, unless conn was disconnected or deleted */
+  if (conn->ref_count > 0)
+    conn_check_write_queue (conn);
+  unref_internal (conn);
+}
+
+
+/* Writes up to @max_bytes of the first queued write.  Returns the
+   number of bytes written. */
+static gint
+conn_write_async_cb (GConn* conn, gint max_bytes)
 {
   Write*     write;
   GIOError   error;
   guint      bytes_to_write;
   gchar*     buffer_start;
   gsize      bytes_written;
-  GConnEvent event = {GNET_CONN_ERROR, NULL, 0};
+
+  /* The send in flight writes the next bytes */
+  if (conn->send_op)
+    return 0;
 
   write = (Write*) conn->write_queue->data;
-  g_return_if_fail (write != NULL);
+  g_return_val_if_fail (write != NULL, 0);
 
   /* Calculate start of buffer */
   buffer_start = &write->buffer[conn->bytes_written];
-  bytes_to_write = write->length - conn->bytes_written;
+  bytes_to_write = MIN (write->length - conn->bytes_written,
+			(guint) max_bytes);
 
   /* Write */
   error = g_io_channel_write(conn->iochannel, buffer_start,
 			     bytes_to_write, &bytes_written);
 
+  /* Try again later if the socket is full.  A scheduled write is
+     made without waiting for OUT. */
+  if (error == G_IO_ERROR_AGAIN)
+    return 0;
+
+  return conn_write_done (conn, (error != G_IO_ERROR_NONE) ? -1 :
+			  (gint) bytes_written);
+}
+
+
+/* Handles a write of @bytes_written bytes of the first queued write;
+   -1 is an error.  Returns the number of bytes written. */
+static gint
+conn_write_done (GConn* conn, gint bytes_written)
+{
+  Write*     write = (Write*) conn->write_queue->data;
+  GConnEvent event = {GNET_CONN_ERROR, NULL, 0};
+
   /* Check for error.  If error, disconnect and notify */
-  if (error != G_IO_ERROR_NONE)
+  if (bytes_written < 0)
     {
       gnet_conn_disconnect (conn);
       (conn->func) (conn, &event, conn->user_data);
       /* conn may be deleted now */
-      return;
+      return 0;
     }
   /* Otherwise, write is good */
 
   /* Increment bytes written count */
   conn->bytes_written += bytes_written;
+  if (bytes_written > 0)
+    {
+      CONN_ACTIVITY (conn);
+
+      if (conn->socket->fast_open)
+	_gnet_tcp_socket_check_fast_open (conn->socket);
+    }
 
   /* Check if we're done writing this queued write */
   if (conn->bytes_written == write->length)
@@ -1271,7 +1938,30 @@ conn_write_async_cb (GConn* conn)
     }
 
   /* Otherwise, keep watching for output */
-  return;
+  return bytes_written;
+}
+
+
+/* Called by the write scheduler when it is our turn to write */
+static gint
+conn_write_scheduled (gpointer data, gint max_bytes)
+{
+  GConn* conn = (GConn*) data;
+  gint written;
+
+  if (!IS_CONNECTED(conn) || !conn->write_queue)
+    return 0;
+
+  ref_internal (conn);
+  written = conn_write_async_cb (conn, max_bytes);
+
+  /* Wait until writable again, unless conn was disconnected or
+     deleted */
+  if (conn->ref_count > 0)
+    conn_check_write_queue (conn);
+  unref_internal (conn);
+
+  return written;
 }
 
 
@@ -1363,25 +2053,135 @@ gnet_conn_set_watch_writable (GConn* conn, gboolean enable)
  *  timeout set on @conn, the old timeout is canceled.  Set @timeout
  *  to 0 to cancel the current timeout.
  *
+ *  The timers of all connections of a main context share one timing
+ *  wheel, so setting, resetting and canceling a timeout is cheap even
+ *  with many thousands of connections.
+ *
  **/
 void
 gnet_conn_timeout (GConn* conn, guint timeout)
 {
   g_return_if_fail (conn != NULL);
 
-  if (conn->timer) {
-    _gnet_source_remove (conn->context, conn->timer);
-    conn->timer = 0;
-  }
+  conn->idle_timeout = 0;
+  conn_timer_set (conn, timeout);
+}
+
+
+/**
+ *  gnet_conn_idle_timeout
+ *  @conn: a #GConn
+ *  @timeout: Timeout (in milliseconds)
+ *
+ *  Sets an idle timeout on a #GConn.  This is like
+ *  gnet_conn_timeout(), except that the timer is restarted whenever
+ *  @conn reads or writes data, so the %GNET_CONN_TIMEOUT event only
+ *  occurs after @timeout milliseconds without any traffic.  After the
+ *  event, the next read or write starts the timer again.  Set
+ *  @timeout to 0, or call gnet_conn_timeout(), to cancel the idle
+ *  timeout.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_idle_timeout (GConn* conn, guint timeout)
+{
+  g_return_if_fail (conn != NULL);
+
+  conn->idle_timeout = timeout;
+  conn_timer_set (conn, timeout);
+}
+
+
+/**
+ *  gnet_conn_set_option
+ *  @conn: a #GConn
+ *  @option: option to set
+ *  @value: value of the option
+ *
+ *  Sets a socket option of @conn; see gnet_tcp_socket_set_option().
+ *  The option is kept and set on the socket every time @conn
+ *  connects, before the connection is made, so options like
+ *  %GNET_SOCKET_OPTION_RCVBUF that affect the handshake can be set
+ *  before gnet_conn_connect().  If @conn is connected, the option is
+ *  also set on its socket at once.  Use
+ *  gnet_server_set_accept_option() to set options on all the
+ *  connections of a #GServer.
+ *
+ *  Returns: TRUE if the option was set or kept for the next
+ *  connection; FALSE if @conn is connected and its socket does not
+ *  support the option.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_conn_set_option (GConn* conn, GNetSocketOption option, gint value)
+{
+  g_return_val_if_fail (conn != NULL, FALSE);
+
+  _gnet_socket_options_set (&conn->options, option, value);
+
+  if (!conn->socket)
+    return TRUE;
+
+  return gnet_tcp_socket_set_option (conn->socket, option, value);
+}
+
+
+/**
+ *  gnet_conn_get_option
+ *  @conn: a #GConn
+ *  @option: option to get
+ *  @value: pointer to store the value in
+ *
+ *  Gets a socket option of the socket of a connected #GConn; see
+ *  gnet_tcp_socket_get_option().
+ *
+ *  Returns: TRUE if the option was read; FALSE if @conn is not
+ *  connected or the option is not supported.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_conn_get_option (const GConn* conn, GNetSocketOption option,
+		      gint* value)
+{
+  g_return_val_if_fail (conn != NULL, FALSE);
+  g_return_val_if_fail (value != NULL, FALSE);
+
+  if (!conn->socket)
+    return FALSE;
+
+  return gnet_tcp_socket_get_option (conn->socket, option, value);
+}
+
+
+static void
+conn_timer_set (GConn* conn, guint timeout)
+{
+  _gnet_timer_remove (conn->context, conn->timer);
+  conn->timer = 0;
 
   if (timeout) {
     g_return_if_fail (conn->func != NULL);
-    conn->timer = _gnet_timeout_add_full (conn->context, G_PRIORITY_DEFAULT,
-        timeout, conn_timeout_cb, conn, (GDestroyNotify) NULL);
+    conn->timer = _gnet_timer_add (conn->context, timeout,
+        conn_timeout_cb, conn);
   }
 }
 
 
+static void
+conn_idle_reset (GConn* conn)
+{
+  if (conn->timer &&
+      _gnet_timer_reset (conn->context, conn->timer, conn->idle_timeout))
+    return;
+
+  conn->timer = _gnet_timer_add (conn->context, conn->idle_timeout,
+      conn_timeout_cb, conn);
+}
+
+
 static gboolean 
 conn_timeout_cb (gpointer data)
 {
@@ -1399,3 +2199,484 @@ conn_timeout_cb (gpointer data)
 
   return FALSE;
 }
+
+
+
+/* **************************************** */
+
+
+/**
+ *  gnet_conn_set_rate_limit
+ *  @conn: a #GConn
+ *  @read_bps: most bytes per second to read; 0 for no limit
+ *  @write_bps: most bytes per second to write; 0 for no limit
+ *
+ *  Limits the bandwidth of a #GConn.  Reads and writes are made when
+ *  the limit allows and may be cut into smaller pieces, so a limited
+ *  #GConn may read or write in bursts of up to a tenth of a second
+ *  worth of data.  The limit applies on top of the limit of the
+ *  #GConnRateGroup the #GConn is in, if any.  Reading after a
+ *  %GNET_CONN_READABLE event or writing after a %GNET_CONN_WRITABLE
+ *  event is not limited.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_set_rate_limit (GConn* conn, gint read_bps, gint write_bps)
+{
+  struct _GConnRate* rate;
+
+  g_return_if_fail (conn != NULL);
+  g_return_if_fail (read_bps >= 0);
+  g_return_if_fail (write_bps >= 0);
+
+  if (!conn->rate && read_bps == 0 && write_bps == 0)
+    return;
+
+  rate = conn_rate_get (conn);
+  scheduler_set_max_ups (rate->read,
+      read_bps ? read_bps : SCHEDULER_UNLIMITED_UNITS);
+  scheduler_set_max_ups (rate->write,
+      write_bps ? write_bps : SCHEDULER_UNLIMITED_UNITS);
+
+  conn_rate_update (conn);
+}
+
+
+/**
+ *  gnet_conn_set_rate_group
+ *  @conn: a #GConn
+ *  @group: a #GConnRateGroup; NULL to leave the current group
+ *
+ *  Puts a #GConn in a #GConnRateGroup, so it shares the group's
+ *  bandwidth limit with the other connections in the group.  A #GConn
+ *  is in at most one group.  The #GConn must use the #GMainContext
+ *  the group was created with; see gnet_conn_rate_group_new_full().
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_set_rate_group (GConn* conn, GConnRateGroup* group)
+{
+  struct _GConnRate* rate;
+  GConnRateGroup* old;
+
+  g_return_if_fail (conn != NULL);
+  g_return_if_fail (group == NULL ||
+		    SAME_CONTEXT (group->read->context, conn->context));
+
+  if (!conn->rate && group == NULL)
+    return;
+
+  rate = conn_rate_get (conn);
+  if (rate->group == group)
+    return;
+
+  old = rate->group;
+  rate->group = group;
+
+  if (group)
+    gnet_conn_rate_group_ref (group);
+
+  scheduler_set_parent (rate->read, group ? group->read : NULL);
+  scheduler_set_parent (rate->write, group ? group->write : NULL);
+
+  if (old)
+    gnet_conn_rate_group_unref (old);
+
+  conn_rate_update (conn);
+}
+
+
+/**
+ *  gnet_conn_set_rate_weight
+ *  @conn: a #GConn
+ *  @weight: share of the group's bandwidth, at least 1
+ *
+ *  Sets the weight of a #GConn in its #GConnRateGroup.  With
+ *  %GNET_CONN_RATE_WEIGHTED_FAIR, connections waiting for the group's
+ *  bandwidth get it in proportion to their weights, so a #GConn with
+ *  weight 2 gets twice as many bytes as one with weight 1.  The
+ *  default is 1.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_set_rate_weight (GConn* conn, guint weight)
+{
+  struct _GConnRate* rate;
+
+  g_return_if_fail (conn != NULL);
+  g_return_if_fail (weight > 0);
+
+  rate = conn_rate_get (conn);
+  rate->read->child.weight = weight;
+  rate->write->child.weight = weight;
+}
+
+
+static struct _GConnRate*
+conn_rate_get (GConn* conn)
+{
+  struct _GConnRate* rate;
+
+  if (conn->rate)
+    return conn->rate;
+
+  rate = g_new0 (struct _GConnRate, 1);
+  rate->read = scheduler_new (conn->context);
+  rate->write = scheduler_new (conn->context);
+  scheduler_schedulee_init (&rate->read_schedulee, conn_read_scheduled, conn);
+  scheduler_schedulee_init (&rate->write_schedulee, conn_write_scheduled, conn);
+  conn->rate = rate;
+
+  return rate;
+}
+
+
+/* Go back to reading and writing directly in a direction that is no
+   longer limited */
+static void
+conn_rate_update (GConn* conn)
+{
+  struct _GConnRate* rate = conn->rate;
+
+  if (!RATE_LIMITED (rate->read) && rate->read_schedulee.queued)
+    {
+      scheduler_remove (rate->read, &rate->read_schedulee);
+      conn_check_read_queue (conn);
+    }
+
+  if (!RATE_LIMITED (rate->write) && rate->write_schedulee.queued)
+    {
+      scheduler_remove (rate->write, &rate->write_schedulee);
+      conn_check_write_queue (conn);
+    }
+}
+
+
+static void
+conn_rate_free (GConn* conn)
+{
+  struct _GConnRate* rate = conn->rate;
+
+  if (!rate)
+    return;
+
+  scheduler_remove (rate->read, &rate->read_schedulee);
+  scheduler_remove (rate->write, &rate->write_schedulee);
+  scheduler_unref (rate->read);
+  scheduler_unref (rate->write);
+  if (rate->group)
+    gnet_conn_rate_group_unref (rate->group);
+
+  g_free (rate);
+  conn->rate = NULL;
+}
+
+
+/**
+ *  gnet_conn_rate_group_new
+ *  @read_bps: most bytes per second to read; 0 for no limit
+ *  @write_bps: most bytes per second to write; 0 for no limit
+ *
+ *  Creates a #GConnRateGroup.  The connections put in the group with
+ *  gnet_conn_set_rate_group() together read and write no more than
+ *  @read_bps and @write_bps.  The bandwidth is shared round robin; see
+ *  gnet_conn_rate_group_set_policy().  The group uses the default
+ *  #GMainContext, so only connections using it can be put in the
+ *  group; see gnet_conn_rate_group_new_full().
+ *
+ *  Returns: a new #GConnRateGroup.
+ *
+ *  Since: 2.0.9
+ **/
+GConnRateGroup*
+gnet_conn_rate_group_new (gint read_bps, gint write_bps)
+{
+  return gnet_conn_rate_group_new_full (read_bps, write_bps, NULL);
+}
+
+
+/**
+ *  gnet_conn_rate_group_new_full
+ *  @read_bps: most bytes per second to read; 0 for no limit
+ *  @write_bps: most bytes per second to write; 0 for no limit
+ *  @context: the #GMainContext of the connections in the group, or
+ *      NULL for the default GLib main context
+ *
+ *  Like gnet_conn_rate_group_new(), but the group schedules its
+ *  connections in @context.  Only connections using @context (see
+ *  gnet_conn_set_main_context()) can be put in the group.
+ *
+ *  Returns: a new #GConnRateGroup.
+ *
+ *  Since: 2.0.9
+ **/
+GConnRateGroup*
+gnet_conn_rate_group_new_full (gint read_bps, gint write_bps,
+			       GMainContext* context)
+{
+  GConnRateGroup* group;
+
+  g_return_val_if_fail (read_bps >= 0, NULL);
+  g_return_val_if_fail (write_bps >= 0, NULL);
+
+  group = g_new0 (GConnRateGroup, 1);
+  group->ref_count = 1;
+  group->read = scheduler_new (context);
+  group->write = scheduler_new (context);
+  gnet_conn_rate_group_set_limit (group, read_bps, write_bps);
+
+  return group;
+}
+
+
+/**
+ *  gnet_conn_rate_group_ref
+ *  @group: a #GConnRateGroup
+ *
+ *  Adds a reference to a #GConnRateGroup.
+ *
+ *  Returns: @group
+ *
+ *  Since: 2.0.9
+ **/
+GConnRateGroup*
+gnet_conn_rate_group_ref (GConnRateGroup* group)
+{
+  g_return_val_if_fail (group != NULL, NULL);
+
+  ++group->ref_count;
+
+  return group;
+}
+
+
+/**
+ *  gnet_conn_rate_group_unref
+ *  @group: a #GConnRateGroup
+ *
+ *  Removes a reference from a #GConnRateGroup.  Each #GConn in the
+ *  group holds a reference, so the group is freed when the reference
+ *  count reaches 0 and no #GConn is in it.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_rate_group_unref (GConnRateGroup* group)
+{
+  g_return_if_fail (group != NULL);
+
+  if (--group->ref_count > 0)
+    return;
+
+  scheduler_unref (group->read);
+  scheduler_unref (group->write);
+  g_free (group);
+}
+
+
+/**
+ *  gnet_conn_rate_group_set_limit
+ *  @group: a #GConnRateGroup
+ *  @read_bps: most bytes per second to read; 0 for no limit
+ *  @write_bps: most bytes per second to write; 0 for no limit
+ *
+ *  Changes the bandwidth limit of a #GConnRateGroup.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_rate_group_set_limit (GConnRateGroup* group,
+				gint read_bps, gint write_bps)
+{
+  g_return_if_fail (group != NULL);
+  g_return_if_fail (read_bps >= 0);
+  g_return_if_fail (write_bps >= 0);
+
+  scheduler_set_max_ups (group->read,
+      read_bps ? read_bps : SCHEDULER_UNLIMITED_UNITS);
+  scheduler_set_max_ups (group->write,
+      write_bps ? write_bps : SCHEDULER_UNLIMITED_UNITS);
+}
+
+
+/**
+ *  gnet_conn_rate_group_set_policy
+ *  @group: a #GConnRateGroup
+ *  @policy: how to share the bandwidth
+ *
+ *  Sets how a #GConnRateGroup shares its bandwidth between the
+ *  connections waiting for it.  The default is
+ *  %GNET_CONN_RATE_ROUND_ROBIN.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_rate_group_set_policy (GConnRateGroup* group,
+				 GConnRatePolicy policy)
+{
+  SchedulerPolicy scheduler_policy;
+
+  g_return_if_fail (group != NULL);
+
+  if (policy == GNET_CONN_RATE_WEIGHTED_FAIR)
+    scheduler_policy = SCHEDULER_POLICY_WEIGHTED_FAIR;
+  else
+    scheduler_policy = SCHEDULER_POLICY_ROUND_ROBIN;
+
+  scheduler_set_policy (group->read, scheduler_policy);
+  scheduler_set_policy (group->write, scheduler_policy);
+}
+
+
+
+/* **************************************** */
+
+
+/**
+ *  gnet_conn_bytes_new
+ *  @data: data to copy
+ *  @length: length of @data
+ *
+ *  Creates a #GConnBytes holding a copy of @data.  The copy is made
+ *  once and shared by every write it is queued for with
+ *  gnet_conn_write_bytes().
+ *
+ *  Returns: a new #GConnBytes; unref with gnet_conn_bytes_unref().
+ *
+ *  Since: 2.0.9
+ **/
+GConnBytes*
+gnet_conn_bytes_new (const gchar* data, gint length)
+{
+  GConnBytes* bytes;
+
+  g_return_val_if_fail (data != NULL || length == 0, NULL);
+  g_return_val_if_fail (length >= 0, NULL);
+
+  /* Store the data right after the header: one allocation */
+  bytes = g_malloc (sizeof (GConnBytes) + length);
+  bytes->data = (gchar*) (bytes + 1);
+  bytes->length = length;
+  bytes->ref_count = 1;
+  bytes->owns_data = FALSE;
+  if (length)
+    memcpy (bytes->data, data, length);
+
+  return bytes;
+}
+
+
+/**
+ *  gnet_conn_bytes_new_take
+ *  @data: data to take (callee owned)
+ *  @length: length of @data
+ *
+ *  Creates a #GConnBytes from @data without copying it.  @data must
+ *  have been allocated with g_malloc(); it is freed with g_free() when
+ *  the last reference is dropped.  Do not modify @data afterwards.
+ *
+ *  Returns: a new #GConnBytes; unref with gnet_conn_bytes_unref().
+ *
+ *  Since: 2.0.9
+ **/
+GConnBytes*
+gnet_conn_bytes_new_take (gchar* data, gint length)
+{
+  GConnBytes* bytes;
+
+  g_return_val_if_fail (data != NULL || length == 0, NULL);
+  g_return_val_if_fail (length >= 0, NULL);
+
+  bytes = g_new0 (GConnBytes, 1);
+  bytes->data = data;
+  bytes->length = length;
+  bytes->ref_count = 1;
+  bytes->owns_data = TRUE;
+
+  return bytes;
+}
+
+
+/**
+ *  gnet_conn_bytes_ref
+ *  @bytes: a #GConnBytes
+ *
+ *  Adds a reference to a #GConnBytes.  This function is thread-safe.
+ *
+ *  Returns: @bytes
+ *
+ *  Since: 2.0.9
+ **/
+GConnBytes*
+gnet_conn_bytes_ref (GConnBytes* bytes)
+{
+  g_return_val_if_fail (bytes != NULL, NULL);
+
+  g_atomic_int_inc (&bytes->ref_count);
+
+  return bytes;
+}
+
+
+/**
+ *  gnet_conn_bytes_unref
+ *  @bytes: a #GConnBytes
+ *
+ *  Removes a reference from a #GConnBytes.  The data is freed when the
+ *  reference count reaches 0.  This function is thread-safe.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_conn_bytes_unref (GConnBytes* bytes)
+{
+  g_return_if_fail (bytes != NULL);
+
+  if (!g_atomic_int_dec_and_test (&bytes->ref_count))
+    return;
+
+  if (bytes->owns_data)
+    g_free (bytes->data);
+  g_free (bytes);
+}
+
+
+/**
+ *  gnet_conn_bytes_get_data
+ *  @bytes: a #GConnBytes
+ *
+ *  Gets the data of a #GConnBytes.  The data must not be modified.
+ *
+ *  Returns: the data (callee owned).
+ *
+ *  Since: 2.0.9
+ **/
+const gchar*
+gnet_conn_bytes_get_data (const GConnBytes* bytes)
+{
+  g_return_val_if_fail (bytes != NULL, NULL);
+
+  return bytes->data;
+}
+
+
+/**
+ *  gnet_conn_bytes_get_length
+ *  @bytes: a #GConnBytes
+ *
+ *  Gets the length of the data of a #GConnBytes.
+ *
+ *  Returns: the length in bytes.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_conn_bytes_get_length (const GConnBytes* bytes)
+{
+  g_return_val_if_fail (bytes != NULL, 0);
+
+  return bytes->length;
+}
@@ -99,6 +99,15 @@ struct _GConnEvent
  *  @timer: [private]
  *  @func: [private]
  *  @user_data: [private]
+ *  @idle_timeout: [private]
+ *  @processing_reads: [private]
+ *  @fast_open: [private]
+ *  @rate: [private]
+ *  @read_wanted: [private]
+ *  @recv_op: [private]
+ *  @send_op: [private]
+ *  @options: [private]
+ *  @dispatch_queued: [private]
  *
  *  TCP Connection.  Some of the fields are public, but do not set
  *  these fields.
@@ -129,12 +138,13 @@ typedef struct _GConn GConn;
  *  %GNET_CONN_TIMEOUT: Timer set by gnet_conn_timeout() expires.
  *
  *  %GNET_CONN_READ: Data has been read.  This event occurs as a result
- *  of calling gnet_conn_read(), gnet_conn_readn(), or
- *  gnet_conn_readline().  buffer and length are set in the event
- *  object.  The buffer is caller owned.
+ *  of calling gnet_conn_read(), gnet_conn_readn(),
+ *  gnet_conn_readline(), or gnet_conn_read_in_place().  buffer and
+ *  length are set in the event object.  The buffer is caller owned.
  *
  *  %GNET_CONN_WRITE: Data has been written.  This event occurs as a
- *  result of calling gnet_conn_write() or gnet_conn_write_direct().
+ *  result of calling gnet_conn_write(), gnet_conn_write_direct() or
+ *  gnet_conn_write_bytes().
  *
  *  %GNET_CONN_READABLE: The connection is readable.
  *
@@ -144,6 +154,51 @@ typedef struct _GConn GConn;
 typedef void (*GConnFunc)(GConn* conn, GConnEvent* event, gpointer user_data);
 
 
+/**
+ *  GConnBytes
+ *
+ *  Reference-counted, immutable data buffer that can be queued for
+ *  writing on any number of #GConn objects with
+ *  gnet_conn_write_bytes().  The data is shared by all the queued
+ *  writes and freed when the last reference is dropped.
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GConnBytes GConnBytes;
+
+
+/**
+ *  GConnRatePolicy
+ *  @GNET_CONN_RATE_ROUND_ROBIN: connections take turns
+ *  @GNET_CONN_RATE_WEIGHTED_FAIR: connections get bytes in proportion
+ *    to their weights
+ *
+ *  How a #GConnRateGroup shares its bandwidth between the connections
+ *  waiting for it.  With round robin, each waiting connection reads or
+ *  writes once in turn, so connections moving bigger pieces get more
+ *  bandwidth.  With weighted fair queueing, each gets a share of the
+ *  bytes in proportion to the weight set with
+ *  gnet_conn_set_rate_weight().
+ *
+ *  Since: 2.0.9
+ **/
+typedef enum {
+  GNET_CONN_RATE_ROUND_ROBIN,
+  GNET_CONN_RATE_WEIGHTED_FAIR
+} GConnRatePolicy;
+
+
+/**
+ *  GConnRateGroup
+ *
+ *  Bandwidth limit shared by a group of #GConn objects.  Add a
+ *  #GConn to a group with gnet_conn_set_rate_group().
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GConnRateGroup GConnRateGroup;
+
+
 struct _GConn
 {
   /* Public */
@@ -173,7 +228,7 @@ struct _GConn
   guint 			bytes_read;
   gboolean			read_eof;
   GList*			read_queue;
-  guint				process_buffer_timeout;
+  guint				process_buffer_timeout;	/* unused */
 
   /* Readable/writable */
   gboolean			watch_readable;
@@ -192,6 +247,30 @@ struct _GConn
 
   GMainContext                * context;
   gint                          priority;
+
+  /* Idle timeout (0 if none) */
+  guint				idle_timeout;
+
+  /* TRUE while the read buffer is being processed */
+  gboolean			processing_reads;
+
+  /* Connect with TCP Fast Open */
+  gboolean			fast_open;
+
+  /* Rate limits (NULL if none) */
+  struct _GConnRate*		rate;
+
+  /* Bytes to buffer before the next in-place read */
+  guint				read_wanted;
+
+  /* io_uring receive and send in flight (0 if none) */
+  guint				recv_op;
+  guint				send_op;
+
+  /* Options of gnet_conn_set_option() (of TcpSocketOption, or NULL) */
+  GArray*			options;
+  /* Queued in the read dispatcher of the main context */
+  gboolean			dispatch_queued;
 };
 
 
@@ -218,6 +297,7 @@ gboolean   gnet_conn_set_main_context (GConn * conn, GMainContext * context);
 /* ********** */
 
 void	   gnet_conn_connect (GConn* conn);
+void	   gnet_conn_set_fast_open (GConn* conn, gboolean enable);
 void	   gnet_conn_disconnect (GConn* conn);
 	      
 gboolean   gnet_conn_is_connected (const GConn* conn);
@@ -228,6 +308,8 @@ gboolean   gnet_conn_is_connected (const GConn* conn);
 void	   gnet_conn_read (GConn* conn);
 void	   gnet_conn_readn (GConn* conn, gint length);
 void	   gnet_conn_readline (GConn* conn);
+void	   gnet_conn_read_in_place (GConn* conn);
+void	   gnet_conn_read_consume (GConn* conn, gint consumed, gint needed);
 
 void	   gnet_conn_write (GConn* conn, gchar* buffer, gint length);
 void	   gnet_conn_write_direct (GConn* conn, gchar* buffer, gint length,
@@ -238,6 +320,39 @@ void	   gnet_conn_set_watch_writable (GConn* conn, gboolean enable);
 void	   gnet_conn_set_watch_error    (GConn* conn, gboolean enable);
 
 void	   gnet_conn_timeout (GConn* conn, guint timeout);
+void	   gnet_conn_idle_timeout (GConn* conn, guint timeout);
+
+gboolean   gnet_conn_set_option (GConn* conn, GNetSocketOption option,
+				 gint value);
+gboolean   gnet_conn_get_option (const GConn* conn, GNetSocketOption option,
+				 gint* value);
+
+void	   gnet_conn_set_rate_limit (GConn* conn, gint read_bps, gint write_bps);
+void	   gnet_conn_set_rate_group (GConn* conn, GConnRateGroup* group);
+void	   gnet_conn_set_rate_weight (GConn* conn, guint weight);
+
+/* ********** */
+
+GConnRateGroup* gnet_conn_rate_group_new (gint read_bps, gint write_bps);
+GConnRateGroup* gnet_conn_rate_group_new_full (gint read_bps, gint write_bps,
+					       GMainContext* context);
+GConnRateGroup* gnet_conn_rate_group_ref (GConnRateGroup* group);
+void	    gnet_conn_rate_group_unref (GConnRateGroup* group);
+void	    gnet_conn_rate_group_set_limit (GConnRateGroup* group,
+					    gint read_bps, gint write_bps);
+void	    gnet_conn_rate_group_set_policy (GConnRateGroup* group,
+					     GConnRatePolicy policy);
+
+/* ********** */
+
+GConnBytes* gnet_conn_bytes_new (const gchar* data, gint length);
+GConnBytes* gnet_conn_bytes_new_take (gchar* data, gint length);
+GConnBytes* gnet_conn_bytes_ref (GConnBytes* bytes);
+void	    gnet_conn_bytes_unref (GConnBytes* bytes);
+const gchar* gnet_conn_bytes_get_data (const GConnBytes* bytes);
+gint	    gnet_conn_bytes_get_length (const GConnBytes* bytes);
+
+void	   gnet_conn_write_bytes (GConn* conn, GConnBytes* bytes);
 
 G_END_DECLS
 
@@ -0,0 +1,69 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+
+#include "cpu-private.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+static guint
+cpu_detect (void)
+{
+  guint features = 0;
+  const gchar* env;
+
+  env = getenv ("GNET_SIMD");
+  if (env && strcmp (env, "none") == 0)
+    return 0;
+
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("ssse3"))
+    features |= GNET_CPU_SSSE3;
+  if (__builtin_cpu_supports ("avx2"))
+    features |= GNET_CPU_AVX2;
+#endif
+#ifdef HAVE_X86_SHA
+  if (__builtin_cpu_supports ("sha") && __builtin_cpu_supports ("sse4.1"))
+    features |= GNET_CPU_SHA;
+#endif
+
+  return features;
+}
+
+
+guint
+_gnet_cpu_get_features (void)
+{
+  /* The high bit marks the features as detected.  Detection gives the
+     same answer in every thread, so a race only repeats it. */
+  static gint features = 0;	/* ATOMIC */
+  gint f;
+
+  f = g_atomic_int_get (&features);
+  if (!f)
+    {
+      f = (gint) (cpu_detect () | 0x80000000U);
+      g_atomic_int_compare_and_exchange (&features, 0, f);
+    }
+
+  return (guint) f & 0x7FFFFFFFU;
+}
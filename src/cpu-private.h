@@ -0,0 +1,45 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+
+#ifndef _GNET_CPU_PRIVATE_H
+#define _GNET_CPU_PRIVATE_H
+
+#include "gnet-private.h"
+
+/* CPU features for the optional vector code paths.  The features are
+   detected on first use.  Setting GNET_SIMD=none in the environment
+   turns them all off, so the portable code can be tested and
+   benchmarked on any machine.
+
+   Vector code is only built if configure found HAVE_X86_SIMD: a
+   compiler with <immintrin.h>, the target function attribute and
+   __builtin_cpu_supports().  The SHA extensions need HAVE_X86_SHA
+   too, since older compilers lack them. */
+typedef enum
+{
+  GNET_CPU_SSSE3	= 1 << 0,
+  GNET_CPU_AVX2		= 1 << 1,
+  GNET_CPU_SHA		= 1 << 2	/* SHA-NI, with SSE4.1 */
+
+} GNetCpuFeatures;
+
+guint	_gnet_cpu_get_features (void);
+
+#endif /* _GNET_CPU_PRIVATE_H */
@@ -0,0 +1,374 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#include "epoll-private.h"
+
+#ifdef HAVE_EPOLL
+
+#include <sys/epoll.h>
+
+/* Maximum number of events fetched per dispatch */
+#define EPOLL_MAX_EVENTS	64
+
+
+typedef struct _EpollSource EpollSource;
+
+typedef struct _EpollWatch
+{
+  guint		id;
+  gint		fd;
+  GIOChannel*	channel;
+  GIOCondition	condition;
+  GIOFunc	function;
+  gpointer	data;
+  gint		ref_count;
+  gboolean	removed;
+
+} EpollWatch;
+
+
+struct _EpollSource
+{
+  GSource	source;
+  GPollFD	pollfd;		/* the epoll fd itself */
+  GMainContext* context;
+  GHashTable*	watches;	/* id -> EpollWatch */
+};
+
+
+static gboolean epoll_source_prepare  (GSource* source, gint* timeout);
+static gboolean epoll_source_check    (GSource* source);
+static gboolean epoll_source_dispatch (GSource* source, GSourceFunc callback,
+				       gpointer user_data);
+static void	epoll_source_finalize (GSource* source);
+
+static GSourceFuncs epoll_source_funcs =
+{
+  epoll_source_prepare,
+  epoll_source_check,
+  epoll_source_dispatch,
+  epoll_source_finalize,
+  NULL,
+  NULL
+};
+
+/* GMainContext -> EpollSource.  The source lives as long as its
+   context; it is removed from here when the context destroys it. */
+static GHashTable* epoll_sources = NULL;
+static guint	   epoll_next_id = 0;
+G_LOCK_DEFINE_STATIC (epoll_sources);
+
+
+
+static guint32
+condition_to_epoll (GIOCondition condition)
+{
+  guint32 events = 0;
+
+  if (condition & G_IO_IN)
+    events |= EPOLLIN;
+  if (condition & G_IO_PRI)
+    events |= EPOLLPRI;
+  if (condition & G_IO_OUT)
+    events |= EPOLLOUT;
+  /* EPOLLERR and EPOLLHUP are always reported */
+
+  return events;
+}
+
+
+static GIOCondition
+epoll_to_condition (guint32 events)
+{
+  GIOCondition condition = 0;
+
+  if (events & EPOLLIN)
+    condition |= G_IO_IN;
+  if (events & EPOLLPRI)
+    condition |= G_IO_PRI;
+  if (events & EPOLLOUT)
+    condition |= G_IO_OUT;
+  if (events & EPOLLERR)
+    condition |= G_IO_ERR;
+  if (events & EPOLLHUP)
+    condition |= G_IO_HUP;
+
+  return condition;
+}
+
+
+static void
+epoll_watch_unref (EpollWatch* watch)
+{
+  if (--watch->ref_count > 0)
+    return;
+
+  g_io_channel_unref (watch->channel);
+  g_free (watch);
+}
+
+
+/* Returns the epoll source of @context, creating it if needed */
+static EpollSource*
+epoll_source_get (GMainContext* context, gboolean create)
+{
+  EpollSource* es;
+  gint epfd;
+
+  if (context == NULL)
+    context = g_main_context_default ();
+
+  G_LOCK (epoll_sources);
+
+  if (epoll_sources == NULL)
+    epoll_sources = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  es = g_hash_table_lookup (epoll_sources, context);
+  if (es != NULL || !create)
+    goto done;
+
+  epfd = epoll_create (EPOLL_MAX_EVENTS);
+  if (epfd < 0)
+    goto done;
+  fcntl (epfd, F_SETFD, FD_CLOEXEC);
+
+  es = (EpollSource*) g_source_new (&epoll_source_funcs, sizeof (EpollSource));
+  es->pollfd.fd = epfd;
+  es->pollfd.events = G_IO_IN;
+  es->pollfd.revents = 0;
+  es->context = context;
+  es->watches = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  g_source_add_poll ((GSource*) es, &es->pollfd);
+  g_source_attach ((GSource*) es, context);
+  g_source_unref ((GSource*) es);	/* context owns it now */
+
+  g_hash_table_insert (epoll_sources, context, es);
+
+ done:
+  G_UNLOCK (epoll_sources);
+
+  return es;
+}
+
+
+static gboolean
+epoll_source_prepare (GSource* source, gint* timeout)
+{
+  *timeout = -1;
+  return FALSE;
+}
+
+
+static gboolean
+epoll_source_check (GSource* source)
+{
+  EpollSource* es = (EpollSource*) source;
+
+  return (es->pollfd.revents & G_IO_IN) != 0;
+}
+
+
+static gboolean
+epoll_source_dispatch (GSource* source, GSourceFunc callback,
+		       gpointer user_data)
+{
+  EpollSource* es = (EpollSource*) source;
+  struct epoll_event events[EPOLL_MAX_EVENTS];
+  gint n, i;
+
+  n = epoll_wait (es->pollfd.fd, events, EPOLL_MAX_EVENTS, 0);
+
+  for (i = 0; i < n; ++i)
+    {
+      EpollWatch* watch;
+      GIOCondition condition;
+
+      /* The watch may have been removed by an earlier callback */
+      watch = g_hash_table_lookup (es->watches,
+				   GUINT_TO_POINTER (events[i].data.u32));
+      if (watch == NULL)
+	continue;
+
+      /* Like a GLib watch, only report what was asked for */
+      condition = epoll_to_condition (events[i].events) & watch->condition;
+      if (condition == 0)
+	continue;
+
+      /* Protect the watch: the callback may remove it */
+      watch->ref_count++;
+
+      if (!(watch->function) (watch->channel, condition, watch->data) &&
+	  !watch->removed)
+	_gnet_epoll_watch_remove (es->context, watch->id);
+
+      epoll_watch_unref (watch);
+    }
+
+  return TRUE;
+}
+
+
+static gboolean
+epoll_source_finalize_watch (gpointer key, gpointer value, gpointer user_data)
+{
+  EpollWatch* watch = (EpollWatch*) value;
+
+  watch->removed = TRUE;
+  epoll_watch_unref (watch);
+
+  return TRUE;
+}
+
+
+static void
+epoll_source_finalize (GSource* source)
+{
+  EpollSource* es = (EpollSource*) source;
+
+  G_LOCK (epoll_sources);
+  if (epoll_sources &&
+      g_hash_table_lookup (epoll_sources, es->context) == es)
+    g_hash_table_remove (epoll_sources, es->context);
+  G_UNLOCK (epoll_sources);
+
+  g_hash_table_foreach_remove (es->watches, epoll_source_finalize_watch, NULL);
+  g_hash_table_destroy (es->watches);
+
+  close (es->pollfd.fd);
+}
+
+
+/* **************************************** */
+
+
+guint
+_gnet_epoll_watch_add (GMainContext* context, GIOChannel* channel,
+		       GIOCondition condition, GIOFunc function,
+		       gpointer data)
+{
+  EpollSource* es;
+  EpollWatch* watch;
+  struct epoll_event event;
+  gint fd;
+
+  g_return_val_if_fail (channel != NULL, 0);
+  g_return_val_if_fail (function != NULL, 0);
+
+  es = epoll_source_get (context, TRUE);
+  if (es == NULL)
+    return 0;
+
+  fd = g_io_channel_unix_get_fd (channel);
+
+  watch = g_new0 (EpollWatch, 1);
+  watch->fd = fd;
+  watch->channel = g_io_channel_ref (channel);
+  watch->condition = condition;
+  watch->function = function;
+  watch->data = data;
+  watch->ref_count = 1;
+
+  G_LOCK (epoll_sources);
+  do {
+    epoll_next_id = (epoll_next_id + 1) & ~GNET_WATCH_ID_TAG_MASK;
+    watch->id = epoll_next_id | GNET_WATCH_ID_TAG_EPOLL;
+  } while (epoll_next_id == 0);
+  G_UNLOCK (epoll_sources);
+
+  memset (&event, 0, sizeof (event));
+  event.events = condition_to_epoll (condition);
+  event.data.u32 = watch->id;
+
+  if (epoll_ctl (es->pollfd.fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+      /* Not pollable by epoll (or already added by someone else) */
+      epoll_watch_unref (watch);
+      return 0;
+    }
+
+  g_hash_table_insert (es->watches, GUINT_TO_POINTER (watch->id), watch);
+
+  return watch->id;
+}
+
+
+gboolean
+_gnet_epoll_watch_modify (GMainContext* context, guint id,
+			  GIOCondition condition, GIOFunc function,
+			  gpointer data)
+{
+  EpollSource* es;
+  EpollWatch* watch;
+  struct epoll_event event;
+
+  es = epoll_source_get (context, FALSE);
+  if (es == NULL)
+    return FALSE;
+
+  watch = g_hash_table_lookup (es->watches, GUINT_TO_POINTER (id));
+  if (watch == NULL)
+    return FALSE;
+
+  watch->function = function;
+  watch->data = data;
+
+  if (watch->condition == condition)
+    return TRUE;
+
+  memset (&event, 0, sizeof (event));
+  event.events = condition_to_epoll (condition);
+  event.data.u32 = watch->id;
+
+  if (epoll_ctl (es->pollfd.fd, EPOLL_CTL_MOD, watch->fd, &event) < 0)
+    return FALSE;
+
+  watch->condition = condition;
+
+  return TRUE;
+}
+
+
+void
+_gnet_epoll_watch_remove (GMainContext* context, guint id)
+{
+  EpollSource* es;
+  EpollWatch* watch;
+  struct epoll_event event;
+
+  es = epoll_source_get (context, FALSE);
+  if (es == NULL)
+    return;
+
+  watch = g_hash_table_lookup (es->watches, GUINT_TO_POINTER (id));
+  if (watch == NULL)
+    return;
+
+  g_hash_table_remove (es->watches, GUINT_TO_POINTER (id));
+
+  /* Fails harmlessly if the fd has already been closed.  (Old kernels
+     want a non-NULL event even for EPOLL_CTL_DEL.) */
+  memset (&event, 0, sizeof (event));
+  epoll_ctl (es->pollfd.fd, EPOLL_CTL_DEL, watch->fd, &event);
+
+  watch->removed = TRUE;
+  epoll_watch_unref (watch);
+}
+
+#endif /* HAVE_EPOLL */
@@ -0,0 +1,51 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#ifndef _GNET_EPOLL_PRIVATE_H
+#define _GNET_EPOLL_PRIVATE_H
+
+#include "gnet-private.h"
+
+#ifdef HAVE_EPOLL
+
+#define GNET_IS_EPOLL_WATCH_ID(ID)	\
+  (((ID) & GNET_WATCH_ID_TAG_MASK) == GNET_WATCH_ID_TAG_EPOLL)
+
+/* All watches of a GMainContext share one epoll fd, which is polled
+   by a single GSource.  Returns 0 if the fd can not be watched with
+   epoll (the caller should fall back to a GLib watch then). */
+guint	_gnet_epoll_watch_add (GMainContext * context,
+                               GIOChannel   * channel,
+                               GIOCondition   condition,
+                               GIOFunc        function,
+                               gpointer       data);
+
+/* Changes the condition of a watch with one epoll_ctl() call.
+   Returns FALSE if the watch does not exist. */
+gboolean _gnet_epoll_watch_modify (GMainContext * context,
+                                   guint          watch,
+                                   GIOCondition   condition,
+                                   GIOFunc        function,
+                                   gpointer       data);
+
+void	_gnet_epoll_watch_remove (GMainContext * context, guint watch);
+
+#endif /* HAVE_EPOLL */
+
+#endif /* _GNET_EPOLL_PRIVATE_H */
@@ -21,6 +21,8 @@
 
 #include "gnet-private.h"
 #include "gnet.h"
+#include "epoll-private.h"
+#include "uring-private.h"
 
 
 /* 
@@ -321,6 +323,120 @@ _gnet_io_watch_add_full (GMainContext * context, gint priority,
   return id;
 }
 
+/* Maps a GNetSocketOption to the setsockopt() level and name */
+static gboolean
+socket_option_lookup (GNetSocketOption option, int* level, int* name)
+{
+  switch (option)
+    {
+    case GNET_SOCKET_OPTION_RCVBUF:
+      *level = SOL_SOCKET;	*name = SO_RCVBUF;	return TRUE;
+    case GNET_SOCKET_OPTION_SNDBUF:
+      *level = SOL_SOCKET;	*name = SO_SNDBUF;	return TRUE;
+    case GNET_SOCKET_OPTION_TCP_NODELAY:
+      *level = IPPROTO_TCP;	*name = TCP_NODELAY;	return TRUE;
+#ifdef TCP_CORK
+    case GNET_SOCKET_OPTION_TCP_CORK:
+      *level = IPPROTO_TCP;	*name = TCP_CORK;	return TRUE;
+#endif
+#ifdef TCP_QUICKACK
+    case GNET_SOCKET_OPTION_TCP_QUICKACK:
+      *level = IPPROTO_TCP;	*name = TCP_QUICKACK;	return TRUE;
+#endif
+#ifdef SO_BUSY_POLL
+    case GNET_SOCKET_OPTION_BUSY_POLL:
+      *level = SOL_SOCKET;	*name = SO_BUSY_POLL;	return TRUE;
+#endif
+#ifdef TCP_FASTOPEN
+    case GNET_SOCKET_OPTION_TCP_FASTOPEN:
+      *level = IPPROTO_TCP;	*name = TCP_FASTOPEN;	return TRUE;
+#endif
+#ifdef SO_INCOMING_CPU
+    case GNET_SOCKET_OPTION_INCOMING_CPU:
+      *level = SOL_SOCKET;	*name = SO_INCOMING_CPU; return TRUE;
+#endif
+#ifdef SO_TIMESTAMPNS
+    case GNET_SOCKET_OPTION_TIMESTAMPNS:
+      *level = SOL_SOCKET;	*name = SO_TIMESTAMPNS;	return TRUE;
+#endif
+#ifdef SO_RXQ_OVFL
+    case GNET_SOCKET_OPTION_RXQ_OVFL:
+      *level = SOL_SOCKET;	*name = SO_RXQ_OVFL;	return TRUE;
+#endif
+    default:
+      return FALSE;
+    }
+}
+
+gboolean
+_gnet_socket_set_option (SOCKET sockfd, GNetSocketOption option, gint value)
+{
+  int level, name;
+  int v = value;
+
+  if (!socket_option_lookup (option, &level, &name))
+    return FALSE;
+
+  return setsockopt (sockfd, level, name, (void*) &v, sizeof (v)) == 0;
+}
+
+gboolean
+_gnet_socket_get_option (SOCKET sockfd, GNetSocketOption option, gint* value)
+{
+  int level, name;
+  int v = 0;
+  socklen_t len = sizeof (v);
+
+  if (!socket_option_lookup (option, &level, &name))
+    return FALSE;
+
+  if (getsockopt (sockfd, level, name, (void*) &v, &len) != 0)
+    return FALSE;
+
+  *value = v;
+  return TRUE;
+}
+
+void
+_gnet_socket_options_set (GArray** options, GNetSocketOption option,
+    gint value)
+{
+  TcpSocketOption o;
+  guint i;
+
+  if (*options == NULL)
+    *options = g_array_new (FALSE, FALSE, sizeof (TcpSocketOption));
+
+  for (i = 0; i < (*options)->len; ++i) {
+    TcpSocketOption *p = &g_array_index (*options, TcpSocketOption, i);
+
+    if (p->option == option) {
+      p->value = value;
+      return;
+    }
+  }
+
+  o.option = option;
+  o.value = value;
+  g_array_append_val (*options, o);
+}
+
+void
+_gnet_socket_set_options (SOCKET sockfd, const GArray * options)
+{
+  guint i;
+
+  if (options == NULL)
+    return;
+
+  for (i = 0; i < options->len; ++i) {
+    TcpSocketOption *o = &g_array_index (options, TcpSocketOption, i);
+
+    _gnet_socket_set_option (sockfd, o->option, o->value);
+  }
+}
+
+
 void
 _gnet_source_remove (GMainContext * context, guint source_id)
 {
@@ -339,3 +455,139 @@ _gnet_source_remove (GMainContext * context, guint source_id)
   }
 }
 
+
+guint
+_gnet_io_watch_update (GMainContext * context, guint watch,
+    GIOChannel * channel, GIOCondition condition, GIOFunc function,
+    gpointer data)
+{
+  g_return_val_if_fail (channel != NULL, 0);
+  g_return_val_if_fail (function != NULL, 0);
+
+  if (condition == 0) {
+    _gnet_io_watch_remove (context, watch);
+    return 0;
+  }
+
+#ifdef HAVE_IO_URING
+  if (watch != 0 && GNET_IS_URING_WATCH_ID (watch)) {
+    /* Queued with the other poll requests, the id stays the same */
+    if (_gnet_uring_watch_modify (context, watch, condition, function, data))
+      return watch;
+    _gnet_uring_watch_remove (context, watch);
+    watch = 0;
+  }
+
+  if (watch == 0 && gnet_get_io_backend () == GNET_IO_BACKEND_IO_URING) {
+    watch = _gnet_uring_watch_add (context, channel, condition, function,
+        data);
+    if (watch != 0)
+      return watch;
+    /* else fall back to a GLib watch */
+  }
+#endif
+
+#ifdef HAVE_EPOLL
+  if (watch != 0 && GNET_IS_EPOLL_WATCH_ID (watch)) {
+    /* Cheap path: one epoll_ctl(), the id stays the same */
+    if (_gnet_epoll_watch_modify (context, watch, condition, function, data))
+      return watch;
+    _gnet_epoll_watch_remove (context, watch);
+    watch = 0;
+  }
+
+  if (watch == 0 && gnet_get_io_backend () == GNET_IO_BACKEND_EPOLL) {
+    watch = _gnet_epoll_watch_add (context, channel, condition, function,
+        data);
+    if (watch != 0)
+      return watch;
+    /* else fall back to a GLib watch */
+  }
+#endif
+
+  if (watch != 0)
+    _gnet_source_remove (context, watch);
+
+  return _gnet_io_watch_add_full (context, G_PRIORITY_DEFAULT, channel,
+      condition, function, data, NULL);
+}
+
+void
+_gnet_io_watch_remove (GMainContext * context, guint watch)
+{
+  if (watch == 0)
+    return;
+
+#ifdef HAVE_IO_URING
+  if (GNET_IS_URING_WATCH_ID (watch)) {
+    _gnet_uring_watch_remove (context, watch);
+    return;
+  }
+#endif
+
+#ifdef HAVE_EPOLL
+  if (GNET_IS_EPOLL_WATCH_ID (watch)) {
+    _gnet_epoll_watch_remove (context, watch);
+    return;
+  }
+#endif
+
+  _gnet_source_remove (context, watch);
+}
+
+guint
+_gnet_io_recv (GMainContext * context, gint fd, GNetIOFunc function,
+    gpointer data)
+{
+  g_return_val_if_fail (function != NULL, 0);
+
+#ifdef HAVE_IO_URING
+  if (gnet_get_io_backend () == GNET_IO_BACKEND_IO_URING)
+    return _gnet_uring_recv (context, fd, function, data);
+#endif
+
+  return 0;
+}
+
+guint
+_gnet_io_send (GMainContext * context, gint fd, const gchar * buffer,
+    gsize length, GNetIOFunc function, gpointer data)
+{
+  g_return_val_if_fail (function != NULL, 0);
+
+#ifdef HAVE_IO_URING
+  if (gnet_get_io_backend () == GNET_IO_BACKEND_IO_URING)
+    return _gnet_uring_send (context, fd, buffer, length, function, data);
+#endif
+
+  return 0;
+}
+
+guint
+_gnet_io_accept (GMainContext * context, gint fd, GNetIOFunc function,
+    gpointer data)
+{
+  g_return_val_if_fail (function != NULL, 0);
+
+#ifdef HAVE_IO_URING
+  if (gnet_get_io_backend () == GNET_IO_BACKEND_IO_URING)
+    return _gnet_uring_accept (context, fd, function, data);
+#endif
+
+  return 0;
+}
+
+void
+_gnet_io_cancel (GMainContext * context, guint op, GDestroyNotify notify,
+    gpointer notify_data)
+{
+#ifdef HAVE_IO_URING
+  if (op != 0) {
+    _gnet_uring_cancel (context, op, notify, notify_data);
+    return;
+  }
+#endif
+
+  if (notify)
+    notify (notify_data);
+}
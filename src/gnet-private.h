@@ -61,6 +61,7 @@
 #include <net/if.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>		/* Need for TOS */
+#include <netinet/tcp.h>	/* Need for TCP_NODELAY */
 #include <arpa/inet.h>
 
 #include <arpa/nameser.h>
@@ -230,11 +231,14 @@ struct _GUdpSocket
   gint ref_count;
   GIOChannel* iochannel;
   struct sockaddr_storage sa;
+  struct _GUdpSocketReceiveState* receive_state;
+  gboolean pktinfo;	/* destination address reporting enabled */
 };
 
 struct _GMcastSocket
 {
   GUdpSocket udpsocket;
+  struct _GMcastSocketDispatch* dispatch;
 };
 
 struct _GTcpSocket
@@ -248,6 +252,12 @@ struct _GTcpSocket
   GTcpSocketAcceptFunc accept_func;
   gpointer accept_data;
   guint	accept_watch;
+  guint	accept_op;		/* io_uring accept in flight */
+
+  GArray* accept_options;	/* of TcpSocketOption, or NULL */
+
+  gboolean fast_open;		/* connected with TCP Fast Open, and not
+				   counted or checked yet */
 };
 
 struct _GInetAddr
@@ -507,6 +517,63 @@ SOCKET _gnet_create_listen_socket (int type, const GInetAddr* iface, int port, s
 int gnet_initialize_windows_sockets(void);
 void gnet_uninitialize_windows_sockets(void);
 
+/* Sets or gets a GNetSocketOption; returns FALSE if the option is not
+   supported by the system or the socket */
+gboolean _gnet_socket_set_option (SOCKET sockfd, GNetSocketOption option,
+				  gint value);
+gboolean _gnet_socket_get_option (SOCKET sockfd, GNetSocketOption option,
+				  gint* value);
+
+/* A socket option kept to be set on sockets created later */
+typedef struct _TcpSocketOption
+{
+  GNetSocketOption	option;
+  gint			value;
+
+} TcpSocketOption;
+
+/* Sets @option to @value in *@options (of TcpSocketOption), creating
+   the array if it is NULL; setting an option again replaces its
+   value */
+void _gnet_socket_options_set (GArray** options, GNetSocketOption option,
+			       gint value);
+/* Sets the options in @options (of TcpSocketOption, or NULL) on
+   @sockfd; options the socket does not support are ignored */
+void _gnet_socket_set_options (SOCKET sockfd, const GArray* options);
+
+/* gnet_tcp_socket_new_async_full() and
+   gnet_tcp_socket_connect_async_full(), connecting with TCP Fast Open
+   if @fast_open, and setting @options (of TcpSocketOption, or NULL)
+   on the socket before connecting.  The options are not set if SOCKS
+   is enabled. */
+GTcpSocketNewAsyncID _gnet_tcp_socket_new_async (const GInetAddr* addr,
+	GTcpSocketNewAsyncFunc func, gpointer data, GDestroyNotify notify,
+	GMainContext* context, gint priority, gboolean fast_open,
+	const GArray* options);
+GTcpSocketConnectAsyncID _gnet_tcp_socket_connect_async (const gchar* hostname,
+	gint port, GTcpSocketConnectAsyncFunc func, gpointer data,
+	GDestroyNotify notify, GMainContext* context, gint priority,
+	gboolean fast_open, const GArray* options);
+
+/* Counts a TCP Fast Open connection in
+   gnet_tcp_socket_get_fast_open_count() if its handshake is done and
+   the server acknowledged the data in the SYN.  Call after reads and
+   writes; does nothing once the connection was checked. */
+void _gnet_tcp_socket_check_fast_open (GTcpSocket* socket);
+
+/* Enables the control messages of gnet_udp_socket_receive_with_info() */
+void _gnet_udp_socket_enable_pktinfo (GUdpSocket* socket);
+
+/* gnet_udp_socket_receive_with_info(); if @block is FALSE, returns -1
+   if no datagram is waiting */
+gint _gnet_udp_socket_receive_with_info (GUdpSocket* socket,
+					 gchar* buffer, gint length,
+					 GInetAddr* src, GUdpPacketInfo* info,
+					 gboolean block);
+
+/* Frees the group dispatcher of a GMcastSocket that is deleted */
+void _gnet_mcast_socket_dispatch_free (GMcastSocket* socket);
+
 /* Private utility functions */
 
 guint   _gnet_idle_add_full     (GMainContext  * context,
@@ -533,6 +600,66 @@ guint   _gnet_io_watch_add_full (GMainContext  * context,
 /* will do nothing if source_id is 0 (unlike g_source_remove()) */
 void    _gnet_source_remove     (GMainContext * context, guint source_id);
 
+/* Watch ids handed out by the epoll and io_uring backends carry one
+   of these tags in their top bits, so they can never be confused with
+   GLib source ids. */
+#define GNET_WATCH_ID_TAG_MASK		0xC0000000U
+#define GNET_WATCH_ID_TAG_EPOLL		0x80000000U
+#define GNET_WATCH_ID_TAG_URING		0xC0000000U
+
+/* (Re)arms the I/O watch @watch (0 for none) for @condition and
+   returns its id, which may differ from @watch.  A @condition of 0
+   removes the watch and returns 0.  Uses the backend selected with
+   gnet_set_io_backend(). */
+guint   _gnet_io_watch_update   (GMainContext  * context,
+                                 guint           watch,
+                                 GIOChannel    * channel,
+                                 GIOCondition    condition,
+                                 GIOFunc         function,
+                                 gpointer        data);
+
+/* Removes a watch returned by _gnet_io_watch_update(); does nothing
+   if @watch is 0 */
+void    _gnet_io_watch_remove   (GMainContext * context, guint watch);
+
+/* Completion of an I/O operation.  @result is what the system call
+   returned, or minus the errno.  @buffer holds the bytes received by
+   a receive, or the peer address (a struct sockaddr_storage) of an
+   accept; it is only valid during the call. */
+typedef void (*GNetIOFunc) (gint result, gpointer buffer, gpointer data);
+
+/* Submit a receive, a send of @length bytes of @buffer, or an accept
+   on @fd as an operation of the io_uring backend, and call @function
+   when it completes.  Return the operation id, or 0 if the backend is
+   not io_uring or cannot run the operation; the caller then watches
+   @fd instead.  The @buffer of a send must stay valid until @function
+   is called, or until the notify of _gnet_io_cancel() is. */
+guint   _gnet_io_recv           (GMainContext  * context,
+                                 gint            fd,
+                                 GNetIOFunc      function,
+                                 gpointer        data);
+
+guint   _gnet_io_send           (GMainContext  * context,
+                                 gint            fd,
+                                 const gchar   * buffer,
+                                 gsize           length,
+                                 GNetIOFunc      function,
+                                 gpointer        data);
+
+guint   _gnet_io_accept         (GMainContext  * context,
+                                 gint            fd,
+                                 GNetIOFunc      function,
+                                 gpointer        data);
+
+/* Cancels operation @op; its function is not called.  @notify is
+   called with @notify_data once the kernel no longer uses the buffer
+   of @op, which may be at once.  Close the file descriptor only after
+   this. */
+void    _gnet_io_cancel         (GMainContext  * context,
+                                 guint           op,
+                                 GDestroyNotify  notify,
+                                 gpointer        notify_data);
+
 G_END_DECLS
 
 #endif /* _GNET_PRIVATE_H */
@@ -21,6 +21,7 @@
 
 #include "gnet-private.h"
 #include "gnet.h"
+#include "uring-private.h"
 
 const guint gnet_major_version = GNET_MAJOR_VERSION;
 const guint gnet_minor_version = GNET_MINOR_VERSION;
@@ -36,6 +37,8 @@ static gboolean ipv6_detect_iface (void);
 #endif
 #endif
 
+static GNetIOBackend io_backend = GNET_IO_BACKEND_GLIB;
+
 #ifdef GNET_WIN32
 void gnet_win32_at_exit( void ); /* Here to keep Visual Studio happy. */
 void gnet_win32_at_exit()
@@ -74,6 +77,17 @@ gnet_init (void)
     g_thread_init (NULL);
 
 #ifndef GNET_WIN32
+  /* Let the environment pick the I/O backend */
+  {
+    const gchar* envvar;
+
+    envvar = g_getenv ("GNET_IO_BACKEND");
+    if (envvar != NULL && strcmp (envvar, "epoll") == 0)
+      gnet_set_io_backend (GNET_IO_BACKEND_EPOLL);
+    else if (envvar != NULL && strcmp (envvar, "io_uring") == 0)
+      gnet_set_io_backend (GNET_IO_BACKEND_IO_URING);
+  }
+
   /* Auto-detect IPv6 policy.  Set it to IPv4 if auto-detection fails. */
 #ifdef HAVE_IPV6
   if (!ipv6_detect_envvar())
@@ -126,6 +140,76 @@ gnet_init (void)
 }
 
 
+/**
+ *  gnet_set_io_backend
+ *  @backend: the #GNetIOBackend to use
+ *
+ *  Selects how #GConn and asynchronously accepting #GTcpSocket servers
+ *  wait for I/O.  With %GNET_IO_BACKEND_EPOLL all their sockets in a
+ *  #GMainContext are multiplexed through one epoll file descriptor,
+ *  so the cost of a main loop iteration depends on the number of
+ *  active sockets rather than on the total number of sockets.  With
+ *  %GNET_IO_BACKEND_IO_URING #GConn reads and writes and accepts are
+ *  io_uring operations, and other waits are poll requests, all
+ *  submitted with one system call per main loop iteration.  Reads go
+ *  to buffers shared by all the sockets of the #GMainContext, so an
+ *  idle connection holds none.  Sockets that cannot be watched this
+ *  way, or kernels without these operations, silently use a GLib
+ *  watch or poll requests.
+ *
+ *  Call this right after gnet_init(), before any connections are
+ *  made.  Watches that already exist keep their backend.  The
+ *  backend can also be selected by setting the GNET_IO_BACKEND
+ *  environment variable to "epoll" or "io_uring" before calling
+ *  gnet_init().
+ *
+ *  Returns: TRUE if @backend is available, FALSE otherwise (then the
+ *  backend is not changed).
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_set_io_backend (GNetIOBackend backend)
+{
+  switch (backend)
+    {
+    case GNET_IO_BACKEND_GLIB:
+      break;
+#ifdef HAVE_EPOLL
+    case GNET_IO_BACKEND_EPOLL:
+      break;
+#endif
+#ifdef HAVE_IO_URING
+    case GNET_IO_BACKEND_IO_URING:
+      if (!_gnet_uring_available ())
+	return FALSE;
+      break;
+#endif
+    default:
+      return FALSE;
+    }
+
+  io_backend = backend;
+  return TRUE;
+}
+
+
+/**
+ *  gnet_get_io_backend
+ *
+ *  Gets the I/O backend set with gnet_set_io_backend().
+ *
+ *  Returns: the current #GNetIOBackend.
+ *
+ *  Since: 2.0.9
+ **/
+GNetIOBackend
+gnet_get_io_backend (void)
+{
+  return io_backend;
+}
+
+
 #if !defined(GNET_WIN32) && defined(HAVE_IPV6)
 #ifndef GNET_WIN32
 /* 
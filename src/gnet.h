@@ -25,6 +25,8 @@
 
 #include "gnetconfig.h"
 #include "inetaddr.h"
+#include "sockopt.h"
+#include "pool.h"
 #include "iochannel.h"
 #include "udp.h"
 #include "mcast.h"
@@ -37,6 +39,9 @@
 #include "server.h"
 #include "md5.h"
 #include "sha.h"
+#include "sha256.h"
+#include "sha512.h"
+#include "blake2b.h"
 #include "ipv6.h"
 #include "base64.h"
 
@@ -93,6 +98,31 @@ GNET_EXPORT const guint gnet_binary_age;
 void gnet_init (void);
 
 
+/**
+ *  GNetIOBackend
+ *  @GNET_IO_BACKEND_GLIB: one GLib I/O watch per socket (default)
+ *  @GNET_IO_BACKEND_EPOLL: all sockets of a #GMainContext share one
+ *    epoll file descriptor (Linux only)
+ *  @GNET_IO_BACKEND_IO_URING: the reads, writes, accepts and poll
+ *    requests of all sockets of a #GMainContext are batched through
+ *    one io_uring (Linux only)
+ *
+ *  How #GConn and the asynchronous accept of #GTcpSocket servers wait
+ *  for I/O.  See gnet_set_io_backend().
+ *
+ *  Since: 2.0.9
+ **/
+typedef enum
+{
+  GNET_IO_BACKEND_GLIB,
+  GNET_IO_BACKEND_EPOLL,
+  GNET_IO_BACKEND_IO_URING
+} GNetIOBackend;
+
+gboolean      gnet_set_io_backend (GNetIOBackend backend);
+GNetIOBackend gnet_get_io_backend (void);
+
+
 
 #ifdef __cplusplus
 }
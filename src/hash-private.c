@@ -0,0 +1,389 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#include "hash-private.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#ifdef GNET_WIN32
+#include <io.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/* Bytes mapped at once.  Small enough for a 32-bit address space, big
+   enough that mapping costs nothing next to hashing. */
+#define HASH_MAP_WINDOW		(64 * 1024 * 1024)
+/* Bytes read at once from files that are not mapped */
+#define HASH_READ_SIZE		(64 * 1024)
+
+
+static gboolean
+hash_read (gint fd, GNetHashUpdateFunc update, gpointer ctx)
+{
+  guint8* buffer;
+  gboolean ok = TRUE;
+
+  buffer = g_malloc (HASH_READ_SIZE);
+  for (;;)
+    {
+      gssize n;
+
+      n = read (fd, buffer, HASH_READ_SIZE);
+      if (n > 0)
+	update (ctx, buffer, n);
+      else if (n == 0)
+	break;
+      else if (errno != EINTR)
+	{
+	  ok = FALSE;
+	  break;
+	}
+    }
+  g_free (buffer);
+
+  return ok;
+}
+
+
+#if defined(HAVE_SYS_MMAN_H) && !defined(GNET_WIN32)
+
+/* Maps the file from @offset to @size in windows that start on a
+   window boundary.  Returns FALSE if a window cannot be mapped; the
+   caller then reads the rest.  The file must not shrink meanwhile:
+   touching a page past the end raises SIGBUS. */
+static gboolean
+hash_map (gint fd, off_t offset, off_t size,
+	  GNetHashUpdateFunc update, gpointer ctx, off_t* done)
+{
+  while (offset < size)
+    {
+      off_t start = offset - offset % HASH_MAP_WINDOW;
+      gsize length = MIN (size - start, HASH_MAP_WINDOW);
+      guint8* map;
+
+      map = mmap (NULL, length, PROT_READ, MAP_PRIVATE, fd, start);
+      if (map == MAP_FAILED)
+	return FALSE;
+#ifdef MADV_SEQUENTIAL
+      madvise (map, length, MADV_SEQUENTIAL);
+#endif
+
+      update (ctx, map + (offset - start), length - (offset - start));
+      munmap (map, length);
+
+      offset = start + length;
+      *done = offset;
+    }
+
+  return TRUE;
+}
+
+#endif
+
+
+gboolean
+_gnet_hash_fd (gint fd, GNetHashUpdateFunc update, gpointer ctx)
+{
+#if defined(HAVE_SYS_MMAN_H) && !defined(GNET_WIN32)
+  struct stat st;
+  off_t offset;
+
+  g_return_val_if_fail (fd >= 0, FALSE);
+  g_return_val_if_fail (update, FALSE);
+
+  /* Map regular files, from where the offset is.  Files in procfs
+     and sysfs report a size of 0 and are only read.  Whatever the
+     mapping left - bytes that could not be mapped or that were
+     appended after fstat() - is read after it. */
+  if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0 &&
+      (offset = lseek (fd, 0, SEEK_CUR)) >= 0 && offset < st.st_size)
+    {
+      off_t done = offset;
+
+      hash_map (fd, offset, st.st_size, update, ctx, &done);
+      if (lseek (fd, done, SEEK_SET) < 0)
+	return FALSE;
+    }
+#else
+  g_return_val_if_fail (fd >= 0, FALSE);
+  g_return_val_if_fail (update, FALSE);
+#endif
+
+  return hash_read (fd, update, ctx);
+}
+
+
+gboolean
+_gnet_hash_file (const gchar* filename,
+		 GNetHashUpdateFunc update, gpointer ctx)
+{
+  gint fd;
+  gboolean ok;
+
+  g_return_val_if_fail (filename, FALSE);
+
+  do
+    fd = open (filename, O_RDONLY | O_BINARY);
+  while (fd < 0 && errno == EINTR);
+  if (fd < 0)
+    return FALSE;
+
+  ok = _gnet_hash_fd (fd, update, ctx);
+  close (fd);
+
+  return ok;
+}
+
+
+gboolean
+_gnet_hash_digest_from_string (const gchar* str, guint8* digest, guint length)
+{
+  guint i;
+
+  for (i = 0; i < length * 2; ++i)
+    {
+      gint val = g_ascii_xdigit_value (str[i]);
+
+      if (val < 0)
+	return FALSE;
+
+      if (i % 2)
+	digest[i / 2] |= val;
+      else
+	digest[i / 2] = val << 4;
+    }
+
+  return TRUE;
+}
+
+
+void
+_gnet_hash_digest_to_string (const guint8* digest, guint length,
+			     gchar* buffer)
+{
+  static const gchar hex[] = "0123456789abcdef";
+  guint i;
+
+  for (i = 0; i < length; ++i)
+    {
+      buffer[i * 2]     = hex[digest[i] >> 4];
+      buffer[i * 2 + 1] = hex[digest[i] & 0x0F];
+    }
+}
+
+
+/* Lanes the vector kernel is kept running for */
+#define HASH_MIN_LANES		2
+
+#define HASH_BLOCK		64
+
+/* A message being hashed in a lane: its whole blocks, then one or two
+   blocks with the rest of the message, the padding and the length */
+typedef struct _HashLane
+{
+  guint			message;
+  gboolean		busy;
+  const guint8*		data;		/* next block */
+  gsize			blocks;		/* blocks left at data */
+  gboolean		in_tail;	/* data points into tail */
+  guint			tail_blocks;
+  guint8		tail[2 * HASH_BLOCK];
+
+} HashLane;
+
+
+static void
+hash_lane_start (const GNetHashBatch* batch, HashLane* lane, guint message,
+		 const guint8* buffer, gsize length)
+{
+  gsize rest = length % HASH_BLOCK;
+  guint64 bits = (guint64) length << 3;
+  guint tail_length;
+
+  lane->message = message;
+  lane->busy = TRUE;
+
+  /* Pad the rest to 56 bytes modulo 64 and append the length */
+  lane->tail_blocks = (rest + 1 + 8 > HASH_BLOCK) ? 2 : 1;
+  tail_length = lane->tail_blocks * HASH_BLOCK;
+  if (rest)
+    memcpy (lane->tail, buffer + length - rest, rest);
+  lane->tail[rest] = 0x80;
+  memset (lane->tail + rest + 1, 0, tail_length - 8 - (rest + 1));
+  if (batch->big_endian)
+    bits = GUINT64_TO_BE (bits);
+  else
+    bits = GUINT64_TO_LE (bits);
+  memcpy (lane->tail + tail_length - 8, &bits, 8);
+
+  lane->data = buffer;
+  lane->blocks = length / HASH_BLOCK;
+  lane->in_tail = FALSE;
+  if (lane->blocks == 0)
+    {
+      lane->data = lane->tail;
+      lane->blocks = lane->tail_blocks;
+      lane->in_tail = TRUE;
+    }
+}
+
+
+static void
+hash_store (const GNetHashBatch* batch, const guint32* state, gchar* digest)
+{
+  guint32 words[GNET_HASH_MAX_WORDS];
+  guint n_words = batch->n_words;
+  guint i;
+
+  if (batch->big_endian)
+    for (i = 0; i < n_words; ++i)
+      words[i] = GUINT32_TO_BE (state[i]);
+  else
+    for (i = 0; i < n_words; ++i)
+      words[i] = GUINT32_TO_LE (state[i]);
+  memcpy (digest, words, n_words * 4);
+}
+
+
+/* Finishes the lane from @state one block at a time */
+static void
+hash_lane_finish (const GNetHashBatch* batch, HashLane* lane, guint32* state,
+		  gchar* digests)
+{
+  batch->blocks (state, lane->data, lane->blocks);
+  if (!lane->in_tail)
+    batch->blocks (state, lane->tail, lane->tail_blocks);
+  hash_store (batch, state, digests + lane->message * batch->n_words * 4);
+}
+
+
+void
+_gnet_hash_batch (const GNetHashBatch* batch, const gchar* const* buffers,
+		  const gsize* lengths, guint n, gchar* digests)
+{
+  HashLane lane;
+  guint32 state[GNET_HASH_MAX_WORDS];
+  guint next = 0;
+
+  g_assert (batch->n_words <= GNET_HASH_MAX_WORDS);
+
+  if (batch->lanes && n >= HASH_MIN_LANES)
+    {
+      HashLane lanes[GNET_HASH_LANES];
+      guint32 lane_state[GNET_HASH_MAX_WORDS][GNET_HASH_LANES];
+      const guint8* data[GNET_HASH_LANES];
+      guint busy = 0;
+      guint l, w;
+
+      for (l = 0; l < GNET_HASH_LANES; ++l)
+	{
+	  lanes[l].busy = FALSE;
+	  if (next < n)
+	    {
+	      hash_lane_start (batch, &lanes[l], next,
+			       (const guint8*) buffers[next], lengths[next]);
+	      for (w = 0; w < batch->n_words; ++w)
+		lane_state[w][l] = batch->iv[w];
+	      ++next;
+	      ++busy;
+	    }
+	}
+
+      while (busy >= HASH_MIN_LANES)
+	{
+	  const guint8* any = NULL;
+	  gsize n_blocks = G_MAXSIZE;
+
+	  /* Run all lanes until the first one reaches the end of its
+	     blocks.  Idle lanes hash a copy of a busy one. */
+	  for (l = 0; l < GNET_HASH_LANES; ++l)
+	    if (lanes[l].busy)
+	      {
+		any = lanes[l].data;
+		n_blocks = MIN (n_blocks, lanes[l].blocks);
+	      }
+	  for (l = 0; l < GNET_HASH_LANES; ++l)
+	    data[l] = lanes[l].busy ? lanes[l].data : any;
+
+	  batch->lanes (lane_state, data, n_blocks);
+
+	  for (l = 0; l < GNET_HASH_LANES; ++l)
+	    {
+	      HashLane* ln = &lanes[l];
+
+	      if (!ln->busy)
+		continue;
+
+	      ln->data += n_blocks * HASH_BLOCK;
+	      ln->blocks -= n_blocks;
+	      if (ln->blocks > 0)
+		continue;
+
+	      if (!ln->in_tail)
+		{
+		  ln->data = ln->tail;
+		  ln->blocks = ln->tail_blocks;
+		  ln->in_tail = TRUE;
+		  continue;
+		}
+
+	      for (w = 0; w < batch->n_words; ++w)
+		state[w] = lane_state[w][l];
+	      hash_store (batch, state,
+			  digests + ln->message * batch->n_words * 4);
+
+	      if (next < n)
+		{
+		  hash_lane_start (batch, ln, next,
+				   (const guint8*) buffers[next], lengths[next]);
+		  for (w = 0; w < batch->n_words; ++w)
+		    lane_state[w][l] = batch->iv[w];
+		  ++next;
+		}
+	      else
+		{
+		  ln->busy = FALSE;
+		  --busy;
+		}
+	    }
+	}
+
+      /* Too few left for the kernel */
+      for (l = 0; l < GNET_HASH_LANES; ++l)
+	if (lanes[l].busy)
+	  {
+	    for (w = 0; w < batch->n_words; ++w)
+	      state[w] = lane_state[w][l];
+	    hash_lane_finish (batch, &lanes[l], state, digests);
+	  }
+    }
+
+  for (; next < n; ++next)
+    {
+      hash_lane_start (batch, &lane, next,
+		       (const guint8*) buffers[next], lengths[next]);
+      memcpy (state, batch->iv, batch->n_words * 4);
+      hash_lane_finish (batch, &lane, state, digests);
+    }
+}
@@ -0,0 +1,128 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+
+#ifndef _GNET_HASH_PRIVATE_H
+#define _GNET_HASH_PRIVATE_H
+
+#include "gnet-private.h"
+
+/* Feeds data to a hash context */
+typedef void (*GNetHashUpdateFunc) (gpointer ctx, const guint8 * buffer,
+                                    gsize length);
+
+/* Feeds everything from the file offset of @fd to the end of the file
+   to @update, and leaves the offset at the end.  Regular files are
+   mapped into memory a window at a time where mmap() is available;
+   anything else is read.  Returns FALSE on an I/O error. */
+gboolean _gnet_hash_fd   (gint fd, GNetHashUpdateFunc update, gpointer ctx);
+
+/* Same for the file @filename */
+gboolean _gnet_hash_file (const gchar * filename,
+                          GNetHashUpdateFunc update, gpointer ctx);
+
+/* Reads the 2 * @length hexadecimal digits of @str into @digest.
+   Returns FALSE if there are fewer digits. */
+gboolean _gnet_hash_digest_from_string (const gchar * str, guint8 * digest,
+                                        guint length);
+
+/* Writes @digest to @buffer as 2 * @length lower case hexadecimal
+   digits, not NUL-terminated */
+void     _gnet_hash_digest_to_string   (const guint8 * digest, guint length,
+                                        gchar * buffer);
+
+/* Multi-buffer hashing.  Many independent messages are hashed at once
+   by a vector kernel that runs one message in each of its lanes, and
+   a lane is refilled with the next message as soon as its message is
+   done.  Messages left over when too few lanes would be busy are
+   finished one at a time. */
+
+#define GNET_HASH_LANES		8
+#define GNET_HASH_MAX_WORDS	8	/* words of chaining state */
+
+/* Hashes @n_blocks 64-byte blocks of @data into @state */
+typedef void (*GNetHashBlocksFunc) (guint32 * state, const guint8 * data,
+                                    gsize n_blocks);
+
+/* Hashes @n_blocks blocks from each of @data into the lanes of @state,
+   word w of lane l being state[w][l] */
+typedef void (*GNetHashLanesFunc) (guint32 state[][GNET_HASH_LANES],
+                                   const guint8 * const * data,
+                                   gsize n_blocks);
+
+typedef struct _GNetHashBatch
+{
+  guint			n_words;	/* state words, all in the digest */
+  const guint32*	iv;		/* initial state */
+  gboolean		big_endian;	/* byte order of length and digest */
+  GNetHashBlocksFunc	blocks;
+  GNetHashLanesFunc	lanes;		/* NULL if the CPU has none */
+
+} GNetHashBatch;
+
+#ifdef HAVE_X86_SIMD
+
+#include <immintrin.h>
+
+/* Loads the 64-byte block at @offset of each of the eight lanes of
+   @data, word i of every lane into @w[i] */
+__attribute__ ((target ("avx2")))
+static inline void
+_gnet_hash_load_x8 (__m256i w[16], const guint8 * const * data, gsize offset)
+{
+  guint h, l;
+
+  for (h = 0; h < 2; ++h)
+    {
+      __m256i r[8], t[8], u[8];
+
+      for (l = 0; l < 8; ++l)
+        r[l] = _mm256_loadu_si256 ((const __m256i *) (data[l] + offset + 32 * h));
+
+      /* 8x8 transpose of 32-bit words */
+      for (l = 0; l < 8; l += 2)
+        {
+          t[l]     = _mm256_unpacklo_epi32 (r[l], r[l + 1]);
+          t[l + 1] = _mm256_unpackhi_epi32 (r[l], r[l + 1]);
+        }
+      for (l = 0; l < 8; l += 4)
+        {
+          u[l]     = _mm256_unpacklo_epi64 (t[l], t[l + 2]);
+          u[l + 1] = _mm256_unpackhi_epi64 (t[l], t[l + 2]);
+          u[l + 2] = _mm256_unpacklo_epi64 (t[l + 1], t[l + 3]);
+          u[l + 3] = _mm256_unpackhi_epi64 (t[l + 1], t[l + 3]);
+        }
+      for (l = 0; l < 4; ++l)
+        {
+          w[8 * h + l]     = _mm256_permute2x128_si256 (u[l], u[l + 4], 0x20);
+          w[8 * h + l + 4] = _mm256_permute2x128_si256 (u[l], u[l + 4], 0x31);
+        }
+    }
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* Hashes message i, @lengths[i] bytes at @buffers[i], into the
+   @n_words * 4 bytes at @digests + i * @n_words * 4 */
+void     _gnet_hash_batch (const GNetHashBatch * batch,
+                           const gchar * const * buffers,
+                           const gsize * lengths, guint n,
+                           gchar * digests);
+
+#endif /* _GNET_HASH_PRIVATE_H */
@@ -113,6 +113,9 @@ gnet_mcast_socket_new_full (const GInetAddr* iface, gint port)
 
   gnet_mcast_socket_set_loopback (ms, FALSE);
 
+  /* Report the group of every datagram from the start */
+  _gnet_udp_socket_enable_pktinfo (us);
+
   return ms;
 }
 
@@ -226,7 +229,9 @@ gnet_mcast_socket_get_local_inetaddr (const GMcastSocket* socket)
  *  @socket: a #GMcastSocket
  *  @inetaddr: address of the group
  *
- *  Joins a multicast group.  Join only one group per socket.
+ *  Joins a multicast group.  A socket can join several groups; use
+ *  gnet_mcast_socket_receive_with_info() or
+ *  gnet_mcast_socket_add_group_func() to tell their datagrams apart.
  *
  *  Returns: 0 on success.
  *
@@ -337,6 +342,118 @@ gnet_mcast_socket_leave_group (GMcastSocket* socket,
 
 
 
+/* Joins or leaves a source-specific group (IP_ADD_SOURCE_MEMBERSHIP,
+   MCAST_JOIN_SOURCE_GROUP) */
+static gint
+mcast_socket_source_group (GMcastSocket* socket, const GInetAddr* group,
+			   const GInetAddr* source, gboolean join)
+{
+  GUdpSocket *udpsocket;
+  gint rv = -1;
+
+  udpsocket = GNET_UDP_SOCKET (socket);
+
+  if (GNET_INETADDR_FAMILY(group) != GNET_INETADDR_FAMILY(source))
+    return -1;
+
+  if (GNET_INETADDR_FAMILY(group) == AF_INET)
+    {
+#ifdef IP_ADD_SOURCE_MEMBERSHIP
+      struct ip_mreq_source mreq;
+
+      memset (&mreq, 0, sizeof (mreq));
+      memcpy (&mreq.imr_multiaddr, GNET_INETADDR_ADDRP(group),
+	      sizeof(mreq.imr_multiaddr));
+      memcpy (&mreq.imr_sourceaddr, GNET_INETADDR_ADDRP(source),
+	      sizeof(mreq.imr_sourceaddr));
+      mreq.imr_interface.s_addr = g_htonl(INADDR_ANY);
+
+      rv = setsockopt (udpsocket->sockfd, IPPROTO_IP,
+		       join ? IP_ADD_SOURCE_MEMBERSHIP : IP_DROP_SOURCE_MEMBERSHIP,
+		       (void*) &mreq, sizeof(mreq));
+#endif
+    }
+#ifdef HAVE_IPV6
+  else if (GNET_INETADDR_FAMILY(group) == AF_INET6)
+    {
+#ifdef MCAST_JOIN_SOURCE_GROUP
+      struct group_source_req req;
+
+      memset (&req, 0, sizeof (req));
+      req.gsr_interface = 0;
+      memcpy (&req.gsr_group, &group->sa, sizeof (struct sockaddr_in6));
+      memcpy (&req.gsr_source, &source->sa, sizeof (struct sockaddr_in6));
+
+      rv = setsockopt (udpsocket->sockfd, IPPROTO_IPV6,
+		       join ? MCAST_JOIN_SOURCE_GROUP : MCAST_LEAVE_SOURCE_GROUP,
+		       (void*) &req, sizeof(req));
+#endif
+    }
+#endif
+  else
+    g_assert_not_reached ();
+
+  return rv;
+}
+
+
+/**
+ *  gnet_mcast_socket_join_source_group
+ *  @socket: a #GMcastSocket
+ *  @group: address of the group
+ *  @source: address of the source
+ *
+ *  Joins a source-specific multicast group: only datagrams sent to
+ *  @group by @source are received.  Call it once for each source.
+ *  @group and @source must be of the same family.
+ *
+ *  Returns: 0 on success; -1 on error or if the system does not
+ *  support source-specific multicast.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_mcast_socket_join_source_group (GMcastSocket* socket,
+				     const GInetAddr* group,
+				     const GInetAddr* source)
+{
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (GNET_IS_MCAST_SOCKET (socket), -1);
+  g_return_val_if_fail (group != NULL, -1);
+  g_return_val_if_fail (source != NULL, -1);
+
+  return mcast_socket_source_group (socket, group, source, TRUE);
+}
+
+
+/**
+ *  gnet_mcast_socket_leave_source_group
+ *  @socket: a #GMcastSocket
+ *  @group: address of the group
+ *  @source: address of the source
+ *
+ *  Leaves a source-specific multicast group joined with
+ *  gnet_mcast_socket_join_source_group().
+ *
+ *  Returns: 0 on success.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_mcast_socket_leave_source_group (GMcastSocket* socket,
+				      const GInetAddr* group,
+				      const GInetAddr* source)
+{
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (GNET_IS_MCAST_SOCKET (socket), -1);
+  g_return_val_if_fail (group != NULL, -1);
+  g_return_val_if_fail (source != NULL, -1);
+
+  return mcast_socket_source_group (socket, group, source, FALSE);
+}
+
+
+
 /**
  *  gnet_mcast_socket_get_ttl
  *  @socket: a #GMcastSocket
@@ -625,6 +742,49 @@ gnet_mcast_socket_set_loopback (GMcastSocket* socket, gboolean enable)
 }
 
 
+/**
+ *  gnet_mcast_socket_set_option
+ *  @socket: a #GMcastSocket
+ *  @option: option to set
+ *  @value: value of the option
+ *
+ *  Sets a socket option of a #GMcastSocket.  See
+ *  gnet_udp_socket_set_option().
+ *
+ *  Returns: TRUE if the option was set; FALSE otherwise.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_mcast_socket_set_option (GMcastSocket* socket, GNetSocketOption option,
+			      gint value)
+{
+  return gnet_udp_socket_set_option ((GUdpSocket*) socket, option, value);
+}
+
+
+/**
+ *  gnet_mcast_socket_get_option
+ *  @socket: a #GMcastSocket
+ *  @option: option to get
+ *  @value: pointer to store the value in
+ *
+ *  Gets a socket option of a #GMcastSocket.  See
+ *  gnet_udp_socket_get_option().
+ *
+ *  Returns: TRUE if the option was read; FALSE otherwise.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_mcast_socket_get_option (const GMcastSocket* socket,
+			      GNetSocketOption option, gint* value)
+{
+  return gnet_udp_socket_get_option ((const GUdpSocket*) socket, option,
+				     value);
+}
+
+
 
 /**
  *  gnet_mcast_socket_send
@@ -668,6 +828,125 @@ gnet_mcast_socket_receive (GMcastSocket* socket, gchar* buffer, gint length,
 }
 
 
+/**
+ *  gnet_mcast_socket_receive_into
+ *  @socket: a #GMcastSocket
+ *  @buffer: buffer to write to
+ *  @length: length of @buffer
+ *  @src: address to store the source address in (optional)
+ *
+ *  Receives data using a #GMcastSocket and stores the source address
+ *  in the existing address @src.  See gnet_udp_socket_receive_into().
+ *
+ *  Returns: the number of bytes received, -1 if unsuccessful.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_mcast_socket_receive_into (GMcastSocket* socket, gchar* buffer,
+				gint length, GInetAddr* src)
+{
+  return gnet_udp_socket_receive_into ((GUdpSocket*) socket,
+				       buffer, length, src);
+}
+
+
+/**
+ *  gnet_mcast_socket_receive_with_info
+ *  @socket: a #GMcastSocket
+ *  @buffer: buffer to write to
+ *  @length: length of @buffer
+ *  @src: address to store the source address in (optional)
+ *  @info: information to fill in
+ *
+ *  Receives data using a #GMcastSocket and reports the group the
+ *  datagram was sent to and the interface it arrived on.  See
+ *  gnet_udp_socket_receive_with_info().
+ *
+ *  Returns: the number of bytes received, -1 if unsuccessful.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_mcast_socket_receive_with_info (GMcastSocket* socket, gchar* buffer,
+				     gint length, GInetAddr* src,
+				     GUdpPacketInfo* info)
+{
+  return gnet_udp_socket_receive_with_info ((GUdpSocket*) socket, buffer,
+					    length, src, info);
+}
+
+
+/**
+ *  gnet_mcast_socket_send_batch
+ *  @socket: a #GMcastSocket
+ *  @packets: packets to send
+ *  @n_packets: number of packets in @packets
+ *
+ *  Sends several datagrams using a #GMcastSocket.  See
+ *  gnet_udp_socket_send_batch().
+ *
+ *  Returns: the number of packets sent; -1 if no packet could be
+ *  sent.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_mcast_socket_send_batch (GMcastSocket* socket,
+			      const GUdpPacket* packets, gint n_packets)
+{
+  return gnet_udp_socket_send_batch ((GUdpSocket*) socket,
+				     packets, n_packets);
+}
+
+
+/**
+ *  gnet_mcast_socket_receive_batch
+ *  @socket: a #GMcastSocket
+ *  @packets: packets to receive into
+ *  @n_packets: number of packets in @packets
+ *
+ *  Receives several datagrams using a #GMcastSocket.  See
+ *  gnet_udp_socket_receive_batch().
+ *
+ *  Returns: the number of packets received; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_mcast_socket_receive_batch (GMcastSocket* socket,
+				 GUdpPacket* packets, gint n_packets)
+{
+  return gnet_udp_socket_receive_batch ((GUdpSocket*) socket,
+					packets, n_packets);
+}
+
+
+/**
+ *  gnet_mcast_socket_receive_batch_pooled
+ *  @socket: a #GMcastSocket
+ *  @pool: pool to take the buffers from
+ *  @packets: packets to receive into
+ *  @n_packets: number of packets in @packets
+ *
+ *  Receives several datagrams using a #GMcastSocket into buffers
+ *  taken from @pool.  See gnet_udp_socket_receive_batch_pooled().
+ *
+ *  Returns: the number of packets received; 0 if the pool has no
+ *  free buffers; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_mcast_socket_receive_batch_pooled (GMcastSocket* socket,
+					GPacketPool* pool,
+					GUdpPacket* packets, gint n_packets)
+{
+  return gnet_udp_socket_receive_batch_pooled ((GUdpSocket*) socket, pool,
+					       packets, n_packets);
+}
+
+
 /**
  *  gnet_mcast_socket_has_packet:
  *  @socket: a #GMcastSocket
@@ -683,3 +962,259 @@ gnet_mcast_socket_has_packet (const GMcastSocket* socket)
   return gnet_udp_socket_has_packet((const GUdpSocket*) socket);
 }
 
+
+
+/* Group dispatcher */
+
+/* Datagrams handled per wakeup at most */
+#define MCAST_DISPATCH_BUDGET	1024
+/* Receive buffer size: the largest possible datagram */
+#define MCAST_DISPATCH_MAX_SIZE	65535
+
+typedef struct _GMcastGroupHandler
+{
+  GMcastSocketGroupFunc	func;
+  gpointer		data;
+  GDestroyNotify	notify;
+} GMcastGroupHandler;
+
+typedef struct _GMcastSocketDispatch
+{
+  GHashTable*		groups;		/* GInetAddr without port -> handler */
+  GMcastGroupHandler*	fallback;	/* for all other groups, or NULL */
+
+  guint			watch;
+  gboolean		dispatching;
+
+  gchar*		buffer;
+  GInetAddr*		src;
+  GInetAddr*		dst;
+} GMcastSocketDispatch;
+
+
+static gboolean mcast_socket_dispatch_cb (GIOChannel* iochannel,
+					  GIOCondition condition,
+					  gpointer data);
+
+static void
+mcast_group_handler_free (GMcastGroupHandler* handler)
+{
+  if (handler->notify)
+    (handler->notify)(handler->data);
+  g_free (handler);
+}
+
+
+/**
+ *  gnet_mcast_socket_add_group_func
+ *  @socket: a #GMcastSocket
+ *  @group: address of the group, or NULL for datagrams of all other
+ *    groups
+ *  @func: callback function
+ *  @data: data to pass to @func on callback
+ *  @notify: function to call to free @data, or NULL
+ *
+ *  Calls @func for every datagram that is sent to @group and
+ *  received by @socket, so one socket can serve many groups.  The
+ *  port of @group is ignored.  The datagrams are received in the
+ *  default main context with gnet_mcast_socket_receive_with_info();
+ *  @info->dst of the callback is the group.  Datagrams of groups
+ *  without a callback go to the callback of the NULL group, or are
+ *  dropped.  A callback added for a group that already has one
+ *  replaces it.
+ *
+ *  The socket must join the groups itself (see
+ *  gnet_mcast_socket_join_group() and
+ *  gnet_mcast_socket_join_source_group()).  Do not receive from the
+ *  socket in other ways while callbacks are set.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_mcast_socket_add_group_func (GMcastSocket* socket,
+				  const GInetAddr* group,
+				  GMcastSocketGroupFunc func, gpointer data,
+				  GDestroyNotify notify)
+{
+  GMcastSocketDispatch* dispatch;
+  GMcastGroupHandler* handler;
+
+  g_return_if_fail (socket != NULL);
+  g_return_if_fail (GNET_IS_MCAST_SOCKET (socket));
+  g_return_if_fail (func != NULL);
+
+  dispatch = socket->dispatch;
+  if (!dispatch)
+    {
+      dispatch = g_new0 (GMcastSocketDispatch, 1);
+      dispatch->groups =
+	g_hash_table_new_full (gnet_inetaddr_hash, gnet_inetaddr_equal,
+			       (GDestroyNotify) gnet_inetaddr_unref,
+			       (GDestroyNotify) mcast_group_handler_free);
+      dispatch->buffer = g_malloc (MCAST_DISPATCH_MAX_SIZE);
+      dispatch->src = g_new0 (GInetAddr, 1);
+      dispatch->src->ref_count = 1;
+      dispatch->dst = g_new0 (GInetAddr, 1);
+      dispatch->dst->ref_count = 1;
+      socket->dispatch = dispatch;
+    }
+
+  handler = g_new0 (GMcastGroupHandler, 1);
+  handler->func = func;
+  handler->data = data;
+  handler->notify = notify;
+
+  if (group)
+    {
+      GInetAddr* key = gnet_inetaddr_clone (group);
+
+      gnet_inetaddr_set_port (key, 0);
+      g_hash_table_insert (dispatch->groups, key, handler);
+    }
+  else
+    {
+      if (dispatch->fallback)
+	mcast_group_handler_free (dispatch->fallback);
+      dispatch->fallback = handler;
+    }
+
+  if (!dispatch->watch)
+    dispatch->watch =
+      _gnet_io_watch_update (NULL, 0,
+			     gnet_mcast_socket_get_io_channel (socket),
+			     G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+			     mcast_socket_dispatch_cb, socket);
+}
+
+
+/**
+ *  gnet_mcast_socket_remove_group_func
+ *  @socket: a #GMcastSocket
+ *  @group: address of the group, or NULL
+ *
+ *  Removes the callback of @group added with
+ *  gnet_mcast_socket_add_group_func().  The socket stays in the
+ *  group.  When the last callback is removed, the socket is no
+ *  longer watched.  This may be called from a callback.
+ *
+ *  Returns: TRUE if a callback was removed.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_mcast_socket_remove_group_func (GMcastSocket* socket,
+				     const GInetAddr* group)
+{
+  GMcastSocketDispatch* dispatch;
+  gboolean removed = FALSE;
+
+  g_return_val_if_fail (socket != NULL, FALSE);
+  g_return_val_if_fail (GNET_IS_MCAST_SOCKET (socket), FALSE);
+
+  dispatch = socket->dispatch;
+  if (!dispatch)
+    return FALSE;
+
+  if (group)
+    {
+      GInetAddr* key = gnet_inetaddr_clone (group);
+
+      gnet_inetaddr_set_port (key, 0);
+      removed = g_hash_table_remove (dispatch->groups, key);
+      gnet_inetaddr_unref (key);
+    }
+  else if (dispatch->fallback)
+    {
+      mcast_group_handler_free (dispatch->fallback);
+      dispatch->fallback = NULL;
+      removed = TRUE;
+    }
+
+  /* The callback stops the watch itself if it is running */
+  if (!dispatch->dispatching && !dispatch->fallback &&
+      g_hash_table_size (dispatch->groups) == 0)
+    {
+      _gnet_io_watch_remove (NULL, dispatch->watch);
+      dispatch->watch = 0;
+    }
+
+  return removed;
+}
+
+
+static gboolean
+mcast_socket_dispatch_cb (GIOChannel* iochannel, GIOCondition condition,
+			  gpointer data)
+{
+  GMcastSocket* socket = (GMcastSocket*) data;
+  GMcastSocketDispatch* dispatch = socket->dispatch;
+  gint budget = MCAST_DISPATCH_BUDGET;
+  gboolean rv = TRUE;
+
+  g_assert (dispatch != NULL);
+
+  /* Do upcalls, protected by a ref */
+  gnet_udp_socket_ref (GNET_UDP_SOCKET (socket));
+  dispatch->dispatching = TRUE;
+
+  /* Errors (for example, ICMP errors reported on the socket) are
+     cleared by receiving, so receive on any condition */
+  while (budget-- > 0 && (dispatch->fallback ||
+			  g_hash_table_size (dispatch->groups) > 0))
+    {
+      GUdpPacketInfo info;
+      GMcastGroupHandler* handler;
+      gint length;
+
+      info.dst = dispatch->dst;
+      length = _gnet_udp_socket_receive_with_info (GNET_UDP_SOCKET (socket),
+						   dispatch->buffer,
+						   MCAST_DISPATCH_MAX_SIZE,
+						   dispatch->src, &info,
+						   FALSE);
+      if (length < 0)
+	break;
+
+      /* Groups are looked up without port */
+      gnet_inetaddr_set_port (dispatch->dst, 0);
+      handler = g_hash_table_lookup (dispatch->groups, dispatch->dst);
+      if (!handler)
+	handler = dispatch->fallback;
+      if (handler)
+	(handler->func)(socket, dispatch->buffer, length, dispatch->src,
+			&info, handler->data);
+    }
+
+  dispatch->dispatching = FALSE;
+  if ((condition & G_IO_NVAL) ||
+      (!dispatch->fallback && g_hash_table_size (dispatch->groups) == 0))
+    {
+      _gnet_io_watch_remove (NULL, dispatch->watch);
+      dispatch->watch = 0;
+      rv = FALSE;
+    }
+
+  gnet_udp_socket_unref (GNET_UDP_SOCKET (socket));
+
+  return rv;
+}
+
+
+void
+_gnet_mcast_socket_dispatch_free (GMcastSocket* socket)
+{
+  GMcastSocketDispatch* dispatch = socket->dispatch;
+
+  if (!dispatch)
+    return;
+
+  socket->dispatch = NULL;
+  _gnet_io_watch_remove (NULL, dispatch->watch);
+  if (dispatch->fallback)
+    mcast_group_handler_free (dispatch->fallback);
+  g_hash_table_destroy (dispatch->groups);
+  g_free (dispatch->buffer);
+  gnet_inetaddr_unref (dispatch->src);
+  gnet_inetaddr_unref (dispatch->dst);
+  g_free (dispatch);
+}
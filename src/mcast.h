@@ -42,6 +42,30 @@ extern "C" {
 typedef struct _GMcastSocket GMcastSocket;
 
 
+/**
+ *  GMcastSocketGroupFunc:
+ *  @socket: the #GMcastSocket
+ *  @buffer: datagram data (callee owned)
+ *  @length: length of @buffer
+ *  @src: source address (callee owned)
+ *  @info: destination group and interface of the datagram (callee
+ *    owned)
+ *  @data: user data
+ *
+ *  Callback for gnet_mcast_socket_add_group_func().  @buffer, @src
+ *  and @info are only valid until the callback returns.  @src and
+ *  @info->dst are reused for the next datagram, so copy them with
+ *  gnet_inetaddr_clone() to keep them; a reference would see them
+ *  change.
+ *
+ *  Since: 2.0.9
+ **/
+typedef void (*GMcastSocketGroupFunc)(GMcastSocket* socket, gchar* buffer,
+				      gint length, GInetAddr* src,
+				      const GUdpPacketInfo* info,
+				      gpointer data);
+
+
 
 /* ********** */
 
@@ -64,6 +88,12 @@ gint 	 gnet_mcast_socket_join_group (GMcastSocket* socket,
 				       const GInetAddr* inetaddr);
 gint 	 gnet_mcast_socket_leave_group (GMcastSocket* socket, 
 					const GInetAddr* inetaddr);
+gint	 gnet_mcast_socket_join_source_group (GMcastSocket* socket,
+					      const GInetAddr* group,
+					      const GInetAddr* source);
+gint	 gnet_mcast_socket_leave_source_group (GMcastSocket* socket,
+					       const GInetAddr* group,
+					       const GInetAddr* source);
 
 gint 	 gnet_mcast_socket_get_ttl (const GMcastSocket* socket);
 gint 	 gnet_mcast_socket_set_ttl (GMcastSocket* socket, gint ttl);
@@ -71,14 +101,44 @@ gint 	 gnet_mcast_socket_set_ttl (GMcastSocket* socket, gint ttl);
 gint 	 gnet_mcast_socket_is_loopback (const GMcastSocket* socket);
 gint 	 gnet_mcast_socket_set_loopback (GMcastSocket* socket, gboolean enable);
 
+gboolean gnet_mcast_socket_set_option (GMcastSocket* socket,
+				       GNetSocketOption option, gint value);
+gboolean gnet_mcast_socket_get_option (const GMcastSocket* socket,
+				       GNetSocketOption option, gint* value);
+
 /* ********** */
 
 gint     gnet_mcast_socket_send (GMcastSocket* socket, const gchar* buffer, 
 				 gint length, const GInetAddr* dst);
 gint     gnet_mcast_socket_receive (GMcastSocket* socket, gchar* buffer, 
 				    gint length, GInetAddr** src);
+gint     gnet_mcast_socket_receive_into (GMcastSocket* socket, gchar* buffer,
+					 gint length, GInetAddr* src);
+gint	 gnet_mcast_socket_receive_with_info (GMcastSocket* socket,
+					      gchar* buffer, gint length,
+					      GInetAddr* src,
+					      GUdpPacketInfo* info);
 gboolean gnet_mcast_socket_has_packet (const GMcastSocket* socket);
 
+gint	 gnet_mcast_socket_send_batch (GMcastSocket* socket,
+				       const GUdpPacket* packets,
+				       gint n_packets);
+gint	 gnet_mcast_socket_receive_batch (GMcastSocket* socket,
+					  GUdpPacket* packets,
+					  gint n_packets);
+gint	 gnet_mcast_socket_receive_batch_pooled (GMcastSocket* socket,
+						 GPacketPool* pool,
+						 GUdpPacket* packets,
+						 gint n_packets);
+
+void	 gnet_mcast_socket_add_group_func (GMcastSocket* socket,
+					   const GInetAddr* group,
+					   GMcastSocketGroupFunc func,
+					   gpointer data,
+					   GDestroyNotify notify);
+gboolean gnet_mcast_socket_remove_group_func (GMcastSocket* socket,
+					      const GInetAddr* group);
+
 
 /**
  *  gnet_mcast_socket_to_udp_socket
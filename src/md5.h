@@ -35,13 +35,21 @@ typedef struct _GMD5 GMD5;
 
 
 GMD5*    gnet_md5_new (const gchar* buffer, guint length);
+GMD5*    gnet_md5_new_large (const gchar* buffer, gsize length);
+GMD5*    gnet_md5_new_file (const gchar* filename);
+GMD5*    gnet_md5_new_fd (gint fd);
 GMD5*	 gnet_md5_new_string (const gchar* str);
 GMD5*    gnet_md5_clone (const GMD5* md5);
 void     gnet_md5_delete (GMD5* md5);
 	
 GMD5*	 gnet_md5_new_incremental (void);
 void	 gnet_md5_update (GMD5* md5, const gchar* buffer, guint length);
+void	 gnet_md5_update_large (GMD5* md5, const gchar* buffer, gsize length);
 void	 gnet_md5_final (GMD5* md5);
+
+void     gnet_md5_digest_batch (const gchar* const* buffers,
+				const gsize* lengths, guint n,
+				gchar* digests);
 	
 gboolean gnet_md5_equal (gconstpointer p1, gconstpointer p2);
 guint	 gnet_md5_hash (gconstpointer p);
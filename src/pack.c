@@ -17,6 +17,7 @@
  * Boston, MA  02111-1307, USA.
  */
 
+#include "config.h"
 #include "pack.h"
 #include <string.h>
 
@@ -25,27 +26,9 @@ static inline gsize strlenn(const char* str, gsize n);
 static inline void flipmemcpy(char* dst, const char* src, gsize n);
 
 
-#define MEMCPY(D,S,N)				\
-  do {						\
-    if ((N) == 1)				\
-      *((char*) (D)) = *((char*) (S));		\
-    else if ((N) == 2)				\
-      {						\
-        ((char*) (D))[0] = ((char*) (S))[0];	\
-        ((char*) (D))[1] = ((char*) (S))[1];	\
-      }						\
-    else if ((N) == 4)				\
-      {						\
-        ((char*) (D))[0] = ((char*) (S))[0];	\
-        ((char*) (D))[1] = ((char*) (S))[1];	\
-        ((char*) (D))[2] = ((char*) (S))[2];	\
-        ((char*) (D))[3] = ((char*) (S))[3];	\
-      }						\
-    else					\
-      {						\
-	memcpy((D), (S), (N));			\
-      }						\
-  } while(0)
+/* N is always a constant, so these compile to a load and a store and,
+   for FLIPMEMCPY, a byte swap instruction */
+#define MEMCPY(D,S,N)  memcpy((D), (S), (N))
 
 
 #define FLIPMEMCPY(D,S,N)			\
@@ -54,15 +37,24 @@ static inline void flipmemcpy(char* dst, const char* src, gsize n);
       *((char*) (D)) = *((char*) (S));		\
     else if ((N) == 2)				\
       {						\
-        ((char*) (D))[0] = ((char*) (S))[1];	\
-        ((char*) (D))[1] = ((char*) (S))[0];	\
+	guint16 t_;				\
+	memcpy (&t_, (S), 2);			\
+	t_ = GUINT16_SWAP_LE_BE (t_);		\
+	memcpy ((D), &t_, 2);			\
       }						\
     else if ((N) == 4)				\
       {						\
-        ((char*) (D))[0] = ((char*) (S))[3];	\
-        ((char*) (D))[1] = ((char*) (S))[2];	\
-        ((char*) (D))[2] = ((char*) (S))[1];	\
-        ((char*) (D))[3] = ((char*) (S))[0];	\
+	guint32 t_;				\
+	memcpy (&t_, (S), 4);			\
+	t_ = GUINT32_SWAP_LE_BE (t_);		\
+	memcpy ((D), &t_, 4);			\
+      }						\
+    else if ((N) == 8)				\
+      {						\
+	guint64 t_;				\
+	memcpy (&t_, (S), 8);			\
+	t_ = GUINT64_SWAP_LE_BE (t_);		\
+	memcpy ((D), &t_, 8);			\
       }						\
     else					\
       {						\
@@ -98,6 +90,94 @@ flipmemcpy(char* dst, const char* src, gsize n)
 }
 
 
+/*
+
+  Varints are LEB128: 7 bits per byte, least significant group first,
+  with the high bit set on every byte but the last.  Signed varints
+  are zigzag encoded first, so that small negative numbers are short
+  too.
+
+*/
+#define VARINT_MAX_SIZE	10
+
+
+
+static inline guint64
+zigzag_encode (gint64 v)
+{
+  return (((guint64) v) << 1) ^ (guint64) (v >> 63);
+}
+
+
+static inline gint64
+zigzag_decode (guint64 u)
+{
+  return (gint64) (u >> 1) ^ -((gint64) (u & 1));
+}
+
+
+static inline guint
+varint_size (guint64 v)
+{
+  guint n = 1;
+
+  while (v >= 0x80)
+    {
+      v >>= 7;
+      ++n;
+    }
+
+  return n;
+}
+
+
+static inline guint
+varint_encode (gchar* buffer, guint64 v)
+{
+  guint n = 0;
+
+  while (v >= 0x80)
+    {
+      buffer[n++] = (gchar) (v | 0x80);
+      v >>= 7;
+    }
+  buffer[n++] = (gchar) v;
+
+  return n;
+}
+
+
+/* Returns bytes read; 0 if the varint is not complete within @length
+   bytes or is longer than 64 bits */
+static inline guint
+varint_decode (const gchar* buffer, gsize length, guint64* vp)
+{
+  guint64 v = 0;
+  guint n;
+
+  if (length > VARINT_MAX_SIZE)
+    length = VARINT_MAX_SIZE;
+
+  for (n = 0; n < length; ++n)
+    {
+      guint8 byte = (guint8) buffer[n];
+
+      /* The tenth byte holds the 64th bit only */
+      if (n == VARINT_MAX_SIZE - 1 && byte > 1)
+	return 0;
+
+      v |= ((guint64) (byte & 0x7F)) << (7 * n);
+      if (!(byte & 0x80))
+	{
+	  *vp = v;
+	  return n + 1;
+	}
+    }
+
+  return 0;
+}
+
+
 # if (G_BYTE_ORDER ==  G_LITTLE_ENDIAN)
 #   define LEMEMCPY(D,S,N) MEMCPY(D,S,N)
 #   define BEMEMCPY(D,S,N) FLIPMEMCPY(D,S,N)
@@ -122,57 +202,42 @@ flipmemcpy(char* dst, const char* src, gsize n)
 
 
 
-/* PACK does MEMCPY regardless of endian */
-/* TYPE is actual data type, VTYPE is type according to vargs */
-#define PACK(TYPE, VTYPE)					\
+/* PACK_RUN packs REPEAT fields with one length check.  COPY is
+   MEMCPY, LEMEMCPY or BEMEMCPY. */
+#define PACK_RUN(TYPE, VTYPE, COPY)				\
   do {								\
-    for (mult=(mult?mult:1); mult; --mult)			\
+    g_return_val_if_fail (mult <= (length - n) / sizeof(TYPE), -1); \
+    for (; mult; --mult)					\
       {								\
         TYPE t;							\
-        g_return_val_if_fail (n + sizeof(TYPE) <= length, -1);	\
         t = (TYPE) va_arg (args, VTYPE);                        \
-        MEMCPY(buffer, (char*) &t, sizeof(TYPE));               \
+        COPY(buffer, (char*) &t, sizeof(TYPE));                 \
         buffer += sizeof(TYPE);					\
         n += sizeof(TYPE); 	                 		\
       }								\
-    mult = 0;	 						\
+  } while(0)
+
+
+/* PACK does MEMCPY regardless of endian */
+/* TYPE is actual data type, VTYPE is type according to vargs */
+#define PACK(TYPE, VTYPE)					\
+  do {								\
+    mult = mult ? mult : 1;					\
+    PACK_RUN(TYPE, VTYPE, MEMCPY);				\
    } while(0)
 
 
-/* PACK2 does memcpy based on endian */
+/* PACK2 does memcpy based on endian.  The byte order is picked once
+   for all REPEAT fields. */
 #define PACK2(TYPENATIVE, VTYPE, TYPESTD)				\
   do {									\
-    for (mult=(mult?mult:1); mult; --mult)				\
-      {									\
-        if (sizemode == 0)						\
-          {								\
-             TYPENATIVE t;						\
-             g_return_val_if_fail (n + sizeof(TYPENATIVE) <= length, -1);\
-             t = (TYPENATIVE) va_arg (args, VTYPE);                    	\
-             MEMCPY(buffer, (char*) &t, sizeof(TYPENATIVE));            \
-             buffer += sizeof(TYPENATIVE);				\
-             n += sizeof(TYPENATIVE); 	                 		\
-          }								\
-        else if (sizemode == 1)						\
-          {								\
-             TYPESTD t;							\
-             g_return_val_if_fail (n + sizeof(TYPESTD) <= length, -1);	\
-             t = (TYPESTD) va_arg (args, VTYPE);               		\
-             LEMEMCPY(buffer, (char*) &t, sizeof(TYPESTD));             \
-             buffer += sizeof(TYPESTD);					\
-             n += sizeof(TYPESTD); 	                 		\
-          }								\
-        else if (sizemode == 2)						\
-          {								\
-             TYPESTD t;							\
-             g_return_val_if_fail (n + sizeof(TYPESTD) <= length, -1);	\
-             t = (TYPESTD) va_arg (args, VTYPE);                       	\
-             BEMEMCPY(buffer, (char*) &t, sizeof(TYPESTD));             \
-             buffer += sizeof(TYPESTD);					\
-             n += sizeof(TYPESTD); 	                 		\
-          }								\
-      }									\
-    mult = 0;								\
+    mult = mult ? mult : 1;						\
+    if (sizemode == 0)							\
+      PACK_RUN(TYPENATIVE, VTYPE, MEMCPY);				\
+    else if (sizemode == 1)						\
+      PACK_RUN(TYPESTD, VTYPE, LEMEMCPY);				\
+    else								\
+      PACK_RUN(TYPESTD, VTYPE, BEMEMCPY);				\
    } while(0)
 
 
@@ -229,6 +294,15 @@ flipmemcpy(char* dst, const char* src, gsize n)
  *
  *  l/L is a signed/unsigned long.
  *
+ *  q/Q is a signed/unsigned 64-bit integer, passed as a #gint64 or
+ *  #guint64 (always 8 bytes).
+ *
+ *  w/W is a signed/unsigned variable-length integer, passed as a
+ *  #gint64 or #guint64.  It is written in LEB128 (as in Protocol
+ *  Buffers): 7 bits per byte, least significant first, in 1 to 10
+ *  bytes.  Signed integers are zigzag encoded first, so -1 is
+ *  written as 1, 1 as 2, -2 as 3, and so on.
+ *
  *  f/D is a float/double (always native order/size).
  *
  *  v is a void pointer (always native size).
@@ -252,8 +326,8 @@ flipmemcpy(char* dst, const char* src, gsize n)
  *  non-NULL-terminated string with a byte before the string storing
  *  the string length.  REPEAT is repeat.
  *
- *  Mnemonics: (B)yte, s(H)ort, (I)nteger, (F)loat, (D)ouble, (V)oid
- *  pointer, (S)tring, (R)aw
+ *  Mnemonics: (B)yte, s(H)ort, (I)nteger, (Q)uad, (W)ide, (F)loat,
+ *  (D)ouble, (V)oid pointer, (S)tring, (R)aw
  *
  *  Pack was inspired by Python's and Perl's pack.  It is more like
  *  Python's than Perl's.  Note that in GNet, a repeat of 0 does not
@@ -395,6 +469,23 @@ gnet_vcalcsize (const gchar* format, va_list args)
 	case 'l':  { SIZE(long, long, gint32); 			break;  }
 	case 'L':  { SIZE(unsigned long, unsigned long, guint32); break;  }
 
+	case 'q':  { SIZE(gint64, gint64, gint64);		break;  }
+	case 'Q':  { SIZE(guint64, guint64, guint64);		break;  }
+
+	case 'w':
+	  {
+	    for (mult=(mult?mult:1); mult; --mult)
+	      n += varint_size (zigzag_encode (va_arg (args, gint64)));
+	    break;
+	  }
+
+	case 'W':
+	  {
+	    for (mult=(mult?mult:1); mult; --mult)
+	      n += varint_size (va_arg (args, guint64));
+	    break;
+	  }
+
 	case 'f':  { SIZE(float, double, float);		break;  }
 	case 'd':  { SIZE(double, double, double);		break;  }
 
@@ -563,6 +654,32 @@ gnet_vpack (const gchar* format, gchar* buffer, const gint length, va_list args)
 	case 'l':  { PACK2(long, long, gint32);			break;  }
 	case 'L':  { PACK2(unsigned long, unsigned long, guint32); break;  }
 
+	case 'q':  { PACK2(gint64, gint64, gint64);		break;  }
+	case 'Q':  { PACK2(guint64, guint64, guint64);		break;  }
+
+	case 'w':
+	case 'W':
+	  {
+	    for (mult=(mult?mult:1); mult; --mult)
+	      {
+		guint64 v;
+		guint vlen;
+
+		if (*p == 'w')
+		  v = zigzag_encode (va_arg (args, gint64));
+		else
+		  v = va_arg (args, guint64);
+
+		vlen = varint_size (v);
+		g_return_val_if_fail (n + vlen <= length, -1);
+
+		varint_encode (buffer, v);
+		buffer += vlen;
+		n += vlen;
+	      }
+	    break;
+	  }
+
 	case 'f':  { PACK(float, double);			break;  }
 	case 'd':  { PACK(double, double);			break;  }
 
@@ -709,54 +826,38 @@ gnet_vpack (const gchar* format, gchar* buffer, const gint length, va_list args)
 
 /* **************************************** */
 
-#define UNPACK(TYPE)						\
+/* UNPACK_RUN unpacks REPEAT fields with one length check.  COPY is
+   MEMCPY, LEMEMCPY or BEMEMCPY. */
+#define UNPACK_RUN(TYPE, COPY, ERROR)				\
   do {								\
-    for (mult=(mult?mult:1); mult; --mult)			\
+    g_return_val_if_fail (mult <= (length - n) / sizeof(TYPE), ERROR); \
+    for (; mult; --mult)					\
       {								\
         TYPE* t;						\
-        g_return_val_if_fail (n + sizeof(TYPE) <= length, FALSE);	\
         t = va_arg (args, TYPE*);                               \
-        MEMCPY((char*) t, buffer, sizeof(TYPE));                \
+        COPY((char*) t, buffer, sizeof(TYPE));                  \
         buffer += sizeof(TYPE);					\
         n += sizeof(TYPE); 	                 		\
       }								\
-    mult = 0;	 						\
+  } while(0)
+
+
+#define UNPACK(TYPE)						\
+  do {								\
+    mult = mult ? mult : 1;					\
+    UNPACK_RUN(TYPE, MEMCPY, FALSE);				\
    } while(0)
 
 
 #define UNPACK2(TYPENATIVE, TYPESTD)					\
   do {									\
-    for (mult=(mult?mult:1); mult; --mult)				\
-      {									\
-        if (sizemode == 0)						\
-          {								\
-             TYPENATIVE* t;						\
-             g_return_val_if_fail (n + sizeof(TYPENATIVE) <= length, -1);	\
-             t = va_arg (args, TYPENATIVE*);                           	\
-             MEMCPY((char*) t, buffer, sizeof(TYPENATIVE));             \
-             buffer += sizeof(TYPENATIVE);				\
-             n += sizeof(TYPENATIVE); 	                 		\
-          }								\
-        else if (sizemode == 1)						\
-          {								\
-             TYPESTD* t;						\
-             g_return_val_if_fail (n + sizeof(TYPESTD) <= length, -1);	\
-             t = va_arg (args, TYPESTD*);                           	\
-             LEMEMCPY((char*) t, buffer, sizeof(TYPESTD));              \
-             buffer += sizeof(TYPESTD);					\
-             n += sizeof(TYPESTD); 	                 		\
-          }								\
-        else if (sizemode == 2)						\
-          {								\
-             TYPESTD* t;						\
-             g_return_val_if_fail (n + sizeof(TYPESTD) <= length, -1);	\
-             t = va_arg (args, TYPESTD*);                           	\
-             BEMEMCPY((char*) t, buffer, sizeof(TYPESTD));              \
-             buffer += sizeof(TYPESTD);					\
-             n += sizeof(TYPESTD); 	                 		\
-          }								\
-      }									\
-    mult = 0;								\
+    mult = mult ? mult : 1;						\
+    if (sizemode == 0)							\
+      UNPACK_RUN(TYPENATIVE, MEMCPY, -1);				\
+    else if (sizemode == 1)						\
+      UNPACK_RUN(TYPESTD, LEMEMCPY, -1);				\
+    else								\
+      UNPACK_RUN(TYPESTD, BEMEMCPY, -1);				\
    } while(0)
 
 
@@ -809,6 +910,12 @@ gnet_vpack (const gchar* format, gchar* buffer, const gint length, va_list args)
  *
  *  l/L is a signed/unsigned long.
  *
+ *  q/Q is a signed/unsigned 64-bit integer (#gint64, #guint64).
+ *
+ *  w/W is a signed/unsigned variable-length integer (#gint64,
+ *  #guint64).  See gnet_pack().  Unpacking fails if the integer does
+ *  not end within @buffer or does not fit in 64 bits.
+ *
  *  f/D is a float/double (always native order/size).
  *  
  *  v is a void pointer (always native size).
@@ -907,6 +1014,31 @@ gnet_vunpack (const gchar * format, const gchar * buffer, gint length,
 	case 'l':  { UNPACK2(long, gint32); 		break;  }
 	case 'L':  { UNPACK2(unsigned long, guint32);	break;  }
 
+	case 'q':  { UNPACK2(gint64, gint64); 		break;  }
+	case 'Q':  { UNPACK2(guint64, guint64);		break;  }
+
+	case 'w':
+	case 'W':
+	  {
+	    for (mult=(mult?mult:1); mult; --mult)
+	      {
+		guint64 v;
+		guint vlen;
+
+		vlen = varint_decode (buffer, length - n, &v);
+		g_return_val_if_fail (vlen, -1);
+
+		if (*p == 'w')
+		  *va_arg (args, gint64*) = zigzag_decode (v);
+		else
+		  *va_arg (args, guint64*) = v;
+
+		buffer += vlen;
+		n += vlen;
+	      }
+	    break;
+	  }
+
 	case 'f':  { UNPACK(float);			break;  }
 	case 'd':  { UNPACK(double);			break;  }
 
@@ -1042,3 +1174,1881 @@ gnet_vunpack (const gchar * format, const gchar * buffer, gint length,
   return n;
 }
 
+
+
+/* **************************************** */
+
+/* A GPackFormat is a format string compiled into an array of
+   operations.  Repeats are resolved, the byte order and sizes are
+   decided once, adjacent fields of the same kind are merged into one
+   operation, and each run of fixed-size fields is checked against
+   the buffer length once. */
+
+typedef enum
+{
+  OP_PAD,		/* x */
+  OP_INT,		/* b B h H i I, passed as int */
+  OP_LONG,		/* l L, passed as long */
+  OP_INT64,		/* q Q */
+  OP_FLOAT,		/* f, passed as double */
+  OP_DOUBLE,		/* d */
+  OP_POINTER,		/* v */
+  OP_STRING,		/* s */
+  OP_STRING_FIXED,	/* S with REPEAT */
+  OP_STRING_RAW,	/* S without REPEAT */
+  OP_BYTES,		/* r */
+  OP_BYTES_FIXED,	/* R */
+  OP_PASCAL,		/* p */
+  OP_VARINT,		/* W */
+  OP_ZIGZAG		/* w */
+} PackOpCode;
+
+
+typedef struct _PackOp
+{
+  guint8	code;
+  guint8	size;	/* bytes per field of fixed-size ops */
+  guint8	swap;	/* fields are byte-swapped */
+  guint		count;	/* fields; bytes for OP_PAD and the FIXED ops */
+  guint		run;	/* bytes of the fixed-size ops starting here,
+			   if this op starts a run; otherwise 0 */
+} PackOp;
+
+
+struct _GPackFormat
+{
+  PackOp*	ops;
+  guint		n_ops;
+  gint		size;	/* packed size, or -1 if it depends on the args */
+};
+
+
+#define OP_IS_FIXED(OP)  ((OP)->code <= OP_POINTER || \
+			  (OP)->code == OP_STRING_FIXED || \
+			  (OP)->code == OP_BYTES_FIXED)
+#define OP_IS_MERGEABLE(OP)  ((OP)->code <= OP_POINTER || \
+			      (OP)->code >= OP_VARINT)
+#define OP_BYTES_OF(OP)	 (((OP)->code <= OP_POINTER && (OP)->code != OP_PAD) ? \
+			  (OP)->count * (OP)->size : (OP)->count)
+
+
+static void
+pack_format_append (GArray* ops, guint code, guint size, gboolean swap,
+		    guint count)
+{
+  PackOp op;
+
+  if (ops->len > 0)
+    {
+      PackOp* last = &g_array_index (ops, PackOp, ops->len - 1);
+
+      if (OP_IS_MERGEABLE (last) && last->code == code &&
+	  last->size == size && last->swap == swap)
+	{
+	  last->count += count;
+	  return;
+	}
+    }
+
+  op.code = code;
+  op.size = size;
+  op.swap = swap;
+  op.count = count;
+  op.run = 0;
+  g_array_append_val (ops, op);
+}
+
+
+/**
+ *  gnet_pack_format_new
+ *  @format: pack data format
+ *
+ *  Compiles a format string for gnet_pack_format_pack(),
+ *  gnet_pack_format_unpack() and gnet_pack_format_calcsize().  The
+ *  format is parsed once, so packing and unpacking with a compiled
+ *  format is faster than with gnet_pack() and gnet_unpack() when the
+ *  same format is used many times.  See gnet_pack() and gnet_unpack()
+ *  for the format.
+ *
+ *  A compiled format is not changed by packing or unpacking, so it may
+ *  be used by several threads at once.
+ *
+ *  Returns: a new #GPackFormat; NULL if @format is invalid.
+ *
+ *  Since: 2.0.9
+ **/
+GPackFormat*
+gnet_pack_format_new (const gchar* format)
+{
+  GPackFormat* pf;
+  GArray* ops;
+  const gchar* p = format;
+  guint mult = 0;
+  gint sizemode = 0;	/* 1 = little, 2 = big */
+  gboolean swap = FALSE;
+  gboolean fixed = TRUE;
+  guint i, j;
+  gsize size = 0;
+
+  g_return_val_if_fail (format, NULL);
+
+  switch (*p)
+    {
+    case '@':			++p;	break;
+    case '<':	sizemode = 1;	++p;	break;
+    case '>':
+    case '!':	sizemode = 2;	++p;	break;
+    }
+
+#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+  swap = (sizemode == 2);
+#else
+  swap = (sizemode == 1);
+#endif
+
+  ops = g_array_new (FALSE, FALSE, sizeof (PackOp));
+
+  for (; *p; ++p)
+    {
+      guint count = mult ? mult : 1;
+
+      switch (*p)
+	{
+	case 'x':  pack_format_append (ops, OP_PAD, 1, FALSE, count);	break;
+
+	case 'b':
+	case 'B':  pack_format_append (ops, OP_INT, 1, FALSE, count);	break;
+
+	case 'h':
+	case 'H':
+	  pack_format_append (ops, OP_INT, sizemode ? 2 : sizeof (short),
+			      swap, count);
+	  break;
+
+	case 'i':
+	case 'I':
+	  pack_format_append (ops, OP_INT, sizemode ? 4 : sizeof (int),
+			      swap, count);
+	  break;
+
+	case 'l':
+	case 'L':
+	  pack_format_append (ops, OP_LONG, sizemode ? 4 : sizeof (long),
+			      swap, count);
+	  break;
+
+	case 'q':
+	case 'Q':
+	  pack_format_append (ops, OP_INT64, 8, swap, count);
+	  break;
+
+	case 'w':  pack_format_append (ops, OP_ZIGZAG, 0, FALSE, count); break;
+	case 'W':  pack_format_append (ops, OP_VARINT, 0, FALSE, count); break;
+
+	case 'f':
+	  pack_format_append (ops, OP_FLOAT, sizeof (float), FALSE, count);
+	  break;
+	case 'd':
+	  pack_format_append (ops, OP_DOUBLE, sizeof (double), FALSE, count);
+	  break;
+
+	case 'v':
+	  pack_format_append (ops, OP_POINTER, sizeof (gpointer), swap, count);
+	  break;
+
+	case 's':  pack_format_append (ops, OP_STRING, 0, FALSE, count); break;
+	case 'r':  pack_format_append (ops, OP_BYTES, 0, FALSE, count);	 break;
+	case 'p':  pack_format_append (ops, OP_PASCAL, 0, FALSE, count); break;
+
+	case 'S':
+	  if (mult)
+	    pack_format_append (ops, OP_STRING_FIXED, 0, FALSE, mult);
+	  else
+	    pack_format_append (ops, OP_STRING_RAW, 0, FALSE, 1);
+	  break;
+
+	case 'R':
+	  if (!mult)
+	    goto error;
+	  pack_format_append (ops, OP_BYTES_FIXED, 0, FALSE, mult);
+	  break;
+
+	case '0':  case '1': case '2': case '3': case '4':
+	case '5':  case '6': case '7': case '8': case '9':
+	  {
+	    mult *= 10;
+	    mult += (*p - '0');
+	    continue;
+	  }
+
+	case ' ': case '\t': case '\n':
+	  continue;
+
+	default:
+	  goto error;
+	}
+
+      mult = 0;
+    }
+
+  /* Mark the runs of fixed-size ops with their size */
+  for (i = 0; i < ops->len; i = j)
+    {
+      PackOp* op = &g_array_index (ops, PackOp, i);
+      gsize run = 0;
+
+      if (!OP_IS_FIXED (op))
+	{
+	  fixed = FALSE;
+	  j = i + 1;
+	  continue;
+	}
+
+      for (j = i; j < ops->len; ++j)
+	{
+	  PackOp* next = &g_array_index (ops, PackOp, j);
+
+	  if (!OP_IS_FIXED (next))
+	    break;
+	  run += OP_BYTES_OF (next);
+	}
+
+      if (run > G_MAXINT)
+	goto error;
+      op->run = run;
+      size += run;
+    }
+
+  if (size > G_MAXINT)
+    goto error;
+
+  pf = g_new0 (GPackFormat, 1);
+  pf->n_ops = ops->len;
+  pf->ops = (PackOp*) g_array_free (ops, FALSE);
+  pf->size = fixed ? (gint) size : -1;
+
+  return pf;
+
+ error:
+  g_array_free (ops, TRUE);
+  g_return_val_if_fail (FALSE, NULL);
+  return NULL;
+}
+
+
+/**
+ *  gnet_pack_format_free
+ *  @format: a #GPackFormat
+ *
+ *  Frees a #GPackFormat.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_pack_format_free (GPackFormat* format)
+{
+  if (format)
+    {
+      g_free (format->ops);
+      g_free (format);
+    }
+}
+
+
+/**
+ *  gnet_pack_format_get_size
+ *  @format: a #GPackFormat
+ *
+ *  Gets the packed size of a #GPackFormat that has only fixed-size
+ *  fields.  Formats with strings other than "S" and "R" with a repeat
+ *  have a size that depends on the arguments.
+ *
+ *  Returns: the number of bytes packed; -1 if it depends on the
+ *  arguments.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_get_size (const GPackFormat* format)
+{
+  g_return_val_if_fail (format, -1);
+
+  return format->size;
+}
+
+
+/* Reverse the bytes of each of the @count @size-byte fields at
+   @buffer.  The loops have no branches, so compilers unroll and
+   vectorize them. */
+static void
+swap_run (gchar* buffer, gsize count, guint size)
+{
+  gsize i;
+
+  switch (size)
+    {
+    case 2:
+      for (i = 0; i < count; ++i, buffer += 2)
+	{
+	  guint16 t;
+	  memcpy (&t, buffer, 2);
+	  t = GUINT16_SWAP_LE_BE (t);
+	  memcpy (buffer, &t, 2);
+	}
+      break;
+    case 4:
+      for (i = 0; i < count; ++i, buffer += 4)
+	{
+	  guint32 t;
+	  memcpy (&t, buffer, 4);
+	  t = GUINT32_SWAP_LE_BE (t);
+	  memcpy (buffer, &t, 4);
+	}
+      break;
+    case 8:
+      for (i = 0; i < count; ++i, buffer += 8)
+	{
+	  guint64 t;
+	  memcpy (&t, buffer, 8);
+	  t = GUINT64_SWAP_LE_BE (t);
+	  memcpy (buffer, &t, 8);
+	}
+      break;
+    }
+}
+
+
+/* Write op->count fields of op->size bytes from VTYPE arguments in
+   native byte order */
+#define FORMAT_PACK_FIELDS(UTYPE, VTYPE)				\
+  G_STMT_START {							\
+    for (i = 0; i < op->count; ++i, buffer += sizeof (UTYPE))		\
+      {									\
+	UTYPE t_ = (UTYPE) va_arg (args, VTYPE);			\
+	memcpy (buffer, &t_, sizeof (UTYPE));				\
+      }									\
+  } G_STMT_END
+
+#define FORMAT_PACK_INTS(VTYPE)						\
+  G_STMT_START {							\
+    switch (op->size)							\
+      {									\
+      case 1:  FORMAT_PACK_FIELDS (guint8, VTYPE);	break;		\
+      case 2:  FORMAT_PACK_FIELDS (guint16, VTYPE);	break;		\
+      case 4:  FORMAT_PACK_FIELDS (guint32, VTYPE);	break;		\
+      case 8:  FORMAT_PACK_FIELDS (guint64, VTYPE);	break;		\
+      }									\
+  } G_STMT_END
+
+/* Read op->count fields of op->size bytes into the pointed-to
+   variables, swapping them with SWAP */
+#define FORMAT_UNPACK_FIELDS(UTYPE, SWAP)				\
+  G_STMT_START {							\
+    for (i = 0; i < op->count; ++i, buffer += sizeof (UTYPE))		\
+      {									\
+	UTYPE t_;							\
+	memcpy (&t_, buffer, sizeof (UTYPE));				\
+	t_ = SWAP (t_);							\
+	memcpy (va_arg (args, gpointer), &t_, sizeof (UTYPE));		\
+      }									\
+  } G_STMT_END
+
+#define NO_SWAP(T)  (T)
+
+
+/**
+ *  gnet_pack_format_pack
+ *  @format: a #GPackFormat
+ *  @buffer: buffer to pack to
+ *  @length: length of @buffer
+ *  @Varargs: variables to pack from
+ *
+ *  Writes @Varargs to @buffer like gnet_pack() does with the format
+ *  string @format was compiled from.
+ *
+ *  Returns: number of bytes packed; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_pack (const GPackFormat* format, gchar* buffer,
+		       gint length, ...)
+{
+  va_list args;
+  gint rv;
+
+  va_start (args, length);
+  rv = gnet_pack_format_vpack (format, buffer, length, args);
+  va_end (args);
+
+  return rv;
+}
+
+
+/**
+ *  gnet_pack_format_vpack
+ *  @format: a #GPackFormat
+ *  @buffer: buffer to pack to
+ *  @length: length of @buffer
+ *  @args: var args
+ *
+ *  Var arg interface to gnet_pack_format_pack().
+ *
+ *  Returns: number of bytes packed; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_vpack (const GPackFormat* format, gchar* buffer,
+			gint length, va_list args)
+{
+  const PackOp* op;
+  const PackOp* end;
+  gchar* start = buffer;
+  guint i;
+
+  g_return_val_if_fail (format, -1);
+  g_return_val_if_fail (buffer, -1);
+  g_return_val_if_fail (length, -1);
+
+  end = format->ops + format->n_ops;
+  for (op = format->ops; op < end; ++op)
+    {
+      gint n = buffer - start;
+
+      /* One check for the whole run of fixed-size fields */
+      g_return_val_if_fail (op->run <= (guint) (length - n), -1);
+
+      switch (op->code)
+	{
+	case OP_PAD:
+	  memset (buffer, 0, op->count);
+	  buffer += op->count;
+	  break;
+
+	/* Integers are written in native order, then the whole op is
+	   swapped at once */
+	case OP_INT:
+	  FORMAT_PACK_INTS (int);
+	  if (op->swap)
+	    swap_run (buffer - op->count * op->size, op->count, op->size);
+	  break;
+
+	case OP_LONG:
+	  FORMAT_PACK_INTS (long);
+	  if (op->swap)
+	    swap_run (buffer - op->count * op->size, op->count, op->size);
+	  break;
+
+	case OP_INT64:
+	  FORMAT_PACK_FIELDS (guint64, guint64);
+	  if (op->swap)
+	    swap_run (buffer - op->count * 8, op->count, 8);
+	  break;
+
+	case OP_FLOAT:
+	  for (i = 0; i < op->count; ++i, buffer += sizeof (float))
+	    {
+	      float t = (float) va_arg (args, double);
+	      memcpy (buffer, &t, sizeof (float));
+	    }
+	  break;
+
+	case OP_DOUBLE:
+	  for (i = 0; i < op->count; ++i, buffer += sizeof (double))
+	    {
+	      double t = va_arg (args, double);
+	      memcpy (buffer, &t, sizeof (double));
+	    }
+	  break;
+
+	case OP_POINTER:
+	  for (i = 0; i < op->count; ++i, buffer += sizeof (gsize))
+	    {
+	      gsize t = (gsize) va_arg (args, gpointer);
+	      memcpy (buffer, &t, sizeof (gsize));
+	    }
+	  if (op->swap)
+	    swap_run (buffer - op->count * sizeof (gsize), op->count,
+		      sizeof (gsize));
+	  break;
+
+	case OP_STRING:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      gchar* s;
+	      gsize slen;
+
+	      s = va_arg (args, gchar*);
+	      g_return_val_if_fail (s, -1);
+
+	      slen = strlen (s);
+	      g_return_val_if_fail (slen + 1 <= (gsize) (length - n), -1);
+
+	      memcpy (buffer, s, slen + 1);	/* include the 0 */
+	      buffer += slen + 1;
+	      n += slen + 1;
+	    }
+	  break;
+
+	case OP_STRING_FIXED:
+	  {
+	    gchar* s;
+
+	    s = va_arg (args, gchar*);
+	    g_return_val_if_fail (s, -1);
+
+	    for (i = 0; i < op->count && s[i]; ++i)
+	      *buffer++ = s[i];
+	    for (; i < op->count; ++i)
+	      *buffer++ = 0;
+	    break;
+	  }
+
+	case OP_STRING_RAW:
+	  {
+	    gchar* s;
+	    gsize slen;
+
+	    s = va_arg (args, gchar*);
+	    g_return_val_if_fail (s, -1);
+
+	    slen = strlen (s);
+	    g_return_val_if_fail (slen <= (gsize) (length - n), -1);
+
+	    memcpy (buffer, s, slen);	/* don't include the 0 */
+	    buffer += slen;
+	    break;
+	  }
+
+	case OP_BYTES:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      gchar* s;
+	      guint ln;
+
+	      s = va_arg (args, gchar*);
+	      ln = va_arg (args, guint);
+
+	      g_return_val_if_fail (s, -1);
+	      g_return_val_if_fail (ln <= (guint) (length - n), -1);
+
+	      memcpy (buffer, s, ln);
+	      buffer += ln;
+	      n += ln;
+	    }
+	  break;
+
+	case OP_BYTES_FIXED:
+	  {
+	    gchar* s;
+
+	    s = va_arg (args, gchar*);
+	    g_return_val_if_fail (s, -1);
+
+	    memcpy (buffer, s, op->count);
+	    buffer += op->count;
+	    break;
+	  }
+
+	case OP_PASCAL:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      gchar* s;
+	      gsize slen;
+
+	      s = va_arg (args, gchar*);
+	      g_return_val_if_fail (s, -1);
+
+	      slen = strlen (s);
+	      g_return_val_if_fail (slen < 256, -1);
+	      g_return_val_if_fail (slen + 1 <= (gsize) (length - n), -1);
+
+	      *buffer++ = slen;
+	      memcpy (buffer, s, slen);
+	      buffer += slen;
+	      n += slen + 1;
+	    }
+	  break;
+
+	case OP_VARINT:
+	case OP_ZIGZAG:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      guint64 v;
+	      guint vlen;
+
+	      if (op->code == OP_ZIGZAG)
+		v = zigzag_encode (va_arg (args, gint64));
+	      else
+		v = va_arg (args, guint64);
+
+	      vlen = varint_size (v);
+	      g_return_val_if_fail (vlen <= (guint) (length - n), -1);
+
+	      varint_encode (buffer, v);
+	      buffer += vlen;
+	      n += vlen;
+	    }
+	  break;
+	}
+    }
+
+  return buffer - start;
+}
+
+
+/**
+ *  gnet_pack_format_pack_strdup
+ *  @format: a #GPackFormat
+ *  @bufferp: pointer to a buffer (buffer is caller owned)
+ *  @Varargs: variables to pack from
+ *
+ *  Writes @Varargs into a buffer pointed to by @bufferp like
+ *  gnet_pack_strdup() does.  If @format has a fixed size, the
+ *  arguments are only walked once.
+ *
+ *  Returns: bytes packed; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_pack_strdup (const GPackFormat* format, gchar** bufferp, ...)
+{
+  va_list args;
+  gint size;
+  gint rv;
+
+  g_return_val_if_fail (format, -1);
+  g_return_val_if_fail (bufferp, -1);
+
+  size = format->size;
+  if (size < 0)
+    {
+      va_start (args, bufferp);
+      size = gnet_pack_format_vcalcsize (format, args);
+      va_end (args);
+      g_return_val_if_fail (size >= 0, -1);
+    }
+
+  if (size == 0)
+    {
+      *bufferp = NULL;
+      return 0;
+    }
+
+  *bufferp = g_new (gchar, size);
+
+  va_start (args, bufferp);
+  rv = gnet_pack_format_vpack (format, *bufferp, size, args);
+  va_end (args);
+
+  return rv;
+}
+
+
+/**
+ *  gnet_pack_format_calcsize
+ *  @format: a #GPackFormat
+ *  @Varargs: variables
+ *
+ *  Calculates the size of the buffer needed to pack @Varargs with
+ *  @format.  If @format has a fixed size, the arguments are not
+ *  looked at; see gnet_pack_format_get_size().
+ *
+ *  Returns: number of bytes required to pack; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_calcsize (const GPackFormat* format, ...)
+{
+  va_list args;
+  gint size;
+
+  va_start (args, format);
+  size = gnet_pack_format_vcalcsize (format, args);
+  va_end (args);
+
+  return size;
+}
+
+
+/**
+ *  gnet_pack_format_vcalcsize
+ *  @format: a #GPackFormat
+ *  @args: var args
+ *
+ *  Var arg interface to gnet_pack_format_calcsize().
+ *
+ *  Returns: number of bytes required to pack; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_vcalcsize (const GPackFormat* format, va_list args)
+{
+  const PackOp* op;
+  const PackOp* end;
+  gsize n = 0;
+  guint i;
+
+  g_return_val_if_fail (format, -1);
+
+  if (format->size >= 0)
+    return format->size;
+
+  end = format->ops + format->n_ops;
+  for (op = format->ops; op < end; ++op)
+    {
+      n += op->run;
+
+      switch (op->code)
+	{
+	case OP_PAD:
+	  break;
+
+	case OP_INT:
+	  for (i = 0; i < op->count; ++i)
+	    (void) va_arg (args, int);
+	  break;
+
+	case OP_LONG:
+	  for (i = 0; i < op->count; ++i)
+	    (void) va_arg (args, long);
+	  break;
+
+	case OP_INT64:
+	  for (i = 0; i < op->count; ++i)
+	    (void) va_arg (args, guint64);
+	  break;
+
+	case OP_VARINT:
+	  for (i = 0; i < op->count; ++i)
+	    n += varint_size (va_arg (args, guint64));
+	  break;
+
+	case OP_ZIGZAG:
+	  for (i = 0; i < op->count; ++i)
+	    n += varint_size (zigzag_encode (va_arg (args, gint64)));
+	  break;
+
+	case OP_FLOAT:
+	case OP_DOUBLE:
+	  for (i = 0; i < op->count; ++i)
+	    (void) va_arg (args, double);
+	  break;
+
+	case OP_POINTER:
+	  for (i = 0; i < op->count; ++i)
+	    (void) va_arg (args, gpointer);
+	  break;
+
+	case OP_STRING_FIXED:
+	case OP_BYTES_FIXED:
+	  {
+	    gchar* s = va_arg (args, gchar*);
+
+	    g_return_val_if_fail (s, -1);
+	    break;
+	  }
+
+	case OP_STRING:
+	case OP_PASCAL:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      gchar* s = va_arg (args, gchar*);
+
+	      g_return_val_if_fail (s, -1);
+	      n += strlen (s) + 1;
+	    }
+	  break;
+
+	case OP_STRING_RAW:
+	  {
+	    gchar* s = va_arg (args, gchar*);
+
+	    g_return_val_if_fail (s, -1);
+	    n += strlen (s);
+	    break;
+	  }
+
+	case OP_BYTES:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      gchar* s = va_arg (args, gchar*);
+
+	      g_return_val_if_fail (s, -1);
+	      n += va_arg (args, guint);
+	    }
+	  break;
+	}
+    }
+
+  g_return_val_if_fail (n <= G_MAXINT, -1);
+
+  return n;
+}
+
+
+/**
+ *  gnet_pack_format_unpack
+ *  @format: a #GPackFormat
+ *  @buffer: buffer to unpack from
+ *  @length: length of @buffer
+ *  @Varargs: addresses of variables to unpack to
+ *
+ *  Reads the data in @buffer into @Varargs like gnet_unpack() does
+ *  with the format string @format was compiled from.
+ *
+ *  Returns: number of bytes unpacked; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_unpack (const GPackFormat* format, const gchar* buffer,
+			 gint length, ...)
+{
+  va_list args;
+  gint rv;
+
+  va_start (args, length);
+  rv = gnet_pack_format_vunpack (format, buffer, length, args);
+  va_end (args);
+
+  return rv;
+}
+
+
+/**
+ *  gnet_pack_format_vunpack
+ *  @format: a #GPackFormat
+ *  @buffer: buffer to unpack from
+ *  @length: length of @buffer
+ *  @args: var args
+ *
+ *  Var arg interface to gnet_pack_format_unpack().
+ *
+ *  Returns: number of bytes unpacked; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_vunpack (const GPackFormat* format, const gchar* buffer,
+			  gint length, va_list args)
+{
+  const PackOp* op;
+  const PackOp* end;
+  const gchar* start = buffer;
+  guint i;
+
+  g_return_val_if_fail (format, -1);
+  g_return_val_if_fail (buffer, -1);
+
+  end = format->ops + format->n_ops;
+  for (op = format->ops; op < end; ++op)
+    {
+      gint n = buffer - start;
+
+      /* One check for the whole run of fixed-size fields */
+      g_return_val_if_fail (op->run <= (guint) (length - n), -1);
+
+      switch (op->code)
+	{
+	case OP_PAD:
+	  buffer += op->count;
+	  break;
+
+	case OP_INT:
+	case OP_LONG:
+	case OP_INT64:
+	case OP_POINTER:
+	  switch (op->size | (op->swap ? 0x100 : 0))
+	    {
+	    case 1:
+	    case 0x101:  FORMAT_UNPACK_FIELDS (guint8, NO_SWAP);	break;
+	    case 2:  FORMAT_UNPACK_FIELDS (guint16, NO_SWAP);		break;
+	    case 4:  FORMAT_UNPACK_FIELDS (guint32, NO_SWAP);		break;
+	    case 8:  FORMAT_UNPACK_FIELDS (guint64, NO_SWAP);		break;
+	    case 0x102:  FORMAT_UNPACK_FIELDS (guint16, GUINT16_SWAP_LE_BE); break;
+	    case 0x104:  FORMAT_UNPACK_FIELDS (guint32, GUINT32_SWAP_LE_BE); break;
+	    case 0x108:  FORMAT_UNPACK_FIELDS (guint64, GUINT64_SWAP_LE_BE); break;
+	    }
+	  break;
+
+	case OP_FLOAT:
+	case OP_DOUBLE:
+	  for (i = 0; i < op->count; ++i, buffer += op->size)
+	    memcpy (va_arg (args, gpointer), buffer, op->size);
+	  break;
+
+	case OP_STRING:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      gchar** sp;
+	      gsize slen;
+
+	      sp = va_arg (args, gchar**);
+	      g_return_val_if_fail (sp, -1);
+
+	      /* The string must be terminated within the buffer */
+	      slen = strlenn (buffer, length - n);
+	      g_return_val_if_fail (slen + 1 <= (gsize) (length - n), -1);
+
+	      *sp = g_new (gchar, slen + 1);
+	      memcpy (*sp, buffer, slen);
+	      (*sp)[slen] = 0;
+	      buffer += slen + 1;
+	      n += slen + 1;
+	    }
+	  break;
+
+	case OP_STRING_FIXED:
+	  {
+	    gchar** sp;
+	    gsize slen;
+
+	    sp = va_arg (args, gchar**);
+	    g_return_val_if_fail (sp, -1);
+
+	    slen = strlenn (buffer, op->count);
+	    *sp = g_new (gchar, op->count + 1);
+	    memcpy (*sp, buffer, slen);
+	    memset (*sp + slen, 0, op->count + 1 - slen);
+	    buffer += op->count;
+	    break;
+	  }
+
+	case OP_STRING_RAW:
+	  /* As in gnet_unpack(), S needs a REPEAT */
+	  g_return_val_if_fail (op->code != OP_STRING_RAW, -1);
+	  break;
+
+	case OP_BYTES:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      gchar** sp;
+	      guint ln;
+
+	      sp = va_arg (args, gchar**);
+	      ln = va_arg (args, guint);
+
+	      g_return_val_if_fail (sp, -1);
+	      g_return_val_if_fail (ln <= (guint) (length - n), -1);
+
+	      *sp = g_new (gchar, ln);
+	      memcpy (*sp, buffer, ln);
+	      buffer += ln;
+	      n += ln;
+	    }
+	  break;
+
+	case OP_BYTES_FIXED:
+	  {
+	    gchar** sp;
+
+	    sp = va_arg (args, gchar**);
+	    g_return_val_if_fail (sp, -1);
+
+	    *sp = g_new (gchar, op->count);
+	    memcpy (*sp, buffer, op->count);
+	    buffer += op->count;
+	    break;
+	  }
+
+	case OP_PASCAL:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      gchar** sp;
+	      guint slen;
+
+	      sp = va_arg (args, gchar**);
+	      g_return_val_if_fail (sp, -1);
+	      g_return_val_if_fail (n + 1 <= length, -1);
+
+	      slen = (guchar) *buffer++;
+	      ++n;
+	      g_return_val_if_fail (slen <= (guint) (length - n), -1);
+
+	      *sp = g_new (gchar, slen + 1);
+	      memcpy (*sp, buffer, slen);
+	      (*sp)[slen] = 0;
+	      buffer += slen;
+	      n += slen;
+	    }
+	  break;
+
+	case OP_VARINT:
+	case OP_ZIGZAG:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      guint64 v;
+	      guint vlen;
+
+	      vlen = varint_decode (buffer, length - n, &v);
+	      g_return_val_if_fail (vlen, -1);
+
+	      if (op->code == OP_ZIGZAG)
+		*va_arg (args, gint64*) = zigzag_decode (v);
+	      else
+		*va_arg (args, guint64*) = v;
+
+	      buffer += vlen;
+	      n += vlen;
+	    }
+	  break;
+	}
+    }
+
+  return buffer - start;
+}
+
+
+/* **************************************** */
+
+/* Cursors.  A cursor unpacks messages from a buffer that may end in
+   the middle of one, such as the data a GConn has read so far.  The
+   fields are measured against the bytes left before anything is
+   unpacked, so a short buffer is reported instead of being an error
+   and nothing is copied until all the fields are there. */
+
+/* Measures the fields of @format at @buffer.  Returns the number of
+   bytes they take if they all end within @length bytes.  Otherwise
+   returns -1 and sets *@needed to the number of bytes, more than
+   @length, the fields take at least; or to 0 if they are
+   malformed. */
+static gint
+pack_format_measure (const GPackFormat* format, const gchar* buffer,
+		     gsize length, va_list args, gsize* needed)
+{
+  const PackOp* op;
+  const PackOp* end;
+  gsize n = 0;
+  guint i;
+
+  end = format->ops + format->n_ops;
+  for (op = format->ops; op < end; ++op)
+    {
+      if (op->run > length - n)
+	{
+	  *needed = n + op->run;
+	  return -1;
+	}
+
+      switch (op->code)
+	{
+	case OP_PAD:
+	  n += op->count;
+	  break;
+
+	case OP_INT:
+	case OP_LONG:
+	case OP_INT64:
+	case OP_FLOAT:
+	case OP_DOUBLE:
+	case OP_POINTER:
+	  for (i = 0; i < op->count; ++i)
+	    (void) va_arg (args, gpointer);
+	  n += op->count * op->size;
+	  break;
+
+	case OP_STRING:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      const gchar* nul;
+
+	      (void) va_arg (args, gpointer);
+	      nul = memchr (buffer + n, 0, length - n);
+	      if (!nul)
+		{
+		  *needed = length + 1;
+		  return -1;
+		}
+	      n = nul - buffer + 1;
+	    }
+	  break;
+
+	case OP_STRING_FIXED:
+	case OP_BYTES_FIXED:
+	  (void) va_arg (args, gpointer);
+	  n += op->count;
+	  break;
+
+	case OP_STRING_RAW:
+	  /* Left to gnet_pack_format_vunpack() to refuse */
+	  break;
+
+	case OP_BYTES:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      guint ln;
+
+	      (void) va_arg (args, gpointer);
+	      ln = va_arg (args, guint);
+	      if (ln > length - n)
+		{
+		  *needed = n + ln;
+		  return -1;
+		}
+	      n += ln;
+	    }
+	  break;
+
+	case OP_PASCAL:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      guint slen;
+
+	      (void) va_arg (args, gpointer);
+	      if (n + 1 > length)
+		{
+		  *needed = n + 1;
+		  return -1;
+		}
+	      slen = (guchar) buffer[n];
+	      if (slen > length - n - 1)
+		{
+		  *needed = n + 1 + slen;
+		  return -1;
+		}
+	      n += 1 + slen;
+	    }
+	  break;
+
+	case OP_VARINT:
+	case OP_ZIGZAG:
+	  for (i = 0; i < op->count; ++i)
+	    {
+	      guint64 v;
+	      guint vlen;
+
+	      (void) va_arg (args, gpointer);
+	      vlen = varint_decode (buffer + n, length - n, &v);
+	      if (!vlen)
+		{
+		  /* Cut short, unless it is already too long */
+		  *needed = (length - n < VARINT_MAX_SIZE) ? length + 1 : 0;
+		  return -1;
+		}
+	      n += vlen;
+	    }
+	  break;
+	}
+    }
+
+  return n;
+}
+
+
+/* Rewinds @cursor after a short or malformed read.  @needed is the
+   number of bytes from the offset the read took, or 0. */
+static gboolean
+pack_cursor_fail (GPackCursor* cursor, gsize needed)
+{
+  cursor->needed = needed ? (gint) (cursor->offset + needed - cursor->length) : 0;
+  cursor->offset = cursor->mark;
+
+  return FALSE;
+}
+
+
+/**
+ *  gnet_pack_cursor_init
+ *  @cursor: a #GPackCursor
+ *  @buffer: buffer to unpack from
+ *  @length: number of bytes in @buffer
+ *
+ *  Sets up @cursor at the start of @buffer.  @buffer may hold several
+ *  messages and may end in the middle of one.  The cursor does not
+ *  copy @buffer, so @buffer must stay valid while the cursor is used.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_pack_cursor_init (GPackCursor* cursor, const gchar* buffer, gint length)
+{
+  g_return_if_fail (cursor);
+  g_return_if_fail (buffer);
+  g_return_if_fail (length >= 0);
+
+  cursor->buffer = buffer;
+  cursor->length = length;
+  cursor->offset = 0;
+  cursor->mark = 0;
+  cursor->needed = 0;
+}
+
+
+/**
+ *  gnet_pack_cursor_unpack
+ *  @cursor: a #GPackCursor
+ *  @format: a #GPackFormat
+ *  @Varargs: addresses of variables to unpack to
+ *
+ *  Unpacks the fields of @format at the position of @cursor like
+ *  gnet_pack_format_unpack() does, and moves the cursor past them.
+ *
+ *  If the buffer ends before the fields do, nothing is unpacked, the
+ *  cursor goes back to where it was last committed with
+ *  gnet_pack_cursor_commit(), and gnet_pack_cursor_get_needed() tells
+ *  how many more bytes the buffer needs at least.  So a message is
+ *  either read whole or not at all.
+ *
+ *  Returns: TRUE if the fields were unpacked; FALSE if the buffer is
+ *  short or the fields are malformed (gnet_pack_cursor_get_needed()
+ *  is 0 then).
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_pack_cursor_unpack (GPackCursor* cursor, const GPackFormat* format, ...)
+{
+  va_list args;
+  gboolean rv;
+
+  va_start (args, format);
+  rv = gnet_pack_cursor_vunpack (cursor, format, args);
+  va_end (args);
+
+  return rv;
+}
+
+
+/**
+ *  gnet_pack_cursor_vunpack
+ *  @cursor: a #GPackCursor
+ *  @format: a #GPackFormat
+ *  @args: var args
+ *
+ *  Var arg interface to gnet_pack_cursor_unpack().
+ *
+ *  Returns: TRUE if the fields were unpacked; FALSE otherwise.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_pack_cursor_vunpack (GPackCursor* cursor, const GPackFormat* format,
+			  va_list args)
+{
+  const gchar* buffer;
+  gsize left;
+  gsize needed = 0;
+  gint size;
+
+  g_return_val_if_fail (cursor, FALSE);
+  g_return_val_if_fail (format, FALSE);
+
+  buffer = cursor->buffer + cursor->offset;
+  left = cursor->length - cursor->offset;
+
+  if (format->size >= 0)
+    {
+      size = format->size;
+      if ((gsize) size > left)
+	return pack_cursor_fail (cursor, size);
+    }
+  else
+    {
+      va_list measure_args;
+
+      G_VA_COPY (measure_args, args);
+      size = pack_format_measure (format, buffer, left, measure_args, &needed);
+      va_end (measure_args);
+      if (size < 0)
+	return pack_cursor_fail (cursor, needed);
+    }
+
+  if (gnet_pack_format_vunpack (format, buffer, size, args) != size)
+    return pack_cursor_fail (cursor, 0);
+
+  cursor->offset += size;
+  cursor->needed = 0;
+
+  return TRUE;
+}
+
+
+/**
+ *  gnet_pack_cursor_read
+ *  @cursor: a #GPackCursor
+ *  @length: number of bytes
+ *
+ *  Gets the next @length bytes at the position of @cursor, without
+ *  copying them, and moves the cursor past them.  This is useful for
+ *  message bodies.  If the buffer is short, the cursor goes back as
+ *  in gnet_pack_cursor_unpack().
+ *
+ *  Returns: a pointer into the buffer of @cursor; NULL if the buffer
+ *  is short.
+ *
+ *  Since: 2.0.9
+ **/
+const gchar*
+gnet_pack_cursor_read (GPackCursor* cursor, gint length)
+{
+  const gchar* p;
+
+  g_return_val_if_fail (cursor, NULL);
+  g_return_val_if_fail (length >= 0, NULL);
+
+  if (length > cursor->length - cursor->offset)
+    {
+      pack_cursor_fail (cursor, length);
+      return NULL;
+    }
+
+  p = cursor->buffer + cursor->offset;
+  cursor->offset += length;
+  cursor->needed = 0;
+
+  return p;
+}
+
+
+/**
+ *  gnet_pack_cursor_commit
+ *  @cursor: a #GPackCursor
+ *
+ *  Marks everything read with @cursor so far as consumed.  A short
+ *  read goes back to here.  Commit after each whole message.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_pack_cursor_commit (GPackCursor* cursor)
+{
+  g_return_if_fail (cursor);
+
+  cursor->mark = cursor->offset;
+}
+
+
+/**
+ *  gnet_pack_cursor_get_committed
+ *  @cursor: a #GPackCursor
+ *
+ *  Gets the number of bytes consumed with gnet_pack_cursor_commit().
+ *  Pass it to gnet_conn_read_consume() when the buffer is from a
+ *  #GConn.
+ *
+ *  Returns: the number of bytes committed.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_cursor_get_committed (const GPackCursor* cursor)
+{
+  g_return_val_if_fail (cursor, 0);
+
+  return cursor->mark;
+}
+
+
+/**
+ *  gnet_pack_cursor_get_needed
+ *  @cursor: a #GPackCursor
+ *
+ *  Gets the number of bytes the buffer of @cursor would need at least
+ *  for the last read to succeed.  More may be needed after them; a
+ *  string is only known to end when its terminator is there, for
+ *  example.
+ *
+ *  Returns: the number of bytes beyond the end of the buffer the last
+ *  read needed; 0 if it succeeded or the data is malformed.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_cursor_get_needed (const GPackCursor* cursor)
+{
+  g_return_val_if_fail (cursor, 0);
+
+  return cursor->needed;
+}
+
+
+/* **************************************** */
+
+/* Arrays of records.  A record is a struct whose members are the
+   fields of a fixed-size, numeric GPackFormat.  Each field of the
+   format becomes an ArrayField that copies it between its place in
+   the packed record and its member of the struct.
+
+   Where the packed record and the struct are at most 16 bytes, all
+   the fields of a record are moved at once by a byte shuffle (SSSE3
+   pshufb) that does the byte swapping too.  If records are also the
+   same size packed as in memory and 16 is a multiple of that size,
+   several records are shuffled per instruction, 32 bytes at a time
+   with AVX2.  The rest is done field by field. */
+
+typedef struct _ArrayField
+{
+  guint		wire;		/* offset in the packed record */
+  gssize	member;		/* offset in the struct; -1 for padding */
+  guint		size;
+  gboolean	swap;
+} ArrayField;
+
+
+static ArrayField*
+array_fields_new (const GPackFormat* format, const gsize* offsets,
+		  gsize record_size, guint* n_fieldsp)
+{
+  ArrayField* fields;
+  const PackOp* op;
+  const PackOp* end;
+  guint n_fields = 0;
+  guint wire = 0;
+  guint n = 0;
+  guint i;
+
+  end = format->ops + format->n_ops;
+  for (op = format->ops; op < end; ++op)
+    {
+      if (op->code > OP_POINTER)
+	return NULL;
+      n_fields += (op->code == OP_PAD) ? 1 : op->count;
+    }
+
+  fields = g_new (ArrayField, n_fields);
+  for (op = format->ops; op < end; ++op)
+    {
+      if (op->code == OP_PAD)
+	{
+	  fields[n].wire = wire;
+	  fields[n].member = -1;
+	  fields[n].size = op->count;
+	  fields[n].swap = FALSE;
+	  wire += op->count;
+	  ++n;
+	  continue;
+	}
+
+      for (i = 0; i < op->count; ++i, ++n)
+	{
+	  gsize member = offsets ? *offsets++ : wire;
+
+	  if (member > record_size || op->size > record_size - member)
+	    {
+	      g_free (fields);
+	      return NULL;
+	    }
+
+	  fields[n].wire = wire;
+	  fields[n].member = member;
+	  fields[n].size = op->size;
+	  fields[n].swap = op->swap && op->size > 1;
+	  wire += op->size;
+	}
+    }
+
+  *n_fieldsp = n_fields;
+  return fields;
+}
+
+
+/* Copy a field, swapping its bytes if @swap.  Swapping is the same
+   both ways. */
+static inline void
+array_copy_field (gchar* dst, const gchar* src, guint size, gboolean swap)
+{
+  if (!swap)
+    {
+      memcpy (dst, src, size);
+      return;
+    }
+
+  switch (size)
+    {
+    case 2:
+      {
+	guint16 t;
+	memcpy (&t, src, 2);
+	t = GUINT16_SWAP_LE_BE (t);
+	memcpy (dst, &t, 2);
+	break;
+      }
+    case 4:
+      {
+	guint32 t;
+	memcpy (&t, src, 4);
+	t = GUINT32_SWAP_LE_BE (t);
+	memcpy (dst, &t, 4);
+	break;
+      }
+    case 8:
+      {
+	guint64 t;
+	memcpy (&t, src, 8);
+	t = GUINT64_SWAP_LE_BE (t);
+	memcpy (dst, &t, 8);
+	break;
+      }
+    default:
+      flipmemcpy (dst, src, size);
+    }
+}
+
+
+#ifdef HAVE_X86_SIMD
+
+#include <immintrin.h>
+#include "cpu-private.h"
+
+#define SHUFFLE_ZERO	((gint8) 0x80)
+
+/* A byte shuffle from the source records to the destination records.
+   Each step loads 16 (or 32) bytes of the source at src_stride,
+   shuffles them, keeps the destination bytes marked in keep, and
+   stores 16 (or 32) bytes at dst_stride.  Steps overlap the next
+   record when a record is less than 16 bytes, so they must be done
+   in order. */
+typedef struct _ArrayShuffle
+{
+  gint8		shuffle[16];	/* source byte, or SHUFFLE_ZERO */
+  gint8		keep[16];	/* -1 to keep the destination byte */
+  gboolean	has_keep;
+  gsize		src_stride;
+  gsize		dst_stride;
+  guint		records;	/* records per step */
+  gboolean	dense;		/* records fill the 16 bytes exactly */
+} ArrayShuffle;
+
+
+/* Build the shuffle that packs (@pack) or unpacks one record.  Returns
+   FALSE if the records do not fit a 16-byte shuffle. */
+static gboolean
+array_shuffle_init (ArrayShuffle* as, const ArrayField* fields,
+		    guint n_fields, gsize wire_size, gsize record_size,
+		    gboolean pack)
+{
+  gsize src_size = pack ? record_size : wire_size;
+  gsize dst_size = pack ? wire_size : record_size;
+  guint i, j, k;
+
+  if (wire_size > 16 || record_size > 16)
+    return FALSE;
+
+  /* Unpacking keeps the struct bytes that are not fields; packing
+     zeroes the padding.  Bytes after the record belong to the next
+     one and are kept. */
+  for (j = 0; j < 16; ++j)
+    {
+      as->shuffle[j] = SHUFFLE_ZERO;
+      as->keep[j] = (pack && j < dst_size) ? 0 : -1;
+    }
+
+  for (i = 0; i < n_fields; ++i)
+    {
+      const ArrayField* f = &fields[i];
+
+      if (f->member < 0)
+	continue;
+
+      for (j = 0; j < f->size; ++j)
+	{
+	  guint from = f->swap ? f->size - 1 - j : j;
+	  guint dst = (pack ? f->wire : f->member) + j;
+	  guint src = (pack ? f->member : f->wire) + from;
+
+	  as->shuffle[dst] = src;
+	  as->keep[dst] = 0;
+	}
+    }
+
+  as->src_stride = src_size;
+  as->dst_stride = dst_size;
+  as->records = 1;
+  as->dense = FALSE;
+
+  /* Several records per step */
+  if (src_size == dst_size && 16 % src_size == 0)
+    {
+      for (k = 1; k < 16 / src_size; ++k)
+	for (j = 0; j < src_size; ++j)
+	  {
+	    gint8 s = as->shuffle[j];
+
+	    as->shuffle[k * src_size + j] =
+	      (s == SHUFFLE_ZERO) ? SHUFFLE_ZERO : s + k * src_size;
+	    as->keep[k * src_size + j] = as->keep[j];
+	  }
+      as->src_stride = as->dst_stride = 16;
+      as->records = 16 / src_size;
+      as->dense = TRUE;
+    }
+
+  as->has_keep = FALSE;
+  for (j = 0; j < 16; ++j)
+    if (as->keep[j])
+      as->has_keep = TRUE;
+
+  return TRUE;
+}
+
+
+/* Number of steps whose 16-byte loads and stores stay in bounds */
+static gsize
+array_shuffle_steps (const ArrayShuffle* as, gsize src_length,
+		     gsize dst_length, gsize width)
+{
+  gsize steps = src_length / as->src_stride;
+
+  if (!as->dense)
+    {
+      gsize n;
+
+      n = (src_length >= width) ? (src_length - width) / as->src_stride + 1 : 0;
+      steps = MIN (steps, n);
+      n = (dst_length >= width) ? (dst_length - width) / as->dst_stride + 1 : 0;
+      steps = MIN (steps, n);
+    }
+
+  return steps;
+}
+
+
+__attribute__ ((target ("ssse3")))
+static gsize
+array_shuffle_ssse3 (const ArrayShuffle* as, gchar* dst, gsize dst_length,
+		     const gchar* src, gsize src_length)
+{
+  __m128i shuffle = _mm_loadu_si128 ((const __m128i*) as->shuffle);
+  __m128i keep = _mm_loadu_si128 ((const __m128i*) as->keep);
+  gsize steps = array_shuffle_steps (as, src_length, dst_length, 16);
+  gsize i;
+
+  for (i = 0; i < steps; ++i)
+    {
+      __m128i v;
+
+      v = _mm_loadu_si128 ((const __m128i*) (src + i * as->src_stride));
+      v = _mm_shuffle_epi8 (v, shuffle);
+      if (as->has_keep)
+	{
+	  __m128i d;
+
+	  d = _mm_loadu_si128 ((const __m128i*) (dst + i * as->dst_stride));
+	  v = _mm_or_si128 (_mm_and_si128 (keep, d), _mm_andnot_si128 (keep, v));
+	}
+      _mm_storeu_si128 ((__m128i*) (dst + i * as->dst_stride), v);
+    }
+
+  return steps * as->records;
+}
+
+
+/* Dense records only: each 128-bit lane holds whole records */
+__attribute__ ((target ("avx2")))
+static gsize
+array_shuffle_avx2 (const ArrayShuffle* as, gchar* dst, gsize dst_length,
+		    const gchar* src, gsize src_length)
+{
+  __m256i shuffle = _mm256_broadcastsi128_si256
+    (_mm_loadu_si128 ((const __m128i*) as->shuffle));
+  __m256i keep = _mm256_broadcastsi128_si256
+    (_mm_loadu_si128 ((const __m128i*) as->keep));
+  gsize steps = src_length / 32;
+  gsize i;
+
+  for (i = 0; i < steps; ++i)
+    {
+      __m256i v;
+
+      v = _mm256_loadu_si256 ((const __m256i*) (src + i * 32));
+      v = _mm256_shuffle_epi8 (v, shuffle);
+      if (as->has_keep)
+	{
+	  __m256i d;
+
+	  d = _mm256_loadu_si256 ((const __m256i*) (dst + i * 32));
+	  v = _mm256_blendv_epi8 (v, d, keep);
+	}
+      _mm256_storeu_si256 ((__m256i*) (dst + i * 32), v);
+    }
+
+  return steps * 2 * as->records;
+}
+
+
+/* Shuffle as many records as the CPU allows; returns the number done */
+static guint
+array_shuffle (const ArrayField* fields, guint n_fields, gsize wire_size,
+	       gsize record_size, gboolean pack, gchar* dst,
+	       const gchar* src, guint n_records)
+{
+  ArrayShuffle as;
+  guint features = _gnet_cpu_get_features ();
+  gsize src_size = pack ? record_size : wire_size;
+  gsize dst_size = pack ? wire_size : record_size;
+  gsize done = 0;
+
+  if (!(features & GNET_CPU_SSSE3) ||
+      !array_shuffle_init (&as, fields, n_fields, wire_size, record_size, pack))
+    return 0;
+
+  if (as.dense && (features & GNET_CPU_AVX2))
+    done = array_shuffle_avx2 (&as, dst, n_records * dst_size,
+			       src, n_records * src_size);
+
+  done += array_shuffle_ssse3 (&as, dst + done * dst_size,
+			       (n_records - done) * dst_size,
+			       src + done * src_size,
+			       (n_records - done) * src_size);
+
+  return done;
+}
+
+#endif /* HAVE_X86_SIMD */
+
+
+static gint
+pack_format_array (const GPackFormat* format, gchar* wire,
+		   gint length, gchar* records, gsize record_size,
+		   const gsize* offsets, guint n_records, gboolean pack)
+{
+  ArrayField* fields;
+  guint n_fields;
+  gsize wire_size;
+  guint done = 0;
+  guint r, i;
+
+  g_return_val_if_fail (format, -1);
+  g_return_val_if_fail (format->size > 0, -1);
+  g_return_val_if_fail (wire, -1);
+  g_return_val_if_fail (records || !n_records, -1);
+  g_return_val_if_fail (length >= 0, -1);
+  g_return_val_if_fail (record_size > 0, -1);
+
+  wire_size = format->size;
+  g_return_val_if_fail (n_records <= length / wire_size, -1);
+
+  fields = array_fields_new (format, offsets, record_size, &n_fields);
+  g_return_val_if_fail (fields, -1);
+
+  /* Same layout, no swapping: a copy */
+  if (record_size == wire_size)
+    {
+      for (i = 0; i < n_fields; ++i)
+	if (fields[i].swap || fields[i].member != (gssize) fields[i].wire)
+	  break;
+      if (i == n_fields)
+	{
+	  if (pack)
+	    memcpy (wire, records, wire_size * n_records);
+	  else
+	    memcpy (records, wire, wire_size * n_records);
+	  done = n_records;
+	}
+    }
+
+#ifdef HAVE_X86_SIMD
+  if (done < n_records)
+    {
+      if (pack)
+	done = array_shuffle (fields, n_fields, wire_size, record_size, TRUE,
+			      wire, records, n_records);
+      else
+	done = array_shuffle (fields, n_fields, wire_size, record_size, FALSE,
+			      records, wire, n_records);
+    }
+#endif
+
+  for (r = done; r < n_records; ++r)
+    {
+      gchar* w = wire + r * wire_size;
+      gchar* m = records + r * record_size;
+
+      for (i = 0; i < n_fields; ++i)
+	{
+	  const ArrayField* f = &fields[i];
+
+	  if (f->member < 0)
+	    {
+	      if (pack)
+		memset (w + f->wire, 0, f->size);
+	    }
+	  else if (pack)
+	    array_copy_field (w + f->wire, m + f->member, f->size, f->swap);
+	  else
+	    array_copy_field (m + f->member, w + f->wire, f->size, f->swap);
+	}
+    }
+
+  g_free (fields);
+
+  return wire_size * n_records;
+}
+
+
+/**
+ *  gnet_pack_format_pack_array
+ *  @format: a #GPackFormat
+ *  @buffer: buffer to pack to
+ *  @length: length of @buffer
+ *  @records: array of structs to pack from
+ *  @record_size: size of each struct
+ *  @offsets: offset of the member of each field in the struct, or
+ *  NULL
+ *  @n_records: number of structs
+ *
+ *  Packs an array of structs, one after another, with one call.
+ *  Each struct is packed like gnet_pack_format_pack() would pack its
+ *  members, but without passing each of them.
+ *
+ *  @format must have a fixed size and only number fields and padding
+ *  ("x", "b", "h", "i", "l", "q", "f", "d", "v" and their unsigned
+ *  variants).  @offsets has the offset of the member (see
+ *  G_STRUCT_OFFSET()) of each field in format order, not counting
+ *  padding; "2H" is two fields.  A member has the packed size of its
+ *  field, so "<l" is a #gint32 member.  If @offsets is NULL, each
+ *  member is at the same offset in the struct as its field in the
+ *  packed record.
+ *
+ *  Records are copied by vector shuffles on processors that support
+ *  them, so packing large arrays runs close to memory speed.
+ *
+ *  Returns: number of bytes packed; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_pack_array (const GPackFormat* format, gchar* buffer,
+			     gint length, gconstpointer records,
+			     gsize record_size, const gsize* offsets,
+			     guint n_records)
+{
+  return pack_format_array (format, buffer, length, (gchar*) records,
+			    record_size, offsets, n_records, TRUE);
+}
+
+
+/**
+ *  gnet_pack_format_unpack_array
+ *  @format: a #GPackFormat
+ *  @buffer: buffer to unpack from
+ *  @length: length of @buffer
+ *  @records: array of structs to unpack to
+ *  @record_size: size of each struct
+ *  @offsets: offset of the member of each field in the struct, or
+ *  NULL
+ *  @n_records: number of structs
+ *
+ *  Unpacks @n_records records from @buffer into an array of structs
+ *  with one call.  See gnet_pack_format_pack_array() for @format and
+ *  @offsets.  Struct bytes that are not members of a field are not
+ *  changed.
+ *
+ *  Returns: number of bytes unpacked; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_pack_format_unpack_array (const GPackFormat* format,
+			       const gchar* buffer, gint length,
+			       gpointer records, gsize record_size,
+			       const gsize* offsets, guint n_records)
+{
+  return pack_format_array (format, (gchar*) buffer, length, records,
+			    record_size, offsets, n_records, FALSE);
+}
@@ -45,6 +45,78 @@ gint gnet_unpack  (const gchar * format, const gchar * buffer, gint length, ...)
 
 gint gnet_vunpack (const gchar * format, const gchar * buffer, gint length, va_list args);
 
+/* compiled formats */
+
+/**
+ *  GPackFormat
+ *
+ *  A format string compiled by gnet_pack_format_new().  The
+ *  implementation is hidden.
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GPackFormat GPackFormat;
+
+GPackFormat* gnet_pack_format_new  (const gchar * format);
+void gnet_pack_format_free (GPackFormat * format);
+
+gint gnet_pack_format_get_size (const GPackFormat * format);
+
+gint gnet_pack_format_pack  (const GPackFormat * format, gchar * buffer, gint length, ...);
+gint gnet_pack_format_vpack (const GPackFormat * format, gchar * buffer, gint length, va_list args);
+gint gnet_pack_format_pack_strdup (const GPackFormat * format, gchar ** bufferp, ...);
+
+gint gnet_pack_format_calcsize  (const GPackFormat * format, ...);
+gint gnet_pack_format_vcalcsize (const GPackFormat * format, va_list args);
+
+gint gnet_pack_format_unpack  (const GPackFormat * format, const gchar * buffer, gint length, ...);
+gint gnet_pack_format_vunpack (const GPackFormat * format, const gchar * buffer, gint length, va_list args);
+
+gint gnet_pack_format_pack_array   (const GPackFormat * format, gchar * buffer, gint length,
+				    gconstpointer records, gsize record_size,
+				    const gsize * offsets, guint n_records);
+gint gnet_pack_format_unpack_array (const GPackFormat * format, const gchar * buffer, gint length,
+				    gpointer records, gsize record_size,
+				    const gsize * offsets, guint n_records);
+
+/* cursors */
+
+/**
+ *  GPackCursor
+ *  @buffer: [private]
+ *  @length: [private]
+ *  @offset: [private]
+ *  @mark: [private]
+ *  @needed: [private]
+ *
+ *  A position in a buffer of packed messages, for unpacking them in
+ *  place as they arrive.  Set it up with gnet_pack_cursor_init(); it
+ *  is usually on the stack.  Do not set the fields.
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GPackCursor GPackCursor;
+struct _GPackCursor
+{
+  const gchar*	buffer;
+  gint		length;
+  gint		offset;
+  gint		mark;
+  gint		needed;
+};
+
+void gnet_pack_cursor_init (GPackCursor * cursor, const gchar * buffer, gint length);
+
+gboolean gnet_pack_cursor_unpack  (GPackCursor * cursor, const GPackFormat * format, ...);
+gboolean gnet_pack_cursor_vunpack (GPackCursor * cursor, const GPackFormat * format, va_list args);
+
+const gchar* gnet_pack_cursor_read (GPackCursor * cursor, gint length);
+
+void gnet_pack_cursor_commit (GPackCursor * cursor);
+
+gint gnet_pack_cursor_get_committed (const GPackCursor * cursor);
+gint gnet_pack_cursor_get_needed    (const GPackCursor * cursor);
+
 
 G_END_DECLS
 
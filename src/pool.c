@@ -0,0 +1,347 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#include "gnet-private.h"
+#include "pool.h"
+
+/* The free slots are kept in lock-free stacks.  There are several
+   stacks, and each thread uses the one its GThread hashes to, so
+   threads that allocate and release at the same time rarely touch
+   the same stack.  A thread takes from the other stacks when its own
+   is empty.
+
+   The head of a stack holds the index of the top slot plus one (0
+   for an empty stack) in its low 32 bits, and a tag that is bumped
+   on every change in its high 32 bits, so that a compare-and-swap
+   fails if the stack changed in between even though the same slot
+   is on top again (the ABA problem).  The tag only wraps after 2^32
+   changes, far more than a thread can miss while it is preempted
+   between reading the head and swapping it. */
+
+#define POOL_STRIPES		8
+#define POOL_MAX_SLOTS		0xFFFF
+/* Size of the slot header in front of each buffer; keeps the buffers
+   aligned to 16 bytes */
+#define POOL_HEADER_SIZE	32
+/* Stacks are a cache line apart */
+#define POOL_STRIPE_SIZE	64
+
+typedef struct _GPacketSlot
+{
+  GPacketPool*	pool;
+  gint		ref_count;	/* ATOMIC */
+  gint		next;		/* next free slot plus one */
+} GPacketSlot;
+
+typedef union _GPacketStripe
+{
+  guint64	head;		/* ATOMIC */
+  gchar		pad[POOL_STRIPE_SIZE];
+} GPacketStripe;
+
+struct _GPacketPool
+{
+  GPacketStripe	stripes[POOL_STRIPES];
+
+  gint		ref_count;	/* ATOMIC */
+  gint		slot_size;
+  gint		n_slots;
+  gsize		stride;
+  gchar*	memory;
+};
+
+
+#define POOL_SLOT(pool, i) \
+  ((GPacketSlot*) ((pool)->memory + (gsize) (i) * (pool)->stride))
+#define POOL_SLOT_BUFFER(slot)	(((gchar*) (slot)) + POOL_HEADER_SIZE)
+#define POOL_BUFFER_SLOT(buffer) \
+  ((GPacketSlot*) (((gchar*) (buffer)) - POOL_HEADER_SIZE))
+
+#define POOL_HEAD(tag, top)	(((guint64) (tag) << 32) | (guint32) (top))
+#define POOL_HEAD_TAG(head)	((guint32) ((head) >> 32))
+#define POOL_HEAD_TOP(head)	((guint32) (head))
+
+/* GLib has no 64-bit atomics; where pointers are 64 bits wide the
+   pointer ones do, elsewhere the compiler's */
+#if GLIB_SIZEOF_VOID_P == 8
+#define POOL_HEAD_GET(head) \
+  ((guint64) GPOINTER_TO_SIZE (g_atomic_pointer_get ((gpointer*) (head))))
+#define POOL_HEAD_CAS(head, old, new) \
+  g_atomic_pointer_compare_and_exchange ((gpointer*) (head), \
+					 GSIZE_TO_POINTER (old), \
+					 GSIZE_TO_POINTER (new))
+#else
+#define POOL_HEAD_GET(head)	 __sync_fetch_and_add ((head), 0)
+#define POOL_HEAD_CAS(head, old, new) \
+  __sync_bool_compare_and_swap ((head), (old), (new))
+#endif
+
+
+static guint
+packet_pool_stripe (void)
+{
+  return (GPOINTER_TO_UINT (g_thread_self ()) >> 4) % POOL_STRIPES;
+}
+
+
+static void
+packet_pool_push (GPacketPool* pool, guint stripe, gint index)
+{
+  GPacketSlot* slot = POOL_SLOT (pool, index);
+  guint64* head = &pool->stripes[stripe].head;
+  guint64 old, new;
+
+  do
+    {
+      old = POOL_HEAD_GET (head);
+      slot->next = POOL_HEAD_TOP (old);
+      new = POOL_HEAD (POOL_HEAD_TAG (old) + 1, index + 1);
+    }
+  while (!POOL_HEAD_CAS (head, old, new));
+}
+
+
+static gint
+packet_pool_pop (GPacketPool* pool, guint stripe)
+{
+  guint64* head = &pool->stripes[stripe].head;
+  guint64 old, new;
+  guint top;
+
+  do
+    {
+      old = POOL_HEAD_GET (head);
+      top = POOL_HEAD_TOP (old);
+      if (top == 0)
+	return -1;
+
+      /* The slot may be taken and its link changed meanwhile; the tag
+	 makes the exchange fail then */
+      new = POOL_HEAD (POOL_HEAD_TAG (old) + 1,
+		       POOL_SLOT (pool, top - 1)->next);
+    }
+  while (!POOL_HEAD_CAS (head, old, new));
+
+  return top - 1;
+}
+
+
+/**
+ *  gnet_packet_pool_new
+ *  @slot_size: size of each buffer in bytes
+ *  @n_slots: number of buffers, at most 65535
+ *
+ *  Creates a #GPacketPool of @n_slots buffers of @slot_size bytes.
+ *  All the memory is allocated now.  Use gnet_packet_pool_alloc() to
+ *  get a buffer.
+ *
+ *  Returns: a new #GPacketPool.
+ *
+ *  Since: 2.0.9
+ **/
+GPacketPool*
+gnet_packet_pool_new (gint slot_size, gint n_slots)
+{
+  GPacketPool* pool;
+  gint i;
+
+  g_return_val_if_fail (slot_size > 0, NULL);
+  g_return_val_if_fail (n_slots > 0 && n_slots <= POOL_MAX_SLOTS, NULL);
+
+  pool = g_new0 (GPacketPool, 1);
+  pool->ref_count = 1;
+  pool->slot_size = slot_size;
+  pool->n_slots = n_slots;
+  pool->stride = POOL_HEADER_SIZE + (((gsize) slot_size + 15) & ~(gsize) 15);
+  pool->memory = g_malloc (pool->stride * n_slots);
+
+  /* Deal the slots out to the stacks, last slot first, so that each
+     stack hands out its slots in address order */
+  for (i = n_slots - 1; i >= 0; --i)
+    {
+      GPacketSlot* slot = POOL_SLOT (pool, i);
+
+      slot->pool = pool;
+      slot->ref_count = 0;
+      packet_pool_push (pool, i % POOL_STRIPES, i);
+    }
+
+  return pool;
+}
+
+
+/**
+ *  gnet_packet_pool_ref
+ *  @pool: a #GPacketPool
+ *
+ *  Adds a reference to a #GPacketPool.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_packet_pool_ref (GPacketPool* pool)
+{
+  g_return_if_fail (pool != NULL);
+
+  g_atomic_int_inc (&pool->ref_count);
+}
+
+
+/**
+ *  gnet_packet_pool_unref
+ *  @pool: a #GPacketPool
+ *
+ *  Removes a reference from a #GPacketPool.  Every buffer taken from
+ *  the pool holds a reference too, so the pool is freed once the
+ *  reference count reaches 0 and all its buffers are released.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_packet_pool_unref (GPacketPool* pool)
+{
+  g_return_if_fail (pool != NULL);
+
+  if (g_atomic_int_dec_and_test (&pool->ref_count))
+    {
+      g_free (pool->memory);
+      g_free (pool);
+    }
+}
+
+
+/**
+ *  gnet_packet_pool_get_slot_size
+ *  @pool: a #GPacketPool
+ *
+ *  Gets the size of the buffers of a #GPacketPool.
+ *
+ *  Returns: the size of each buffer in bytes.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_packet_pool_get_slot_size (const GPacketPool* pool)
+{
+  g_return_val_if_fail (pool != NULL, 0);
+
+  return pool->slot_size;
+}
+
+
+/**
+ *  gnet_packet_pool_get_n_slots
+ *  @pool: a #GPacketPool
+ *
+ *  Gets the number of buffers of a #GPacketPool.
+ *
+ *  Returns: the number of buffers.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_packet_pool_get_n_slots (const GPacketPool* pool)
+{
+  g_return_val_if_fail (pool != NULL, 0);
+
+  return pool->n_slots;
+}
+
+
+/**
+ *  gnet_packet_pool_alloc
+ *  @pool: a #GPacketPool
+ *
+ *  Takes a buffer of gnet_packet_pool_get_slot_size() bytes from a
+ *  #GPacketPool.  The buffer has one reference; it goes back to the
+ *  pool when gnet_packet_buffer_unref() drops the last one.  This
+ *  may be called from any thread.
+ *
+ *  Returns: a buffer; NULL if all the buffers are in use.
+ *
+ *  Since: 2.0.9
+ **/
+gchar*
+gnet_packet_pool_alloc (GPacketPool* pool)
+{
+  GPacketSlot* slot;
+  guint stripe;
+  gint index = -1;
+  guint i;
+
+  g_return_val_if_fail (pool != NULL, NULL);
+
+  stripe = packet_pool_stripe ();
+  for (i = 0; i < POOL_STRIPES && index < 0; ++i)
+    index = packet_pool_pop (pool, (stripe + i) % POOL_STRIPES);
+  if (index < 0)
+    return NULL;
+
+  slot = POOL_SLOT (pool, index);
+  g_atomic_int_set (&slot->ref_count, 1);
+  g_atomic_int_inc (&pool->ref_count);
+
+  return POOL_SLOT_BUFFER (slot);
+}
+
+
+/**
+ *  gnet_packet_buffer_ref
+ *  @buffer: a buffer from gnet_packet_pool_alloc()
+ *
+ *  Adds a reference to a buffer of a #GPacketPool.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_packet_buffer_ref (gchar* buffer)
+{
+  g_return_if_fail (buffer != NULL);
+
+  g_atomic_int_inc (&POOL_BUFFER_SLOT (buffer)->ref_count);
+}
+
+
+/**
+ *  gnet_packet_buffer_unref
+ *  @buffer: a buffer from gnet_packet_pool_alloc()
+ *
+ *  Removes a reference from a buffer of a #GPacketPool.  When the
+ *  last reference is dropped, the buffer goes back to its pool.  This
+ *  may be called from any thread.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_packet_buffer_unref (gchar* buffer)
+{
+  GPacketSlot* slot;
+  GPacketPool* pool;
+
+  g_return_if_fail (buffer != NULL);
+
+  slot = POOL_BUFFER_SLOT (buffer);
+  if (g_atomic_int_dec_and_test (&slot->ref_count))
+    {
+      pool = slot->pool;
+      packet_pool_push (pool, packet_pool_stripe (),
+			(gint) (((gchar*) slot - pool->memory) / pool->stride));
+      gnet_packet_pool_unref (pool);
+    }
+}
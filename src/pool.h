@@ -0,0 +1,63 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+
+#ifndef _GNET_POOL_H
+#define _GNET_POOL_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+/**
+ *  GPacketPool
+ *
+ *  A pool of equal-size packet buffers that are allocated once.
+ *  Getting a buffer from the pool and giving it back does not
+ *  allocate memory and does not take a lock, so a pool can be shared
+ *  by threads.  Buffers are reference counted and go back to the
+ *  pool when the last reference is dropped.  The implementation is
+ *  hidden.
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GPacketPool GPacketPool;
+
+
+GPacketPool* gnet_packet_pool_new (gint slot_size, gint n_slots);
+void	     gnet_packet_pool_ref (GPacketPool* pool);
+void	     gnet_packet_pool_unref (GPacketPool* pool);
+
+gint	     gnet_packet_pool_get_slot_size (const GPacketPool* pool);
+gint	     gnet_packet_pool_get_n_slots (const GPacketPool* pool);
+
+gchar*	     gnet_packet_pool_alloc (GPacketPool* pool);
+
+void	     gnet_packet_buffer_ref (gchar* buffer);
+void	     gnet_packet_buffer_unref (gchar* buffer);
+
+
+#ifdef __cplusplus
+}
+#endif				/* __cplusplus */
+
+#endif /* _GNET_POOL_H */
@@ -12,69 +12,160 @@
  * Library General Public License for more details.
  *
  * You should have received a copy of the GNU Library General Public
- * License along with this library; if not, write to the 
+ * License along with this library; if not, write to the
  * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
  * Boston, MA  02111-1307, USA.
  */
 
 
+#include "gnet-private.h"
+#include "timer-private.h"
 #include "scheduler.h"
-#include <sys/unistd.h>
-#include <math.h>
 
 
-static gboolean can_dispatch (Scheduler* scheduler);
-static void 	set_timer (Scheduler* scheduler);
-static gboolean scheduler_cb (gpointer data);
+#define USEC_PER_SEC		G_GINT64_CONSTANT (1000000)
 
+/* The bucket holds 1/SCHEDULER_BURST_DIV seconds of units and a
+   schedulee is called once there are 1/SCHEDULER_QUANTUM_DIV seconds
+   of units, so reads and writes are not cut into tiny pieces. */
+#define SCHEDULER_BURST_DIV	10
+#define SCHEDULER_QUANTUM_DIV	100
 
-typedef struct _Schedulee
-{
-  gpointer user_data;
-  SchedulerFunc func;
+/* Virtual time one unit costs a schedulee of weight 1 */
+#define SCHEDULER_FAIR_SCALE	256
 
-} Schedulee;
+/* Longest time the bucket is filled for at once */
+#define SCHEDULER_MAX_FILL	(10 * USEC_PER_SEC)
 
 
+static gint 	can_dispatch (Scheduler* scheduler);
+static void 	set_timer (Scheduler* scheduler);
+static void 	set_timer_now (Scheduler* scheduler);
+static void	kick (Scheduler* scheduler);
+static gint	dispatch (Scheduler* scheduler, gint max_units);
+static gboolean scheduler_cb (gpointer data);
+static gint	scheduler_child_cb (gpointer data, gint max_units);
+
 
-Scheduler* 
-scheduler_new (void)
+
+Scheduler*
+scheduler_new (GMainContext* context)
 {
   Scheduler* scheduler;
 
   scheduler = g_new0 (Scheduler, 1);
   scheduler->policy = SCHEDULER_POLICY_ROUND_ROBIN;
   scheduler->max_ups = SCHEDULER_UNLIMITED_UNITS;
+  scheduler->ref_count = 1;
+  if (context)
+    scheduler->context = g_main_context_ref (context);
+  scheduler_schedulee_init (&scheduler->child, scheduler_child_cb, scheduler);
 
   return scheduler;
 }
 
 
 void
-scheduler_delete (Scheduler* scheduler)
+scheduler_ref (Scheduler* scheduler)
 {
-  if (scheduler)
-    {
-      GList* i;
+  g_return_if_fail (scheduler);
 
-      for (i = scheduler->queue; i != NULL; i = i->next)
-	g_free (i->data);
-      g_list_free (scheduler->queue);
+  ++scheduler->ref_count;
+}
 
-      if (scheduler->timer)
-	g_source_remove (scheduler->timer);
 
-      g_free (scheduler);
-    }
+void
+scheduler_unref (Scheduler* scheduler)
+{
+  GList* i;
+
+  g_return_if_fail (scheduler);
+
+  if (--scheduler->ref_count > 0)
+    return;
+
+  scheduler_set_parent (scheduler, NULL);
+
+  for (i = scheduler->queue; i != NULL; i = i->next)
+    ((Schedulee*) i->data)->queued = FALSE;
+  g_list_free (scheduler->queue);
+
+  _gnet_timer_remove (scheduler->context, scheduler->timer);
+  if (scheduler->context)
+    g_main_context_unref (scheduler->context);
+
+  g_free (scheduler);
 }
 
 
 void
 scheduler_set_policy (Scheduler* scheduler, SchedulerPolicy policy)
 {
+  GList* i;
+
   g_return_if_fail (scheduler);
 
+  if (scheduler->policy == policy)
+    return;
+
+  /* Start over in turn; the queue was in the old policy's order */
   scheduler->policy = policy;
+  scheduler->vtime = 0;
+  for (i = scheduler->queue; i != NULL; i = i->next)
+    {
+      Schedulee* schedulee = (Schedulee*) i->data;
+
+      schedulee->start = 0;
+      schedulee->finish = 0;
+    }
+}
+
+
+static gint64
+scheduler_now (void)
+{
+  GTimeVal tv;
+
+  g_get_current_time (&tv);
+
+  return (gint64) tv.tv_sec * USEC_PER_SEC + tv.tv_usec;
+}
+
+
+static gint64
+scheduler_burst (Scheduler* scheduler)
+{
+  return MAX (scheduler->max_ups / SCHEDULER_BURST_DIV, 1) * USEC_PER_SEC;
+}
+
+
+static gint64
+scheduler_quantum (Scheduler* scheduler)
+{
+  return MAX (scheduler->max_ups / SCHEDULER_QUANTUM_DIV, 1) * USEC_PER_SEC;
+}
+
+
+/* Add the units earned since the bucket was last filled */
+static void
+fill (Scheduler* scheduler)
+{
+  gint64 now, elapsed;
+
+  if (scheduler->max_ups < 0)
+    return;
+
+  now = scheduler_now ();
+  elapsed = now - scheduler->last_fill;
+  scheduler->last_fill = now;
+
+  /* The clock went back */
+  if (elapsed < 0)
+    return;
+
+  elapsed = MIN (elapsed, SCHEDULER_MAX_FILL);
+  scheduler->tokens += elapsed * scheduler->max_ups;
+  scheduler->tokens = MIN (scheduler->tokens, scheduler_burst (scheduler));
 }
 
 
@@ -83,134 +174,270 @@ scheduler_set_max_ups (Scheduler* scheduler, gint max_units_per_second)
 {
   g_return_if_fail (scheduler);
 
-  scheduler->max_ups = max_units_per_second;
+  if (scheduler->max_ups == max_units_per_second)
+    return;
 
-  /* Dispatch all now if it's now below 0 */
-  if (max_units_per_second < 0)
+  /* Keep what was earned at the old rate; start with a full bucket
+     when there was no limit */
+  if (scheduler->max_ups < 0)
     {
-      GList* i;
+      scheduler->max_ups = max_units_per_second;
+      scheduler->tokens = scheduler_burst (scheduler);
+      scheduler->last_fill = scheduler_now ();
+    }
+  else
+    {
+      fill (scheduler);
+      scheduler->max_ups = max_units_per_second;
+      if (max_units_per_second >= 0)
+	scheduler->tokens = MIN (scheduler->tokens, scheduler_burst (scheduler));
+    }
 
-      for (i = scheduler->queue; i != NULL; i = i->next)
-	{
-	  Schedulee* schedulee = (Schedulee*) i->data;
-	  gint units;
-	  /* FIX: What if I try to remove myself? */
+  /* Recompute when the waiting schedulees can go */
+  if (scheduler->queue)
+    set_timer_now (scheduler);
+}
 
-	  units = (schedulee->func)(schedulee->user_data);
-	  if (units)
-	    scheduler->last_units = units;
 
-	  g_free (schedulee);
-	}
+void
+scheduler_set_parent (Scheduler* scheduler, Scheduler* parent)
+{
+  g_return_if_fail (scheduler);
+  g_return_if_fail (parent != scheduler);
 
-      if (scheduler->queue)
-	{
-	  gettimeofday(&scheduler->last_dispatch, NULL);
+  if (scheduler->parent == parent)
+    return;
 
-	  g_list_free (scheduler->queue);
-	  scheduler->queue = NULL;
-	}
+  if (scheduler->parent)
+    {
+      scheduler_remove (scheduler->parent, &scheduler->child);
+      scheduler_unref (scheduler->parent);
     }
 
-  /* Otherwise, reset the timer if there is one and we're waiting for
-     something */
-  else if (scheduler->timer)
-    {
-      g_return_if_fail (scheduler->queue);
+  scheduler->parent = parent;
 
-      g_source_remove (scheduler->timer);
-      set_timer (scheduler);
+  if (parent)
+    scheduler_ref (parent);
+
+  if (scheduler->queue)
+    set_timer_now (scheduler);
+}
+
+
+void
+scheduler_set_context (Scheduler* scheduler, GMainContext* context)
+{
+  g_return_if_fail (scheduler);
+
+  if (scheduler->context == context)
+    return;
+
+  if (scheduler->timer)
+    {
+      _gnet_timer_remove (scheduler->context, scheduler->timer);
+      scheduler->timer = 0;
     }
 
+  if (scheduler->context)
+    g_main_context_unref (scheduler->context);
+  scheduler->context = context ? g_main_context_ref (context) : NULL;
+
+  if (scheduler->queue)
+    set_timer_now (scheduler);
 }
 
 
+void
+scheduler_schedulee_init (Schedulee* schedulee,
+			  SchedulerFunc func, gpointer user_data)
+{
+  g_return_if_fail (schedulee);
+  g_return_if_fail (func);
+
+  memset (schedulee, 0, sizeof (*schedulee));
+  schedulee->func = func;
+  schedulee->user_data = user_data;
+  schedulee->weight = 1;
+}
+
+
+static gint
+compare_start (gconstpointer a, gconstpointer b)
+{
+  const Schedulee* sa = (const Schedulee*) a;
+  const Schedulee* sb = (const Schedulee*) b;
+
+  /* Equal start times go in turn */
+  return (sa->start < sb->start) ? -1 : 1;
+}
 
 
 void
-scheduler_add (Scheduler* scheduler, gpointer user_data, SchedulerFunc func, gint units)
+scheduler_add (Scheduler* scheduler, Schedulee* schedulee)
 {
   g_return_if_fail (scheduler);
-  g_return_if_fail (func);
+  g_return_if_fail (schedulee);
+  g_return_if_fail (schedulee->func);
+
+  if (schedulee->queued)
+    return;
+  schedulee->queued = TRUE;
 
-  /* Dispatch now if queue is empty and we can dispatch */
-  if (!scheduler->queue && can_dispatch (scheduler))
+  /* Queue in order of virtual start time.  A schedulee that has been
+     idle starts at the current virtual time, so it cannot save up
+     units. */
+  if (scheduler->policy == SCHEDULER_POLICY_WEIGHTED_FAIR)
     {
-      scheduler->last_units = (func)(user_data);
-      gettimeofday(&scheduler->last_dispatch, NULL);
+      schedulee->start = MAX (scheduler->vtime, schedulee->finish);
+      scheduler->queue = g_list_insert_sorted (scheduler->queue, schedulee,
+					       compare_start);
     }
-
-  /* Otherwise, add to the queue.  Make sure the timer is set. */
   else
-    {
-      Schedulee* schedulee;
+    scheduler->queue = g_list_append (scheduler->queue, schedulee);
+
+  /* Dispatch now if we can, otherwise make sure the timer is set */
+  kick (scheduler);
+}
 
-      schedulee = g_new (Schedulee, 1);
-      schedulee->user_data = user_data;
-      schedulee->func = func;
 
-      scheduler->queue = g_list_append (scheduler->queue, schedulee);
 
-      g_return_if_fail (scheduler->timer);
+void
+scheduler_remove (Scheduler* scheduler, Schedulee* schedulee)
+{
+  g_return_if_fail (scheduler);
+  g_return_if_fail (schedulee);
+
+  /* The schedulee may be going away while it is called */
+  if (scheduler->dispatching == schedulee)
+    scheduler->dispatching = NULL;
+
+  if (!schedulee->queued || !g_list_find (scheduler->queue, schedulee))
+    return;
+
+  scheduler->queue = g_list_remove (scheduler->queue, schedulee);
+  schedulee->queued = FALSE;
+  schedulee->start = 0;
+  schedulee->finish = 0;
+
+  /* Cancel timer and leave the parent if there's nothing left */
+  if (!scheduler->queue)
+    {
+      _gnet_timer_remove (scheduler->context, scheduler->timer);
+      scheduler->timer = 0;
+
+      if (scheduler->parent)
+	scheduler_remove (scheduler->parent, &scheduler->child);
     }
 }
 
 
+/* Returns the units that may be spent now, or 0 if the schedulees
+   must wait */
+static gint
+can_dispatch (Scheduler* scheduler)
+{
+  /* If bandwidth is unlimited, it can be dispatched. */
+  if (scheduler->max_ups < 0)
+    return G_MAXINT;
+
+  fill (scheduler);
+
+  if (scheduler->tokens < scheduler_quantum (scheduler))
+    return 0;
 
-void
-scheduler_remove (Scheduler* scheduler, gpointer user_data)
+  return (gint) MIN (scheduler->tokens / USEC_PER_SEC, G_MAXINT);
+}
+
+
+/* Dispatch the schedulees that can go and set the timer for the rest.
+   A scheduler with a parent waits in the parent's queue instead. */
+static void
+kick (Scheduler* scheduler)
 {
-  GList* i;
+  gint units;
 
-  g_return_if_fail (scheduler);
+  /* Schedulees added while dispatching go in the running loop */
+  if (scheduler->running || !scheduler->queue)
+    return;
 
-  /* Remove all schedulees */
-  for (i = scheduler->queue; i != NULL; )
+  if (!can_dispatch (scheduler))
     {
-      Schedulee* s = (Schedulee*) i->data;
-      GList* old_i = i;
-      i = i->next;
-
-      if (s->user_data == user_data)
-	{
-	  g_free (s);
-	  scheduler->queue = g_list_remove_link (scheduler->queue, old_i);
-	}
+      set_timer (scheduler);
+      return;
     }
 
-  /* Cancel timer if there's nothing left */
-  if (!scheduler->queue && scheduler->timer)
+  if (scheduler->parent)
     {
-      g_source_remove (scheduler->timer);
-      scheduler->timer = 0;
+      scheduler_add (scheduler->parent, &scheduler->child);
+      return;
     }
+
+  scheduler_ref (scheduler);
+  while (scheduler->queue && (units = can_dispatch (scheduler)) > 0)
+    dispatch (scheduler, units);
+
+  if (scheduler->queue)
+    set_timer (scheduler);
+  scheduler_unref (scheduler);
 }
 
 
-static gboolean
-can_dispatch (Scheduler* scheduler)
+/* Pop the next schedulee off the queue and call it with up to
+   @max_units.  Returns the units used. */
+static gint
+dispatch (Scheduler* scheduler, gint max_units)
 {
-  struct timeval timeofday, diff;
-  gdouble secs, ups;
+  Schedulee* schedulee;
+  gint units;
 
-  /* If we just dispatched something that was free, it can be dispatched */
-  if (scheduler->last_units == 0)
-    return TRUE;
+  schedulee = (Schedulee*) scheduler->queue->data;
+  scheduler->queue = g_list_delete_link (scheduler->queue, scheduler->queue);
+  schedulee->queued = FALSE;
 
-  /* If bandwidth is unlimited, it can be dispatched. */
-  if (scheduler->max_ups < 0)
-    return TRUE;
+  if (scheduler->policy == SCHEDULER_POLICY_WEIGHTED_FAIR)
+    scheduler->vtime = schedulee->start;
+
+  /* dispatching is cleared if the schedulee is removed meanwhile */
+  scheduler->dispatching = schedulee;
+  scheduler->running = TRUE;
+  units = (schedulee->func)(schedulee->user_data, max_units);
+  scheduler->running = FALSE;
+
+  if (scheduler->dispatching == schedulee)
+    {
+      if (scheduler->policy == SCHEDULER_POLICY_WEIGHTED_FAIR)
+	schedulee->finish = schedulee->start + (guint64) MAX (units, 0) *
+	  SCHEDULER_FAIR_SCALE / MAX (schedulee->weight, 1);
+    }
+  scheduler->dispatching = NULL;
+
+  if (scheduler->max_ups >= 0)
+    scheduler->tokens -= (gint64) MAX (units, 0) * USEC_PER_SEC;
+
+  return units;
+}
+
+
+/* Called by the parent when this scheduler's turn comes */
+static gint
+scheduler_child_cb (gpointer data, gint max_units)
+{
+  Scheduler* scheduler = (Scheduler*) data;
+  gint units = 0;
+  gint own;
 
-  gettimeofday(&timeofday, NULL);
+  scheduler_ref (scheduler);
 
-  timersub (&timeofday, &scheduler->last_dispatch, &diff);
-  secs = (gdouble) diff.tv_sec + (((gdouble) diff.tv_usec) / 1000000.0);
-  ups = secs / (gdouble) scheduler->last_units;
+  own = can_dispatch (scheduler);
+  if (own > 0 && scheduler->queue)
+    units = dispatch (scheduler, MIN (own, max_units));
 
-  if (ups > scheduler->max_ups)
-    return FALSE;
+  /* Wait in the parent's queue again, or for the bucket to fill */
+  kick (scheduler);
 
-  return TRUE;
+  scheduler_unref (scheduler);
+
+  return units;
 }
 
 
@@ -218,28 +445,34 @@ can_dispatch (Scheduler* scheduler)
 static void
 set_timer (Scheduler* scheduler)
 {
-  gdouble offset;
-  struct timeval timeofday, diff;
-  gint ms;
+  gint64 needed;
+  guint ms;
 
   g_return_if_fail (scheduler);
 
   if (scheduler->max_ups <= 0 || scheduler->timer)
     return;
 
-  offset = ((gdouble) scheduler->last_units) / ((gdouble) scheduler->max_ups);
-  diff.tv_sec = (gint) offset;
-  diff.tv_usec = (offset - floor(offset)) * 1000000.0;
+  /* Wait until the bucket holds a quantum */
+  needed = scheduler_quantum (scheduler) - scheduler->tokens;
+  needed = (needed + scheduler->max_ups - 1) / scheduler->max_ups;
+  ms = (guint) MAX ((needed + 999) / 1000, 1);
 
-  gettimeofday(&timeofday, NULL);
+  scheduler->timer = _gnet_timer_add (scheduler->context, ms,
+				      scheduler_cb, scheduler);
+}
 
-  timeradd (&scheduler->last_dispatch, &diff, &diff);
-  timersub (&diff, &timeofday, &diff);
 
-  ms = (diff.tv_sec * 1000) + (diff.tv_usec / 1000);
-  g_return_if_fail (ms >= 0);
+/* Dispatch from the main loop rather than from the caller */
+static void
+set_timer_now (Scheduler* scheduler)
+{
+  if (scheduler->timer &&
+      _gnet_timer_reset (scheduler->context, scheduler->timer, 0))
+    return;
 
-  scheduler->timer = g_timeout_add (ms, scheduler_cb, scheduler);
+  scheduler->timer = _gnet_timer_add (scheduler->context, 0,
+				      scheduler_cb, scheduler);
 }
 
 
@@ -252,34 +485,7 @@ scheduler_cb (gpointer data)
   g_return_val_if_fail (scheduler, FALSE);
 
   scheduler->timer = 0;
-
-  if (scheduler->queue)
-    {
-      Schedulee* schedulee;
-
-    again:
-      /* Pop off next schedulee */
-      schedulee = (Schedulee*) scheduler->queue->data;
-      scheduler->queue = g_list_remove_link (scheduler->queue, scheduler->queue);
-
-      /* Dispatch */
-      scheduler->last_units = (schedulee->func)(schedulee->user_data);
-      g_free (schedulee);
-
-      /* Do again if it didn't cost anything */
-      if (!scheduler->last_units && scheduler->queue)
-	goto again;
-
-      gettimeofday(&scheduler->last_dispatch, NULL);
-
-      /* Schedule next dispatch */
-      if (scheduler->queue)
-	{
-	  g_return_val_if_fail (scheduler->last_units, FALSE);
-	  set_timer (scheduler);
-	}
-    }
+  kick (scheduler);
 
   return FALSE;
 }
-
@@ -12,31 +12,40 @@
  * Library General Public License for more details.
  *
  * You should have received a copy of the GNU Library General Public
- * License along with this library; if not, write to the 
+ * License along with this library; if not, write to the
  * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
  * Boston, MA  02111-1307, USA.
  */
 
-/* 
+/*
 
    The scheduler manages schedulees.  A schedulee is a function and
    executing that function has some unit cost.  The scheduler assures
    that all schedulees get executed and the units spent doesn't exceed
    some maximum rate.  The intent is to use this to limit bandwidth.
    The schedulee functions are reads or writes and cost is bytes
-   writen.  
+   writen.
 
-   This works the last time I checked, but I haven't integrated and
-   documented it.  The problem is whether it should be integrated with
-   iochannel, etc, which might be tricky.  It might make more sense to
-   subclass Iochannel and add a subiochannel_set_scheduler.  But, I'm
-   not sure if this is possible.  
+   The rate is kept with a token bucket.  The bucket fills at
+   max_ups units per second, measured in microseconds, and holds a
+   tenth of a second worth of units.  A schedulee is called when the
+   bucket holds at least a quantum (a hundredth of a second worth of
+   units, or the whole bucket if that is less) and is told how many
+   units it may spend.
 
-   It's tricky to get this working with asynchronous IO functions.  If
-   you can write to an IOChannel, then you hand the IOChannel to the
-   scheduler which will perform the read at the appropriate time.
-   This is fine, but can we integrate it with gnet_iochannel and
-   conn/server?
+   A scheduler may have a parent.  It then waits in the parent's
+   queue like a schedulee and its schedulees may spend no more than
+   either bucket allows.  GConn uses this for a per-connection limit
+   inside a limit shared by a group of connections.
+
+   Waiting schedulees are called in turn (SCHEDULER_POLICY_ROUND_ROBIN)
+   or by start-time fair queueing (SCHEDULER_POLICY_WEIGHTED_FAIR),
+   which shares the units between them in proportion to their weights
+   whatever their costs.
+
+   A scheduler's timer runs in its GMainContext, so a scheduler and
+   its schedulees must only be used from the thread running that
+   context.
 
 */
 
@@ -45,8 +54,6 @@
 #define _SCHEDULER_H
 
 #include <glib.h>
-#include <sys/types.h>
-#include <sys/time.h>
 
 
 #ifdef __cplusplus
@@ -56,7 +63,8 @@ extern "C" {
 
 typedef enum
 {
-  SCHEDULER_POLICY_ROUND_ROBIN
+  SCHEDULER_POLICY_ROUND_ROBIN,
+  SCHEDULER_POLICY_WEIGHTED_FAIR
 
 } SchedulerPolicy;
 
@@ -64,7 +72,29 @@ typedef enum
 #define SCHEDULER_UNLIMITED_UNITS	-1
 
 
-typedef struct _Scheduler
+/* Called with the units that may be spent, at least 1.  Returns units
+   used, or 0 if the schedulee could not do anything.  Either way the
+   schedulee is no longer queued; it calls scheduler_add() again when
+   it has more to do.  */
+typedef gint (*SchedulerFunc)(gpointer user_data, gint max_units);
+
+
+typedef struct _Schedulee
+{
+  SchedulerFunc		func;
+  gpointer		user_data;
+  guint			weight;
+
+  /* Private */
+  gboolean		queued;
+  guint64		start;		/* virtual start time */
+  guint64		finish;		/* virtual finish time */
+
+} Schedulee;
+
+
+typedef struct _Scheduler Scheduler;
+struct _Scheduler
 {
   SchedulerPolicy	policy;
   gint 			max_ups;
@@ -72,23 +102,35 @@ typedef struct _Scheduler
   GList* 		queue;
 
   guint			timer;
+  GMainContext*		context;
+
+  gint64		tokens;		/* units * 1000000 */
+  gint64		last_fill;	/* microseconds */
 
-  gint			last_units;
-  struct timeval	last_dispatch;
+  guint64		vtime;		/* virtual time (fair queueing) */
+  Schedulee*		dispatching;	/* schedulee being called, or NULL */
+  gboolean		running;	/* a schedulee is being called */
 
-} Scheduler;
+  Scheduler*		parent;
+  Schedulee		child;		/* this scheduler in parent's queue */
 
-typedef gint (*SchedulerFunc)(gpointer user_data);	/* Returns units used */
+  guint			ref_count;
+};
 
 
-Scheduler*  scheduler_new (void);
-void	    scheduler_delete (Scheduler* scheduler);
+Scheduler*  scheduler_new (GMainContext* context);
+void	    scheduler_ref (Scheduler* scheduler);
+void	    scheduler_unref (Scheduler* scheduler);
 
 void	    scheduler_set_policy (Scheduler* scheduler, SchedulerPolicy policy);
 void	    scheduler_set_max_ups (Scheduler* scheduler, gint max_units_per_second);
+void	    scheduler_set_parent (Scheduler* scheduler, Scheduler* parent);
+void	    scheduler_set_context (Scheduler* scheduler, GMainContext* context);
 
-void	    scheduler_add (Scheduler* scheduler, gpointer user_data, SchedulerFunc func, gint units);
-void	    scheduler_remove (Scheduler* scheduler, gpointer user_data);
+void	    scheduler_schedulee_init (Schedulee* schedulee,
+				      SchedulerFunc func, gpointer user_data);
+void	    scheduler_add (Scheduler* scheduler, Schedulee* schedulee);
+void	    scheduler_remove (Scheduler* scheduler, Schedulee* schedulee);
 
 
 
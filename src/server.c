@@ -127,6 +127,29 @@ gnet_server_unref (GServer* server)
 
 
 
+/**
+ *  gnet_server_set_accept_option
+ *  @server: a #GServer
+ *  @option: option to set
+ *  @value: value of the option
+ *
+ *  Sets a socket option that is applied to the socket of every
+ *  connection accepted by @server from now on, before the #GConn is
+ *  passed to the #GServerFunc.  See
+ *  gnet_tcp_socket_server_set_accept_option().
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_server_set_accept_option (GServer* server, GNetSocketOption option,
+			       gint value)
+{
+  g_return_if_fail (server);
+
+  gnet_tcp_socket_server_set_accept_option (server->socket, option, value);
+}
+
+
 static void
 server_accept_cb (GTcpSocket* server_socket, GTcpSocket* client, gpointer data)
 {
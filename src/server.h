@@ -94,6 +94,10 @@ void      gnet_server_delete (GServer* server);
 void	  gnet_server_ref (GServer* server);
 void	  gnet_server_unref (GServer* server);
 
+void	  gnet_server_set_accept_option (GServer* server,
+					 GNetSocketOption option,
+					 gint value);
+
 
 #ifdef __cplusplus
 }
@@ -35,14 +35,22 @@ typedef struct _GSHA GSHA;
 
 
 GSHA*    gnet_sha_new (const gchar* buffer, guint length);
+GSHA*    gnet_sha_new_large (const gchar* buffer, gsize length);
+GSHA*    gnet_sha_new_file (const gchar* filename);
+GSHA*    gnet_sha_new_fd (gint fd);
 GSHA*	 gnet_sha_new_string (const gchar* str);
 GSHA*    gnet_sha_clone (const GSHA* sha);
 void     gnet_sha_delete (GSHA* sha);
 	
 GSHA*	 gnet_sha_new_incremental (void);
 void	 gnet_sha_update (GSHA* sha, const gchar* buffer, guint length);
+void	 gnet_sha_update_large (GSHA* sha, const gchar* buffer, gsize length);
 void	 gnet_sha_final (GSHA* sha);
 
+void     gnet_sha_digest_batch (const gchar* const* buffers,
+				const gsize* lengths, guint n,
+				gchar* digests);
+
 gboolean gnet_sha_equal (gconstpointer p1, gconstpointer p2);
 guint	 gnet_sha_hash (gconstpointer p);
 	
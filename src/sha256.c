@@ -0,0 +1,563 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#include "gnet-private.h"
+#include "sha256.h"
+#include "hash-private.h"
+
+#include <string.h>
+
+
+/* SHA-256 (FIPS 180-4) */
+
+#define SHA256_BLOCK	64
+
+typedef struct _SHA256Context
+{
+  guint32	state[8];
+  guint64	count;			/* bytes hashed */
+  guint8	buffer[SHA256_BLOCK];	/* partial block */
+
+} SHA256Context;
+
+/* Hashes @n_blocks whole blocks of @data into @state */
+typedef void (*SHA256BlocksFunc) (guint32* state, const guint8* data,
+				  gsize n_blocks);
+
+static const guint32 sha256_k[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const guint32 sha256_iv[8] =
+{
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+
+#define ROTR32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+#define CH(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define BSIG0(x)	(ROTR32 (x, 2) ^ ROTR32 (x, 13) ^ ROTR32 (x, 22))
+#define BSIG1(x)	(ROTR32 (x, 6) ^ ROTR32 (x, 11) ^ ROTR32 (x, 25))
+#define SSIG0(x)	(ROTR32 (x, 7) ^ ROTR32 (x, 18) ^ ((x) >> 3))
+#define SSIG1(x)	(ROTR32 (x, 17) ^ ROTR32 (x, 19) ^ ((x) >> 10))
+
+/* One round.  Instead of moving the eight working variables along,
+   the caller renames them, eight rounds at a time. */
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, i)				\
+  G_STMT_START {							\
+    guint32 t1 = h + BSIG1 (e) + CH (e, f, g) + sha256_k[i] + w[i];	\
+    d += t1;								\
+    h = t1 + BSIG0 (a) + MAJ (a, b, c);					\
+  } G_STMT_END
+
+
+static void
+sha256_blocks (guint32* state, const guint8* data, gsize n_blocks)
+{
+  for (; n_blocks > 0; --n_blocks, data += SHA256_BLOCK)
+    {
+      guint32 w[64];
+      guint32 a, b, c, d, e, f, g, h;
+      guint i;
+
+      for (i = 0; i < 16; ++i)
+	{
+	  memcpy (&w[i], data + 4 * i, 4);
+	  w[i] = GUINT32_FROM_BE (w[i]);
+	}
+      for (i = 16; i < 64; ++i)
+	w[i] = SSIG1 (w[i - 2]) + w[i - 7] + SSIG0 (w[i - 15]) + w[i - 16];
+
+      a = state[0];
+      b = state[1];
+      c = state[2];
+      d = state[3];
+      e = state[4];
+      f = state[5];
+      g = state[6];
+      h = state[7];
+
+      for (i = 0; i < 64; i += 8)
+	{
+	  SHA256_ROUND (a, b, c, d, e, f, g, h, i);
+	  SHA256_ROUND (h, a, b, c, d, e, f, g, i + 1);
+	  SHA256_ROUND (g, h, a, b, c, d, e, f, i + 2);
+	  SHA256_ROUND (f, g, h, a, b, c, d, e, i + 3);
+	  SHA256_ROUND (e, f, g, h, a, b, c, d, i + 4);
+	  SHA256_ROUND (d, e, f, g, h, a, b, c, i + 5);
+	  SHA256_ROUND (c, d, e, f, g, h, a, b, i + 6);
+	  SHA256_ROUND (b, c, d, e, f, g, h, a, i + 7);
+	}
+
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+    }
+}
+
+
+#ifdef HAVE_X86_SHA
+
+/* SHA-256 with the x86 SHA extensions.  The state is kept as ABEF and
+   CDGH, as sha256rnds2 wants it.  Each sha256rnds2 does two rounds on
+   the two low words of its message operand, so four rounds take two.
+   The message schedule is computed up front with sha256msg1 and
+   sha256msg2. */
+
+#include <immintrin.h>
+#include "cpu-private.h"
+
+__attribute__ ((target ("sha,sse4.1")))
+static void
+sha256_blocks_ni (guint32* state, const guint8* data, gsize n_blocks)
+{
+  const __m128i bswap = _mm_set_epi64x (G_GINT64_CONSTANT (0x0c0d0e0f08090a0b),
+					G_GINT64_CONSTANT (0x0405060700010203));
+  __m128i abef, cdgh, tmp;
+
+  /* DCBA, HGFE to ABEF, CDGH */
+  tmp = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i*) state), 0xB1);
+  cdgh = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i*) (state + 4)), 0x1B);
+  abef = _mm_alignr_epi8 (tmp, cdgh, 8);
+  cdgh = _mm_blend_epi16 (cdgh, tmp, 0xF0);
+
+  for (; n_blocks > 0; --n_blocks, data += SHA256_BLOCK)
+    {
+      __m128i abef_save = abef;
+      __m128i cdgh_save = cdgh;
+      __m128i w[16];
+      guint i;
+
+      for (i = 0; i < 4; ++i)
+	w[i] = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i*) (data + 16 * i)),
+				 bswap);
+      for (i = 4; i < 16; ++i)
+	w[i] = _mm_sha256msg2_epu32
+	  (_mm_add_epi32 (_mm_sha256msg1_epu32 (w[i - 4], w[i - 3]),
+			  _mm_alignr_epi8 (w[i - 1], w[i - 2], 4)),
+	   w[i - 1]);
+
+      for (i = 0; i < 16; ++i)
+	{
+	  __m128i msg;
+
+	  msg = _mm_add_epi32 (w[i], _mm_loadu_si128 ((const __m128i*) (sha256_k + 4 * i)));
+	  cdgh = _mm_sha256rnds2_epu32 (cdgh, abef, msg);
+	  abef = _mm_sha256rnds2_epu32 (abef, cdgh, _mm_shuffle_epi32 (msg, 0x0E));
+	}
+
+      abef = _mm_add_epi32 (abef, abef_save);
+      cdgh = _mm_add_epi32 (cdgh, cdgh_save);
+    }
+
+  /* ABEF, CDGH back to DCBA, HGFE */
+  tmp = _mm_shuffle_epi32 (abef, 0x1B);
+  cdgh = _mm_shuffle_epi32 (cdgh, 0xB1);
+  _mm_storeu_si128 ((__m128i*) state, _mm_blend_epi16 (tmp, cdgh, 0xF0));
+  _mm_storeu_si128 ((__m128i*) (state + 4), _mm_alignr_epi8 (cdgh, tmp, 8));
+}
+
+#endif /* HAVE_X86_SHA */
+
+
+/* Picks the fastest block function the CPU has */
+static SHA256BlocksFunc
+sha256_get_blocks (void)
+{
+#ifdef HAVE_X86_SHA
+  if (_gnet_cpu_get_features () & GNET_CPU_SHA)
+    return sha256_blocks_ni;
+#endif
+
+  return sha256_blocks;
+}
+
+
+static void
+sha256_init (SHA256Context* ctx)
+{
+  memcpy (ctx->state, sha256_iv, sizeof (ctx->state));
+  ctx->count = 0;
+}
+
+
+static void
+sha256_update (SHA256Context* ctx, const guint8* data, gsize length)
+{
+  SHA256BlocksFunc blocks = sha256_get_blocks ();
+  gsize used = ctx->count % SHA256_BLOCK;
+
+  ctx->count += length;
+
+  /* Fill the partial block first */
+  if (used)
+    {
+      gsize n = MIN (length, SHA256_BLOCK - used);
+
+      memcpy (ctx->buffer + used, data, n);
+      data += n;
+      length -= n;
+      if (used + n < SHA256_BLOCK)
+	return;
+      blocks (ctx->state, ctx->buffer, 1);
+    }
+
+  /* Whole blocks are hashed in place */
+  if (length >= SHA256_BLOCK)
+    {
+      blocks (ctx->state, data, length / SHA256_BLOCK);
+      data += length & ~(gsize) (SHA256_BLOCK - 1);
+      length %= SHA256_BLOCK;
+    }
+
+  memcpy (ctx->buffer, data, length);
+}
+
+
+/* Pads to 56 bytes modulo 64 with 0x80 and zeros, appends the length
+   in bits, big-endian, and writes the state big-endian to @digest */
+static void
+sha256_final (SHA256Context* ctx, guint8* digest)
+{
+  SHA256BlocksFunc blocks = sha256_get_blocks ();
+  gsize used = ctx->count % SHA256_BLOCK;
+  guint64 bits = GUINT64_TO_BE (ctx->count << 3);
+  guint i;
+
+  ctx->buffer[used++] = 0x80;
+  if (used > SHA256_BLOCK - 8)
+    {
+      memset (ctx->buffer + used, 0, SHA256_BLOCK - used);
+      blocks (ctx->state, ctx->buffer, 1);
+      used = 0;
+    }
+  memset (ctx->buffer + used, 0, SHA256_BLOCK - 8 - used);
+  memcpy (ctx->buffer + SHA256_BLOCK - 8, &bits, 8);
+  blocks (ctx->state, ctx->buffer, 1);
+
+  for (i = 0; i < 8; ++i)
+    {
+      guint32 word = GUINT32_TO_BE (ctx->state[i]);
+
+      memcpy (digest + 4 * i, &word, 4);
+    }
+}
+
+
+/* ************************************************************ */
+
+struct _GSHA256
+{
+  SHA256Context	ctx;
+  guint8	digest[GNET_SHA256_HASH_LENGTH];
+};
+
+
+/**
+ *  gnet_sha256_new:
+ *  @buffer: buffer to hash
+ *  @length: length of @buffer
+ *
+ *  Creates a #GSHA256 from @buffer.
+ *
+ *  Returns: a new #GSHA256.
+ *
+ *  Since: 2.0.9
+ **/
+GSHA256*
+gnet_sha256_new (const gchar* buffer, gsize length)
+{
+  GSHA256* sha256;
+
+  sha256 = g_new0 (GSHA256, 1);
+  sha256_init (&sha256->ctx);
+  sha256_update (&sha256->ctx, (const guint8*) buffer, length);
+  sha256_final (&sha256->ctx, sha256->digest);
+
+  return sha256;
+}
+
+
+/**
+ *  gnet_sha256_new_string:
+ *  @str: hexadecimal string
+ *
+ *  Creates a #GSHA256 from @str.  @str is a hexadecimal string
+ *  representing the digest.
+ *
+ *  Returns: a new #GSHA256.
+ *
+ *  Since: 2.0.9
+ **/
+GSHA256*
+gnet_sha256_new_string (const gchar* str)
+{
+  GSHA256* sha256;
+
+  g_return_val_if_fail (str, NULL);
+  g_return_val_if_fail (strlen (str) >= GNET_SHA256_HASH_LENGTH * 2, NULL);
+
+  sha256 = g_new0 (GSHA256, 1);
+  if (!_gnet_hash_digest_from_string (str, sha256->digest, GNET_SHA256_HASH_LENGTH))
+    {
+      g_free (sha256);
+      g_return_val_if_fail (FALSE, NULL);
+    }
+
+  return sha256;
+}
+
+
+/**
+ *  gnet_sha256_clone:
+ *  @sha256: a #GSHA256
+ *
+ *  Copies a #GSHA256.
+ *
+ *  Returns: a copy of @sha256.
+ *
+ *  Since: 2.0.9
+ **/
+GSHA256*
+gnet_sha256_clone (const GSHA256* sha256)
+{
+  g_return_val_if_fail (sha256, NULL);
+
+  return g_memdup (sha256, sizeof (GSHA256));
+}
+
+
+/**
+ *  gnet_sha256_delete:
+ *  @sha256: a #GSHA256
+ *
+ *  Deletes a #GSHA256.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_sha256_delete (GSHA256* sha256)
+{
+  g_free (sha256);
+}
+
+
+/**
+ *  gnet_sha256_new_incremental:
+ *
+ *  Creates a #GSHA256 incrementally.  After creating a #GSHA256, call
+ *  gnet_sha256_update() one or more times to hash data.  Finally, call
+ *  gnet_sha256_final() to compute the final hash value.
+ *
+ *  Returns: a new #GSHA256.
+ *
+ *  Since: 2.0.9
+ **/
+GSHA256*
+gnet_sha256_new_incremental (void)
+{
+  GSHA256* sha256;
+
+  sha256 = g_new0 (GSHA256, 1);
+  sha256_init (&sha256->ctx);
+
+  return sha256;
+}
+
+
+/**
+ *  gnet_sha256_update:
+ *  @sha256: a #GSHA256
+ *  @buffer: buffer to add
+ *  @length: length of @buffer
+ *
+ *  Updates the hash with @buffer.  This may be called several times
+ *  on a hash created by gnet_sha256_new_incremental() before being
+ *  finalized by calling gnet_sha256_final().
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_sha256_update (GSHA256* sha256, const gchar* buffer, gsize length)
+{
+  g_return_if_fail (sha256);
+
+  sha256_update (&sha256->ctx, (const guint8*) buffer, length);
+}
+
+
+/**
+ *  gnet_sha256_final:
+ *  @sha256: a #GSHA256
+ *
+ *  Calculates the final hash value of a #GSHA256.  This should only be
+ *  called on a #GSHA256 created by gnet_sha256_new_incremental().
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_sha256_final (GSHA256* sha256)
+{
+  g_return_if_fail (sha256);
+
+  sha256_final (&sha256->ctx, sha256->digest);
+}
+
+
+/**
+ *  gnet_sha256_equal:
+ *  @p1: a #GSHA256
+ *  @p2: another #GSHA256
+ *
+ *  Compares two #GSHA256's for equality.
+ *
+ *  Returns: TRUE if they are equal; FALSE otherwise.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_sha256_equal (gconstpointer p1, gconstpointer p2)
+{
+  const GSHA256* sha256a = (const GSHA256*) p1;
+  const GSHA256* sha256b = (const GSHA256*) p2;
+
+  return memcmp (sha256a->digest, sha256b->digest, GNET_SHA256_HASH_LENGTH) == 0;
+}
+
+
+/**
+ *  gnet_sha256_hash:
+ *  @p: a #GSHA256
+ *
+ *  Creates a hash code for a #GSHA256 for use with GHashTable.  This
+ *  hash value is not the same as the SHA-256 digest.
+ *
+ *  Returns: the hash code for @p.
+ *
+ *  Since: 2.0.9
+ **/
+guint
+gnet_sha256_hash (gconstpointer p)
+{
+  const GSHA256* sha256 = (const GSHA256*) p;
+  guint32 word;
+  guint hash = 0;
+  guint i;
+
+  g_return_val_if_fail (sha256, 0);
+
+  for (i = 0; i < GNET_SHA256_HASH_LENGTH; i += 4)
+    {
+      memcpy (&word, sha256->digest + i, 4);
+      hash ^= word;
+    }
+
+  return hash;
+}
+
+
+/**
+ *  gnet_sha256_get_digest:
+ *  @sha256: a #GSHA256
+ *
+ *  Gets the raw SHA-256 digest.
+ *
+ *  Returns: a callee-owned buffer containing the SHA-256 hash digest.
+ *  The buffer is %GNET_SHA256_HASH_LENGTH bytes long.
+ *
+ *  Since: 2.0.9
+ **/
+gchar*
+gnet_sha256_get_digest (const GSHA256* sha256)
+{
+  g_return_val_if_fail (sha256, NULL);
+
+  return (gchar*) sha256->digest;
+}
+
+
+/**
+ *  gnet_sha256_get_string:
+ *  @sha256: a #GSHA256
+ *
+ *  Gets the digest represented as a human-readable string.
+ *
+ *  Returns: a hexadecimal string representing the digest.  The string
+ *  is 2 * %GNET_SHA256_HASH_LENGTH bytes long and NULL terminated.  The
+ *  string is caller owned.
+ *
+ *  Since: 2.0.9
+ **/
+gchar*
+gnet_sha256_get_string (const GSHA256* sha256)
+{
+  gchar* str;
+
+  g_return_val_if_fail (sha256, NULL);
+
+  str = g_new (gchar, GNET_SHA256_HASH_LENGTH * 2 + 1);
+  _gnet_hash_digest_to_string (sha256->digest, GNET_SHA256_HASH_LENGTH, str);
+  str[GNET_SHA256_HASH_LENGTH * 2] = '\0';
+
+  return str;
+}
+
+
+/**
+ *  gnet_sha256_copy_string:
+ *  @sha256: a #GSHA256
+ *  @buffer: buffer at least 2 * %GNET_SHA256_HASH_LENGTH bytes long
+ *
+ *  Copies the digest, represented as a string, into @buffer.  The
+ *  string is not NULL terminated.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_sha256_copy_string (const GSHA256* sha256, gchar* buffer)
+{
+  g_return_if_fail (sha256);
+  g_return_if_fail (buffer);
+
+  _gnet_hash_digest_to_string (sha256->digest, GNET_SHA256_HASH_LENGTH, buffer);
+}
@@ -0,0 +1,72 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+
+#ifndef _GNET_SHA256_H
+#define _GNET_SHA256_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ *  GSHA256
+ *
+ *  GSHA256 is a SHA-256 hash (FIPS 180-4).  Where the CPU has the
+ *  x86 SHA extensions, they are used.
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GSHA256 GSHA256;
+
+/**
+ *  GNET_SHA256_HASH_LENGTH
+ *
+ *  Length of the SHA-256 hash in bytes.
+ *
+ *  Since: 2.0.9
+ **/
+#define GNET_SHA256_HASH_LENGTH	32
+
+
+GSHA256* gnet_sha256_new (const gchar* buffer, gsize length);
+GSHA256* gnet_sha256_new_string (const gchar* str);
+GSHA256* gnet_sha256_clone (const GSHA256* sha256);
+void     gnet_sha256_delete (GSHA256* sha256);
+
+GSHA256* gnet_sha256_new_incremental (void);
+void     gnet_sha256_update (GSHA256* sha256, const gchar* buffer, gsize length);
+void     gnet_sha256_final (GSHA256* sha256);
+
+gboolean gnet_sha256_equal (gconstpointer p1, gconstpointer p2);
+guint    gnet_sha256_hash (gconstpointer p);
+
+gchar*   gnet_sha256_get_digest (const GSHA256* sha256);
+gchar*   gnet_sha256_get_string (const GSHA256* sha256);
+
+void     gnet_sha256_copy_string (const GSHA256* sha256, gchar* buffer);
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _GNET_SHA256_H */
@@ -0,0 +1,511 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#include "gnet-private.h"
+#include "sha512.h"
+#include "hash-private.h"
+
+#include <string.h>
+
+
+/* SHA-512 (FIPS 180-4).  There is no vector version: the x86 SHA
+   extensions do not cover SHA-512, and with 64-bit words the scalar
+   rounds already keep a 64-bit CPU busy. */
+
+#define SHA512_BLOCK	128
+
+typedef struct _SHA512Context
+{
+  guint64	state[8];
+  guint64	count;			/* bytes hashed */
+  guint8	buffer[SHA512_BLOCK];	/* partial block */
+
+} SHA512Context;
+
+static const guint64 sha512_k[80] =
+{
+  G_GUINT64_CONSTANT (0x428a2f98d728ae22), G_GUINT64_CONSTANT (0x7137449123ef65cd),
+  G_GUINT64_CONSTANT (0xb5c0fbcfec4d3b2f), G_GUINT64_CONSTANT (0xe9b5dba58189dbbc),
+  G_GUINT64_CONSTANT (0x3956c25bf348b538), G_GUINT64_CONSTANT (0x59f111f1b605d019),
+  G_GUINT64_CONSTANT (0x923f82a4af194f9b), G_GUINT64_CONSTANT (0xab1c5ed5da6d8118),
+  G_GUINT64_CONSTANT (0xd807aa98a3030242), G_GUINT64_CONSTANT (0x12835b0145706fbe),
+  G_GUINT64_CONSTANT (0x243185be4ee4b28c), G_GUINT64_CONSTANT (0x550c7dc3d5ffb4e2),
+  G_GUINT64_CONSTANT (0x72be5d74f27b896f), G_GUINT64_CONSTANT (0x80deb1fe3b1696b1),
+  G_GUINT64_CONSTANT (0x9bdc06a725c71235), G_GUINT64_CONSTANT (0xc19bf174cf692694),
+  G_GUINT64_CONSTANT (0xe49b69c19ef14ad2), G_GUINT64_CONSTANT (0xefbe4786384f25e3),
+  G_GUINT64_CONSTANT (0x0fc19dc68b8cd5b5), G_GUINT64_CONSTANT (0x240ca1cc77ac9c65),
+  G_GUINT64_CONSTANT (0x2de92c6f592b0275), G_GUINT64_CONSTANT (0x4a7484aa6ea6e483),
+  G_GUINT64_CONSTANT (0x5cb0a9dcbd41fbd4), G_GUINT64_CONSTANT (0x76f988da831153b5),
+  G_GUINT64_CONSTANT (0x983e5152ee66dfab), G_GUINT64_CONSTANT (0xa831c66d2db43210),
+  G_GUINT64_CONSTANT (0xb00327c898fb213f), G_GUINT64_CONSTANT (0xbf597fc7beef0ee4),
+  G_GUINT64_CONSTANT (0xc6e00bf33da88fc2), G_GUINT64_CONSTANT (0xd5a79147930aa725),
+  G_GUINT64_CONSTANT (0x06ca6351e003826f), G_GUINT64_CONSTANT (0x142929670a0e6e70),
+  G_GUINT64_CONSTANT (0x27b70a8546d22ffc), G_GUINT64_CONSTANT (0x2e1b21385c26c926),
+  G_GUINT64_CONSTANT (0x4d2c6dfc5ac42aed), G_GUINT64_CONSTANT (0x53380d139d95b3df),
+  G_GUINT64_CONSTANT (0x650a73548baf63de), G_GUINT64_CONSTANT (0x766a0abb3c77b2a8),
+  G_GUINT64_CONSTANT (0x81c2c92e47edaee6), G_GUINT64_CONSTANT (0x92722c851482353b),
+  G_GUINT64_CONSTANT (0xa2bfe8a14cf10364), G_GUINT64_CONSTANT (0xa81a664bbc423001),
+  G_GUINT64_CONSTANT (0xc24b8b70d0f89791), G_GUINT64_CONSTANT (0xc76c51a30654be30),
+  G_GUINT64_CONSTANT (0xd192e819d6ef5218), G_GUINT64_CONSTANT (0xd69906245565a910),
+  G_GUINT64_CONSTANT (0xf40e35855771202a), G_GUINT64_CONSTANT (0x106aa07032bbd1b8),
+  G_GUINT64_CONSTANT (0x19a4c116b8d2d0c8), G_GUINT64_CONSTANT (0x1e376c085141ab53),
+  G_GUINT64_CONSTANT (0x2748774cdf8eeb99), G_GUINT64_CONSTANT (0x34b0bcb5e19b48a8),
+  G_GUINT64_CONSTANT (0x391c0cb3c5c95a63), G_GUINT64_CONSTANT (0x4ed8aa4ae3418acb),
+  G_GUINT64_CONSTANT (0x5b9cca4f7763e373), G_GUINT64_CONSTANT (0x682e6ff3d6b2b8a3),
+  G_GUINT64_CONSTANT (0x748f82ee5defb2fc), G_GUINT64_CONSTANT (0x78a5636f43172f60),
+  G_GUINT64_CONSTANT (0x84c87814a1f0ab72), G_GUINT64_CONSTANT (0x8cc702081a6439ec),
+  G_GUINT64_CONSTANT (0x90befffa23631e28), G_GUINT64_CONSTANT (0xa4506cebde82bde9),
+  G_GUINT64_CONSTANT (0xbef9a3f7b2c67915), G_GUINT64_CONSTANT (0xc67178f2e372532b),
+  G_GUINT64_CONSTANT (0xca273eceea26619c), G_GUINT64_CONSTANT (0xd186b8c721c0c207),
+  G_GUINT64_CONSTANT (0xeada7dd6cde0eb1e), G_GUINT64_CONSTANT (0xf57d4f7fee6ed178),
+  G_GUINT64_CONSTANT (0x06f067aa72176fba), G_GUINT64_CONSTANT (0x0a637dc5a2c898a6),
+  G_GUINT64_CONSTANT (0x113f9804bef90dae), G_GUINT64_CONSTANT (0x1b710b35131c471b),
+  G_GUINT64_CONSTANT (0x28db77f523047d84), G_GUINT64_CONSTANT (0x32caab7b40c72493),
+  G_GUINT64_CONSTANT (0x3c9ebe0a15c9bebc), G_GUINT64_CONSTANT (0x431d67c49c100d4c),
+  G_GUINT64_CONSTANT (0x4cc5d4becb3e42b6), G_GUINT64_CONSTANT (0x597f299cfc657e2a),
+  G_GUINT64_CONSTANT (0x5fcb6fab3ad6faec), G_GUINT64_CONSTANT (0x6c44198c4a475817)
+};
+
+static const guint64 sha512_iv[8] =
+{
+  G_GUINT64_CONSTANT (0x6a09e667f3bcc908), G_GUINT64_CONSTANT (0xbb67ae8584caa73b),
+  G_GUINT64_CONSTANT (0x3c6ef372fe94f82b), G_GUINT64_CONSTANT (0xa54ff53a5f1d36f1),
+  G_GUINT64_CONSTANT (0x510e527fade682d1), G_GUINT64_CONSTANT (0x9b05688c2b3e6c1f),
+  G_GUINT64_CONSTANT (0x1f83d9abfb41bd6b), G_GUINT64_CONSTANT (0x5be0cd19137e2179)
+};
+
+
+#define ROTR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+#define CH(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define BSIG0(x)	(ROTR64 (x, 28) ^ ROTR64 (x, 34) ^ ROTR64 (x, 39))
+#define BSIG1(x)	(ROTR64 (x, 14) ^ ROTR64 (x, 18) ^ ROTR64 (x, 41))
+#define SSIG0(x)	(ROTR64 (x, 1) ^ ROTR64 (x, 8) ^ ((x) >> 7))
+#define SSIG1(x)	(ROTR64 (x, 19) ^ ROTR64 (x, 61) ^ ((x) >> 6))
+
+/* One round, with the variables renamed by the caller as in
+   sha256.c */
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, i)				\
+  G_STMT_START {							\
+    guint64 t1 = h + BSIG1 (e) + CH (e, f, g) + sha512_k[i] + w[i];	\
+    d += t1;								\
+    h = t1 + BSIG0 (a) + MAJ (a, b, c);					\
+  } G_STMT_END
+
+
+static void
+sha512_blocks (guint64* state, const guint8* data, gsize n_blocks)
+{
+  for (; n_blocks > 0; --n_blocks, data += SHA512_BLOCK)
+    {
+      guint64 w[80];
+      guint64 a, b, c, d, e, f, g, h;
+      guint i;
+
+      for (i = 0; i < 16; ++i)
+	{
+	  memcpy (&w[i], data + 8 * i, 8);
+	  w[i] = GUINT64_FROM_BE (w[i]);
+	}
+      for (i = 16; i < 80; ++i)
+	w[i] = SSIG1 (w[i - 2]) + w[i - 7] + SSIG0 (w[i - 15]) + w[i - 16];
+
+      a = state[0];
+      b = state[1];
+      c = state[2];
+      d = state[3];
+      e = state[4];
+      f = state[5];
+      g = state[6];
+      h = state[7];
+
+      for (i = 0; i < 80; i += 8)
+	{
+	  SHA512_ROUND (a, b, c, d, e, f, g, h, i);
+	  SHA512_ROUND (h, a, b, c, d, e, f, g, i + 1);
+	  SHA512_ROUND (g, h, a, b, c, d, e, f, i + 2);
+	  SHA512_ROUND (f, g, h, a, b, c, d, e, i + 3);
+	  SHA512_ROUND (e, f, g, h, a, b, c, d, i + 4);
+	  SHA512_ROUND (d, e, f, g, h, a, b, c, i + 5);
+	  SHA512_ROUND (c, d, e, f, g, h, a, b, i + 6);
+	  SHA512_ROUND (b, c, d, e, f, g, h, a, i + 7);
+	}
+
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+    }
+}
+
+
+static void
+sha512_init (SHA512Context* ctx)
+{
+  memcpy (ctx->state, sha512_iv, sizeof (ctx->state));
+  ctx->count = 0;
+}
+
+
+static void
+sha512_update (SHA512Context* ctx, const guint8* data, gsize length)
+{
+  gsize used = ctx->count % SHA512_BLOCK;
+
+  ctx->count += length;
+
+  /* Fill the partial block first */
+  if (used)
+    {
+      gsize n = MIN (length, SHA512_BLOCK - used);
+
+      memcpy (ctx->buffer + used, data, n);
+      data += n;
+      length -= n;
+      if (used + n < SHA512_BLOCK)
+	return;
+      sha512_blocks (ctx->state, ctx->buffer, 1);
+    }
+
+  /* Whole blocks are hashed in place */
+  if (length >= SHA512_BLOCK)
+    {
+      sha512_blocks (ctx->state, data, length / SHA512_BLOCK);
+      data += length & ~(gsize) (SHA512_BLOCK - 1);
+      length %= SHA512_BLOCK;
+    }
+
+  memcpy (ctx->buffer, data, length);
+}
+
+
+/* Pads to 112 bytes modulo 128 with 0x80 and zeros, appends the
+   128-bit length in bits, big-endian, and writes the state big-endian
+   to @digest */
+static void
+sha512_final (SHA512Context* ctx, guint8* digest)
+{
+  gsize used = ctx->count % SHA512_BLOCK;
+  guint64 bits_hi = GUINT64_TO_BE (ctx->count >> 61);
+  guint64 bits_lo = GUINT64_TO_BE (ctx->count << 3);
+  guint i;
+
+  ctx->buffer[used++] = 0x80;
+  if (used > SHA512_BLOCK - 16)
+    {
+      memset (ctx->buffer + used, 0, SHA512_BLOCK - used);
+      sha512_blocks (ctx->state, ctx->buffer, 1);
+      used = 0;
+    }
+  memset (ctx->buffer + used, 0, SHA512_BLOCK - 16 - used);
+  memcpy (ctx->buffer + SHA512_BLOCK - 16, &bits_hi, 8);
+  memcpy (ctx->buffer + SHA512_BLOCK - 8, &bits_lo, 8);
+  sha512_blocks (ctx->state, ctx->buffer, 1);
+
+  for (i = 0; i < 8; ++i)
+    {
+      guint64 word = GUINT64_TO_BE (ctx->state[i]);
+
+      memcpy (digest + 8 * i, &word, 8);
+    }
+}
+
+
+/* ************************************************************ */
+
+struct _GSHA512
+{
+  SHA512Context	ctx;
+  guint8	digest[GNET_SHA512_HASH_LENGTH];
+};
+
+
+/**
+ *  gnet_sha512_new:
+ *  @buffer: buffer to hash
+ *  @length: length of @buffer
+ *
+ *  Creates a #GSHA512 from @buffer.
+ *
+ *  Returns: a new #GSHA512.
+ *
+ *  Since: 2.0.9
+ **/
+GSHA512*
+gnet_sha512_new (const gchar* buffer, gsize length)
+{
+  GSHA512* sha512;
+
+  sha512 = g_new0 (GSHA512, 1);
+  sha512_init (&sha512->ctx);
+  sha512_update (&sha512->ctx, (const guint8*) buffer, length);
+  sha512_final (&sha512->ctx, sha512->digest);
+
+  return sha512;
+}
+
+
+/**
+ *  gnet_sha512_new_string:
+ *  @str: hexadecimal string
+ *
+ *  Creates a #GSHA512 from @str.  @str is a hexadecimal string
+ *  representing the digest.
+ *
+ *  Returns: a new #GSHA512.
+ *
+ *  Since: 2.0.9
+ **/
+GSHA512*
+gnet_sha512_new_string (const gchar* str)
+{
+  GSHA512* sha512;
+
+  g_return_val_if_fail (str, NULL);
+  g_return_val_if_fail (strlen (str) >= GNET_SHA512_HASH_LENGTH * 2, NULL);
+
+  sha512 = g_new0 (GSHA512, 1);
+  if (!_gnet_hash_digest_from_string (str, sha512->digest, GNET_SHA512_HASH_LENGTH))
+    {
+      g_free (sha512);
+      g_return_val_if_fail (FALSE, NULL);
+    }
+
+  return sha512;
+}
+
+
+/**
+ *  gnet_sha512_clone:
+ *  @sha512: a #GSHA512
+ *
+ *  Copies a #GSHA512.
+ *
+ *  Returns: a copy of @sha512.
+ *
+ *  Since: 2.0.9
+ **/
+GSHA512*
+gnet_sha512_clone (const GSHA512* sha512)
+{
+  g_return_val_if_fail (sha512, NULL);
+
+  return g_memdup (sha512, sizeof (GSHA512));
+}
+
+
+/**
+ *  gnet_sha512_delete:
+ *  @sha512: a #GSHA512
+ *
+ *  Deletes a #GSHA512.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_sha512_delete (GSHA512* sha512)
+{
+  g_free (sha512);
+}
+
+
+/**
+ *  gnet_sha512_new_incremental:
+ *
+ *  Creates a #GSHA512 incrementally.  After creating a #GSHA512, call
+ *  gnet_sha512_update() one or more times to hash data.  Finally, call
+ *  gnet_sha512_final() to compute the final hash value.
+ *
+ *  Returns: a new #GSHA512.
+ *
+ *  Since: 2.0.9
+ **/
+GSHA512*
+gnet_sha512_new_incremental (void)
+{
+  GSHA512* sha512;
+
+  sha512 = g_new0 (GSHA512, 1);
+  sha512_init (&sha512->ctx);
+
+  return sha512;
+}
+
+
+/**
+ *  gnet_sha512_update:
+ *  @sha512: a #GSHA512
+ *  @buffer: buffer to add
+ *  @length: length of @buffer
+ *
+ *  Updates the hash with @buffer.  This may be called several times
+ *  on a hash created by gnet_sha512_new_incremental() before being
+ *  finalized by calling gnet_sha512_final().
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_sha512_update (GSHA512* sha512, const gchar* buffer, gsize length)
+{
+  g_return_if_fail (sha512);
+
+  sha512_update (&sha512->ctx, (const guint8*) buffer, length);
+}
+
+
+/**
+ *  gnet_sha512_final:
+ *  @sha512: a #GSHA512
+ *
+ *  Calculates the final hash value of a #GSHA512.  This should only be
+ *  called on a #GSHA512 created by gnet_sha512_new_incremental().
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_sha512_final (GSHA512* sha512)
+{
+  g_return_if_fail (sha512);
+
+  sha512_final (&sha512->ctx, sha512->digest);
+}
+
+
+/**
+ *  gnet_sha512_equal:
+ *  @p1: a #GSHA512
+ *  @p2: another #GSHA512
+ *
+ *  Compares two #GSHA512's for equality.
+ *
+ *  Returns: TRUE if they are equal; FALSE otherwise.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_sha512_equal (gconstpointer p1, gconstpointer p2)
+{
+  const GSHA512* sha512a = (const GSHA512*) p1;
+  const GSHA512* sha512b = (const GSHA512*) p2;
+
+  return memcmp (sha512a->digest, sha512b->digest, GNET_SHA512_HASH_LENGTH) == 0;
+}
+
+
+/**
+ *  gnet_sha512_hash:
+ *  @p: a #GSHA512
+ *
+ *  Creates a hash code for a #GSHA512 for use with GHashTable.  This
+ *  hash value is not the same as the SHA-512 digest.
+ *
+ *  Returns: the hash code for @p.
+ *
+ *  Since: 2.0.9
+ **/
+guint
+gnet_sha512_hash (gconstpointer p)
+{
+  const GSHA512* sha512 = (const GSHA512*) p;
+  guint32 word;
+  guint hash = 0;
+  guint i;
+
+  g_return_val_if_fail (sha512, 0);
+
+  for (i = 0; i < GNET_SHA512_HASH_LENGTH; i += 4)
+    {
+      memcpy (&word, sha512->digest + i, 4);
+      hash ^= word;
+    }
+
+  return hash;
+}
+
+
+/**
+ *  gnet_sha512_get_digest:
+ *  @sha512: a #GSHA512
+ *
+ *  Gets the raw SHA-512 digest.
+ *
+ *  Returns: a callee-owned buffer containing the SHA-512 hash digest.
+ *  The buffer is %GNET_SHA512_HASH_LENGTH bytes long.
+ *
+ *  Since: 2.0.9
+ **/
+gchar*
+gnet_sha512_get_digest (const GSHA512* sha512)
+{
+  g_return_val_if_fail (sha512, NULL);
+
+  return (gchar*) sha512->digest;
+}
+
+
+/**
+ *  gnet_sha512_get_string:
+ *  @sha512: a #GSHA512
+ *
+ *  Gets the digest represented as a human-readable string.
+ *
+ *  Returns: a hexadecimal string representing the digest.  The string
+ *  is 2 * %GNET_SHA512_HASH_LENGTH bytes long and NULL terminated.  The
+ *  string is caller owned.
+ *
+ *  Since: 2.0.9
+ **/
+gchar*
+gnet_sha512_get_string (const GSHA512* sha512)
+{
+  gchar* str;
+
+  g_return_val_if_fail (sha512, NULL);
+
+  str = g_new (gchar, GNET_SHA512_HASH_LENGTH * 2 + 1);
+  _gnet_hash_digest_to_string (sha512->digest, GNET_SHA512_HASH_LENGTH, str);
+  str[GNET_SHA512_HASH_LENGTH * 2] = '\0';
+
+  return str;
+}
+
+
+/**
+ *  gnet_sha512_copy_string:
+ *  @sha512: a #GSHA512
+ *  @buffer: buffer at least 2 * %GNET_SHA512_HASH_LENGTH bytes long
+ *
+ *  Copies the digest, represented as a string, into @buffer.  The
+ *  string is not NULL terminated.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_sha512_copy_string (const GSHA512* sha512, gchar* buffer)
+{
+  g_return_if_fail (sha512);
+  g_return_if_fail (buffer);
+
+  _gnet_hash_digest_to_string (sha512->digest, GNET_SHA512_HASH_LENGTH, buffer);
+}
@@ -0,0 +1,71 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+
+#ifndef _GNET_SHA512_H
+#define _GNET_SHA512_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ *  GSHA512
+ *
+ *  GSHA512 is a SHA-512 hash (FIPS 180-4).
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GSHA512 GSHA512;
+
+/**
+ *  GNET_SHA512_HASH_LENGTH
+ *
+ *  Length of the SHA-512 hash in bytes.
+ *
+ *  Since: 2.0.9
+ **/
+#define GNET_SHA512_HASH_LENGTH	64
+
+
+GSHA512* gnet_sha512_new (const gchar* buffer, gsize length);
+GSHA512* gnet_sha512_new_string (const gchar* str);
+GSHA512* gnet_sha512_clone (const GSHA512* sha512);
+void     gnet_sha512_delete (GSHA512* sha512);
+
+GSHA512* gnet_sha512_new_incremental (void);
+void     gnet_sha512_update (GSHA512* sha512, const gchar* buffer, gsize length);
+void     gnet_sha512_final (GSHA512* sha512);
+
+gboolean gnet_sha512_equal (gconstpointer p1, gconstpointer p2);
+guint    gnet_sha512_hash (gconstpointer p);
+
+gchar*   gnet_sha512_get_digest (const GSHA512* sha512);
+gchar*   gnet_sha512_get_string (const GSHA512* sha512);
+
+void     gnet_sha512_copy_string (const GSHA512* sha512, gchar* buffer);
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _GNET_SHA512_H */
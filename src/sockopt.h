@@ -0,0 +1,83 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+
+#ifndef _GNET_SOCKOPT_H
+#define _GNET_SOCKOPT_H
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+/**
+ *  GNetSocketOption
+ *  @GNET_SOCKET_OPTION_RCVBUF: kernel receive buffer size in bytes
+ *    (SO_RCVBUF)
+ *  @GNET_SOCKET_OPTION_SNDBUF: kernel send buffer size in bytes
+ *    (SO_SNDBUF)
+ *  @GNET_SOCKET_OPTION_TCP_NODELAY: non-zero to disable Nagle's
+ *    algorithm (TCP_NODELAY)
+ *  @GNET_SOCKET_OPTION_TCP_CORK: non-zero to hold back partial
+ *    segments until the option is cleared (TCP_CORK, Linux)
+ *  @GNET_SOCKET_OPTION_TCP_QUICKACK: non-zero to acknowledge at once
+ *    instead of delaying ACKs (TCP_QUICKACK, Linux).  The kernel may
+ *    clear it again, so set it after each read if needed.
+ *  @GNET_SOCKET_OPTION_BUSY_POLL: microseconds to busy poll the
+ *    device queue on blocking receives (SO_BUSY_POLL, Linux)
+ *  @GNET_SOCKET_OPTION_TCP_FASTOPEN: length of the TCP Fast Open
+ *    queue of a server socket, 0 to disable (TCP_FASTOPEN)
+ *  @GNET_SOCKET_OPTION_INCOMING_CPU: CPU that should handle the
+ *    socket's packets (SO_INCOMING_CPU, Linux)
+ *  @GNET_SOCKET_OPTION_TIMESTAMPNS: non-zero to have the kernel time
+ *    stamp received datagrams in nanoseconds (SO_TIMESTAMPNS, Linux).
+ *    See gnet_udp_socket_receive_with_info().
+ *  @GNET_SOCKET_OPTION_RXQ_OVFL: non-zero to report the number of
+ *    datagrams the socket dropped with each received datagram
+ *    (SO_RXQ_OVFL, Linux).  See gnet_udp_socket_receive_with_info().
+ *
+ *  Socket options that can be set with gnet_tcp_socket_set_option(),
+ *  gnet_udp_socket_set_option(), gnet_mcast_socket_set_option(),
+ *  gnet_unix_socket_set_option() and gnet_conn_set_option().  All
+ *  values are integers.  Options that the operating system or the
+ *  socket type does not support can not be set.
+ *
+ *  Since: 2.0.9
+ **/
+typedef enum {
+  GNET_SOCKET_OPTION_RCVBUF,
+  GNET_SOCKET_OPTION_SNDBUF,
+  GNET_SOCKET_OPTION_TCP_NODELAY,
+  GNET_SOCKET_OPTION_TCP_CORK,
+  GNET_SOCKET_OPTION_TCP_QUICKACK,
+  GNET_SOCKET_OPTION_BUSY_POLL,
+  GNET_SOCKET_OPTION_TCP_FASTOPEN,
+  GNET_SOCKET_OPTION_INCOMING_CPU,
+  GNET_SOCKET_OPTION_TIMESTAMPNS,
+  GNET_SOCKET_OPTION_RXQ_OVFL
+} GNetSocketOption;
+
+
+#ifdef __cplusplus
+}
+#endif				/* __cplusplus */
+
+#endif /* _GNET_SOCKOPT_H */
@@ -60,8 +60,25 @@ typedef struct _GTcpSocketConnectState
 
   GMainContext             * context; /* we hold a ref */
   gint                       priority;
+
+  gboolean                   fast_open;
+  GArray                   * options; /* of TcpSocketOption, or NULL */
 } GTcpSocketConnectState;
 
+/* Length of the queue of pending TCP Fast Open requests of servers */
+#define TCP_FAST_OPEN_QUEUE	256
+
+/* Number of connections whose data in the SYN was acknowledged */
+static gint tcp_fast_open_count = 0;
+
+static void tcp_socket_count_fast_open (GTcpSocket* socket, gboolean closing);
+
+static GTcpSocketNewAsyncID
+tcp_socket_new_async_direct (const GInetAddr * addr,
+    GTcpSocketNewAsyncFunc func, gpointer data, GDestroyNotify notify,
+    GMainContext * context, gint priority, gboolean fast_open,
+    const GArray * options);
+
 /**
  *  gnet_tcp_socket_connect
  *  @hostname: host name
@@ -131,11 +148,54 @@ gnet_tcp_socket_connect_async_full (const gchar * hostname, gint port,
     GTcpSocketConnectAsyncFunc func, gpointer data, GDestroyNotify notify,
     GMainContext * context, gint priority)
 {
-  GTcpSocketConnectState* state;
+  g_return_val_if_fail (hostname != NULL, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  return _gnet_tcp_socket_connect_async (hostname, port, func, data, notify,
+      context, priority, FALSE, NULL);
+}
 
+/**
+ *  gnet_tcp_socket_connect_async_fast_open_full
+ *  @hostname: host name
+ *  @port: port
+ *  @func: callback function
+ *  @data: data to pass to @func on callback
+ *  @notify: function to call to free @data, or NULL
+ *  @context: the #GMainContext to use for notifications, or NULL for the
+ *      default GLib main context.  If in doubt, pass NULL.
+ *  @priority: the priority with which to schedule notifications in the
+ *      main context, e.g. #G_PRIORITY_DEFAULT or #G_PRIORITY_HIGH.
+ *
+ *  Like gnet_tcp_socket_connect_async_full(), but connects with TCP
+ *  Fast Open.  See gnet_tcp_socket_new_async_fast_open_full().
+ *
+ *  Returns: the ID of the connection; NULL on failure.  The ID can be
+ *  used with gnet_tcp_socket_connect_async_cancel() to cancel the
+ *  connection.
+ *
+ *  Since: 2.0.9
+ **/
+GTcpSocketConnectAsyncID
+gnet_tcp_socket_connect_async_fast_open_full (const gchar * hostname,
+    gint port, GTcpSocketConnectAsyncFunc func, gpointer data,
+    GDestroyNotify notify, GMainContext * context, gint priority)
+{
   g_return_val_if_fail (hostname != NULL, NULL);
   g_return_val_if_fail (func != NULL, NULL);
 
+  return _gnet_tcp_socket_connect_async (hostname, port, func, data, notify,
+      context, priority, TRUE, NULL);
+}
+
+GTcpSocketConnectAsyncID
+_gnet_tcp_socket_connect_async (const gchar * hostname, gint port,
+    GTcpSocketConnectAsyncFunc func, gpointer data, GDestroyNotify notify,
+    GMainContext * context, gint priority, gboolean fast_open,
+    const GArray * options)
+{
+  GTcpSocketConnectState* state;
+
   if (context == NULL)
     context = g_main_context_default ();
 
@@ -146,6 +206,14 @@ gnet_tcp_socket_connect_async_full (const gchar * hostname, gint port,
   state->notify = notify;
   state->context = g_main_context_ref (context);
   state->priority = priority;
+  state->fast_open = fast_open;
+  if (options && options->len)
+    {
+      state->options = g_array_sized_new (FALSE, FALSE,
+					  sizeof (TcpSocketOption),
+					  options->len);
+      g_array_append_vals (state->options, options->data, options->len);
+    }
 
   state->inetaddr_id = gnet_inetaddr_new_list_async_full (hostname, port,
       gnet_tcp_socket_connect_inetaddr_cb, state, (GDestroyNotify) NULL,
@@ -156,6 +224,8 @@ gnet_tcp_socket_connect_async_full (const gchar * hostname, gint port,
   if (state->inetaddr_id == NULL) {
     if (state->notify)
       state->notify (state->data);
+    if (state->options)
+      g_array_free (state->options, TRUE);
     g_main_context_unref (state->context);
     g_free (state);
     return NULL;
@@ -215,9 +285,10 @@ gnet_tcp_socket_connect_inetaddr_cb (GList* ia_list, gpointer data)
 	  ia = (GInetAddr*) state->ia_next->data;
 	  state->ia_next = state->ia_next->next;
 
-	  tcp_id = gnet_tcp_socket_new_async_full (ia,
+	  tcp_id = _gnet_tcp_socket_new_async (ia,
               gnet_tcp_socket_connect_tcp_cb, state, (GDestroyNotify) NULL,
-              state->context, state->priority);
+              state->context, state->priority, state->fast_open,
+              state->options);
 
 	  if (tcp_id)	/* Success */
 	    {
@@ -282,9 +353,10 @@ gnet_tcp_socket_connect_tcp_cb (GTcpSocket* socket, gpointer data)
       ia = (GInetAddr*) state->ia_next->data;
       state->ia_next = state->ia_next->next;
 
-      tcp_id = gnet_tcp_socket_new_async_full (ia,
+      tcp_id = _gnet_tcp_socket_new_async (ia,
           gnet_tcp_socket_connect_tcp_cb, state, (GDestroyNotify) NULL,
-          state->context, state->priority);
+          state->context, state->priority, state->fast_open,
+          state->options);
 
       if (tcp_id)	/* Success */
 	{
@@ -340,6 +412,9 @@ gnet_tcp_socket_connect_async_cancel (GTcpSocketConnectAsyncID id)
   if (state->notify)
     state->notify (state->data);
 
+  if (state->options)
+    g_array_free (state->options, TRUE);
+
   g_main_context_unref (state->context);
 
   g_free (state);
@@ -453,18 +528,74 @@ gnet_tcp_socket_new_async_full (const GInetAddr * addr,
     GTcpSocketNewAsyncFunc func, gpointer data, GDestroyNotify notify,
     GMainContext * context, gint priority)
 {
-  GTcpSocketNewAsyncID async_id;
+  g_return_val_if_fail (addr != NULL, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  return _gnet_tcp_socket_new_async (addr, func, data, notify, context,
+      priority, FALSE, NULL);
+}
 
+/**
+ *  gnet_tcp_socket_new_async_fast_open_full
+ *  @addr: address
+ *  @func: callback function
+ *  @data: data to pass to @func on callback
+ *  @notify: function to call to free @data, or NULL
+ *  @context: the #GMainContext to use for notifications, or NULL for the
+ *      default GLib main context.  If in doubt, pass NULL.
+ *  @priority: the priority with which to schedule notifications in the
+ *      main context, e.g. #G_PRIORITY_DEFAULT or #G_PRIORITY_HIGH.
+ *
+ *  Like gnet_tcp_socket_new_async_full(), but connects with TCP Fast
+ *  Open (TCP_FASTOPEN_CONNECT, Linux 4.11 and later).  If the
+ *  client has a Fast Open cookie for the server, the handshake is
+ *  deferred: the callback is called at once, and the first data
+ *  written to the socket is sent in the SYN, saving a round trip.
+ *  Otherwise the kernel connects normally and asks the server for a
+ *  cookie for the next connection.  If Fast Open is not available,
+ *  or SOCKS is enabled, this is the same as
+ *  gnet_tcp_socket_new_async_full().
+ *
+ *  Only use Fast Open for protocols in which the client sends first,
+ *  and whose first request is safe to repeat: the SYN is only sent
+ *  when data is written, and the server may receive the data twice.
+ *  Since the handshake may not have happened yet when the callback
+ *  is called, connection errors may only be reported when reading or
+ *  writing.
+ *
+ *  Returns: the ID of the connection; NULL on failure.  The ID can be
+ *  used with gnet_tcp_socket_new_async_cancel() to cancel the
+ *  connection.
+ *
+ *  Since: 2.0.9
+ **/
+GTcpSocketNewAsyncID
+gnet_tcp_socket_new_async_fast_open_full (const GInetAddr * addr,
+    GTcpSocketNewAsyncFunc func, gpointer data, GDestroyNotify notify,
+    GMainContext * context, gint priority)
+{
   g_return_val_if_fail (addr != NULL, NULL);
   g_return_val_if_fail (func != NULL, NULL);
 
+  return _gnet_tcp_socket_new_async (addr, func, data, notify, context,
+      priority, TRUE, NULL);
+}
+
+GTcpSocketNewAsyncID
+_gnet_tcp_socket_new_async (const GInetAddr * addr,
+    GTcpSocketNewAsyncFunc func, gpointer data, GDestroyNotify notify,
+    GMainContext * context, gint priority, gboolean fast_open,
+    const GArray * options)
+{
+  GTcpSocketNewAsyncID async_id;
+
   /* Use SOCKS if enabled, otherwise, connect directly to the address */
   if (gnet_socks_get_enabled()) {
     async_id = _gnet_socks_tcp_socket_new_async_full (addr, func, data,
         notify, context, priority);
   } else {
-    async_id = gnet_tcp_socket_new_async_direct_full (addr, func, data,
-        notify, context, priority);
+    async_id = tcp_socket_new_async_direct (addr, func, data,
+        notify, context, priority, fast_open, options);
   }
 
   return async_id;
@@ -527,6 +658,19 @@ GTcpSocketNewAsyncID
 gnet_tcp_socket_new_async_direct_full (const GInetAddr * addr, 
     GTcpSocketNewAsyncFunc func, gpointer data, GDestroyNotify notify,
     GMainContext * context, gint priority)
+{
+  g_return_val_if_fail (addr != NULL, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  return tcp_socket_new_async_direct (addr, func, data, notify, context,
+      priority, FALSE, NULL);
+}
+
+static GTcpSocketNewAsyncID
+tcp_socket_new_async_direct (const GInetAddr * addr,
+    GTcpSocketNewAsyncFunc func, gpointer data, GDestroyNotify notify,
+    GMainContext * context, gint priority, gboolean fast_open,
+    const GArray * options)
 {
   SOCKET		sockfd;
 #ifndef GNET_WIN32
@@ -538,9 +682,6 @@ gnet_tcp_socket_new_async_direct_full (const GInetAddr * addr,
   GTcpSocketAsyncState* state;
   gint			status;
 
-  g_return_val_if_fail (addr != NULL, NULL);
-  g_return_val_if_fail (func != NULL, NULL);
-
   if (context == NULL)
     context = g_main_context_default ();
 
@@ -579,6 +720,21 @@ gnet_tcp_socket_new_async_direct_full (const GInetAddr * addr,
   s->ref_count = 1;
   s->sockfd = sockfd;
 
+  /* Options like SO_RCVBUF must be set before the handshake */
+  _gnet_socket_set_options (sockfd, options);
+
+#ifdef TCP_FASTOPEN_CONNECT
+  /* Older kernels do not know the option; connect normally then */
+  if (fast_open)
+    {
+      const int on = 1;
+
+      if (setsockopt (sockfd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+		      (void*) &on, sizeof (on)) == 0)
+	s->fast_open = TRUE;
+    }
+#endif
+
   /* Connect (but non-blocking!) */
   status = connect(s->sockfd, &GNET_INETADDR_SA(addr), 
 		   GNET_INETADDR_LEN(addr));
@@ -777,13 +933,22 @@ gnet_tcp_socket_unref_internal (GTcpSocket * socket)
     return FALSE;
 
   if (socket->accept_watch)
-    g_source_remove (socket->accept_watch);
+    _gnet_io_watch_remove (NULL, socket->accept_watch);
+  if (socket->accept_op)
+    _gnet_io_cancel (NULL, socket->accept_op, NULL, NULL);
+
+  /* Count it if the handshake was not checked yet */
+  if (socket->fast_open)
+    tcp_socket_count_fast_open (socket, TRUE);
 
   GNET_CLOSE_SOCKET (socket->sockfd); /* Don't care if this fails... */
 
   if (socket->iochannel)
     g_io_channel_unref (socket->iochannel);
 
+  if (socket->accept_options)
+    g_array_free (socket->accept_options, TRUE);
+
   g_free (socket);
   return TRUE;
 }
@@ -970,6 +1135,147 @@ gnet_tcp_socket_set_tos (GTcpSocket* socket, GNetTOS tos)
 }
 
 
+
+/**
+ *  gnet_tcp_socket_set_option
+ *  @socket: a #GTcpSocket
+ *  @option: option to set
+ *  @value: value of the option
+ *
+ *  Sets a socket option of a #GTcpSocket.  See #GNetSocketOption for
+ *  the options and their values.
+ *
+ *  Returns: TRUE if the option was set; FALSE if it is not supported
+ *  or the value is invalid.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_tcp_socket_set_option (GTcpSocket* socket, GNetSocketOption option,
+			    gint value)
+{
+  g_return_val_if_fail (socket != NULL, FALSE);
+
+  return _gnet_socket_set_option (socket->sockfd, option, value);
+}
+
+
+/**
+ *  gnet_tcp_socket_get_option
+ *  @socket: a #GTcpSocket
+ *  @option: option to get
+ *  @value: pointer to store the value in
+ *
+ *  Gets a socket option of a #GTcpSocket.  The value may differ from
+ *  the one set; for example, Linux doubles buffer sizes.
+ *
+ *  Returns: TRUE if the option was read; FALSE if it is not
+ *  supported.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_tcp_socket_get_option (const GTcpSocket* socket,
+			    GNetSocketOption option, gint* value)
+{
+  g_return_val_if_fail (socket != NULL, FALSE);
+  g_return_val_if_fail (value != NULL, FALSE);
+
+  return _gnet_socket_get_option (socket->sockfd, option, value);
+}
+
+
+/* Counts @socket in tcp_fast_open_count if the server acknowledged
+   the data in its SYN.  Does nothing until the handshake is done,
+   unless @closing.  Clears @socket->fast_open once it is checked. */
+static void
+tcp_socket_count_fast_open (GTcpSocket* socket, gboolean closing)
+{
+#if defined(TCP_INFO) && defined(TCPI_OPT_SYN_DATA)
+  struct tcp_info info;
+  socklen_t len = sizeof (info);
+
+  if (getsockopt (socket->sockfd, IPPROTO_TCP, TCP_INFO,
+		  (void*) &info, &len) != 0)
+    return;
+
+  /* With Fast Open, connect() returns before the SYN is sent */
+  if (!closing &&
+      (info.tcpi_state == TCP_SYN_SENT || info.tcpi_state == TCP_CLOSE))
+    return;
+
+  if (info.tcpi_options & TCPI_OPT_SYN_DATA)
+    g_atomic_int_inc (&tcp_fast_open_count);
+#endif
+
+  socket->fast_open = FALSE;
+}
+
+
+void
+_gnet_tcp_socket_check_fast_open (GTcpSocket* socket)
+{
+  if (socket->fast_open)
+    tcp_socket_count_fast_open (socket, FALSE);
+}
+
+
+/**
+ *  gnet_tcp_socket_get_fast_open_count
+ *
+ *  Gets the number of TCP Fast Open connections whose data in the SYN
+ *  was acknowledged by the server, that is, connections that saved a
+ *  round trip.  A #GConn is counted by its first read or write once
+ *  the handshake is done; other connections are counted when their
+ *  #GTcpSocket is deleted.  Only Linux reports this; elsewhere the
+ *  count stays 0.
+ *
+ *  Returns: the number of successful TCP Fast Open connections.
+ *
+ *  Since: 2.0.9
+ **/
+guint
+gnet_tcp_socket_get_fast_open_count (void)
+{
+  return g_atomic_int_get (&tcp_fast_open_count);
+}
+
+
+/**
+ *  gnet_tcp_socket_server_set_accept_option
+ *  @socket: a server #GTcpSocket
+ *  @option: option to set
+ *  @value: value of the option
+ *
+ *  Sets a socket option that is applied to every connection accepted
+ *  from @socket from now on, by gnet_tcp_socket_server_accept(),
+ *  gnet_tcp_socket_server_accept_nonblock() and
+ *  gnet_tcp_socket_server_accept_async().  Setting an option again
+ *  replaces its value.  Options that can not be set on an accepted
+ *  connection are ignored.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_tcp_socket_server_set_accept_option (GTcpSocket* socket,
+					  GNetSocketOption option,
+					  gint value)
+{
+  g_return_if_fail (socket != NULL);
+
+  _gnet_socket_options_set (&socket->accept_options, option, value);
+}
+
+
+/* Applies the accept options of @server to the accepted @client */
+static void
+tcp_socket_apply_accept_options (const GTcpSocket* server, GTcpSocket* client)
+{
+  _gnet_socket_set_options (client->sockfd, server->accept_options);
+}
+
+
+
 /* **************************************** */
 /* Server stuff */
 
@@ -1085,6 +1391,16 @@ gnet_tcp_socket_server_new_full (const GInetAddr* iface, gint port)
   if (getsockname(sockfd, &GNET_SOCKADDR_SA(sa), &socklen) != 0)
     goto error;
   
+#ifdef TCP_FASTOPEN
+  /* Accept data in the SYN from TCP Fast Open clients.  The system
+     must allow it too (net.ipv4.tcp_fastopen on Linux). */
+  {
+    const int qlen = TCP_FAST_OPEN_QUEUE;
+
+    setsockopt(sockfd, IPPROTO_TCP, TCP_FASTOPEN, (void*) &qlen, sizeof(qlen));
+  }
+#endif
+
   /* Listen */
   if (listen(sockfd, 10) != 0)
     goto error;
@@ -1170,6 +1486,8 @@ gnet_tcp_socket_server_accept (GTcpSocket* socket)
   s->sockfd = sockfd;
   s->sa = sa;
 
+  tcp_socket_apply_accept_options (socket, s);
+
   return s;
 }
 
@@ -1237,6 +1555,8 @@ gnet_tcp_socket_server_accept_nonblock (GTcpSocket* socket)
   s->sockfd = sockfd;
   s->sa = sa;
 
+  tcp_socket_apply_accept_options (socket, s);
+
   return s;
 }
 
@@ -1278,6 +1598,8 @@ gnet_tcp_socket_server_accept (GTcpSocket* socket)
   s->sockfd = sockfd;
   s->sa = sa;
 
+  tcp_socket_apply_accept_options (socket, s);
+
   return s;
 }
 
@@ -1321,6 +1643,8 @@ gnet_tcp_socket_server_accept_nonblock (GTcpSocket* socket)
   s->sockfd = sockfd;
   s->sa = sa;
 
+  tcp_socket_apply_accept_options (socket, s);
+
   return s;
 }
 
@@ -1332,6 +1656,9 @@ gnet_tcp_socket_server_accept_nonblock (GTcpSocket* socket)
 static gboolean tcp_socket_server_accept_async_cb (GIOChannel* iochannel, 
 						   GIOCondition condition, 
 						   gpointer data);
+static void	tcp_socket_server_accept_start (GTcpSocket* socket);
+static void	tcp_socket_server_accept_done (gint result, gpointer buffer,
+					       gpointer data);
 
 /**
  *  gnet_tcp_socket_server_accept_async:
@@ -1350,8 +1677,6 @@ gnet_tcp_socket_server_accept_async (GTcpSocket* socket,
 				     GTcpSocketAcceptFunc accept_func,
 				     gpointer user_data)
 {
-  GIOChannel* iochannel;
-
   g_return_if_fail (socket);
   g_return_if_fail (accept_func);
   g_return_if_fail (!socket->accept_func);
@@ -1366,14 +1691,76 @@ gnet_tcp_socket_server_accept_async (GTcpSocket* socket,
   socket->accept_func = accept_func;
   socket->accept_data = user_data;
 
+  tcp_socket_server_accept_start (socket);
+}
+
+
+/* Accepts the next connection with an io_uring operation, or watches
+   for it */
+static void
+tcp_socket_server_accept_start (GTcpSocket* socket)
+{
+  GIOChannel* iochannel;
+
+  socket->accept_op = _gnet_io_accept (NULL, (gint) socket->sockfd,
+				       tcp_socket_server_accept_done, socket);
+  if (socket->accept_op)
+    return;
+
   /* Add read watch */
   iochannel = gnet_tcp_socket_get_io_channel (socket);
-  socket->accept_watch = g_io_add_watch(iochannel, 
+  socket->accept_watch = _gnet_io_watch_update (NULL, 0, iochannel,
 					G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL, 
 					tcp_socket_server_accept_async_cb, socket);
 }
 
 
+static void
+tcp_socket_server_accept_done (gint result, gpointer buffer, gpointer data)
+{
+  GTcpSocket* server = (GTcpSocket*) data;
+  GTcpSocket* client;
+
+  server->accept_op = 0;
+
+  if (result < 0)
+    {
+      /* The socket can not accept: report it, as the watch does */
+      if (result == -EBADF || result == -EINVAL || result == -ENOTSOCK)
+	{
+	  gnet_tcp_socket_ref (server);
+	  (server->accept_func)(server, NULL, server->accept_data);
+	  server->accept_func = NULL;
+	  server->accept_data = NULL;
+	  gnet_tcp_socket_unref (server);
+	  return;
+	}
+
+      /* Otherwise the connection failed: wait for the next one */
+      tcp_socket_server_accept_start (server);
+      return;
+    }
+
+  client = g_new0 (GTcpSocket, 1);
+  client->ref_count = 1;
+  client->sockfd = result;
+  memcpy (&client->sa, buffer, sizeof (client->sa));
+
+  tcp_socket_apply_accept_options (server, client);
+
+  /* Do upcall, protected by a ref */
+  gnet_tcp_socket_ref (server);
+
+  (server->accept_func)(server, client, server->accept_data);
+
+  /* Accept the next one unless the server was deleted or canceled, or
+     the callback started accepting again */
+  if (!gnet_tcp_socket_unref_internal (server) && server->accept_func &&
+      !server->accept_op && !server->accept_watch)
+    tcp_socket_server_accept_start (server);
+}
+
+
 
 static gboolean
 tcp_socket_server_accept_async_cb (GIOChannel* iochannel, GIOCondition condition, 
@@ -1427,12 +1814,18 @@ gnet_tcp_socket_server_accept_async_cancel (GTcpSocket* socket)
 {
   g_return_if_fail (socket);
 
-  if (!socket->accept_watch)
+  if (!socket->accept_watch && !socket->accept_op)
     return;
 
   socket->accept_func = NULL;
   socket->accept_data = NULL;
 
-  g_source_remove (socket->accept_watch);
+  if (socket->accept_op)
+    {
+      _gnet_io_cancel (NULL, socket->accept_op, NULL, NULL);
+      socket->accept_op = 0;
+    }
+
+  _gnet_io_watch_remove (NULL, socket->accept_watch);
   socket->accept_watch = 0;
 }
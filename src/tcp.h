@@ -24,6 +24,7 @@
 #define _GNET_TCP_H
 
 #include "inetaddr.h"
+#include "sockopt.h"
 
 #include <glib.h>
 
@@ -91,6 +92,16 @@ typedef enum
 
 void 	    gnet_tcp_socket_set_tos (GTcpSocket* socket, GNetTOS tos);
 
+gboolean    gnet_tcp_socket_set_option (GTcpSocket* socket,
+					GNetSocketOption option, gint value);
+gboolean    gnet_tcp_socket_get_option (const GTcpSocket* socket,
+					GNetSocketOption option, gint* value);
+void	    gnet_tcp_socket_server_set_accept_option (GTcpSocket* socket,
+						      GNetSocketOption option,
+						      gint value);
+
+guint	    gnet_tcp_socket_get_fast_open_count (void);
+
 
 
 /* **************************************** */
@@ -156,6 +167,14 @@ GTcpSocketConnectAsyncID  gnet_tcp_socket_connect_async_full (const gchar
                                                               GMainContext             * context,
                                                               gint                       priority);
 
+GTcpSocketConnectAsyncID  gnet_tcp_socket_connect_async_fast_open_full (const gchar              * hostname,
+                                                                        gint                       port,
+                                                                        GTcpSocketConnectAsyncFunc func,
+                                                                        gpointer                   data,
+                                                                        GDestroyNotify             notify,
+                                                                        GMainContext             * context,
+                                                                        gint                       priority);
+
 void                      gnet_tcp_socket_connect_async_cancel (GTcpSocketConnectAsyncID id);
 
 /* ********** */
@@ -195,6 +214,13 @@ GTcpSocketNewAsyncID  gnet_tcp_socket_new_async_full        (const GInetAddr
                                                              GMainContext           * context,
                                                              gint                     priority);
 
+GTcpSocketNewAsyncID  gnet_tcp_socket_new_async_fast_open_full (const GInetAddr      * addr,
+                                                                GTcpSocketNewAsyncFunc func,
+                                                                gpointer               data,
+                                                                GDestroyNotify         notify,
+                                                                GMainContext         * context,
+                                                                gint                   priority);
+
 void                  gnet_tcp_socket_new_async_cancel      (GTcpSocketNewAsyncID id);
 
 
@@ -0,0 +1,472 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#include "timer-private.h"
+
+/* The wheel has WHEEL_LEVELS levels of WHEEL_SIZE slots.  A tick is
+   one millisecond, so level 0 covers 64 ms, level 1 about 4 seconds,
+   level 2 about 4.5 minutes and level 3 about 4.6 hours.  Timers
+   further away are parked in the last slot of level 3 and re-inserted
+   when that slot is cascaded. */
+#define WHEEL_BITS	6
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SIZE - 1)
+#define WHEEL_LEVELS	4
+
+
+typedef struct _Timer Timer;
+
+struct _Timer
+{
+  Timer*	next;
+  Timer*	prev;
+  guint64	expires;	/* tick */
+  guint		id;
+  gint		level;
+  gint		slot;
+  GSourceFunc	function;
+  gpointer	data;
+};
+
+
+typedef struct _TimerWheel
+{
+  GSource	source;
+  GMainContext* context;
+  guint64	now;		/* last tick processed */
+  gint64	offset;		/* added to the clock, see wheel_get_ticks() */
+  guint		next_id;
+  GHashTable*	timers;		/* id -> Timer */
+  guint64	occupied[WHEEL_LEVELS];
+  Timer*	slots[WHEEL_LEVELS][WHEEL_SIZE];
+
+} TimerWheel;
+
+
+static gboolean wheel_source_prepare  (GSource* source, gint* timeout);
+static gboolean wheel_source_check    (GSource* source);
+static gboolean wheel_source_dispatch (GSource* source, GSourceFunc callback,
+				       gpointer user_data);
+static void	wheel_source_finalize (GSource* source);
+
+static GSourceFuncs wheel_source_funcs =
+{
+  wheel_source_prepare,
+  wheel_source_check,
+  wheel_source_dispatch,
+  wheel_source_finalize,
+  NULL,
+  NULL
+};
+
+/* GMainContext -> TimerWheel.  The wheel lives as long as its
+   context; it is removed from here when the context destroys it. */
+static GHashTable* timer_wheels = NULL;
+G_LOCK_DEFINE_STATIC (timer_wheels);
+
+
+
+/* Returns the current time in ticks.  The offset keeps the ticks from
+   going backwards when the system clock does. */
+static guint64
+wheel_get_ticks (TimerWheel* wheel)
+{
+  GTimeVal tv;
+  gint64 ticks;
+
+  g_get_current_time (&tv);
+  ticks = (gint64) tv.tv_sec * 1000 + tv.tv_usec / 1000 + wheel->offset;
+
+  if (ticks < (gint64) wheel->now)
+    {
+      wheel->offset += (gint64) wheel->now - ticks;
+      ticks = wheel->now;
+    }
+
+  return (guint64) ticks;
+}
+
+
+static gint
+lowest_bit (guint64 map)
+{
+  gint n = 0;
+
+  if ((map & 0xFFFFFFFFU) == 0) { n += 32; map >>= 32; }
+  if ((map & 0xFFFFU) == 0)     { n += 16; map >>= 16; }
+  if ((map & 0xFFU) == 0)       { n += 8;  map >>= 8;  }
+  if ((map & 0xFU) == 0)        { n += 4;  map >>= 4;  }
+  if ((map & 0x3U) == 0)        { n += 2;  map >>= 2;  }
+  if ((map & 0x1U) == 0)        { n += 1; }
+
+  return n;
+}
+
+
+static void
+wheel_link (TimerWheel* wheel, Timer* timer, gint level, gint slot)
+{
+  Timer** head = &wheel->slots[level][slot];
+
+  timer->level = level;
+  timer->slot = slot;
+  timer->prev = NULL;
+  timer->next = *head;
+  if (*head)
+    (*head)->prev = timer;
+  *head = timer;
+
+  wheel->occupied[level] |= (guint64) 1 << slot;
+}
+
+
+static void
+wheel_unlink (TimerWheel* wheel, Timer* timer)
+{
+  if (timer->prev)
+    timer->prev->next = timer->next;
+  else
+    wheel->slots[timer->level][timer->slot] = timer->next;
+  if (timer->next)
+    timer->next->prev = timer->prev;
+
+  if (wheel->slots[timer->level][timer->slot] == NULL)
+    wheel->occupied[timer->level] &= ~((guint64) 1 << timer->slot);
+
+  timer->next = timer->prev = NULL;
+}
+
+
+/* Inserts @timer in the lowest level whose current rotation reaches
+   its expiry.  timer->expires must not be before wheel->now. */
+static void
+wheel_insert (TimerWheel* wheel, Timer* timer)
+{
+  guint64 expires = timer->expires;
+  gint level;
+  gint shift = 0;
+
+  for (level = 0; level < WHEEL_LEVELS; ++level)
+    {
+      shift = level * WHEEL_BITS;
+      if ((expires >> shift) - (wheel->now >> shift) < WHEEL_SIZE)
+	break;
+    }
+
+  if (level == WHEEL_LEVELS)
+    {
+      level = WHEEL_LEVELS - 1;
+      expires = ((wheel->now >> shift) + WHEEL_SIZE - 1) << shift;
+    }
+
+  wheel_link (wheel, timer, level, (expires >> shift) & WHEEL_MASK);
+}
+
+
+/* Returns the first tick after wheel->now at which a slot expires or
+   is cascaded, or 0 if the wheel is empty. */
+static guint64
+wheel_next_tick (TimerWheel* wheel)
+{
+  guint64 next = 0;
+  gint level;
+
+  for (level = 0; level < WHEEL_LEVELS; ++level)
+    {
+      gint shift = level * WHEEL_BITS;
+      guint64 pos = wheel->now >> shift;
+      guint64 map = wheel->occupied[level];
+      gint start;
+      guint64 tick;
+
+      if (map == 0)
+	continue;
+
+      /* Rotate so bit 0 is the slot after the current one */
+      start = (pos + 1) & WHEEL_MASK;
+      if (start)
+	map = (map >> start) | (map << (WHEEL_SIZE - start));
+
+      tick = (pos + 1 + lowest_bit (map)) << shift;
+      if (next == 0 || tick < next)
+	next = tick;
+    }
+
+  return next;
+}
+
+
+static void
+wheel_cascade (TimerWheel* wheel, gint level)
+{
+  gint slot = (wheel->now >> (level * WHEEL_BITS)) & WHEEL_MASK;
+  Timer* timer;
+
+  while ((timer = wheel->slots[level][slot]) != NULL)
+    {
+      wheel_unlink (wheel, timer);
+      wheel_insert (wheel, timer);
+    }
+}
+
+
+/* Runs all timers expiring up to and including @ticks */
+static void
+wheel_advance (TimerWheel* wheel, guint64 ticks)
+{
+  while (wheel->now < ticks)
+    {
+      guint64 next;
+      gint level;
+      gint slot;
+      Timer* timer;
+
+      /* Skip the ticks on which nothing happens */
+      next = wheel_next_tick (wheel);
+      if (next == 0 || next > ticks)
+	{
+	  wheel->now = ticks;
+	  break;
+	}
+      wheel->now = next;
+
+      for (level = 1; level < WHEEL_LEVELS; ++level)
+	{
+	  if (wheel->now & (((guint64) 1 << (level * WHEEL_BITS)) - 1))
+	    break;
+	  wheel_cascade (wheel, level);
+	}
+
+      /* The callbacks may add and remove timers, but never in this
+	 slot */
+      slot = wheel->now & WHEEL_MASK;
+      while ((timer = wheel->slots[0][slot]) != NULL)
+	{
+	  wheel_unlink (wheel, timer);
+
+	  /* Restarted after it was queued here */
+	  if (timer->expires > wheel->now)
+	    {
+	      wheel_insert (wheel, timer);
+	      continue;
+	    }
+
+	  g_hash_table_remove (wheel->timers, GUINT_TO_POINTER (timer->id));
+	  (timer->function) (timer->data);
+	  g_free (timer);
+	}
+    }
+}
+
+
+/* Returns the wheel of @context, creating it if needed */
+static TimerWheel*
+wheel_get (GMainContext* context, gboolean create)
+{
+  TimerWheel* wheel;
+
+  if (context == NULL)
+    context = g_main_context_default ();
+
+  G_LOCK (timer_wheels);
+
+  if (timer_wheels == NULL)
+    timer_wheels = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  wheel = g_hash_table_lookup (timer_wheels, context);
+  if (wheel != NULL || !create)
+    goto done;
+
+  wheel = (TimerWheel*) g_source_new (&wheel_source_funcs, sizeof (TimerWheel));
+  wheel->context = context;
+  wheel->timers = g_hash_table_new (g_direct_hash, g_direct_equal);
+  wheel->now = wheel_get_ticks (wheel);
+
+  g_source_attach ((GSource*) wheel, context);
+  g_source_unref ((GSource*) wheel);	/* context owns it now */
+
+  g_hash_table_insert (timer_wheels, context, wheel);
+
+ done:
+  G_UNLOCK (timer_wheels);
+
+  return wheel;
+}
+
+
+static gboolean
+wheel_source_prepare (GSource* source, gint* timeout)
+{
+  TimerWheel* wheel = (TimerWheel*) source;
+  guint64 next;
+  guint64 ticks;
+
+  next = wheel_next_tick (wheel);
+  if (next == 0)
+    {
+      *timeout = -1;
+      return FALSE;
+    }
+
+  ticks = wheel_get_ticks (wheel);
+  if (next <= ticks)
+    {
+      *timeout = 0;
+      return TRUE;
+    }
+
+  *timeout = (gint) MIN (next - ticks, G_MAXINT);
+  return FALSE;
+}
+
+
+static gboolean
+wheel_source_check (GSource* source)
+{
+  TimerWheel* wheel = (TimerWheel*) source;
+  guint64 next;
+
+  next = wheel_next_tick (wheel);
+
+  return next != 0 && next <= wheel_get_ticks (wheel);
+}
+
+
+static gboolean
+wheel_source_dispatch (GSource* source, GSourceFunc callback,
+		       gpointer user_data)
+{
+  TimerWheel* wheel = (TimerWheel*) source;
+
+  wheel_advance (wheel, wheel_get_ticks (wheel));
+
+  return TRUE;
+}
+
+
+static gboolean
+wheel_source_finalize_timer (gpointer key, gpointer value, gpointer user_data)
+{
+  g_free (value);
+
+  return TRUE;
+}
+
+
+static void
+wheel_source_finalize (GSource* source)
+{
+  TimerWheel* wheel = (TimerWheel*) source;
+
+  G_LOCK (timer_wheels);
+  if (timer_wheels &&
+      g_hash_table_lookup (timer_wheels, wheel->context) == wheel)
+    g_hash_table_remove (timer_wheels, wheel->context);
+  G_UNLOCK (timer_wheels);
+
+  g_hash_table_foreach_remove (wheel->timers, wheel_source_finalize_timer, NULL);
+  g_hash_table_destroy (wheel->timers);
+}
+
+
+/* **************************************** */
+
+
+guint
+_gnet_timer_add (GMainContext* context, guint timeout,
+		 GSourceFunc function, gpointer data)
+{
+  TimerWheel* wheel;
+  Timer* timer;
+
+  g_return_val_if_fail (function != NULL, 0);
+
+  wheel = wheel_get (context, TRUE);
+
+  timer = g_new0 (Timer, 1);
+  timer->function = function;
+  timer->data = data;
+  timer->expires = MAX (wheel_get_ticks (wheel) + timeout, wheel->now + 1);
+
+  do {
+    timer->id = ++wheel->next_id;
+  } while (timer->id == 0 ||
+	   g_hash_table_lookup (wheel->timers, GUINT_TO_POINTER (timer->id)));
+
+  wheel_insert (wheel, timer);
+  g_hash_table_insert (wheel->timers, GUINT_TO_POINTER (timer->id), timer);
+
+  return timer->id;
+}
+
+
+gboolean
+_gnet_timer_reset (GMainContext* context, guint id, guint timeout)
+{
+  TimerWheel* wheel;
+  Timer* timer;
+  guint64 expires;
+
+  wheel = wheel_get (context, FALSE);
+  if (wheel == NULL)
+    return FALSE;
+
+  timer = g_hash_table_lookup (wheel->timers, GUINT_TO_POINTER (id));
+  if (timer == NULL)
+    return FALSE;
+
+  expires = MAX (wheel_get_ticks (wheel) + timeout, wheel->now + 1);
+
+  /* A later expiry is picked up when the timer's slot comes round,
+     so an idle timer reset on every read is never moved more than
+     once per slot. */
+  if (expires < timer->expires)
+    {
+      wheel_unlink (wheel, timer);
+      timer->expires = expires;
+      wheel_insert (wheel, timer);
+    }
+  else
+    timer->expires = expires;
+
+  return TRUE;
+}
+
+
+void
+_gnet_timer_remove (GMainContext* context, guint id)
+{
+  TimerWheel* wheel;
+  Timer* timer;
+
+  if (id == 0)
+    return;
+
+  wheel = wheel_get (context, FALSE);
+  if (wheel == NULL)
+    return;
+
+  timer = g_hash_table_lookup (wheel->timers, GUINT_TO_POINTER (id));
+  if (timer == NULL)
+    return;
+
+  g_hash_table_remove (wheel->timers, GUINT_TO_POINTER (id));
+  wheel_unlink (wheel, timer);
+  g_free (timer);
+}
@@ -0,0 +1,47 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#ifndef _GNET_TIMER_PRIVATE_H
+#define _GNET_TIMER_PRIVATE_H
+
+#include "gnet-private.h"
+
+/* One-shot millisecond timers.  All timers of a GMainContext live in
+   one hierarchical timing wheel that is driven by a single GSource,
+   so adding, resetting and removing a timer is O(1) and does not
+   touch GLib's source list.  Timers must only be used from the thread
+   running @context.
+
+   The timer is removed before @function is called; the return value
+   of @function is ignored. */
+guint	_gnet_timer_add (GMainContext * context,
+                         guint          timeout,
+                         GSourceFunc    function,
+                         gpointer       data);
+
+/* Restarts @timer so it expires @timeout ms from now.  Returns FALSE
+   if the timer does not exist (anymore). */
+gboolean _gnet_timer_reset (GMainContext * context,
+                            guint          timer,
+                            guint          timeout);
+
+/* Does nothing if @timer is 0 or has already expired */
+void	_gnet_timer_remove (GMainContext * context, guint timer);
+
+#endif /* _GNET_TIMER_PRIVATE_H */
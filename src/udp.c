@@ -18,6 +18,10 @@
  * Boston, MA  02111-1307, USA.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* for sendmmsg() and recvmmsg() */
+#endif
+
 #include "gnet-private.h"
 #include "udp.h"
 
@@ -25,6 +29,33 @@
 #define GNET_IS_UDP_SOCKET(s)   ((s) && (GNET_UDP_SOCKET_TYPE(s) == GNET_UDP_SOCKET_TYPE_COOKIE \
                                       || GNET_UDP_SOCKET_TYPE(s) == GNET_MCAST_SOCKET_TYPE_COOKIE))
 
+/* Maximum number of datagrams passed to one sendmmsg()/recvmmsg() */
+#define UDP_BATCH_MAX	64
+
+#ifdef HAVE_SENDMMSG
+/* Cleared if the kernel does not implement the calls */
+static gboolean udp_mmsg_supported = TRUE;
+#endif
+
+#ifdef HAVE_UDP_GSO
+#include <netinet/udp.h>
+
+/* Limits of one UDP_SEGMENT send: the kernel accepts at most 64
+   segments, and all of them must fit in one IP packet */
+#define UDP_GSO_MAX_SEGMENTS	64
+#define UDP_GSO_MAX_BYTES	65000
+
+/* 1 if the kernel supports UDP_SEGMENT, 0 if not, -1 if unknown */
+static gint udp_gso_supported = -1;
+#endif
+
+static gboolean udp_socket_dst_sockaddr (const GUdpSocket* socket,
+					 const GInetAddr* dst,
+					 struct sockaddr_storage* sa);
+static gint udp_socket_receive_batch (GUdpSocket* socket,
+				      GUdpPacket* packets, gint n_packets,
+				      gboolean block);
+
 /**
  *  gnet_udp_socket_new
  *  
@@ -166,6 +197,10 @@ gnet_udp_socket_unref (GUdpSocket* socket)
   g_return_if_fail (GNET_IS_UDP_SOCKET (socket));
 
   if (g_atomic_int_dec_and_test (&socket->ref_count)) {
+    gnet_udp_socket_receive_async_cancel (socket);
+    if (socket->type == GNET_MCAST_SOCKET_TYPE_COOKIE)
+      _gnet_mcast_socket_dispatch_free ((GMcastSocket*) socket);
+
     GNET_CLOSE_SOCKET (socket->sockfd);  /* Don't care if this fails... */
 
     if (socket->iochannel)
@@ -248,32 +283,13 @@ gnet_udp_socket_get_local_inetaddr (const GUdpSocket* socket)
 }
 
 
-/**
- *  gnet_udp_socket_send
- *  @socket: a #GUdpSocket
- *  @buffer: buffer to send
- *  @length: length of @buffer
- *  @dst: destination address
- *
- *  Sends data to a host using a #GUdpSocket.
- *
- *  Returns: 0 if successful; something else on error.
- *
- **/
-gint 
-gnet_udp_socket_send (GUdpSocket* socket, 
-		      const gchar* buffer, gint length, 
-		      const GInetAddr* dst)
+/* Converts @dst to an address @socket can send to (IPv4 addresses
+   are mapped to IPv6 and vice versa).  Returns FALSE if that is not
+   possible. */
+static gboolean
+udp_socket_dst_sockaddr (const GUdpSocket* socket, const GInetAddr* dst,
+			 struct sockaddr_storage* sa)
 {
-  gint bytes_sent;
-  struct sockaddr_storage sa;
-
-  g_return_val_if_fail (socket != NULL, -1);
-  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), -1);
-  g_return_val_if_fail (dst != NULL, -1);
-  g_return_val_if_fail (buffer != NULL, -1);
-
-  /* Address of dst must be address of socket */
 #ifdef HAVE_IPV6
   if (GNET_INETADDR_FAMILY(dst) != GNET_SOCKADDR_FAMILY(socket->sa))
     {
@@ -281,13 +297,13 @@ gnet_udp_socket_send (GUdpSocket* socket,
       if (GNET_INETADDR_FAMILY(dst) == AF_INET && 
 	  GNET_SOCKADDR_FAMILY(socket->sa) == AF_INET6)
 	{
-          GNET_SOCKADDR_FAMILY(sa) = AF_INET6;
-	  GNET_SOCKADDR_SET_SS_LEN(sa);
-          GNET_SOCKADDR_PORT_SET(sa, GNET_INETADDR_PORT(dst));
-          GNET_SOCKADDR_ADDR32_SET(sa, 0, 0);
-          GNET_SOCKADDR_ADDR32_SET(sa, 1, 0);
-          GNET_SOCKADDR_ADDR32_SET(sa, 2, g_htonl(0xffff));
-          GNET_SOCKADDR_ADDR32_SET(sa, 3, GNET_INETADDR_ADDR32(dst, 0));
+          GNET_SOCKADDR_FAMILY(*sa) = AF_INET6;
+	  GNET_SOCKADDR_SET_SS_LEN(*sa);
+          GNET_SOCKADDR_PORT_SET(*sa, GNET_INETADDR_PORT(dst));
+          GNET_SOCKADDR_ADDR32_SET(*sa, 0, 0);
+          GNET_SOCKADDR_ADDR32_SET(*sa, 1, 0);
+          GNET_SOCKADDR_ADDR32_SET(*sa, 2, g_htonl(0xffff));
+          GNET_SOCKADDR_ADDR32_SET(*sa, 3, GNET_INETADDR_ADDR32(dst, 0));
 	}
 
       /* If dst is IPv6, map to IPv4 if possible */
@@ -295,22 +311,53 @@ gnet_udp_socket_send (GUdpSocket* socket,
                GNET_SOCKADDR_FAMILY(socket->sa) == AF_INET &&
                IN6_IS_ADDR_V4MAPPED(&GNET_INETADDR_SA6(dst).sin6_addr))
 	{
-          GNET_SOCKADDR_FAMILY(sa) = AF_INET;
-	  GNET_SOCKADDR_SET_SS_LEN(sa);
-          GNET_SOCKADDR_PORT_SET(sa, GNET_INETADDR_PORT(dst));
-          GNET_SOCKADDR_ADDR32_SET(sa, 0, GNET_INETADDR_ADDR32(dst, 3));
+          GNET_SOCKADDR_FAMILY(*sa) = AF_INET;
+	  GNET_SOCKADDR_SET_SS_LEN(*sa);
+          GNET_SOCKADDR_PORT_SET(*sa, GNET_INETADDR_PORT(dst));
+          GNET_SOCKADDR_ADDR32_SET(*sa, 0, GNET_INETADDR_ADDR32(dst, 3));
 	}
       else
-        return -1;
+        return FALSE;
 
     }
     /* Addresses match - just copy the address */
     else
 #endif
       {
-	sa = dst->sa;
+	*sa = dst->sa;
       }
 
+  return TRUE;
+}
+
+
+/**
+ *  gnet_udp_socket_send
+ *  @socket: a #GUdpSocket
+ *  @buffer: buffer to send
+ *  @length: length of @buffer
+ *  @dst: destination address
+ *
+ *  Sends data to a host using a #GUdpSocket.
+ *
+ *  Returns: 0 if successful; something else on error.
+ *
+ **/
+gint 
+gnet_udp_socket_send (GUdpSocket* socket, 
+		      const gchar* buffer, gint length, 
+		      const GInetAddr* dst)
+{
+  gint bytes_sent;
+  struct sockaddr_storage sa;
+
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), -1);
+  g_return_val_if_fail (dst != NULL, -1);
+  g_return_val_if_fail (buffer != NULL, -1);
+
+  if (!udp_socket_dst_sockaddr (socket, dst, &sa))
+    return -1;
 
   bytes_sent = sendto (socket->sockfd,
                        (void*) buffer, length, 0,
@@ -333,7 +380,8 @@ gnet_udp_socket_send (GUdpSocket* socket,
  *
  *  Receives data using a #GUdpSocket.  If @src is set, the source
  *  address is stored in the location @src points to.  The address is
- *  caller owned.
+ *  caller owned.  Use gnet_udp_socket_receive_into() to avoid
+ *  allocating an address for every datagram.
  *
  *  Returns: the number of bytes received, -1 on error.
  *
@@ -369,85 +417,1416 @@ gnet_udp_socket_receive (GUdpSocket* socket,
 }
 
 
-#ifndef GNET_WIN32  /*********** Unix code ***********/
+/* The address of @addr is about to change; drop its cached name */
+static void
+udp_inetaddr_clear_name (GInetAddr* addr)
+{
+  g_free (addr->name);
+  addr->name = NULL;
+}
 
 
 /**
- *  gnet_udp_socket_has_packet
+ *  gnet_udp_socket_send_batch
  *  @socket: a #GUdpSocket
+ *  @packets: packets to send
+ *  @n_packets: number of packets in @packets
  *
- *  Tests if a #GUdpSocket has a packet waiting to be received.
+ *  Sends several datagrams using a #GUdpSocket.  Each packet is sent
+ *  to its own address, like with gnet_udp_socket_send().  On Linux
+ *  the packets are passed to the kernel with as few sendmmsg() calls
+ *  as possible; elsewhere they are sent one by one.
  *
- *  Returns: TRUE if there is packet waiting, FALSE otherwise.
+ *  Sending stops at the first packet that can not be sent.
  *
+ *  Returns: the number of packets sent, which is less than
+ *  @n_packets if a packet could not be sent; -1 if no packet could
+ *  be sent.
+ *
+ *  Since: 2.0.9
  **/
-gboolean
-gnet_udp_socket_has_packet (const GUdpSocket* socket)
+gint
+gnet_udp_socket_send_batch (GUdpSocket* socket,
+			    const GUdpPacket* packets, gint n_packets)
 {
-  fd_set readfds;
-  struct timeval timeout = {0, 0};
+  gint sent = 0;
 
-  g_return_val_if_fail (socket != NULL, FALSE);
-  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), FALSE);
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), -1);
+  g_return_val_if_fail (n_packets >= 0, -1);
+  g_return_val_if_fail (packets != NULL || n_packets == 0, -1);
 
-  FD_ZERO (&readfds);
-  FD_SET (socket->sockfd, &readfds);
-  if ((select(socket->sockfd + 1, &readfds, NULL, NULL, &timeout)) == 1)
+#ifdef HAVE_SENDMMSG
+  while (udp_mmsg_supported && sent < n_packets)
     {
-      return TRUE;
+      struct mmsghdr msgs[UDP_BATCH_MAX];
+      struct iovec iovs[UDP_BATCH_MAX];
+      struct sockaddr_storage sas[UDP_BATCH_MAX];
+      gint n = MIN (n_packets - sent, UDP_BATCH_MAX);
+      gboolean stop;
+      gint i;
+      gint rv;
+
+      memset (msgs, 0, n * sizeof (struct mmsghdr));
+      for (i = 0; i < n; ++i)
+	{
+	  const GUdpPacket* packet = &packets[sent + i];
+
+	  /* Stop in front of a packet that can not be sent */
+	  if (packet->buffer == NULL || packet->addr == NULL ||
+	      !udp_socket_dst_sockaddr (socket, packet->addr, &sas[i]))
+	    break;
+
+	  iovs[i].iov_base = packet->buffer;
+	  iovs[i].iov_len = packet->length;
+	  msgs[i].msg_hdr.msg_name = &sas[i];
+	  msgs[i].msg_hdr.msg_namelen = GNET_SOCKADDR_LEN(sas[i]);
+	  msgs[i].msg_hdr.msg_iov = &iovs[i];
+	  msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+      if (i == 0)
+	break;
+      stop = (i < n);
+      n = i;
+
+      rv = sendmmsg (socket->sockfd, msgs, n, 0);
+      if (rv < 0)
+	{
+	  if (errno == ENOSYS)
+	    {
+	      udp_mmsg_supported = FALSE;
+	      break;
+	    }
+	  return (sent > 0) ? sent : -1;
+	}
+
+      sent += rv;
+      if (rv < n || stop)
+	return sent;
     }
 
-  return FALSE;
-}
+  if (udp_mmsg_supported || sent == n_packets)
+    return (sent > 0 || n_packets == 0) ? sent : -1;
+#endif
 
+  for (; sent < n_packets; ++sent)
+    {
+      const GUdpPacket* packet = &packets[sent];
 
-#else	/*********** Windows code ***********/
+      if (packet->buffer == NULL || packet->addr == NULL ||
+	  gnet_udp_socket_send (socket, packet->buffer, packet->length,
+				packet->addr) != 0)
+	break;
+    }
 
+  return (sent > 0 || n_packets == 0) ? sent : -1;
+}
 
-gboolean
-gnet_udp_socket_has_packet (const GUdpSocket* socket)
+
+/* Receives one datagram into @packet.  If @block is FALSE, returns -1
+   if no datagram is waiting. */
+static gint
+udp_socket_receive_packet (GUdpSocket* socket, GUdpPacket* packet,
+			   gboolean block)
 {
   gint bytes_received;
-  gchar data[1];
-  guint packetlength;
-  u_long arg;
-  gint error;
+  struct sockaddr_storage sa;
+  struct sockaddr_storage* sap;
+  socklen_t sa_len = sizeof (struct sockaddr_storage);
+  gint flags = 0;
 
-  g_return_val_if_fail (socket != NULL, FALSE);
-  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), FALSE);
+  /* Receive the source straight into the caller's address */
+  sap = packet->addr ? &packet->addr->sa : &sa;
 
-  arg = 1;
-  ioctlsocket(socket->sockfd, FIONBIO, &arg); /* set to non-blocking mode */
+  if (!block)
+    {
+#ifdef MSG_DONTWAIT
+      flags = MSG_DONTWAIT;
+#else
+      if (!gnet_udp_socket_has_packet (socket))
+	return -1;
+#endif
+    }
 
-  packetlength = 1;
-  bytes_received = recvfrom(socket->sockfd, (void*) data, packetlength, 
-			    MSG_PEEK, NULL, NULL);
+  bytes_received = recvfrom (socket->sockfd,
+			     (void*) packet->buffer, packet->length,
+			     flags, (struct sockaddr*) sap, &sa_len);
+  if (bytes_received == -1)
+    return -1;
 
-  error = WSAGetLastError();
+  packet->received = bytes_received;
+  if (packet->addr)
+    udp_inetaddr_clear_name (packet->addr);
 
-  arg = 0;
-  ioctlsocket(socket->sockfd, FIONBIO, &arg); /* set blocking mode */
+  return bytes_received;
+}
 
-  if (bytes_received == SOCKET_ERROR)
+
+/**
+ *  gnet_udp_socket_receive_into
+ *  @socket: a #GUdpSocket
+ *  @buffer: buffer to write to
+ *  @length: length of @buffer
+ *  @src: address to store the source address in (optional)
+ *
+ *  Receives data using a #GUdpSocket, like gnet_udp_socket_receive(),
+ *  but stores the source address in the existing address @src
+ *  instead of allocating a new one.  Creating @src once (for example
+ *  with gnet_inetaddr_new_bytes()) and reusing it for every datagram
+ *  makes receiving free of memory allocations; the source can then
+ *  be looked up with gnet_inetaddr_hash() and gnet_inetaddr_equal()
+ *  without copying it.  Do not pass an address that is in use as a
+ *  hash table key.
+ *
+ *  Returns: the number of bytes received, -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_udp_socket_receive_into (GUdpSocket* socket,
+			      gchar* buffer, gint length,
+			      GInetAddr* src)
+{
+  GUdpPacket packet;
+
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (buffer != NULL, -1);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), -1);
+
+  packet.buffer = buffer;
+  packet.length = length;
+  packet.addr = src;
+
+  return udp_socket_receive_packet (socket, &packet, TRUE);
+}
+
+
+/**
+ *  gnet_udp_socket_receive_batch
+ *  @socket: a #GUdpSocket
+ *  @packets: packets to receive into
+ *  @n_packets: number of packets in @packets
+ *
+ *  Receives several datagrams using a #GUdpSocket.  For each packet,
+ *  set @buffer and @length to the buffer to receive into, and @addr
+ *  to a #GInetAddr to store the source address in, or NULL if it is
+ *  not needed.  The number of bytes received is stored in @received.
+ *  Reusing the addresses and buffers of @packets for the next call
+ *  makes receiving free of memory allocations.
+ *
+ *  Like gnet_udp_socket_receive(), this function blocks until a
+ *  datagram is available (unless the socket is non-blocking).  It
+ *  then receives the datagrams that are already waiting, up to
+ *  @n_packets, without blocking again.  On Linux this takes one
+ *  recvmmsg() call per 64 datagrams; elsewhere one call per datagram.
+ *
+ *  Returns: the number of packets received; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_udp_socket_receive_batch (GUdpSocket* socket,
+			       GUdpPacket* packets, gint n_packets)
+{
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), -1);
+  g_return_val_if_fail (n_packets >= 0, -1);
+  g_return_val_if_fail (packets != NULL || n_packets == 0, -1);
+
+  return udp_socket_receive_batch (socket, packets, n_packets, TRUE);
+}
+
+
+/* Sets the buffers of up to @n_packets packets to buffers from @pool
+   and returns the number set.  The other buffers are set to NULL. */
+static gint
+udp_packets_alloc (GPacketPool* pool, GUdpPacket* packets, gint n_packets)
+{
+  gint length = gnet_packet_pool_get_slot_size (pool);
+  gint n = 0;
+  gint i;
+
+  for (i = 0; i < n_packets; ++i)
     {
-      if (WSAEMSGSIZE != error)
+      packets[i].buffer = (n == i) ? gnet_packet_pool_alloc (pool) : NULL;
+      packets[i].length = length;
+      packets[i].received = 0;
+      if (packets[i].buffer)
+	++n;
+    }
+
+  return n;
+}
+
+
+/* Releases the pool buffers of @n_packets packets */
+static void
+udp_packets_release (GUdpPacket* packets, gint n_packets)
+{
+  gint i;
+
+  for (i = 0; i < n_packets; ++i)
+    {
+      gnet_packet_buffer_unref (packets[i].buffer);
+      packets[i].buffer = NULL;
+    }
+}
+
+
+/**
+ *  gnet_udp_socket_receive_batch_pooled
+ *  @socket: a #GUdpSocket
+ *  @pool: pool to take the buffers from
+ *  @packets: packets to receive into
+ *  @n_packets: number of packets in @packets
+ *
+ *  Receives several datagrams using a #GUdpSocket, like
+ *  gnet_udp_socket_receive_batch(), into buffers taken from @pool.
+ *  The @buffer and @length of the packets are set by this function;
+ *  set @addr as for gnet_udp_socket_receive_batch().  The buffer of
+ *  each received packet belongs to the caller, who must release it
+ *  with gnet_packet_buffer_unref(), possibly from another thread.
+ *  The buffers of packets that were not received are set to NULL.
+ *  Datagrams longer than the buffers of the pool are truncated.
+ *
+ *  Returns: the number of packets received; 0 if the pool has no
+ *  free buffers; -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_udp_socket_receive_batch_pooled (GUdpSocket* socket, GPacketPool* pool,
+				      GUdpPacket* packets, gint n_packets)
+{
+  gint n, received;
+
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), -1);
+  g_return_val_if_fail (pool != NULL, -1);
+  g_return_val_if_fail (n_packets >= 0, -1);
+  g_return_val_if_fail (packets != NULL || n_packets == 0, -1);
+
+  n = udp_packets_alloc (pool, packets, n_packets);
+  if (n == 0)
+    return 0;
+
+  received = udp_socket_receive_batch (socket, packets, n, TRUE);
+  udp_packets_release (packets + MAX (received, 0), n - MAX (received, 0));
+
+  return received;
+}
+
+
+/* Receives up to @n_packets datagrams.  If @block is TRUE, waits for
+   the first one; otherwise returns -1 if none is pending. */
+static gint
+udp_socket_receive_batch (GUdpSocket* socket, GUdpPacket* packets,
+			  gint n_packets, gboolean block)
+{
+  gint received = 0;
+
+#ifdef HAVE_SENDMMSG
+  while (udp_mmsg_supported && received < n_packets)
+    {
+      struct mmsghdr msgs[UDP_BATCH_MAX];
+      struct iovec iovs[UDP_BATCH_MAX];
+      gint n = MIN (n_packets - received, UDP_BATCH_MAX);
+      gint i;
+      gint rv;
+
+      memset (msgs, 0, n * sizeof (struct mmsghdr));
+      for (i = 0; i < n; ++i)
 	{
-	  return FALSE;
+	  GUdpPacket* packet = &packets[received + i];
+
+	  iovs[i].iov_base = packet->buffer;
+	  iovs[i].iov_len = packet->length;
+	  if (packet->addr)
+	    {
+	      msgs[i].msg_hdr.msg_name = &packet->addr->sa;
+	      msgs[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_storage);
+	    }
+	  msgs[i].msg_hdr.msg_iov = &iovs[i];
+	  msgs[i].msg_hdr.msg_iovlen = 1;
 	}
-      /* else, the buffer was not big enough, which is fine since we
-	 just want to see if a packet is there..*/
+
+      /* Only wait for the first datagram */
+      rv = recvmmsg (socket->sockfd, msgs, n,
+		     (block && received == 0) ? MSG_WAITFORONE : MSG_DONTWAIT,
+		     NULL);
+      if (rv < 0)
+	{
+	  if (errno == ENOSYS)
+	    {
+	      udp_mmsg_supported = FALSE;
+	      break;
+	    }
+	  return (received > 0) ? received : -1;
+	}
+
+      for (i = 0; i < rv; ++i)
+	{
+	  GUdpPacket* packet = &packets[received + i];
+
+	  packet->received = msgs[i].msg_len;
+	  if (packet->addr)
+	    udp_inetaddr_clear_name (packet->addr);
+	}
+
+      received += rv;
+      if (rv < n)
+	return received;
     }
 
-  if (bytes_received)
-    return TRUE;
+  if (udp_mmsg_supported || received == n_packets)
+    return received;
+#endif
 
-  return FALSE;
+  for (; received < n_packets; ++received)
+    {
+      if (udp_socket_receive_packet (socket, &packets[received],
+				     block && received == 0) < 0)
+	break;
+    }
+
+  return (received > 0 || n_packets == 0) ? received : -1;
 }
-	
-#endif		/*********** End Windows code ***********/
 
 
 
+/**
+ *  gnet_udp_socket_send_segments
+ *  @socket: a #GUdpSocket
+ *  @buffer: datagrams to send, back to back
+ *  @length: length of @buffer
+ *  @segment_size: size of each datagram
+ *  @dst: destination address
+ *
+ *  Sends @buffer as a series of datagrams of @segment_size bytes
+ *  each (the last one may be shorter) to @dst.  On Linux, the buffer
+ *  is handed to the kernel in one call per 64 datagrams using UDP
+ *  segmentation offload (UDP_SEGMENT), so the network stack is
+ *  traversed once per call instead of once per datagram.  If the
+ *  kernel or the outgoing interface does not support it, or
+ *  @segment_size does not fit the path, the datagrams not sent yet
+ *  are sent with gnet_udp_socket_send_batch() instead.
+ *  The receiver sees the same datagrams in both cases.
+ *
+ *  Returns: 0 if successful; something else on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_udp_socket_send_segments (GUdpSocket* socket,
+			       const gchar* buffer, gint length,
+			       gint segment_size, const GInetAddr* dst)
+{
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), -1);
+  g_return_val_if_fail (buffer != NULL || length == 0, -1);
+  g_return_val_if_fail (length >= 0, -1);
+  g_return_val_if_fail (segment_size > 0 && segment_size <= 0xFFFF, -1);
+  g_return_val_if_fail (dst != NULL, -1);
+
+  if (length <= segment_size)
+    return gnet_udp_socket_send (socket, buffer, length, dst);
+
+#ifdef HAVE_UDP_GSO
+  if (udp_gso_supported == -1)
+    {
+      int value;
+      socklen_t value_len = sizeof (value);
+
+      udp_gso_supported = (getsockopt (socket->sockfd, IPPROTO_UDP,
+				       UDP_SEGMENT, &value, &value_len) == 0);
+    }
+
+  if (udp_gso_supported)
+    {
+      struct sockaddr_storage sa;
+      gint max_chunk;
+
+      if (!udp_socket_dst_sockaddr (socket, dst, &sa))
+	return -1;
+
+      max_chunk = MIN (UDP_GSO_MAX_SEGMENTS, UDP_GSO_MAX_BYTES / segment_size);
+      max_chunk = MAX (max_chunk, 1) * segment_size;
+
+      while (length > segment_size)
+	{
+	  union {
+	    struct cmsghdr cmsg;
+	    gchar buf[CMSG_SPACE (sizeof (guint16))];
+	  } control;
+	  struct cmsghdr* cmsg;
+	  struct msghdr msg;
+	  struct iovec iov;
+	  gint chunk = MIN (length, max_chunk);
+	  gssize sent;
+
+	  iov.iov_base = (void*) buffer;
+	  iov.iov_len = chunk;
+
+	  memset (&msg, 0, sizeof (msg));
+	  msg.msg_name = &sa;
+	  msg.msg_namelen = GNET_SOCKADDR_LEN(sa);
+	  msg.msg_iov = &iov;
+	  msg.msg_iovlen = 1;
+	  msg.msg_control = control.buf;
+	  msg.msg_controllen = sizeof (control.buf);
+
+	  cmsg = CMSG_FIRSTHDR (&msg);
+	  cmsg->cmsg_level = IPPROTO_UDP;
+	  cmsg->cmsg_type = UDP_SEGMENT;
+	  cmsg->cmsg_len = CMSG_LEN (sizeof (guint16));
+	  *(guint16*) CMSG_DATA (cmsg) = segment_size;
+
+	  sent = sendmsg (socket->sockfd, &msg, 0);
+	  if (sent < 0)
+	    {
+	      if (errno == EINTR)
+		continue;
+
+	      /* EOPNOTSUPP, ENOPROTOOPT: no offload at all, so stop
+		 trying it.  EIO: the interface can not checksum the
+		 segments.  EINVAL, EMSGSIZE: the segments do not fit
+		 the path.  Those depend on the route and the segment
+		 size, so only this call does without it.  The
+		 datagrams can still be sent one by one. */
+	      if (errno == EOPNOTSUPP || errno == ENOPROTOOPT)
+		{
+		  udp_gso_supported = 0;
+		  break;
+		}
+	      if (errno == EIO || errno == EINVAL || errno == EMSGSIZE)
+		break;
+	      return -1;
+	    }
+
+	  /* After a short send, continue after the whole segments
+	     that were sent */
+	  if (sent < chunk)
+	    {
+	      sent -= sent % segment_size;
+	      if (sent == 0)
+		break;
+	    }
+
+	  buffer += sent;
+	  length -= sent;
+	}
+
+      if (length <= segment_size)
+	return (length > 0) ? gnet_udp_socket_send (socket, buffer, length, dst) : 0;
+    }
+#endif
+
+  while (length > 0)
+    {
+      GUdpPacket packets[UDP_BATCH_MAX];
+      gint n;
+
+      for (n = 0; n < UDP_BATCH_MAX && length > 0; ++n)
+	{
+	  packets[n].buffer = (gchar*) buffer;
+	  packets[n].length = MIN (length, segment_size);
+	  packets[n].addr = (GInetAddr*) dst;
+
+	  buffer += packets[n].length;
+	  length -= packets[n].length;
+	}
+
+      if (gnet_udp_socket_send_batch (socket, packets, n) != n)
+	return -1;
+    }
+
+  return 0;
+}
+
+
+/**
+ *  gnet_udp_socket_set_receive_offload
+ *  @socket: a #GUdpSocket
+ *  @enable: whether to enable receive offload
+ *
+ *  Enables or disables UDP receive offload (UDP_GRO) for a
+ *  #GUdpSocket.  When it is enabled, the kernel may coalesce
+ *  consecutive datagrams of the same size from the same source into
+ *  one buffer, so they can be received with one call.  Receive with
+ *  gnet_udp_socket_receive_segments() and split the buffer with
+ *  gnet_udp_segments_split() when it is enabled; the other receive
+ *  functions can not tell coalesced datagrams apart.
+ *
+ *  Returns: TRUE if receive offload is now enabled; FALSE if it is
+ *  disabled or not supported.  Receiving with
+ *  gnet_udp_socket_receive_segments() works in either case.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_udp_socket_set_receive_offload (GUdpSocket* socket, gboolean enable)
+{
+  g_return_val_if_fail (socket != NULL, FALSE);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), FALSE);
+
+#ifdef HAVE_UDP_GSO
+  {
+    int value = enable ? 1 : 0;
+
+    if (setsockopt (socket->sockfd, IPPROTO_UDP, UDP_GRO,
+		    (void*) &value, sizeof (value)) == 0)
+      return enable;
+  }
+#endif
+
+  return FALSE;
+}
+
+
+/**
+ *  gnet_udp_socket_receive_segments
+ *  @socket: a #GUdpSocket
+ *  @buffer: buffer to write to
+ *  @length: length of @buffer
+ *  @src: address to store the source address in (optional)
+ *  @segment_size: pointer to store the datagram size in
+ *
+ *  Receives data using a #GUdpSocket, like
+ *  gnet_udp_socket_receive_into().  If receive offload is enabled
+ *  (see gnet_udp_socket_set_receive_offload()), the data may be
+ *  several datagrams from @src of @segment_size bytes each (the last
+ *  one may be shorter).  Otherwise, or if the kernel did not
+ *  coalesce datagrams, @segment_size is set to the number of bytes
+ *  received.  Use gnet_udp_segments_split() to get the datagrams.
+ *  @buffer should be 65535 bytes long, the largest size the kernel
+ *  coalesces into.
+ *
+ *  Returns: the number of bytes received, -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_udp_socket_receive_segments (GUdpSocket* socket,
+				  gchar* buffer, gint length,
+				  GInetAddr* src, gint* segment_size)
+{
+#ifdef HAVE_UDP_GSO
+  union {
+    struct cmsghdr cmsg;
+    gchar buf[CMSG_SPACE (sizeof (int))];
+  } control;
+  struct cmsghdr* cmsg;
+  struct msghdr msg;
+  struct iovec iov;
+#endif
+  gint bytes_received;
+
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (buffer != NULL, -1);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), -1);
+  g_return_val_if_fail (segment_size != NULL, -1);
+
+#ifdef HAVE_UDP_GSO
+  iov.iov_base = buffer;
+  iov.iov_len = length;
+
+  memset (&msg, 0, sizeof (msg));
+  if (src)
+    {
+      msg.msg_name = &src->sa;
+      msg.msg_namelen = sizeof (struct sockaddr_storage);
+    }
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  bytes_received = recvmsg (socket->sockfd, &msg, 0);
+  if (bytes_received == -1)
+    return -1;
+
+  if (src)
+    udp_inetaddr_clear_name (src);
+
+  *segment_size = bytes_received;
+  for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg))
+    {
+      if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+	{
+	  int gso_size;
+
+	  memcpy (&gso_size, CMSG_DATA (cmsg), sizeof (gso_size));
+	  if (gso_size > 0 && gso_size < bytes_received)
+	    *segment_size = gso_size;
+	}
+    }
+#else
+  bytes_received = gnet_udp_socket_receive_into (socket, buffer, length, src);
+  *segment_size = bytes_received;
+#endif
+
+  return bytes_received;
+}
+
+
+/**
+ *  gnet_udp_segments_split
+ *  @buffer: buffer received with gnet_udp_socket_receive_segments()
+ *  @length: number of bytes in @buffer
+ *  @segment_size: the datagram size
+ *  @packets: packets to fill in (optional)
+ *  @n_packets: number of packets in @packets
+ *
+ *  Splits a buffer received with gnet_udp_socket_receive_segments()
+ *  into datagrams without copying.  For each datagram, @buffer of
+ *  the packet is set to the start of the datagram within @buffer,
+ *  and @length and @received are set to its size.  @addr is not
+ *  changed.  At most @n_packets packets are filled in.
+ *
+ *  Returns: the number of datagrams in @buffer, which may be more
+ *  than @n_packets.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_udp_segments_split (gchar* buffer, gint length, gint segment_size,
+			 GUdpPacket* packets, gint n_packets)
+{
+  gint n;
+  gint i;
+
+  g_return_val_if_fail (length >= 0, 0);
+  g_return_val_if_fail (segment_size > 0, 0);
+  g_return_val_if_fail (packets != NULL || n_packets == 0, 0);
+
+  n = (length + segment_size - 1) / segment_size;
+
+  for (i = 0; i < n && i < n_packets; ++i)
+    {
+      packets[i].buffer = buffer + i * segment_size;
+      packets[i].length = MIN (segment_size, length - i * segment_size);
+      packets[i].received = packets[i].length;
+    }
+
+  return n;
+}
+
+
+/* Receive with destination address */
+
+/* Asks the kernel for the destination address of every datagram.
+   Done on first use for UDP sockets, since it costs a control message
+   per datagram. */
+void
+_gnet_udp_socket_enable_pktinfo (GUdpSocket* socket)
+{
+#if defined(IP_PKTINFO) || (defined(HAVE_IPV6) && defined(IPV6_RECVPKTINFO))
+  const int on = 1;
+#endif
+
+  if (socket->pktinfo)
+    return;
+  socket->pktinfo = TRUE;
+
+  /* Learn the port if the system picked it, for the destinations */
+  if (GNET_SOCKADDR_PORT (socket->sa) == 0)
+    {
+      struct sockaddr_storage sa;
+      socklen_t len = sizeof (sa);
+
+      if (getsockname (socket->sockfd, &GNET_SOCKADDR_SA (sa), &len) == 0)
+	{
+	  GNET_SOCKADDR_PORT_SET (socket->sa, GNET_SOCKADDR_PORT (sa));
+	}
+    }
+
+  /* Also set on IPv6 sockets, for IPv4 datagrams to mapped addresses */
+#ifdef IP_PKTINFO
+  setsockopt (socket->sockfd, IPPROTO_IP, IP_PKTINFO,
+	      (void*) &on, sizeof (on));
+#endif
+#if defined(HAVE_IPV6) && defined(IPV6_RECVPKTINFO)
+  if (GNET_SOCKADDR_FAMILY (socket->sa) == AF_INET6)
+    setsockopt (socket->sockfd, IPPROTO_IPV6, IPV6_RECVPKTINFO,
+		(void*) &on, sizeof (on));
+#endif
+}
+
+
+/* Sets @addr to @family address @addrp and the port of @socket */
+static void
+udp_inetaddr_set_dst (GInetAddr* addr, const GUdpSocket* socket,
+		      gint family, const void* addrp)
+{
+  gushort port = GNET_SOCKADDR_PORT (socket->sa);
+
+  memset (&addr->sa, 0, sizeof (addr->sa));
+  GNET_SOCKADDR_FAMILY (addr->sa) = family;
+  memcpy (GNET_INETADDR_ADDRP (addr), addrp, GNET_INETADDR_ADDRLEN (addr));
+  GNET_INETADDR_PORT_SET (addr, port);
+  GNET_INETADDR_SET_SS_LEN (addr);
+  udp_inetaddr_clear_name (addr);
+}
+
+
+/**
+ *  gnet_udp_socket_receive_with_info
+ *  @socket: a #GUdpSocket
+ *  @buffer: buffer to write to
+ *  @length: length of @buffer
+ *  @src: address to store the source address in (optional)
+ *  @info: information to fill in
+ *
+ *  Receives data using a #GUdpSocket, like
+ *  gnet_udp_socket_receive_into(), and reports where the datagram
+ *  was sent to: the destination address is stored in @info->dst (if
+ *  set) and the index of the interface it arrived on in
+ *  @info->ifindex.  For a socket that has joined several multicast
+ *  groups, the destination address is the group the datagram was
+ *  sent to.  The port of the destination address is the port of the
+ *  socket.
+ *
+ *  The destination is read from IP_PKTINFO (IPV6_PKTINFO for IPv6)
+ *  control messages.  A #GUdpSocket enables them on the first call,
+ *  so datagrams that were already waiting may be reported without
+ *  interface; a #GMcastSocket enables them when it is created.
+ *  Where they are not available, the destination address is the
+ *  address the socket is bound to and the interface index is 0.
+ *
+ *  If #GNET_SOCKET_OPTION_TIMESTAMPNS is enabled on the socket,
+ *  @info->timestamp is the time the kernel received the datagram.
+ *  Compare it to the current time (clock_gettime() with
+ *  CLOCK_REALTIME) to measure how long the datagram waited in the
+ *  socket's queue and in the application.  If
+ *  #GNET_SOCKET_OPTION_RXQ_OVFL is enabled, @info->drops is the
+ *  number of datagrams the socket dropped up to the time the datagram
+ *  was queued; an increase means datagrams were lost in between.
+ *
+ *  Returns: the number of bytes received, -1 on error.
+ *
+ *  Since: 2.0.9
+ **/
+gint
+gnet_udp_socket_receive_with_info (GUdpSocket* socket,
+				   gchar* buffer, gint length,
+				   GInetAddr* src, GUdpPacketInfo* info)
+{
+  g_return_val_if_fail (socket != NULL, -1);
+  g_return_val_if_fail (buffer != NULL, -1);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), -1);
+  g_return_val_if_fail (info != NULL, -1);
+
+  return _gnet_udp_socket_receive_with_info (socket, buffer, length,
+					     src, info, TRUE);
+}
+
+
+gint
+_gnet_udp_socket_receive_with_info (GUdpSocket* socket,
+				    gchar* buffer, gint length,
+				    GInetAddr* src, GUdpPacketInfo* info,
+				    gboolean block)
+{
+  gint bytes_received;
+#ifndef GNET_WIN32
+  union {
+    struct cmsghdr cmsg;
+    gchar buf[256];
+  } control;
+  struct cmsghdr* cmsg;
+  struct msghdr msg;
+  struct iovec iov;
+  gint flags = 0;
+
+  _gnet_udp_socket_enable_pktinfo (socket);
+
+  iov.iov_base = buffer;
+  iov.iov_len = length;
+
+  memset (&msg, 0, sizeof (msg));
+  if (src)
+    {
+      msg.msg_name = &src->sa;
+      msg.msg_namelen = sizeof (struct sockaddr_storage);
+    }
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  if (!block)
+    flags = MSG_DONTWAIT;
+
+  bytes_received = recvmsg (socket->sockfd, &msg, flags);
+  if (bytes_received == -1)
+    return -1;
+
+  if (src)
+    udp_inetaddr_clear_name (src);
+
+  if (info->dst)
+    {
+      memcpy (&info->dst->sa, &socket->sa, sizeof (info->dst->sa));
+      udp_inetaddr_clear_name (info->dst);
+    }
+  info->ifindex = 0;
+  info->drops = 0;
+  info->timestamp = 0;
+
+  for (cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg))
+    {
+#ifdef SCM_TIMESTAMPNS
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+	{
+	  struct timespec ts;
+
+	  memcpy (&ts, CMSG_DATA (cmsg), sizeof (ts));
+	  info->timestamp = (guint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+	}
+#endif
+#ifdef SO_RXQ_OVFL
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+	{
+	  guint32 drops;
+
+	  memcpy (&drops, CMSG_DATA (cmsg), sizeof (drops));
+	  info->drops = drops;
+	}
+#endif
+#ifdef IP_PKTINFO
+      if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO)
+	{
+	  struct in_pktinfo pktinfo;
+
+	  memcpy (&pktinfo, CMSG_DATA (cmsg), sizeof (pktinfo));
+	  if (info->dst)
+	    udp_inetaddr_set_dst (info->dst, socket, AF_INET,
+				  &pktinfo.ipi_addr);
+	  if (pktinfo.ipi_ifindex)
+	    info->ifindex = pktinfo.ipi_ifindex;
+	}
+#endif
+#if defined(HAVE_IPV6) && defined(IPV6_PKTINFO)
+      if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO)
+	{
+	  struct in6_pktinfo pktinfo;
+
+	  memcpy (&pktinfo, CMSG_DATA (cmsg), sizeof (pktinfo));
+	  /* IPv4 datagrams may be reported with a mapped address too */
+	  if (info->dst && IN6_IS_ADDR_V4MAPPED (&pktinfo.ipi6_addr))
+	    udp_inetaddr_set_dst (info->dst, socket, AF_INET,
+				  &pktinfo.ipi6_addr.s6_addr[12]);
+	  else if (info->dst)
+	    udp_inetaddr_set_dst (info->dst, socket, AF_INET6,
+				  &pktinfo.ipi6_addr);
+	  if (pktinfo.ipi6_ifindex)
+	    info->ifindex = pktinfo.ipi6_ifindex;
+	}
+#endif
+    }
+#else
+  GUdpPacket packet;
+
+  packet.buffer = buffer;
+  packet.length = length;
+  packet.addr = src;
+  bytes_received = udp_socket_receive_packet (socket, &packet, block);
+  if (bytes_received == -1)
+    return -1;
+
+  if (info->dst)
+    {
+      memcpy (&info->dst->sa, &socket->sa, sizeof (info->dst->sa));
+      udp_inetaddr_clear_name (info->dst);
+    }
+  info->ifindex = 0;
+  info->drops = 0;
+  info->timestamp = 0;
+#endif
+
+  return bytes_received;
+}
+
+
+/* Asynchronous receive */
+
+/* Datagrams received per batch by gnet_udp_socket_receive_async() */
+#define UDP_ASYNC_BATCH		16
+/* Datagrams handled per wakeup at most, so a flood of datagrams can
+   not starve the other sources of the main loop */
+#define UDP_ASYNC_BUDGET	1024
+/* Default buffer size: the largest possible datagram */
+#define UDP_ASYNC_MAX_SIZE	65535
+
+typedef struct _GUdpSocketReceiveState
+{
+  GUdpSocketReceiveFunc	func;
+  gpointer		data;
+  GDestroyNotify	notify;
+
+  GMainContext*		context;
+  guint			watch;
+
+  gboolean		dispatching;
+  gboolean		canceled;
+
+  gchar*		buffers;
+  GUdpPacket		packets[UDP_ASYNC_BATCH];
+
+  GPacketPool*		pool;	/* buffers are taken from here if set */
+
+} GUdpSocketReceiveState;
+
+
+static void udp_socket_receive_async (GUdpSocket* socket,
+				      GUdpSocketReceiveFunc func,
+				      gpointer data, GDestroyNotify notify,
+				      gint max_size, GPacketPool* pool,
+				      GMainContext* context, gint priority);
+static gboolean udp_socket_receive_async_cb (GIOChannel* iochannel,
+					     GIOCondition condition,
+					     gpointer data);
+
+static void
+udp_socket_receive_state_free (GUdpSocketReceiveState* state)
+{
+  gint i;
+
+  for (i = 0; i < UDP_ASYNC_BATCH; ++i)
+    gnet_inetaddr_unref (state->packets[i].addr);
+  g_free (state->buffers);
+  if (state->pool)
+    gnet_packet_pool_unref (state->pool);
+
+  if (state->context)
+    g_main_context_unref (state->context);
+  g_free (state);
+}
+
+
+/**
+ *  gnet_udp_socket_receive_async
+ *  @socket: a #GUdpSocket
+ *  @func: callback function
+ *  @data: data to pass to @func on callback
+ *
+ *  Asynchronously receives datagrams using a #GUdpSocket.  The
+ *  callback is called once for every datagram received, until
+ *  gnet_udp_socket_receive_async_cancel() is called or an error
+ *  occurs.  Uses the default main context and priority.  See
+ *  gnet_udp_socket_receive_async_full().
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_udp_socket_receive_async (GUdpSocket* socket,
+			       GUdpSocketReceiveFunc func, gpointer data)
+{
+  gnet_udp_socket_receive_async_full (socket, func, data, NULL, 0,
+				      NULL, G_PRIORITY_DEFAULT);
+}
+
+
+/**
+ *  gnet_udp_socket_receive_async_full
+ *  @socket: a #GUdpSocket
+ *  @func: callback function
+ *  @data: data to pass to @func on callback
+ *  @notify: function to call to free @data, or NULL
+ *  @max_size: size of the largest datagram to receive, or 0 for the
+ *    largest possible datagram.  Longer datagrams are truncated.
+ *  @context: the #GMainContext to receive in, or NULL for the default
+ *    context
+ *  @priority: the priority of the receive watch
+ *
+ *  Asynchronously receives datagrams using a #GUdpSocket.  The
+ *  callback is called once for every datagram received, until
+ *  gnet_udp_socket_receive_async_cancel() is called or an error
+ *  occurs.  When the socket becomes readable, all the datagrams that
+ *  are waiting are received in batches (see
+ *  gnet_udp_socket_receive_batch()) into buffers that are allocated
+ *  once and reused, so receiving does not allocate memory.  At most
+ *  1024 datagrams are handled per main loop iteration.
+ *
+ *  Only one asynchronous receive can be active on a socket at a time.
+ *  @notify is called when receiving stops.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_udp_socket_receive_async_full (GUdpSocket* socket,
+				    GUdpSocketReceiveFunc func,
+				    gpointer data, GDestroyNotify notify,
+				    gint max_size, GMainContext* context,
+				    gint priority)
+{
+  g_return_if_fail (socket != NULL);
+  g_return_if_fail (GNET_IS_UDP_SOCKET (socket));
+  g_return_if_fail (func != NULL);
+  g_return_if_fail (max_size >= 0);
+  g_return_if_fail (socket->receive_state == NULL);
+
+  udp_socket_receive_async (socket, func, data, notify, max_size, NULL,
+			    context, priority);
+}
+
+
+/**
+ *  gnet_udp_socket_receive_async_pooled
+ *  @socket: a #GUdpSocket
+ *  @pool: pool to take the buffers from
+ *  @func: callback function
+ *  @data: data to pass to @func on callback
+ *  @notify: function to call to free @data, or NULL
+ *  @context: the #GMainContext to receive in, or NULL for the default
+ *    context
+ *  @priority: the priority of the receive watch
+ *
+ *  Asynchronously receives datagrams using a #GUdpSocket, like
+ *  gnet_udp_socket_receive_async_full(), into buffers taken from
+ *  @pool.  The buffer passed to the callback is released when the
+ *  callback returns; to keep it, for example to hand it to another
+ *  thread, call gnet_packet_buffer_ref() on it and
+ *  gnet_packet_buffer_unref() when done.  Datagrams longer than the
+ *  buffers of the pool are truncated.  Datagrams that arrive while
+ *  all the buffers of the pool are in use are dropped.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_udp_socket_receive_async_pooled (GUdpSocket* socket, GPacketPool* pool,
+				      GUdpSocketReceiveFunc func,
+				      gpointer data, GDestroyNotify notify,
+				      GMainContext* context, gint priority)
+{
+  g_return_if_fail (socket != NULL);
+  g_return_if_fail (GNET_IS_UDP_SOCKET (socket));
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (func != NULL);
+  g_return_if_fail (socket->receive_state == NULL);
+
+  udp_socket_receive_async (socket, func, data, notify,
+			    gnet_packet_pool_get_slot_size (pool), pool,
+			    context, priority);
+}
+
+
+static void
+udp_socket_receive_async (GUdpSocket* socket, GUdpSocketReceiveFunc func,
+			  gpointer data, GDestroyNotify notify,
+			  gint max_size, GPacketPool* pool,
+			  GMainContext* context, gint priority)
+{
+  GUdpSocketReceiveState* state;
+  GIOChannel* iochannel;
+  gint i;
+
+  if (max_size == 0)
+    max_size = UDP_ASYNC_MAX_SIZE;
+
+  state = g_new0 (GUdpSocketReceiveState, 1);
+  state->func = func;
+  state->data = data;
+  state->notify = notify;
+  if (context)
+    state->context = g_main_context_ref (context);
+
+  if (pool)
+    {
+      gnet_packet_pool_ref (pool);
+      state->pool = pool;
+    }
+  else
+    state->buffers = g_malloc (UDP_ASYNC_BATCH * max_size);
+
+  for (i = 0; i < UDP_ASYNC_BATCH; ++i)
+    {
+      GUdpPacket* packet = &state->packets[i];
+
+      if (state->buffers)
+	packet->buffer = state->buffers + i * max_size;
+      packet->length = max_size;
+      packet->addr = g_new0 (GInetAddr, 1);
+      packet->addr->ref_count = 1;
+    }
+
+  socket->receive_state = state;
+
+  iochannel = gnet_udp_socket_get_io_channel (socket);
+  if (priority == G_PRIORITY_DEFAULT)
+    state->watch = _gnet_io_watch_update (context, 0, iochannel,
+					  G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+					  udp_socket_receive_async_cb, socket);
+  else
+    state->watch = _gnet_io_watch_add_full (context, priority, iochannel,
+					    G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+					    udp_socket_receive_async_cb, socket,
+					    NULL);
+}
+
+
+static gboolean
+udp_socket_receive_async_cb (GIOChannel* iochannel, GIOCondition condition,
+			     gpointer data)
+{
+  GUdpSocket* socket = (GUdpSocket*) data;
+  GUdpSocketReceiveState* state = socket->receive_state;
+  gboolean rv = TRUE;
+
+  g_assert (state != NULL);
+
+  /* Do upcalls, protected by a ref */
+  gnet_udp_socket_ref (socket);
+  state->dispatching = TRUE;
+
+  if (condition & G_IO_IN)
+    {
+      gint budget = UDP_ASYNC_BUDGET;
+
+      while (budget > 0 && !state->canceled)
+	{
+	  gint m = MIN (budget, UDP_ASYNC_BATCH);
+	  gint n, i;
+
+	  if (state->pool)
+	    {
+	      m = udp_packets_alloc (state->pool, state->packets, m);
+	      if (m == 0)
+		{
+		  GUdpPacket drop;
+		  gchar c;
+
+		  /* No buffer is free: drop the datagram */
+		  drop.buffer = &c;
+		  drop.length = 0;
+		  drop.addr = NULL;
+		  if (udp_socket_receive_packet (socket, &drop, FALSE) < 0)
+		    break;
+		  --budget;
+		  continue;
+		}
+	    }
+
+	  /* Errors (for example, ICMP errors reported on the socket)
+	     do not stop receiving.  The watch fires again if more
+	     datagrams are waiting.  A pending error without datagrams
+	     is cleared below. */
+	  n = udp_socket_receive_batch (socket, state->packets, m, FALSE);
+	  if (n > 0)
+	    budget -= n;
+
+	  for (i = 0; i < n && !state->canceled; ++i)
+	    {
+	      GUdpPacket* packet = &state->packets[i];
+
+	      (state->func)(socket, packet->buffer, packet->received,
+			    packet->addr, state->data);
+	    }
+
+	  if (state->pool)
+	    udp_packets_release (state->packets, m);
+
+	  if (n < UDP_ASYNC_BATCH)
+	    break;
+	}
+    }
+  else
+    {
+      socklen_t len = sizeof (gint);
+      gint error;
+
+      /* G_IO_ERR alone is a pending error, like an ICMP error.
+	 Reading it clears it and receiving goes on.  Anything else
+	 is irrecoverable. */
+      if (condition != G_IO_ERR ||
+	  getsockopt (socket->sockfd, SOL_SOCKET, SO_ERROR,
+		      (void*) &error, &len) < 0)
+	{
+	  (state->func)(socket, NULL, -1, NULL, state->data);
+	  if (!state->canceled)
+	    gnet_udp_socket_receive_async_cancel (socket);
+	}
+    }
+
+  state->dispatching = FALSE;
+  if (state->canceled)
+    {
+      udp_socket_receive_state_free (state);
+      rv = FALSE;
+    }
+
+  gnet_udp_socket_unref (socket);
+
+  return rv;
+}
+
+
+/**
+ *  gnet_udp_socket_receive_async_cancel
+ *  @socket: a #GUdpSocket
+ *
+ *  Stops asynchronously receiving datagrams with a #GUdpSocket.  The
+ *  socket is not closed.  This may be called from the receive
+ *  callback; the datagrams of the current batch that have not been
+ *  passed to the callback yet are then dropped.
+ *
+ *  Since: 2.0.9
+ **/
+void
+gnet_udp_socket_receive_async_cancel (GUdpSocket* socket)
+{
+  GUdpSocketReceiveState* state;
+
+  g_return_if_fail (socket != NULL);
+  g_return_if_fail (GNET_IS_UDP_SOCKET (socket));
+
+  state = socket->receive_state;
+  if (!state)
+    return;
+
+  socket->receive_state = NULL;
+  state->canceled = TRUE;
+  _gnet_io_watch_remove (state->context, state->watch);
+  state->watch = 0;
+
+  if (state->notify)
+    (state->notify)(state->data);
+
+  /* Freed by the callback if it is running */
+  if (!state->dispatching)
+    udp_socket_receive_state_free (state);
+}
+
+#ifndef GNET_WIN32  /*********** Unix code ***********/
+
+
+/**
+ *  gnet_udp_socket_has_packet
+ *  @socket: a #GUdpSocket
+ *
+ *  Tests if a #GUdpSocket has a packet waiting to be received.
+ *
+ *  Returns: TRUE if there is packet waiting, FALSE otherwise.
+ *
+ **/
+gboolean
+gnet_udp_socket_has_packet (const GUdpSocket* socket)
+{
+  fd_set readfds;
+  struct timeval timeout = {0, 0};
+
+  g_return_val_if_fail (socket != NULL, FALSE);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), FALSE);
+
+  FD_ZERO (&readfds);
+  FD_SET (socket->sockfd, &readfds);
+  if ((select(socket->sockfd + 1, &readfds, NULL, NULL, &timeout)) == 1)
+    {
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+
+#else	/*********** Windows code ***********/
+
+
+gboolean
+gnet_udp_socket_has_packet (const GUdpSocket* socket)
+{
+  gint bytes_received;
+  gchar data[1];
+  guint packetlength;
+  u_long arg;
+  gint error;
+
+  g_return_val_if_fail (socket != NULL, FALSE);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), FALSE);
+
+  arg = 1;
+  ioctlsocket(socket->sockfd, FIONBIO, &arg); /* set to non-blocking mode */
+
+  packetlength = 1;
+  bytes_received = recvfrom(socket->sockfd, (void*) data, packetlength, 
+			    MSG_PEEK, NULL, NULL);
+
+  error = WSAGetLastError();
+
+  arg = 0;
+  ioctlsocket(socket->sockfd, FIONBIO, &arg); /* set blocking mode */
+
+  if (bytes_received == SOCKET_ERROR)
+    {
+      if (WSAEMSGSIZE != error)
+	{
+	  return FALSE;
+	}
+      /* else, the buffer was not big enough, which is fine since we
+	 just want to see if a packet is there..*/
+    }
+
+  if (bytes_received)
+    return TRUE;
+
+  return FALSE;
+}
+	
+#endif		/*********** End Windows code ***********/
+
+
+
+/**
+ *  gnet_udp_socket_set_option
+ *  @socket: a #GUdpSocket
+ *  @option: option to set
+ *  @value: value of the option
+ *
+ *  Sets a socket option of a #GUdpSocket.  See #GNetSocketOption for
+ *  the options and their values.  The TCP options can not be set.
+ *
+ *  Returns: TRUE if the option was set; FALSE if it is not supported
+ *  or the value is invalid.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_udp_socket_set_option (GUdpSocket* socket, GNetSocketOption option,
+			    gint value)
+{
+  g_return_val_if_fail (socket != NULL, FALSE);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), FALSE);
+
+  return _gnet_socket_set_option (socket->sockfd, option, value);
+}
+
+
+/**
+ *  gnet_udp_socket_get_option
+ *  @socket: a #GUdpSocket
+ *  @option: option to get
+ *  @value: pointer to store the value in
+ *
+ *  Gets a socket option of a #GUdpSocket.  See
+ *  gnet_tcp_socket_get_option().
+ *
+ *  Returns: TRUE if the option was read; FALSE if it is not
+ *  supported.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_udp_socket_get_option (const GUdpSocket* socket,
+			    GNetSocketOption option, gint* value)
+{
+  g_return_val_if_fail (socket != NULL, FALSE);
+  g_return_val_if_fail (GNET_IS_UDP_SOCKET (socket), FALSE);
+  g_return_val_if_fail (value != NULL, FALSE);
+
+  return _gnet_socket_get_option (socket->sockfd, option, value);
+}
+
+
 /**
  *  gnet_udp_socket_get_ttl
  *  @socket: a #GUdpSocket
@@ -22,6 +22,8 @@
 #define _GNET_UDP_H
 
 #include "inetaddr.h"
+#include "sockopt.h"
+#include "pool.h"
 
 #include <glib.h>
 
@@ -40,6 +42,84 @@ extern "C" {
 typedef struct _GUdpSocket GUdpSocket;
 
 
+/**
+ *  GUdpPacket
+ *  @buffer: packet data
+ *  @length: length of the data to send, or size of @buffer when
+ *    receiving
+ *  @received: number of bytes received (set when receiving)
+ *  @addr: destination address when sending; when receiving, an
+ *    address that is overwritten with the source address, or NULL
+ *
+ *  One datagram of a gnet_udp_socket_send_batch() or
+ *  gnet_udp_socket_receive_batch() call.
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GUdpPacket GUdpPacket;
+struct _GUdpPacket
+{
+  gchar*	buffer;
+  gint		length;
+  gint		received;
+  GInetAddr*	addr;
+};
+
+
+/**
+ *  GUdpPacketInfo
+ *  @dst: an address that is overwritten with the destination address
+ *    of the datagram, or NULL.  For multicast datagrams this is the
+ *    group address.
+ *  @ifindex: index of the interface the datagram arrived on (set
+ *    when receiving), or 0 if unknown
+ *  @drops: number of datagrams the socket has dropped so far, because
+ *    its receive buffer was full (set when receiving if
+ *    #GNET_SOCKET_OPTION_RXQ_OVFL is enabled, otherwise 0)
+ *  @timestamp: time the kernel received the datagram, in nanoseconds
+ *    since the epoch (set when receiving if
+ *    #GNET_SOCKET_OPTION_TIMESTAMPNS is enabled, otherwise 0)
+ *
+ *  Information about a datagram received with
+ *  gnet_udp_socket_receive_with_info().
+ *
+ *  Since: 2.0.9
+ **/
+typedef struct _GUdpPacketInfo GUdpPacketInfo;
+struct _GUdpPacketInfo
+{
+  GInetAddr*	dst;
+  gint		ifindex;
+  guint		drops;
+  guint64	timestamp;
+};
+
+
+/**
+ *  GUdpSocketReceiveFunc:
+ *  @socket: the #GUdpSocket
+ *  @buffer: datagram data (callee owned), or NULL on error
+ *  @length: length of @buffer, or -1 on error
+ *  @src: source address (callee owned), or NULL on error
+ *  @data: user data
+ *
+ *  Callback for gnet_udp_socket_receive_async().  @buffer and @src
+ *  are only valid until the callback returns.  @src is reused for
+ *  the next datagram, so copy it with gnet_inetaddr_clone() to keep
+ *  it; a reference would see it change.  Copy @buffer to keep it,
+ *  or reference it with gnet_packet_buffer_ref() if it comes from a
+ *  #GPacketPool (see gnet_udp_socket_receive_async_pooled()).
+ *  Errors reported on the socket, like ICMP errors, do not stop
+ *  receiving.  If the socket had an irrecoverable error, @buffer and
+ *  @src are NULL, @length is -1 and receiving stops.
+ *
+ *  Since: 2.0.9
+ **/
+typedef void (*GUdpSocketReceiveFunc)(GUdpSocket* socket, gchar* buffer,
+				      gint length, GInetAddr* src,
+				      gpointer data);
+
+
 
 /* ******************************************** */
 /* UDP socket functions				*/
@@ -63,14 +143,69 @@ gint 	 gnet_udp_socket_send (GUdpSocket* socket, const gchar* buffer,
  			       gint length, const GInetAddr* dst);
 gint 	 gnet_udp_socket_receive (GUdpSocket* socket, gchar* buffer,
 				  gint length, GInetAddr** src);
+gint	 gnet_udp_socket_receive_into (GUdpSocket* socket, gchar* buffer,
+				       gint length, GInetAddr* src);
+gint	 gnet_udp_socket_receive_with_info (GUdpSocket* socket,
+					    gchar* buffer, gint length,
+					    GInetAddr* src,
+					    GUdpPacketInfo* info);
 gboolean gnet_udp_socket_has_packet (const GUdpSocket* socket);
 
+gint	 gnet_udp_socket_send_batch (GUdpSocket* socket,
+				     const GUdpPacket* packets,
+				     gint n_packets);
+gint	 gnet_udp_socket_receive_batch (GUdpSocket* socket,
+					GUdpPacket* packets,
+					gint n_packets);
+gint	 gnet_udp_socket_receive_batch_pooled (GUdpSocket* socket,
+					       GPacketPool* pool,
+					       GUdpPacket* packets,
+					       gint n_packets);
+
+gint	 gnet_udp_socket_send_segments (GUdpSocket* socket,
+					const gchar* buffer, gint length,
+					gint segment_size,
+					const GInetAddr* dst);
+gboolean gnet_udp_socket_set_receive_offload (GUdpSocket* socket,
+					      gboolean enable);
+gint	 gnet_udp_socket_receive_segments (GUdpSocket* socket,
+					   gchar* buffer, gint length,
+					   GInetAddr* src,
+					   gint* segment_size);
+gint	 gnet_udp_segments_split (gchar* buffer, gint length,
+				  gint segment_size,
+				  GUdpPacket* packets, gint n_packets);
+
+void	 gnet_udp_socket_receive_async (GUdpSocket* socket,
+					GUdpSocketReceiveFunc func,
+					gpointer data);
+void	 gnet_udp_socket_receive_async_full (GUdpSocket* socket,
+					     GUdpSocketReceiveFunc func,
+					     gpointer data,
+					     GDestroyNotify notify,
+					     gint max_size,
+					     GMainContext* context,
+					     gint priority);
+void	 gnet_udp_socket_receive_async_pooled (GUdpSocket* socket,
+					       GPacketPool* pool,
+					       GUdpSocketReceiveFunc func,
+					       gpointer data,
+					       GDestroyNotify notify,
+					       GMainContext* context,
+					       gint priority);
+void	 gnet_udp_socket_receive_async_cancel (GUdpSocket* socket);
+
 
 /* ********** */
 
 gint 	 gnet_udp_socket_get_ttl (const GUdpSocket* socket);
 gint 	 gnet_udp_socket_set_ttl (GUdpSocket* socket, gint ttl);
 
+gboolean gnet_udp_socket_set_option (GUdpSocket* socket,
+				     GNetSocketOption option, gint value);
+gboolean gnet_udp_socket_get_option (const GUdpSocket* socket,
+				     GNetSocketOption option, gint* value);
+
 
 #ifdef __cplusplus
 }
@@ -235,6 +235,53 @@ gnet_unix_socket_get_io_channel (GUnixSocket* socket)
 }
 
 
+/**
+ *  gnet_unix_socket_set_option
+ *  @socket: a #GUnixSocket
+ *  @option: option to set
+ *  @value: value of the option
+ *
+ *  Sets a socket option of a #GUnixSocket.  Only the buffer sizes
+ *  and, on Linux, %GNET_SOCKET_OPTION_BUSY_POLL apply to Unix
+ *  sockets.
+ *
+ *  Returns: TRUE if the option was set; FALSE otherwise.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_unix_socket_set_option (GUnixSocket* socket, GNetSocketOption option,
+			     gint value)
+{
+  g_return_val_if_fail (socket != NULL, FALSE);
+
+  return _gnet_socket_set_option (socket->sockfd, option, value);
+}
+
+
+/**
+ *  gnet_unix_socket_get_option
+ *  @socket: a #GUnixSocket
+ *  @option: option to get
+ *  @value: pointer to store the value in
+ *
+ *  Gets a socket option of a #GUnixSocket.
+ *
+ *  Returns: TRUE if the option was read; FALSE otherwise.
+ *
+ *  Since: 2.0.9
+ **/
+gboolean
+gnet_unix_socket_get_option (const GUnixSocket* socket,
+			     GNetSocketOption option, gint* value)
+{
+  g_return_val_if_fail (socket != NULL, FALSE);
+  g_return_val_if_fail (value != NULL, FALSE);
+
+  return _gnet_socket_get_option (socket->sockfd, option, value);
+}
+
+
 /**
  *  gnet_unix_socket_get_path
  *  @socket: a #GUnixSocket
@@ -22,6 +22,7 @@
 #define _GNET_UNIX_H
 
 #include <glib.h>
+#include "sockopt.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -48,6 +49,13 @@ GIOChannel*  gnet_unix_socket_get_io_channel (GUnixSocket* socket);
 
 gchar*       gnet_unix_socket_get_path (const GUnixSocket* socket);
 
+gboolean     gnet_unix_socket_set_option (GUnixSocket* socket,
+					  GNetSocketOption option,
+					  gint value);
+gboolean     gnet_unix_socket_get_option (const GUnixSocket* socket,
+					  GNetSocketOption option,
+					  gint* value);
+
 GUnixSocket* gnet_unix_socket_server_new (const gchar* path);
 GUnixSocket* gnet_unix_socket_server_new_abstract (const gchar* path);
 
@@ -0,0 +1,1238 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#include "uring-private.h"
+
+#ifdef HAVE_IO_URING
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/io_uring.h>
+
+/* Submission queue size.  The completion queue is bigger since a
+   modified watch produces two completions. */
+#define URING_SQ_ENTRIES	256
+#define URING_CQ_ENTRIES	8192
+
+/* Buffers the kernel picks from for receives.  A receive only takes
+   one when data arrives, and gets it back after its callback, so a
+   few serve any number of sockets. */
+#define URING_BUFFER_GROUP	1
+#define URING_RECV_BUFFERS	64
+#define URING_RECV_BUFFER_SIZE	(16 * 1024)
+
+/* Low word of the user_data of the poll request that an operation
+   waits behind after -EAGAIN; its own completion has 0 */
+#define URING_OP_POLL		1
+
+#define URING_LOAD_ACQUIRE(P)	  __atomic_load_n ((P), __ATOMIC_ACQUIRE)
+#define URING_STORE_RELEASE(P, V) __atomic_store_n ((P), (V), __ATOMIC_RELEASE)
+
+
+typedef struct _UringWatch
+{
+  guint		id;
+  guint		generation;	/* of the poll request in flight */
+  gint		fd;
+  GIOChannel*	channel;
+  GIOCondition	condition;
+  GIOFunc	function;
+  gpointer	data;
+  gint		ref_count;
+  gboolean	armed;		/* poll request in flight */
+  gboolean	dispatching;
+  gboolean	removed;
+
+} UringWatch;
+
+
+typedef struct _UringOp
+{
+  guint		id;
+  guint8	opcode;
+  gint		fd;
+  const gchar*	buffer;		/* of a send */
+  gsize		length;
+  GNetIOFunc	function;
+  gpointer	data;
+  gboolean	polling;	/* waits behind a poll request */
+  gboolean	starved;	/* waits for a receive buffer */
+  gboolean	canceled;
+  GDestroyNotify notify;
+  gpointer	notify_data;
+
+  /* Peer of an accept */
+  struct sockaddr_storage addr;
+  socklen_t	addrlen;
+
+} UringOp;
+
+
+/* A completion reaped while looking for a free SQE, kept for the next
+   dispatch */
+typedef struct _UringCompletion
+{
+  guint64	user_data;
+  gint		res;
+  guint		flags;
+
+} UringCompletion;
+
+
+typedef struct _UringSource
+{
+  GSource	source;
+  GPollFD	pollfd;		/* eventfd signalled on completions */
+  GMainContext* context;
+  GHashTable*	watches;	/* id -> UringWatch */
+  GList*	unarmed;	/* watches waiting for a free SQE */
+  GHashTable*	ops;		/* id -> UringOp */
+  GList*	starved;	/* receives waiting for a buffer */
+  GArray*	backlog;	/* of UringCompletion */
+  gboolean	ops_supported;	/* the kernel runs all opcodes we use */
+  gchar*	recv_buffers;	/* NULL until the first receive */
+
+  /* The ring */
+  gint		ring_fd;
+  guint*	sq_head;
+  guint*	sq_tail;
+  guint*	sq_mask;
+  guint*	sq_array;
+  guint		sq_entries;
+  guint		sq_local_tail;	/* includes unsubmitted entries */
+  guint		to_submit;
+  struct io_uring_sqe* sqes;
+  guint*	cq_head;
+  guint*	cq_tail;
+  guint*	cq_mask;
+  struct io_uring_cqe* cqes;
+
+  gpointer	sq_ring;
+  gsize		sq_ring_size;
+  gpointer	cq_ring;
+  gsize		cq_ring_size;
+  gsize		sqes_size;
+
+} UringSource;
+
+
+static gboolean uring_source_prepare  (GSource* source, gint* timeout);
+static gboolean uring_source_check    (GSource* source);
+static gboolean uring_source_dispatch (GSource* source, GSourceFunc callback,
+				       gpointer user_data);
+static void	uring_source_finalize (GSource* source);
+
+static GSourceFuncs uring_source_funcs =
+{
+  uring_source_prepare,
+  uring_source_check,
+  uring_source_dispatch,
+  uring_source_finalize,
+  NULL,
+  NULL
+};
+
+/* GMainContext -> UringSource.  The source lives as long as its
+   context. */
+static GHashTable* uring_sources = NULL;
+static guint	   uring_next_id = 0;
+G_LOCK_DEFINE_STATIC (uring_sources);
+
+
+
+static gint
+uring_setup (guint entries, struct io_uring_params* params)
+{
+  return (gint) syscall (__NR_io_uring_setup, entries, params);
+}
+
+
+static gint
+uring_enter (gint fd, guint to_submit, guint min_complete, guint flags)
+{
+  return (gint) syscall (__NR_io_uring_enter, fd, to_submit, min_complete,
+			 flags, NULL, 0);
+}
+
+
+gboolean
+_gnet_uring_available (void)
+{
+  static gint available = -1;
+
+  if (available < 0)
+    {
+      struct io_uring_params params;
+      gint fd;
+
+      memset (&params, 0, sizeof (params));
+      fd = uring_setup (1, &params);
+      if (fd >= 0)
+	close (fd);
+      available = (fd >= 0);
+    }
+
+  return available;
+}
+
+
+/* Maps the rings of a freshly set up ring fd */
+static gboolean
+uring_map (UringSource* us, struct io_uring_params* params)
+{
+  gchar* sq;
+  gchar* cq;
+
+  us->sq_ring_size = params->sq_off.array + params->sq_entries * sizeof (guint);
+  us->cq_ring_size = params->cq_off.cqes +
+    params->cq_entries * sizeof (struct io_uring_cqe);
+
+  if (params->features & IORING_FEAT_SINGLE_MMAP)
+    us->sq_ring_size = us->cq_ring_size = MAX(us->sq_ring_size, us->cq_ring_size);
+
+  us->sq_ring = mmap (NULL, us->sq_ring_size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_POPULATE, us->ring_fd, IORING_OFF_SQ_RING);
+  if (us->sq_ring == MAP_FAILED)
+    {
+      us->sq_ring = NULL;
+      return FALSE;
+    }
+
+  if (params->features & IORING_FEAT_SINGLE_MMAP)
+    us->cq_ring = us->sq_ring;
+  else
+    {
+      us->cq_ring = mmap (NULL, us->cq_ring_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, us->ring_fd,
+			  IORING_OFF_CQ_RING);
+      if (us->cq_ring == MAP_FAILED)
+	{
+	  us->cq_ring = NULL;
+	  return FALSE;
+	}
+    }
+
+  us->sqes_size = params->sq_entries * sizeof (struct io_uring_sqe);
+  us->sqes = mmap (NULL, us->sqes_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, us->ring_fd, IORING_OFF_SQES);
+  if (us->sqes == MAP_FAILED)
+    {
+      us->sqes = NULL;
+      return FALSE;
+    }
+
+  sq = (gchar*) us->sq_ring;
+  us->sq_head  = (guint*) (sq + params->sq_off.head);
+  us->sq_tail  = (guint*) (sq + params->sq_off.tail);
+  us->sq_mask  = (guint*) (sq + params->sq_off.ring_mask);
+  us->sq_array = (guint*) (sq + params->sq_off.array);
+  us->sq_entries = params->sq_entries;
+  us->sq_local_tail = *us->sq_tail;
+
+  cq = (gchar*) us->cq_ring;
+  us->cq_head = (guint*) (cq + params->cq_off.head);
+  us->cq_tail = (guint*) (cq + params->cq_off.tail);
+  us->cq_mask = (guint*) (cq + params->cq_off.ring_mask);
+  us->cqes    = (struct io_uring_cqe*) (cq + params->cq_off.cqes);
+
+  return TRUE;
+}
+
+
+static void
+uring_unmap (UringSource* us)
+{
+  if (us->sqes)
+    munmap (us->sqes, us->sqes_size);
+  if (us->cq_ring && us->cq_ring != us->sq_ring)
+    munmap (us->cq_ring, us->cq_ring_size);
+  if (us->sq_ring)
+    munmap (us->sq_ring, us->sq_ring_size);
+}
+
+
+/* Submits all queued SQEs.  Returns FALSE on error, with errno set. */
+static gboolean
+uring_submit (UringSource* us)
+{
+  while (us->to_submit > 0)
+    {
+      gint rv;
+
+      rv = uring_enter (us->ring_fd, us->to_submit, 0, 0);
+      if (rv < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return FALSE;
+	}
+      if (rv == 0)
+	{
+	  errno = EBUSY;
+	  return FALSE;
+	}
+
+      us->to_submit -= rv;
+    }
+
+  return TRUE;
+}
+
+
+/* Moves the completions in the ring to the backlog.  Returns how many
+   were moved. */
+static guint
+uring_reap (UringSource* us)
+{
+  guint head, tail;
+  guint n = 0;
+
+  head = *us->cq_head;
+  tail = URING_LOAD_ACQUIRE (us->cq_tail);
+  while (head != tail)
+    {
+      struct io_uring_cqe* cqe = &us->cqes[head & *us->cq_mask];
+      UringCompletion c;
+
+      c.user_data = cqe->user_data;
+      c.res = cqe->res;
+      c.flags = cqe->flags;
+      g_array_append_val (us->backlog, c);
+      ++head;
+      ++n;
+    }
+  URING_STORE_RELEASE (us->cq_head, head);
+
+  return n;
+}
+
+
+/* Returns a cleared SQE.  If the queue is full, it is submitted; if
+   the kernel refuses more until completions are taken, they are moved
+   to the backlog, or waited for.  Returns NULL only if the ring
+   failed. */
+static struct io_uring_sqe*
+uring_get_sqe (UringSource* us)
+{
+  struct io_uring_sqe* sqe;
+  guint index;
+
+  while (us->sq_local_tail - URING_LOAD_ACQUIRE (us->sq_head) >= us->sq_entries)
+    {
+      if (uring_submit (us))
+	continue;
+      if (errno != EBUSY && errno != EAGAIN)
+	{
+	  g_warning ("io_uring submission failed: %s", g_strerror (errno));
+	  return NULL;
+	}
+
+      if (uring_reap (us) == 0 &&
+	  uring_enter (us->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+	  errno != EINTR)
+	{
+	  g_warning ("io_uring wait failed: %s", g_strerror (errno));
+	  return NULL;
+	}
+    }
+
+  index = us->sq_local_tail & *us->sq_mask;
+  sqe = &us->sqes[index];
+  memset (sqe, 0, sizeof (*sqe));
+  us->sq_array[index] = index;
+
+  return sqe;
+}
+
+
+/* Makes the SQE returned by the last uring_get_sqe() visible to the
+   kernel.  It is submitted in the next prepare. */
+static void
+uring_queue_sqe (UringSource* us)
+{
+  us->sq_local_tail++;
+  URING_STORE_RELEASE (us->sq_tail, us->sq_local_tail);
+  us->to_submit++;
+}
+
+
+static guint64
+uring_watch_user_data (UringWatch* watch)
+{
+  return ((guint64) watch->id << 32) | watch->generation;
+}
+
+
+static gboolean
+uring_watch_arm (UringSource* us, UringWatch* watch)
+{
+  struct io_uring_sqe* sqe;
+  guint32 events;
+
+  sqe = uring_get_sqe (us);
+  if (sqe == NULL)
+    {
+      if (!g_list_find (us->unarmed, watch))
+	us->unarmed = g_list_prepend (us->unarmed, watch);
+      return FALSE;
+    }
+
+  events = 0;
+  if (watch->condition & G_IO_IN)
+    events |= POLLIN;
+  if (watch->condition & G_IO_PRI)
+    events |= POLLPRI;
+  if (watch->condition & G_IO_OUT)
+    events |= POLLOUT;
+
+  watch->generation++;
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = watch->fd;
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+  sqe->poll32_events = (events << 16) | (events >> 16);
+#else
+  sqe->poll32_events = events;
+#endif
+  sqe->user_data = uring_watch_user_data (watch);
+  uring_queue_sqe (us);
+
+  watch->armed = TRUE;
+  if (us->unarmed)
+    us->unarmed = g_list_remove (us->unarmed, watch);
+
+  return TRUE;
+}
+
+
+/* Queues the cancel of the request with @user_data.  The completion
+   of the cancel itself is ignored. */
+static gboolean
+uring_queue_cancel (UringSource* us, guint8 opcode, guint64 user_data)
+{
+  struct io_uring_sqe* sqe;
+
+  sqe = uring_get_sqe (us);
+  if (sqe == NULL)
+    return FALSE;
+
+  sqe->opcode = opcode;
+  sqe->fd = -1;
+  sqe->addr = user_data;
+  sqe->user_data = 0;
+  uring_queue_sqe (us);
+
+  return TRUE;
+}
+
+
+/* Cancels the poll request in flight.  Its completion is ignored since
+   the generation no longer matches.  uring_get_sqe() waits for room,
+   so the cancel is only lost if the ring failed, and the request then
+   completes with an error. */
+static void
+uring_watch_disarm (UringSource* us, UringWatch* watch)
+{
+  if (!watch->armed)
+    return;
+
+  uring_queue_cancel (us, IORING_OP_POLL_REMOVE,
+		      uring_watch_user_data (watch));
+
+  watch->generation++;
+  watch->armed = FALSE;
+}
+
+
+static void
+uring_watch_unref (UringWatch* watch)
+{
+  if (--watch->ref_count > 0)
+    return;
+
+  g_io_channel_unref (watch->channel);
+  g_free (watch);
+}
+
+
+/* **************************************** */
+/* Operations */
+
+
+/* Returns a new watch or operation id */
+static guint
+uring_new_id (void)
+{
+  guint id;
+
+  G_LOCK (uring_sources);
+  do {
+    uring_next_id = (uring_next_id + 1) & ~GNET_WATCH_ID_TAG_MASK;
+    id = uring_next_id | GNET_WATCH_ID_TAG_URING;
+  } while (uring_next_id == 0);
+  G_UNLOCK (uring_sources);
+
+  return id;
+}
+
+
+/* Returns TRUE if the kernel runs every opcode the operations use */
+static gboolean
+uring_probe (gint ring_fd)
+{
+  static const guint8 opcodes[] = {
+    IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL, IORING_OP_PROVIDE_BUFFERS,
+    IORING_OP_RECV, IORING_OP_SEND, IORING_OP_ACCEPT
+  };
+  struct io_uring_probe* probe;
+  gboolean supported = FALSE;
+  guint i;
+
+  probe = g_malloc0 (sizeof (struct io_uring_probe) +
+		     256 * sizeof (struct io_uring_probe_op));
+  if (syscall (__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE,
+	       probe, 256) == 0)
+    {
+      supported = TRUE;
+      for (i = 0; i < G_N_ELEMENTS (opcodes); ++i)
+	if (opcodes[i] >= probe->ops_len ||
+	    !(probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED))
+	  supported = FALSE;
+    }
+  g_free (probe);
+
+  return supported;
+}
+
+
+static guint64
+uring_op_user_data (UringOp* op)
+{
+  return (guint64) op->id << 32;
+}
+
+
+/* Gives @count receive buffers from buffer @bid to the kernel */
+static void
+uring_provide_buffers (UringSource* us, guint bid, guint count)
+{
+  struct io_uring_sqe* sqe;
+
+  sqe = uring_get_sqe (us);
+  if (sqe == NULL)
+    return;
+
+  sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe->fd = count;
+  sqe->addr = (guint64) (gsize) (us->recv_buffers +
+				 bid * URING_RECV_BUFFER_SIZE);
+  sqe->len = URING_RECV_BUFFER_SIZE;
+  sqe->off = bid;
+  sqe->buf_group = URING_BUFFER_GROUP;
+  sqe->user_data = 0;
+  uring_queue_sqe (us);
+}
+
+
+/* Queues the request of @op, behind a poll request if the last try
+   would have blocked.  Returns FALSE if the ring failed. */
+static gboolean
+uring_op_queue (UringSource* us, UringOp* op)
+{
+  struct io_uring_sqe* sqe;
+
+  if (op->polling)
+    {
+      guint32 events = (op->opcode == IORING_OP_SEND) ? POLLOUT : POLLIN;
+
+      sqe = uring_get_sqe (us);
+      if (sqe == NULL)
+	return FALSE;
+
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->fd = op->fd;
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+      sqe->poll32_events = (events << 16) | (events >> 16);
+#else
+      sqe->poll32_events = events;
+#endif
+      sqe->flags = IOSQE_IO_LINK;	/* the operation runs after it */
+      sqe->user_data = uring_op_user_data (op) | URING_OP_POLL;
+      uring_queue_sqe (us);
+    }
+
+  sqe = uring_get_sqe (us);
+  if (sqe == NULL)
+    return FALSE;
+
+  sqe->opcode = op->opcode;
+  sqe->fd = op->fd;
+  switch (op->opcode)
+    {
+    case IORING_OP_RECV:
+      sqe->len = URING_RECV_BUFFER_SIZE;
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = URING_BUFFER_GROUP;
+      break;
+    case IORING_OP_SEND:
+      sqe->addr = (guint64) (gsize) op->buffer;
+      sqe->len = op->length;
+      break;
+    case IORING_OP_ACCEPT:
+      op->addrlen = sizeof (op->addr);
+      sqe->addr = (guint64) (gsize) &op->addr;
+      sqe->addr2 = (guint64) (gsize) &op->addrlen;
+      break;
+    }
+  sqe->user_data = uring_op_user_data (op);
+  uring_queue_sqe (us);
+
+  return TRUE;
+}
+
+
+static void
+uring_op_free (UringOp* op)
+{
+  if (op->notify)
+    (op->notify) (op->notify_data);
+  g_free (op);
+}
+
+
+/* Handles the completion of @op */
+static void
+uring_op_complete (UringSource* us, UringOp* op, gint res, guint flags)
+{
+  gpointer buffer = NULL;
+  gint bid = -1;
+
+  if (flags & IORING_CQE_F_BUFFER)
+    {
+      bid = flags >> IORING_CQE_BUFFER_SHIFT;
+      buffer = us->recv_buffers + bid * URING_RECV_BUFFER_SIZE;
+    }
+
+  /* All buffers are taken: wait until one comes back */
+  if (res == -ENOBUFS && !op->canceled)
+    {
+      op->starved = TRUE;
+      us->starved = g_list_append (us->starved, op);
+      return;
+    }
+
+  /* Would block: wait for the socket first */
+  if (res == -EAGAIN && !op->canceled)
+    {
+      op->polling = TRUE;
+      if (uring_op_queue (us, op))
+	return;
+    }
+
+  g_hash_table_remove (us->ops, GUINT_TO_POINTER (op->id));
+
+  if (op->canceled)
+    {
+      if (op->opcode == IORING_OP_ACCEPT && res >= 0)
+	close (res);
+    }
+  else if (op->opcode == IORING_OP_ACCEPT)
+    (op->function) (res, &op->addr, op->data);
+  else
+    (op->function) (res, buffer, op->data);
+
+  if (bid >= 0)
+    uring_provide_buffers (us, bid, 1);
+
+  uring_op_free (op);
+}
+
+
+/* Queues the cancel of @op, or frees it if it is not in flight */
+static void
+uring_op_cancel (UringSource* us, UringOp* op)
+{
+  op->canceled = TRUE;
+
+  if (op->starved)
+    {
+      us->starved = g_list_remove (us->starved, op);
+      g_hash_table_remove (us->ops, GUINT_TO_POINTER (op->id));
+      uring_op_free (op);
+      return;
+    }
+
+  /* Canceling the poll request fails the operation linked to it */
+  if (op->polling)
+    uring_queue_cancel (us, IORING_OP_ASYNC_CANCEL,
+			uring_op_user_data (op) | URING_OP_POLL);
+  uring_queue_cancel (us, IORING_OP_ASYNC_CANCEL, uring_op_user_data (op));
+}
+
+
+static UringSource*
+uring_source_get (GMainContext* context, gboolean create)
+{
+  UringSource* us;
+  struct io_uring_params params;
+  gint ring_fd, event_fd;
+
+  if (context == NULL)
+    context = g_main_context_default ();
+
+  G_LOCK (uring_sources);
+
+  if (uring_sources == NULL)
+    uring_sources = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  us = g_hash_table_lookup (uring_sources, context);
+  if (us != NULL || !create)
+    goto done;
+
+  memset (&params, 0, sizeof (params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = URING_CQ_ENTRIES;
+  ring_fd = uring_setup (URING_SQ_ENTRIES, &params);
+  if (ring_fd < 0 && errno == EINVAL)	/* old kernel without CQSIZE */
+    {
+      memset (&params, 0, sizeof (params));
+      ring_fd = uring_setup (URING_SQ_ENTRIES, &params);
+    }
+  if (ring_fd < 0)
+    goto done;
+
+  event_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (event_fd < 0)
+    {
+      close (ring_fd);
+      goto done;
+    }
+
+  us = (UringSource*) g_source_new (&uring_source_funcs, sizeof (UringSource));
+  us->ring_fd = ring_fd;
+  us->pollfd.fd = event_fd;
+  us->pollfd.events = G_IO_IN;
+  us->pollfd.revents = 0;
+  us->context = context;
+  us->watches = g_hash_table_new (g_direct_hash, g_direct_equal);
+  us->ops = g_hash_table_new (g_direct_hash, g_direct_equal);
+  us->backlog = g_array_new (FALSE, FALSE, sizeof (UringCompletion));
+  us->ops_supported = uring_probe (ring_fd);
+
+  if (!uring_map (us, &params) ||
+      syscall (__NR_io_uring_register, ring_fd, IORING_REGISTER_EVENTFD,
+	       &event_fd, 1) < 0)
+    {
+      g_source_unref ((GSource*) us);	/* finalize cleans up */
+      us = NULL;
+      goto done;
+    }
+
+  g_source_add_poll ((GSource*) us, &us->pollfd);
+  g_source_attach ((GSource*) us, context);
+  g_source_unref ((GSource*) us);	/* context owns it now */
+
+  g_hash_table_insert (uring_sources, context, us);
+
+ done:
+  G_UNLOCK (uring_sources);
+
+  return us;
+}
+
+
+static gboolean
+uring_source_prepare (GSource* source, gint* timeout)
+{
+  UringSource* us = (UringSource*) source;
+
+  *timeout = -1;
+
+  /* Arm watches that did not get an SQE earlier */
+  while (us->unarmed)
+    {
+      UringWatch* watch = (UringWatch*) us->unarmed->data;
+
+      us->unarmed = g_list_remove (us->unarmed, watch);
+      if (!uring_watch_arm (us, watch))
+	break;
+    }
+
+  /* Retry receives that found no buffer, now that the buffers given
+     back are queued before them */
+  while (us->starved)
+    {
+      UringOp* op = (UringOp*) us->starved->data;
+
+      us->starved = g_list_remove (us->starved, op);
+      op->starved = FALSE;
+      if (!uring_op_queue (us, op))
+	{
+	  op->starved = TRUE;
+	  us->starved = g_list_prepend (us->starved, op);
+	  break;
+	}
+    }
+
+  /* One system call for all the requests queued since the last
+     iteration */
+  if (us->to_submit > 0 && !uring_submit (us))
+    g_warning ("io_uring submission failed: %s", g_strerror (errno));
+
+  return us->backlog->len > 0 ||
+    *us->cq_head != URING_LOAD_ACQUIRE (us->cq_tail);
+}
+
+
+static gboolean
+uring_source_check (GSource* source)
+{
+  UringSource* us = (UringSource*) source;
+
+  return (us->pollfd.revents & G_IO_IN) || us->backlog->len > 0 ||
+    *us->cq_head != URING_LOAD_ACQUIRE (us->cq_tail);
+}
+
+
+/* Takes the oldest completion: from the backlog, then from the ring.
+   Returns FALSE if there is none. */
+static gboolean
+uring_source_next (UringSource* us, UringCompletion* c)
+{
+  struct io_uring_cqe* cqe;
+  guint head;
+
+  if (us->backlog->len > 0)
+    {
+      *c = g_array_index (us->backlog, UringCompletion, 0);
+      g_array_remove_index (us->backlog, 0);
+      return TRUE;
+    }
+
+  head = *us->cq_head;
+  if (head == URING_LOAD_ACQUIRE (us->cq_tail))
+    return FALSE;
+
+  cqe = &us->cqes[head & *us->cq_mask];
+  c->user_data = cqe->user_data;
+  c->res = cqe->res;
+  c->flags = cqe->flags;
+
+  /* Give the entry back before the callback can queue more */
+  URING_STORE_RELEASE (us->cq_head, head + 1);
+
+  return TRUE;
+}
+
+
+static void
+uring_watch_complete (UringSource* us, UringWatch* watch, gint res)
+{
+  GIOCondition condition;
+
+  watch->armed = FALSE;
+
+  if (res < 0)
+    condition = (G_IO_ERR | G_IO_NVAL) & watch->condition;
+  else
+    {
+      condition = 0;
+      if (res & POLLIN)
+	condition |= G_IO_IN;
+      if (res & POLLPRI)
+	condition |= G_IO_PRI;
+      if (res & POLLOUT)
+	condition |= G_IO_OUT;
+      if (res & POLLERR)
+	condition |= G_IO_ERR;
+      if (res & POLLHUP)
+	condition |= G_IO_HUP;
+      if (res & POLLNVAL)
+	condition |= G_IO_NVAL;
+      condition &= watch->condition;
+    }
+
+  if (condition == 0)
+    {
+      if (res >= 0)
+	uring_watch_arm (us, watch);
+      return;
+    }
+
+  /* Protect the watch: the callback may remove it */
+  watch->ref_count++;
+  watch->dispatching = TRUE;
+
+  if (!(watch->function) (watch->channel, condition, watch->data))
+    {
+      if (!watch->removed)
+	_gnet_uring_watch_remove (us->context, watch->id);
+    }
+  else if (!watch->removed && !watch->armed)
+    uring_watch_arm (us, watch);	/* poll requests are one-shot */
+
+  watch->dispatching = FALSE;
+  uring_watch_unref (watch);
+}
+
+
+static gboolean
+uring_source_dispatch (GSource* source, GSourceFunc callback,
+		       gpointer user_data)
+{
+  UringSource* us = (UringSource*) source;
+  UringCompletion c;
+  guint64 counter;
+
+  /* Clear the eventfd */
+  while (read (us->pollfd.fd, &counter, sizeof (counter)) < 0 && errno == EINTR)
+    ;
+
+  /* Completions that arrive meanwhile are handled too */
+  while (uring_source_next (us, &c))
+    {
+      gpointer id = GUINT_TO_POINTER ((guint) (c.user_data >> 32));
+      UringWatch* watch;
+      UringOp* op;
+
+      if (c.user_data == 0)		/* cancel or buffers */
+	continue;
+
+      watch = g_hash_table_lookup (us->watches, id);
+      if (watch != NULL)
+	{
+	  if (watch->generation == (guint) c.user_data && watch->armed)
+	    uring_watch_complete (us, watch, c.res);
+	  continue;			/* else stale or cancelled */
+	}
+
+      op = g_hash_table_lookup (us->ops, id);
+      if (op != NULL && (guint) c.user_data == 0)	/* not its poll */
+	uring_op_complete (us, op, c.res, c.flags);
+    }
+
+  return TRUE;
+}
+
+
+static gboolean
+uring_source_finalize_watch (gpointer key, gpointer value, gpointer user_data)
+{
+  UringWatch* watch = (UringWatch*) value;
+
+  watch->removed = TRUE;
+  uring_watch_unref (watch);
+
+  return TRUE;
+}
+
+
+static void
+uring_source_finalize_op (gpointer key, gpointer value, gpointer user_data)
+{
+  UringSource* us = (UringSource*) user_data;
+  UringOp* op = (UringOp*) value;
+
+  if (!op->canceled)
+    uring_op_cancel (us, op);
+}
+
+
+/* Cancels the operations in flight and waits until they complete: the
+   kernel may use their buffers until then.  Their functions are not
+   called. */
+static void
+uring_source_finalize_ops (UringSource* us)
+{
+  GList* starved;
+  UringCompletion c;
+
+  if (us->sqes == NULL)
+    return;			/* never mapped */
+
+  starved = us->starved;
+  us->starved = NULL;
+  while (starved)
+    {
+      UringOp* op = (UringOp*) starved->data;
+
+      starved = g_list_delete_link (starved, starved);
+      g_hash_table_remove (us->ops, GUINT_TO_POINTER (op->id));
+      uring_op_free (op);
+    }
+
+  g_hash_table_foreach (us->ops, uring_source_finalize_op, us);
+  if (!uring_submit (us))
+    return;
+
+  while (g_hash_table_size (us->ops) > 0)
+    {
+      if (!uring_source_next (us, &c))
+	{
+	  if (uring_enter (us->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+	      errno != EINTR)
+	    break;
+	  continue;
+	}
+
+      if (c.user_data != 0 && (guint) c.user_data == 0)
+	{
+	  UringOp* op = g_hash_table_lookup (us->ops,
+			  GUINT_TO_POINTER ((guint) (c.user_data >> 32)));
+
+	  if (op != NULL)
+	    {
+	      op->canceled = TRUE;
+	      uring_op_complete (us, op, c.res, 0);
+	    }
+	}
+    }
+}
+
+
+static void
+uring_source_finalize (GSource* source)
+{
+  UringSource* us = (UringSource*) source;
+
+  G_LOCK (uring_sources);
+  if (uring_sources &&
+      g_hash_table_lookup (uring_sources, us->context) == us)
+    g_hash_table_remove (uring_sources, us->context);
+  G_UNLOCK (uring_sources);
+
+  g_list_free (us->unarmed);
+  g_hash_table_foreach_remove (us->watches, uring_source_finalize_watch, NULL);
+  g_hash_table_destroy (us->watches);
+
+  if (us->ops)
+    {
+      uring_source_finalize_ops (us);
+      g_hash_table_destroy (us->ops);
+    }
+  if (us->backlog)
+    g_array_free (us->backlog, TRUE);
+
+  /* Closing the ring cancels all requests in flight */
+  uring_unmap (us);
+  close (us->ring_fd);
+  close (us->pollfd.fd);
+
+  g_free (us->recv_buffers);
+}
+
+
+/* **************************************** */
+
+
+guint
+_gnet_uring_watch_add (GMainContext* context, GIOChannel* channel,
+		       GIOCondition condition, GIOFunc function,
+		       gpointer data)
+{
+  UringSource* us;
+  UringWatch* watch;
+
+  g_return_val_if_fail (channel != NULL, 0);
+  g_return_val_if_fail (function != NULL, 0);
+
+  us = uring_source_get (context, TRUE);
+  if (us == NULL)
+    return 0;
+
+  watch = g_new0 (UringWatch, 1);
+  watch->fd = g_io_channel_unix_get_fd (channel);
+  watch->channel = g_io_channel_ref (channel);
+  watch->condition = condition;
+  watch->function = function;
+  watch->data = data;
+  watch->ref_count = 1;
+
+  watch->id = uring_new_id ();
+  g_hash_table_insert (us->watches, GUINT_TO_POINTER (watch->id), watch);
+
+  uring_watch_arm (us, watch);	/* or armed in the next prepare */
+
+  return watch->id;
+}
+
+
+gboolean
+_gnet_uring_watch_modify (GMainContext* context, guint id,
+			  GIOCondition condition, GIOFunc function,
+			  gpointer data)
+{
+  UringSource* us;
+  UringWatch* watch;
+
+  us = uring_source_get (context, FALSE);
+  if (us == NULL)
+    return FALSE;
+
+  watch = g_hash_table_lookup (us->watches, GUINT_TO_POINTER (id));
+  if (watch == NULL)
+    return FALSE;
+
+  watch->function = function;
+  watch->data = data;
+
+  if (watch->condition == condition)
+    return TRUE;
+
+  watch->condition = condition;
+
+  /* Replace the poll request in flight.  A watch being dispatched is
+     re-armed when its callback returns. */
+  if (watch->armed)
+    {
+      uring_watch_disarm (us, watch);
+      uring_watch_arm (us, watch);
+    }
+  else if (!watch->dispatching)
+    uring_watch_arm (us, watch);
+
+  return TRUE;
+}
+
+
+void
+_gnet_uring_watch_remove (GMainContext* context, guint id)
+{
+  UringSource* us;
+  UringWatch* watch;
+
+  us = uring_source_get (context, FALSE);
+  if (us == NULL)
+    return;
+
+  watch = g_hash_table_lookup (us->watches, GUINT_TO_POINTER (id));
+  if (watch == NULL)
+    return;
+
+  g_hash_table_remove (us->watches, GUINT_TO_POINTER (id));
+  us->unarmed = g_list_remove (us->unarmed, watch);
+
+  /* Submit the cancel right away: the poll request holds a reference
+     to the file, so the socket would otherwise stay open until the
+     next main loop iteration even if the caller closes it now. */
+  uring_watch_disarm (us, watch);
+  uring_submit (us);
+
+  watch->removed = TRUE;
+  uring_watch_unref (watch);
+}
+
+
+static guint
+uring_op_start (GMainContext* context, guint8 opcode, gint fd,
+		const gchar* buffer, gsize length,
+		GNetIOFunc function, gpointer data)
+{
+  UringSource* us;
+  UringOp* op;
+
+  us = uring_source_get (context, TRUE);
+  if (us == NULL || !us->ops_supported)
+    return 0;
+
+  if (opcode == IORING_OP_RECV && us->recv_buffers == NULL)
+    {
+      us->recv_buffers = g_malloc (URING_RECV_BUFFERS *
+				   URING_RECV_BUFFER_SIZE);
+      uring_provide_buffers (us, 0, URING_RECV_BUFFERS);
+    }
+
+  op = g_new0 (UringOp, 1);
+  op->id = uring_new_id ();
+  op->opcode = opcode;
+  op->fd = fd;
+  op->buffer = buffer;
+  op->length = length;
+  op->function = function;
+  op->data = data;
+
+  if (!uring_op_queue (us, op))
+    {
+      g_free (op);
+      return 0;
+    }
+
+  g_hash_table_insert (us->ops, GUINT_TO_POINTER (op->id), op);
+
+  return op->id;
+}
+
+
+guint
+_gnet_uring_recv (GMainContext* context, gint fd,
+		  GNetIOFunc function, gpointer data)
+{
+  return uring_op_start (context, IORING_OP_RECV, fd, NULL, 0,
+			 function, data);
+}
+
+
+guint
+_gnet_uring_send (GMainContext* context, gint fd,
+		  const gchar* buffer, gsize length,
+		  GNetIOFunc function, gpointer data)
+{
+  return uring_op_start (context, IORING_OP_SEND, fd, buffer, length,
+			 function, data);
+}
+
+
+guint
+_gnet_uring_accept (GMainContext* context, gint fd,
+		    GNetIOFunc function, gpointer data)
+{
+  return uring_op_start (context, IORING_OP_ACCEPT, fd, NULL, 0,
+			 function, data);
+}
+
+
+void
+_gnet_uring_cancel (GMainContext* context, guint id,
+		    GDestroyNotify notify, gpointer notify_data)
+{
+  UringSource* us;
+  UringOp* op = NULL;
+
+  us = uring_source_get (context, FALSE);
+  if (us != NULL)
+    op = g_hash_table_lookup (us->ops, GUINT_TO_POINTER (id));
+  if (op == NULL || op->canceled)
+    {
+      if (notify)
+	notify (notify_data);
+      return;
+    }
+
+  op->notify = notify;
+  op->notify_data = notify_data;
+  uring_op_cancel (us, op);
+
+  /* Submit right away, like the cancel of a watch: the request holds
+     a reference to the file */
+  uring_submit (us);
+}
+
+#endif /* HAVE_IO_URING */
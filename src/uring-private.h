@@ -0,0 +1,79 @@
+/* GNet - Networking library
+ * Copyright (C) 2000  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA  02111-1307, USA.
+ */
+
+#ifndef _GNET_URING_PRIVATE_H
+#define _GNET_URING_PRIVATE_H
+
+#include "gnet-private.h"
+
+#ifdef HAVE_IO_URING
+
+#define GNET_IS_URING_WATCH_ID(ID)	\
+  (((ID) & GNET_WATCH_ID_TAG_MASK) == GNET_WATCH_ID_TAG_URING)
+
+/* Returns TRUE if the kernel supports io_uring */
+gboolean _gnet_uring_available (void);
+
+/* All watches and operations of a GMainContext share one ring.
+   Requests are queued and submitted with a single io_uring_enter()
+   per main loop iteration; completions are reaped from one eventfd
+   GSource.  Watches have the same semantics as the epoll functions. */
+guint	_gnet_uring_watch_add (GMainContext * context,
+                               GIOChannel   * channel,
+                               GIOCondition   condition,
+                               GIOFunc        function,
+                               gpointer       data);
+
+gboolean _gnet_uring_watch_modify (GMainContext * context,
+                                   guint          watch,
+                                   GIOCondition   condition,
+                                   GIOFunc        function,
+                                   gpointer       data);
+
+void	_gnet_uring_watch_remove (GMainContext * context, guint watch);
+
+/* Receives, sends and accepts run on the same ring as operations, see
+   _gnet_io_recv() and friends.  Receives read into buffers the ring
+   provides to the kernel, so an idle socket holds no buffer.  Each
+   returns 0 if the kernel lacks an opcode. */
+guint	_gnet_uring_recv (GMainContext * context,
+                          gint           fd,
+                          GNetIOFunc     function,
+                          gpointer       data);
+
+guint	_gnet_uring_send (GMainContext * context,
+                          gint           fd,
+                          const gchar  * buffer,
+                          gsize          length,
+                          GNetIOFunc     function,
+                          gpointer       data);
+
+guint	_gnet_uring_accept (GMainContext * context,
+                            gint           fd,
+                            GNetIOFunc     function,
+                            gpointer       data);
+
+void	_gnet_uring_cancel (GMainContext  * context,
+                            guint           op,
+                            GDestroyNotify  notify,
+                            gpointer        notify_data);
+
+#endif /* HAVE_IO_URING */
+
+#endif /* _GNET_URING_PRIVATE_H */
@@ -0,0 +1,159 @@
+/* GNet base64 benchmark
+ * Copyright (C) 2000-2003  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Encodes and decodes @megabytes (default 256) of data with base64,
+   with and without RFC 2045 line breaks, and with base64url, and
+   reports megabytes of binary data per second.  The data goes through
+   gnet_base64_encode() and gnet_base64_decode() and the _into()
+   functions in messages of @size bytes (default 64 kilobytes), and
+   through a GBase64Encoder and GBase64Decoder in pieces of that
+   size.
+
+     bench-base64 [megabytes [size]]
+
+   Run with GNET_SIMD=none to compare with the portable code.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gnet.h>
+
+
+static gdouble
+rate (GTimer* timer, guint64 total)
+{
+  return (gdouble) total / (1024 * 1024) / g_timer_elapsed (timer, NULL);
+}
+
+
+static void
+bench (const gchar* data, gsize size, guint64 total, GBase64Flags flags)
+{
+  const gchar* label;
+  GTimer* timer;
+  GBase64Encoder* encoder;
+  GBase64Decoder* decoder;
+  gboolean strict = (flags & GNET_BASE64_FLAG_STRICT) != 0;
+  gchar* encoded;
+  gchar* decoded;
+  gsize encoded_length;
+  gint length;
+  gsize written;
+  guint64 done;
+
+  label = strict ? "strict" : (flags & GNET_BASE64_FLAG_URL) ? "url" : "";
+  encoded_length = gnet_base64_encode_length (size, flags);
+  encoded = g_malloc (encoded_length);
+  gnet_base64_encode_into (data, size, encoded, flags);
+  decoded = g_malloc (size * 2 + 64);
+
+  timer = g_timer_new ();
+
+  /* gnet_base64_encode() has no base64url */
+  if (!(flags & GNET_BASE64_FLAG_URL))
+    {
+      g_timer_start (timer);
+      for (done = 0; done < total; done += size)
+	g_free (gnet_base64_encode (data, size, &length, strict));
+      printf ("%-8s encode: %6.0f MB/s", label, rate (timer, done));
+
+      g_timer_start (timer);
+      for (done = 0; done < total; done += size)
+	g_free (gnet_base64_decode (encoded, encoded_length, &length));
+      printf ("   decode: %6.0f MB/s\n", rate (timer, done));
+    }
+
+  /* Into the caller's buffer */
+  g_timer_start (timer);
+  for (done = 0; done < total; done += size)
+    gnet_base64_encode_into (data, size, decoded, flags);
+  printf ("%-8s   into: %6.0f MB/s", label, rate (timer, done));
+
+  g_timer_start (timer);
+  for (done = 0; done < total; done += size)
+    gnet_base64_decode_into (encoded, encoded_length, decoded, &written, flags);
+  printf ("     into: %6.0f MB/s\n", rate (timer, done));
+
+  /* In pieces */
+  encoder = gnet_base64_encoder_new_full (flags);
+  g_timer_start (timer);
+  for (done = 0; done < total; done += size)
+    gnet_base64_encoder_update (encoder, data, size, decoded);
+  gnet_base64_encoder_final (encoder, decoded);
+  printf ("%-8s stream: %6.0f MB/s", label, rate (timer, done));
+  gnet_base64_encoder_delete (encoder);
+
+  decoder = gnet_base64_decoder_new_full (flags);
+  g_timer_start (timer);
+  for (done = 0; done < total; done += size)
+    gnet_base64_decoder_update (decoder, encoded, encoded_length,
+				decoded, &written);
+  gnet_base64_decoder_final (decoder);
+  printf ("   stream: %6.0f MB/s\n", rate (timer, done));
+  gnet_base64_decoder_delete (decoder);
+
+  g_timer_destroy (timer);
+  g_free (decoded);
+  g_free (encoded);
+}
+
+
+int
+main (int argc, char** argv)
+{
+  guint64 total = 256;
+  gsize size = 64 * 1024;
+  gchar* data;
+  gsize i;
+
+  gnet_init ();
+
+  if (argc > 3)
+    {
+      fprintf (stderr, "usage: bench-base64 [megabytes [size]]\n");
+      exit (EXIT_FAILURE);
+    }
+  if (argc > 1)
+    total = g_ascii_strtoull (argv[1], NULL, 10);
+  if (argc > 2)
+    size = g_ascii_strtoull (argv[2], NULL, 10);
+  if (total == 0 || size < 3 || size > G_MAXINT / 2)
+    {
+      fprintf (stderr, "Error: bad megabytes or size\n");
+      exit (EXIT_FAILURE);
+    }
+  total *= 1024 * 1024;
+
+  /* A whole number of groups, so the pieces decode alone */
+  size -= size % 3;
+
+  data = g_malloc (size);
+  for (i = 0; i < size; ++i)
+    data[i] = (gchar) (i * 131 + (i >> 11));
+
+  bench (data, size, total, 0);
+  bench (data, size, total, GNET_BASE64_FLAG_STRICT);
+  bench (data, size, total, GNET_BASE64_FLAG_URL);
+
+  g_free (data);
+
+  return 0;
+}
@@ -0,0 +1,200 @@
+/* GConn I/O backend benchmark
+ * Copyright (C) 2000-2003  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Ping-pongs lines between GConn clients and a GServer on the
+   loopback interface and reports round trips per second.  Idle
+   connections can be added to show how the backends scale with the
+   number of watched sockets. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gnet.h>
+
+#define MESSAGE "ping\n"
+
+static gint   active_clients;
+static gint   round_trips;
+static gint   round_trips_done;
+static gint   clients_done;
+static GList* conns;
+
+
+static void
+server_conn_func (GConn* conn, GConnEvent* event, gpointer user_data)
+{
+  switch (event->type)
+    {
+    case GNET_CONN_READ:
+      gnet_conn_write (conn, MESSAGE, strlen (MESSAGE));
+      gnet_conn_readline (conn);
+      break;
+    case GNET_CONN_WRITE:
+      break;
+    default:
+      gnet_conn_disconnect (conn);
+      break;
+    }
+}
+
+
+static void
+server_func (GServer* server, GConn* conn, gpointer user_data)
+{
+  if (conn == NULL)
+    {
+      fprintf (stderr, "Error: accept failed\n");
+      exit (EXIT_FAILURE);
+    }
+
+  conns = g_list_prepend (conns, conn);
+  gnet_conn_set_callback (conn, server_conn_func, NULL);
+  gnet_conn_readline (conn);
+}
+
+
+static void
+client_func (GConn* conn, GConnEvent* event, gpointer user_data)
+{
+  gint* count = (gint*) user_data;
+
+  switch (event->type)
+    {
+    case GNET_CONN_CONNECT:
+      if (count == NULL)	/* idle connection */
+	break;
+      gnet_conn_write (conn, MESSAGE, strlen (MESSAGE));
+      gnet_conn_readline (conn);
+      break;
+    case GNET_CONN_READ:
+      ++round_trips_done;
+      if (++(*count) == round_trips)
+	{
+	  ++clients_done;
+	  break;
+	}
+      gnet_conn_write (conn, MESSAGE, strlen (MESSAGE));
+      gnet_conn_readline (conn);
+      break;
+    case GNET_CONN_WRITE:
+      break;
+    default:
+      fprintf (stderr, "Error: connection failed\n");
+      exit (EXIT_FAILURE);
+    }
+}
+
+
+int
+main (int argc, char** argv)
+{
+  GNetIOBackend backend = GNET_IO_BACKEND_GLIB;
+  gint idle_clients = 0;
+  GInetAddr* addr;
+  GServer* server;
+  GConn** clients;
+  gint* counts;
+  GTimer* timer;
+  gdouble elapsed;
+  gint i;
+
+  gnet_init ();
+
+  if (argc < 2 || argc > 5)
+    {
+      fprintf (stderr, "usage: bench-conn glib|epoll|io_uring "
+	       "[clients] [round-trips] [idle-clients]\n");
+      exit (EXIT_FAILURE);
+    }
+
+  if (strcmp (argv[1], "epoll") == 0)
+    backend = GNET_IO_BACKEND_EPOLL;
+  else if (strcmp (argv[1], "io_uring") == 0)
+    backend = GNET_IO_BACKEND_IO_URING;
+  else if (strcmp (argv[1], "glib") != 0)
+    {
+      fprintf (stderr, "Error: unknown backend %s\n", argv[1]);
+      exit (EXIT_FAILURE);
+    }
+
+  if (!gnet_set_io_backend (backend))
+    {
+      fprintf (stderr, "Error: backend %s is not available\n", argv[1]);
+      exit (EXIT_FAILURE);
+    }
+
+  active_clients = (argc > 2) ? atoi (argv[2]) : 16;
+  round_trips = (argc > 3) ? atoi (argv[3]) : 10000;
+  idle_clients = (argc > 4) ? atoi (argv[4]) : 0;
+
+  gnet_socks_set_enabled (FALSE);
+
+  addr = gnet_inetaddr_new ("127.0.0.1", 0);
+  server = gnet_server_new (addr, 0, server_func, NULL);
+  if (!server)
+    {
+      fprintf (stderr, "Error: Could not start server\n");
+      exit (EXIT_FAILURE);
+    }
+  gnet_inetaddr_set_port (addr, server->port);
+
+  clients = g_new0 (GConn*, active_clients + idle_clients);
+  counts = g_new0 (gint, active_clients);
+
+  /* Idle connections first, they must be watched but never fire */
+  for (i = 0; i < idle_clients; ++i)
+    {
+      clients[active_clients + i] = gnet_conn_new_inetaddr (addr, client_func, NULL);
+      gnet_conn_connect (clients[active_clients + i]);
+      gnet_conn_readline (clients[active_clients + i]);
+    }
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < active_clients; ++i)
+    {
+      clients[i] = gnet_conn_new_inetaddr (addr, client_func, &counts[i]);
+      gnet_conn_connect (clients[i]);
+    }
+
+  while (clients_done < active_clients)
+    g_main_context_iteration (NULL, TRUE);
+
+  elapsed = g_timer_elapsed (timer, NULL);
+
+  printf ("%s: %d clients (+%d idle), %d round trips in %.3f s: "
+	  "%.0f round trips/s\n", argv[1], active_clients, idle_clients,
+	  round_trips_done, elapsed, round_trips_done / elapsed);
+
+  for (i = 0; i < active_clients + idle_clients; ++i)
+    gnet_conn_unref (clients[i]);
+  while (conns)
+    {
+      gnet_conn_unref ((GConn*) conns->data);
+      conns = g_list_delete_link (conns, conns);
+    }
+  gnet_server_delete (server);
+  gnet_inetaddr_delete (addr);
+  g_timer_destroy (timer);
+  g_free (clients);
+  g_free (counts);
+
+  return 0;
+}
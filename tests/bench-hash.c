@@ -0,0 +1,169 @@
+/* GNet hash benchmark
+ * Copyright (C) 2000-2003  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Hashes messages of 64 bytes to 1 gigabyte with @hash (md5, sha,
+   sha256, sha512 or blake2b; default sha) and reports megabytes per
+   second for each size.  Messages up to 16 megabytes are hashed with
+   gnet_*_new(); bigger ones are fed to gnet_*_update() 16 megabytes
+   at a time, like a file would be.  Each size hashes about @megabytes
+   (default 256) in total, or one message if that is bigger.
+
+     bench-hash [hash [megabytes [max-size]]]
+
+   Run with GNET_SIMD=none to compare with the portable code.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gnet.h>
+
+#define CHUNK_SIZE	(16 * 1024 * 1024)
+#define MAX_SIZE	(G_GUINT64_CONSTANT (1) << 30)
+
+
+/* The hash types all have these, with 64-bit lengths */
+typedef struct
+{
+  const gchar*	name;
+  gpointer	(*new) (const gchar* buffer, gsize length);
+  gpointer	(*new_incremental) (void);
+  void		(*update) (gpointer hash, const gchar* buffer, gsize length);
+  void		(*final) (gpointer hash);
+  void		(*delete) (gpointer hash);
+
+} Hash;
+
+#define HASH(name, new, update)				\
+  { #name, (gpointer) gnet_ ## name ## _ ## new,	\
+    (gpointer) gnet_ ## name ## _new_incremental,	\
+    (gpointer) gnet_ ## name ## _ ## update,		\
+    (gpointer) gnet_ ## name ## _final,			\
+    (gpointer) gnet_ ## name ## _delete }
+
+static const Hash hashes[] =
+{
+  HASH (md5, new_large, update_large),
+  HASH (sha, new_large, update_large),
+  HASH (sha256, new, update),
+  HASH (sha512, new, update),
+  HASH (blake2b, new, update)
+};
+
+
+static gdouble
+bench_size (const Hash* hash, const gchar* buffer,
+	    guint64 size, guint64 total)
+{
+  GTimer* timer;
+  guint64 done;
+  guint64 rounds;
+  gpointer h;
+  gdouble seconds;
+
+  rounds = MAX (total / size, 1);
+
+  timer = g_timer_new ();
+  for (done = 0; done < rounds; ++done)
+    {
+      if (size <= CHUNK_SIZE)
+	h = hash->new (buffer, size);
+      else
+	{
+	  guint64 left;
+
+	  h = hash->new_incremental ();
+	  for (left = size; left > 0; left -= MIN (left, CHUNK_SIZE))
+	    hash->update (h, buffer, MIN (left, CHUNK_SIZE));
+	  hash->final (h);
+	}
+      hash->delete (h);
+    }
+  seconds = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  return (gdouble) size * rounds / (1024 * 1024) / seconds;
+}
+
+
+int
+main (int argc, char** argv)
+{
+  guint64 total = 256;
+  guint64 max_size = MAX_SIZE;
+  const Hash* hash = &hashes[1];
+  guint64 size;
+  gchar* buffer;
+  gint i;
+
+  gnet_init ();
+
+  if (argc > 4)
+    {
+      fprintf (stderr, "usage: bench-hash [hash [megabytes [max-size]]]\n");
+      exit (EXIT_FAILURE);
+    }
+  if (argc > 1)
+    {
+      for (hash = hashes; hash < hashes + G_N_ELEMENTS (hashes); ++hash)
+	if (strcmp (hash->name, argv[1]) == 0)
+	  break;
+      if (hash == hashes + G_N_ELEMENTS (hashes))
+	{
+	  fprintf (stderr, "Error: unknown hash %s\n", argv[1]);
+	  exit (EXIT_FAILURE);
+	}
+    }
+  if (argc > 2)
+    total = g_ascii_strtoull (argv[2], NULL, 10);
+  if (argc > 3)
+    max_size = g_ascii_strtoull (argv[3], NULL, 10);
+  if (total == 0 || max_size < 64)
+    {
+      fprintf (stderr, "Error: bad megabytes or max-size\n");
+      exit (EXIT_FAILURE);
+    }
+  total *= 1024 * 1024;
+
+  buffer = g_malloc (CHUNK_SIZE);
+  for (i = 0; i < CHUNK_SIZE; ++i)
+    buffer[i] = (gchar) (i * 131 + (i >> 11));
+
+  for (size = 64; size <= max_size; size *= 4)
+    {
+      gchar* label;
+
+      if (size >= 1024 * 1024)
+	label = g_strdup_printf ("%" G_GUINT64_FORMAT " MB",
+				 size / (1024 * 1024));
+      else if (size >= 1024)
+	label = g_strdup_printf ("%" G_GUINT64_FORMAT " KB", size / 1024);
+      else
+	label = g_strdup_printf ("%" G_GUINT64_FORMAT " B", size);
+
+      printf ("%8s: %6.0f MB/s\n", label, bench_size (hash, buffer, size, total));
+      fflush (stdout);
+      g_free (label);
+    }
+
+  g_free (buffer);
+
+  return 0;
+}
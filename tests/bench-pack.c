@@ -0,0 +1,199 @@
+/* gnet_pack()/GPackFormat benchmark
+ * Copyright (C) 2000-2003  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Packs and unpacks a small message header and reports messages per
+   second.  Modes:
+
+     interpreted  gnet_pack() and gnet_unpack() with the format string
+     compiled     gnet_pack_format_pack() and gnet_pack_format_unpack()
+                  with a GPackFormat compiled once
+     array        gnet_pack_format_pack_array() and
+                  gnet_pack_format_unpack_array() on frames of 100000
+                  16-byte records; reports megabytes per second
+
+   Run with GNET_SIMD=none to compare with the portable code.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gnet.h>
+
+/* version, flags, type, length, id, sequence, timestamp, 8 bytes of
+   padding */
+#define FORMAT	"!BBHIIII8x"
+
+/* id, type, flags, value */
+#define ARRAY_FORMAT	"!IHHQ"
+#define ARRAY_RECORDS	100000
+
+typedef struct
+{
+  guint32 id;
+  guint16 type;
+  guint16 flags;
+  guint64 value;
+} Record;
+
+
+static void
+bench_array (gint rounds)
+{
+  static const gsize offsets[] = {
+    G_STRUCT_OFFSET (Record, id), G_STRUCT_OFFSET (Record, type),
+    G_STRUCT_OFFSET (Record, flags), G_STRUCT_OFFSET (Record, value) };
+  GPackFormat* format;
+  Record* records;
+  gchar* frame;
+  gint length;
+  GTimer* timer;
+  gdouble pack_time, unpack_time;
+  gdouble megabytes;
+  gint i;
+
+  format = gnet_pack_format_new (ARRAY_FORMAT);
+  length = gnet_pack_format_get_size (format) * ARRAY_RECORDS;
+  records = g_new0 (Record, ARRAY_RECORDS);
+  frame = g_malloc (length);
+  for (i = 0; i < ARRAY_RECORDS; ++i)
+    {
+      records[i].id = i;
+      records[i].value = (guint64) i * i;
+    }
+
+  timer = g_timer_new ();
+  for (i = 0; i < rounds; ++i)
+    gnet_pack_format_pack_array (format, frame, length, records,
+				 sizeof (Record), offsets, ARRAY_RECORDS);
+  pack_time = g_timer_elapsed (timer, NULL);
+
+  g_timer_start (timer);
+  for (i = 0; i < rounds; ++i)
+    gnet_pack_format_unpack_array (format, frame, length, records,
+				   sizeof (Record), offsets, ARRAY_RECORDS);
+  unpack_time = g_timer_elapsed (timer, NULL);
+
+  if (records[ARRAY_RECORDS - 1].id != ARRAY_RECORDS - 1)
+    {
+      fprintf (stderr, "Error: unpack failed\n");
+      exit (EXIT_FAILURE);
+    }
+
+  megabytes = (gdouble) length * rounds / (1024 * 1024);
+  printf ("array: %d frames of %d records: pack %.0f MB/s, unpack %.0f MB/s\n",
+	  rounds, ARRAY_RECORDS, megabytes / pack_time, megabytes / unpack_time);
+
+  gnet_pack_format_free (format);
+  g_free (records);
+  g_free (frame);
+  g_timer_destroy (timer);
+}
+
+
+int
+main (int argc, char** argv)
+{
+  GPackFormat* format = NULL;
+  gboolean compiled;
+  gchar buffer[64];
+  gint rounds;
+  gint size = 0;
+  GTimer* timer;
+  gdouble pack_time, unpack_time;
+  guint8 version, flags;
+  guint16 type;
+  guint32 length, id, sequence, timestamp;
+  guint32 check = 0;
+  gint i;
+
+  gnet_init ();
+
+  if (argc < 2 || argc > 3 ||
+      (strcmp (argv[1], "interpreted") != 0 &&
+       strcmp (argv[1], "compiled") != 0 &&
+       strcmp (argv[1], "array") != 0))
+    {
+      fprintf (stderr, "usage: bench-pack interpreted|compiled|array [rounds]\n");
+      exit (EXIT_FAILURE);
+    }
+
+  if (argc > 2)
+    rounds = atoi (argv[2]);
+  else
+    rounds = (strcmp (argv[1], "array") == 0) ? 1000 : 10000000;
+  if (rounds <= 0)
+    {
+      fprintf (stderr, "Error: bad rounds\n");
+      exit (EXIT_FAILURE);
+    }
+
+  if (strcmp (argv[1], "array") == 0)
+    {
+      bench_array (rounds);
+      return 0;
+    }
+
+  compiled = (strcmp (argv[1], "compiled") == 0);
+  if (compiled)
+    format = gnet_pack_format_new (FORMAT);
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < rounds; ++i)
+    {
+      if (compiled)
+	size = gnet_pack_format_pack (format, buffer, sizeof (buffer),
+				      1, i & 0xff, 0x1234, 28, i, i + 1, i + 2);
+      else
+	size = gnet_pack (FORMAT, buffer, sizeof (buffer),
+			  1, i & 0xff, 0x1234, 28, i, i + 1, i + 2);
+    }
+
+  pack_time = g_timer_elapsed (timer, NULL);
+  g_timer_start (timer);
+
+  for (i = 0; i < rounds; ++i)
+    {
+      if (compiled)
+	gnet_pack_format_unpack (format, buffer, size, &version, &flags,
+				 &type, &length, &id, &sequence, &timestamp);
+      else
+	gnet_unpack (FORMAT, buffer, size, &version, &flags,
+		     &type, &length, &id, &sequence, &timestamp);
+      check += sequence;
+    }
+
+  unpack_time = g_timer_elapsed (timer, NULL);
+
+  if (size != 28 || length != 28 || type != 0x1234)
+    {
+      fprintf (stderr, "Error: pack failed\n");
+      exit (EXIT_FAILURE);
+    }
+
+  printf ("%s: %d messages of %d bytes: pack %.0f/s, unpack %.0f/s (%u)\n",
+	  argv[1], rounds, size, rounds / pack_time, rounds / unpack_time,
+	  check);
+
+  gnet_pack_format_free (format);
+  g_timer_destroy (timer);
+
+  return 0;
+}
@@ -0,0 +1,191 @@
+/* GUdpSocket send/receive benchmark
+ * Copyright (C) 2000-2003  David Helder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Sends equal-size datagrams between two GUdpSockets on the loopback
+   interface and reports datagrams per second.  Each round sends a
+   burst of datagrams and then receives all of them, so none are
+   dropped.  Modes:
+
+     plain  gnet_udp_socket_send() and gnet_udp_socket_receive_into()
+     batch  gnet_udp_socket_send_batch() and gnet_udp_socket_receive_batch()
+     gso    gnet_udp_socket_send_segments() and
+            gnet_udp_socket_receive_segments() with receive offload
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <gnet.h>
+
+#define BURST		64
+#define MAX_DATAGRAM	65535
+
+
+static GUdpSocket*
+udp_socket_new_local (void)
+{
+  GInetAddr* addr;
+  GUdpSocket* socket;
+
+  addr = gnet_inetaddr_new ("127.0.0.1", 0);
+  socket = gnet_udp_socket_new_full (addr, 0);
+  gnet_inetaddr_delete (addr);
+  if (!socket)
+    {
+      fprintf (stderr, "Error: Could not create socket\n");
+      exit (EXIT_FAILURE);
+    }
+
+  return socket;
+}
+
+
+int
+main (int argc, char** argv)
+{
+  GUdpSocket* sender;
+  GUdpSocket* receiver;
+  GInetAddr* dst;
+  GInetAddr* src;
+  GUdpPacket packets[BURST];
+  gchar* out;
+  gchar* in;
+  gint rounds;
+  gint size;
+  gint calls = 0;
+  GTimer* timer;
+  gdouble elapsed;
+  gint i, j;
+
+  gnet_init ();
+
+  if (argc < 2 || argc > 4 ||
+      (strcmp (argv[1], "plain") != 0 && strcmp (argv[1], "batch") != 0 &&
+       strcmp (argv[1], "gso") != 0))
+    {
+      fprintf (stderr, "usage: bench-udp plain|batch|gso [rounds] [size]\n");
+      exit (EXIT_FAILURE);
+    }
+
+  rounds = (argc > 2) ? atoi (argv[2]) : 10000;
+  size = (argc > 3) ? atoi (argv[3]) : 1200;
+  if (rounds <= 0 || size <= 0 || size > MAX_DATAGRAM)
+    {
+      fprintf (stderr, "Error: bad rounds or size\n");
+      exit (EXIT_FAILURE);
+    }
+
+  sender = udp_socket_new_local ();
+  receiver = udp_socket_new_local ();
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+  src = gnet_inetaddr_clone (dst);
+
+  out = g_malloc0 (size * BURST);
+  in = g_malloc (MAX_DATAGRAM);
+  for (i = 0; i < BURST; ++i)
+    {
+      packets[i].buffer = g_malloc (size);
+      packets[i].length = size;
+      packets[i].addr = src;
+    }
+
+  if (strcmp (argv[1], "gso") == 0 &&
+      !gnet_udp_socket_set_receive_offload (receiver, TRUE))
+    printf ("gso: receive offload is not supported\n");
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < rounds; ++i)
+    {
+      gint received = 0;
+
+      if (strcmp (argv[1], "plain") == 0)
+	{
+	  for (j = 0; j < BURST; ++j)
+	    gnet_udp_socket_send (sender, out + j * size, size, dst);
+	  for (; received < BURST; ++received, ++calls)
+	    if (gnet_udp_socket_receive_into (receiver, in, size, src) != size)
+	      break;
+	}
+      else if (strcmp (argv[1], "batch") == 0)
+	{
+	  GUdpPacket send[BURST];
+
+	  for (j = 0; j < BURST; ++j)
+	    {
+	      send[j].buffer = out + j * size;
+	      send[j].length = size;
+	      send[j].addr = dst;
+	    }
+	  gnet_udp_socket_send_batch (sender, send, BURST);
+	  while (received < BURST)
+	    {
+	      gint n = gnet_udp_socket_receive_batch (receiver, packets,
+						      BURST - received);
+	      if (n <= 0)
+		break;
+	      received += n;
+	      ++calls;
+	    }
+	}
+      else
+	{
+	  gnet_udp_socket_send_segments (sender, out, size * BURST, size, dst);
+	  while (received < BURST)
+	    {
+	      gint segment_size;
+	      gint length;
+
+	      length = gnet_udp_socket_receive_segments (receiver, in,
+							 MAX_DATAGRAM, src,
+							 &segment_size);
+	      if (length <= 0)
+		break;
+	      received += gnet_udp_segments_split (in, length, segment_size,
+						   NULL, 0);
+	      ++calls;
+	    }
+	}
+
+      if (received != BURST)
+	{
+	  fprintf (stderr, "Error: receive failed\n");
+	  exit (EXIT_FAILURE);
+	}
+    }
+
+  elapsed = g_timer_elapsed (timer, NULL);
+
+  printf ("%s: %d datagrams of %d bytes in %.3f s: %.0f datagrams/s "
+	  "(%.1f per receive call)\n", argv[1], rounds * BURST, size,
+	  elapsed, rounds * BURST / elapsed, (gdouble) rounds * BURST / calls);
+
+  for (i = 0; i < BURST; ++i)
+    g_free (packets[i].buffer);
+  g_free (out);
+  g_free (in);
+  gnet_inetaddr_delete (src);
+  gnet_inetaddr_delete (dst);
+  gnet_udp_socket_delete (sender);
+  gnet_udp_socket_delete (receiver);
+  g_timer_destroy (timer);
+
+  return 0;
+}
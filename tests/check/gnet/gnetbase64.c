@@ -19,6 +19,8 @@
 
 #include "gnetcheck.h"
 
+#include <string.h>
+
 const gchar sesame[] =
     "Aladdin:open sesame and many many more so come here and see the gold";
 const gchar aladin[] =
@@ -114,6 +116,328 @@ GNET_START_TEST (test_base64_8bit)
 
 GNET_END_TEST;
 
+/* base64 a bit at a time, to check the vector code against */
+static gchar *
+ref_encode (const guchar * src, gsize srclen, gboolean strict)
+{
+  static const gchar chars[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  GString *str = g_string_new (NULL);
+  gsize bit, i;
+
+  for (bit = 0; bit < srclen * 8; bit += 6) {
+    guint v = 0;
+
+    for (i = bit; i < bit + 6; ++i)
+      v = (v << 1) | ((i < srclen * 8) ? (src[i / 8] >> (7 - i % 8)) & 1 : 0);
+    g_string_append_c (str, chars[v]);
+
+    /* strict: a newline after each line of 18 whole groups */
+    if (strict && (bit / 6 + 1) % 72 == 0 && bit / 6 + 1 <= srclen / 3 * 4)
+      g_string_append_c (str, '\n');
+  }
+  for (i = srclen % 3; i > 0 && i < 3; ++i)
+    g_string_append_c (str, '=');
+
+  return g_string_free (str, FALSE);
+}
+
+GNET_START_TEST (test_base64_lengths)
+{
+  guchar data[320];
+  gint i, length, strict;
+
+  for (i = 0; i < (gint) sizeof (data); ++i)
+    data[i] = (guchar) (i * 167 + (i >> 5));
+
+  /* every length and alignment, through the vector code and around it */
+  for (strict = 0; strict <= 1; ++strict) {
+    for (length = 0; length < 300; ++length) {
+      gint offset = length % 7;
+      gchar *expect, *buf1, *buf2;
+      gint len1, len2;
+
+      expect = ref_encode (data + offset, length, strict);
+      buf1 = gnet_base64_encode ((gchar *) data + offset, length, &len1,
+          strict);
+      fail_unless_equals_string (buf1, expect);
+      fail_unless_equals_int (len1, strlen (expect) + 1);
+
+      buf2 = gnet_base64_decode (buf1, len1 - 1, &len2);
+      fail_unless (buf2 != NULL);
+      fail_unless_equals_int (len2, length);
+      fail_unless (memcmp (buf2, data + offset, length) == 0);
+
+      g_free (buf2);
+      g_free (buf1);
+      g_free (expect);
+    }
+  }
+}
+
+GNET_END_TEST;
+
+GNET_START_TEST (test_base64_decode_liberal)
+{
+  static const struct
+  {
+    const gchar *src;
+    const gchar *decoded;       /* NULL if invalid */
+  } vectors[] = {
+    { "QQ==", "A" },
+    { "QUI=", "AB" },
+    { "QUJD", "ABC" },
+    { "QQ", NULL },             /* not a whole byte */
+    { "QUI", NULL },
+    { "QR==", NULL },           /* bits set after the last byte */
+    { "QQ==QUJD", NULL },       /* data after the padding */
+    { "=QUJD", NULL },          /* padding in the wrong place */
+    { "QUJD=", NULL },
+    { "Q=Q==", NULL },
+    { "QUJD=QUJD", NULL },      /* = ends the data */
+    { "QQ= =", "A" },
+    { "QQ=.", "A" },            /* junk after the padding is skipped */
+    { "QQ== \n", "A" },
+    { " Q\tQ\r\n==\n", "A" },
+    { "QUJD\xc3\xa9QUJD", "ABCABC" },   /* 8-bit junk is skipped too */
+    /* junk in the second vector's worth */
+    { "QUJDQUJDQUJDQUJDQUJDQUJDQUJDQUJDQU*JDQUJDQUJDQUJDQUJDQUJDQUJDQUJD",
+      "ABCABCABCABCABCABCABCABCABCABCABCABCABCABCABCABC" }
+  };
+  gchar data[1000];
+  GString *str;
+  gchar *buf;
+  gint len;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (vectors); ++i) {
+    len = -1;
+    buf = gnet_base64_decode (vectors[i].src, -1, &len);
+    if (vectors[i].decoded) {
+      fail_unless (buf != NULL, vectors[i].src);
+      fail_unless_equals_string (buf, vectors[i].decoded);
+      fail_unless_equals_int (len, strlen (vectors[i].decoded));
+    } else {
+      fail_unless (buf == NULL, vectors[i].src);
+      fail_unless_equals_int (len, 0);
+    }
+    g_free (buf);
+  }
+
+  /* CRLF line breaks, and a space every 20 characters */
+  for (i = 0; i < sizeof (data); ++i)
+    data[i] = (gchar) (i * 37 + (i >> 4));
+  buf = gnet_base64_encode (data, sizeof (data), &len, TRUE);
+  str = g_string_new (NULL);
+  for (i = 0; buf[i]; ++i) {
+    if (buf[i] == '\n')
+      g_string_append_c (str, '\r');
+    else if (i % 20 == 0)
+      g_string_append_c (str, ' ');
+    g_string_append_c (str, buf[i]);
+  }
+  g_free (buf);
+  buf = gnet_base64_decode (str->str, str->len, &len);
+  fail_unless (buf != NULL);
+  fail_unless_equals_int (len, sizeof (data));
+  fail_unless (memcmp (buf, data, sizeof (data)) == 0);
+  g_free (buf);
+  g_string_free (str, TRUE);
+}
+
+GNET_END_TEST;
+
+#define STREAM_LENGTH 100000
+
+GNET_START_TEST (test_base64_stream)
+{
+  GBase64Encoder *encoder;
+  GBase64Decoder *decoder;
+  gchar *data, *expect, *encoded, *decoded;
+  gsize n, pos, chunk, elen, dlen, written;
+  gint len, strict;
+
+  data = g_malloc (STREAM_LENGTH);
+  for (pos = 0; pos < STREAM_LENGTH; ++pos)
+    data[pos] = (gchar) (pos * 131 + (pos >> 11));
+
+  encoded = g_malloc (STREAM_LENGTH * 2);
+  decoded = g_malloc (STREAM_LENGTH);
+
+  for (strict = 0; strict <= 1; ++strict) {
+    expect = gnet_base64_encode (data, STREAM_LENGTH, &len, strict);
+
+    /* in pieces of all sizes, some smaller than a group */
+    encoder = gnet_base64_encoder_new (strict);
+    elen = 0;
+    for (pos = 0, chunk = 0; pos < STREAM_LENGTH; pos += n, ++chunk) {
+      n = MIN (chunk * chunk % 997, STREAM_LENGTH - pos);
+      elen += gnet_base64_encoder_update (encoder, data + pos, n,
+          encoded + elen);
+    }
+    elen += gnet_base64_encoder_final (encoder, encoded + elen);
+    gnet_base64_encoder_delete (encoder);
+
+    fail_unless_equals_int (elen, len - 1);
+    fail_unless (memcmp (encoded, expect, elen) == 0);
+    g_free (expect);
+
+    /* and back, in pieces that split the quanta and line breaks */
+    decoder = gnet_base64_decoder_new ();
+    dlen = 0;
+    for (pos = 0, chunk = 0; pos < elen; pos += n, ++chunk) {
+      n = MIN (chunk * 7 % 101, elen - pos);
+      fail_unless (gnet_base64_decoder_update (decoder, encoded + pos, n,
+              decoded + dlen, &written));
+      dlen += written;
+    }
+    fail_unless (gnet_base64_decoder_final (decoder));
+
+    fail_unless_equals_int (dlen, STREAM_LENGTH);
+    fail_unless (memcmp (decoded, data, STREAM_LENGTH) == 0);
+
+    /* a failed update fails until the end */
+    fail_unless (gnet_base64_decoder_update (decoder, "QQ==", 4,
+            decoded, &written));
+    fail_unless_equals_int (written, 1);
+    fail_if (gnet_base64_decoder_update (decoder, "QUJD", 4,
+            decoded, &written));
+    fail_if (gnet_base64_decoder_update (decoder, "\n", 1,
+            decoded, &written));
+    fail_if (gnet_base64_decoder_final (decoder));
+    fail_unless (gnet_base64_decoder_update (decoder, "QUJD", 4,
+            decoded, &written));
+    fail_unless (gnet_base64_decoder_final (decoder));
+    gnet_base64_decoder_delete (decoder);
+  }
+
+  g_free (decoded);
+  g_free (encoded);
+  g_free (data);
+}
+
+GNET_END_TEST;
+
+GNET_START_TEST (test_base64_into)
+{
+  static const GBase64Flags all_flags[] = {
+    0, GNET_BASE64_FLAG_STRICT, GNET_BASE64_FLAG_URL,
+    GNET_BASE64_FLAG_URL | GNET_BASE64_FLAG_STRICT
+  };
+  gchar data[300], encoded[500], decoded[300];
+  guint i, f, length;
+
+  for (i = 0; i < sizeof (data); ++i)
+    data[i] = (gchar) (i * 251 + (i >> 3));
+
+  for (f = 0; f < G_N_ELEMENTS (all_flags); ++f) {
+    GBase64Flags flags = all_flags[f];
+
+    for (length = 0; length < sizeof (data); ++length) {
+      gchar *expect, *c;
+      gint len;
+      gsize elen, dlen;
+
+      /* the same as gnet_base64_encode(), with - and _ and no padding
+         for base64url */
+      expect = gnet_base64_encode (data, length, &len,
+          flags & GNET_BASE64_FLAG_STRICT);
+      if (flags & GNET_BASE64_FLAG_URL) {
+        for (c = expect; *c; ++c)
+          *c = (*c == '+') ? '-' : (*c == '/') ? '_' : *c;
+        while (len > 1 && expect[len - 2] == '=')
+          expect[--len - 1] = '\0';
+      }
+
+      /* exactly the length said, and not a byte more */
+      elen = gnet_base64_encode_length (length, flags);
+      fail_unless_equals_int (elen, len - 1);
+      memset (encoded, '#', sizeof (encoded));
+      fail_unless_equals_int (gnet_base64_encode_into (data, length, encoded,
+              flags), elen);
+      fail_unless (memcmp (encoded, expect, elen) == 0);
+      fail_unless (encoded[elen] == '#');
+      g_free (expect);
+
+      dlen = gnet_base64_decode_length (encoded, elen, flags);
+      fail_unless_equals_int (dlen, length);
+      memset (decoded, '#', sizeof (decoded));
+      fail_unless (gnet_base64_decode_into (encoded, elen, decoded, &dlen,
+              flags));
+      fail_unless_equals_int (dlen, length);
+      fail_unless (memcmp (decoded, data, length) == 0);
+      if (length < sizeof (decoded))
+        fail_unless (decoded[length] == '#');
+    }
+  }
+}
+
+GNET_END_TEST;
+
+GNET_START_TEST (test_base64_url)
+{
+  /* RFC 4648 test vectors */
+  static const gchar *vectors[][2] = {
+    { "", "" },
+    { "f", "Zg" },
+    { "fo", "Zm8" },
+    { "foo", "Zm9v" },
+    { "foob", "Zm9vYg" },
+    { "fooba", "Zm9vYmE" },
+    { "foobar", "Zm9vYmFy" },
+    { "\xfb\xff", "-_8" }
+  };
+  GBase64Encoder *encoder;
+  GBase64Decoder *decoder;
+  gchar buf[32];
+  gsize n, len;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (vectors); ++i) {
+    n = gnet_base64_encode_into (vectors[i][0], strlen (vectors[i][0]), buf,
+        GNET_BASE64_FLAG_URL);
+    fail_unless_equals_int (n, strlen (vectors[i][1]));
+    fail_unless (memcmp (buf, vectors[i][1], n) == 0);
+
+    fail_unless (gnet_base64_decode_into (vectors[i][1],
+            strlen (vectors[i][1]), buf, &n, GNET_BASE64_FLAG_URL));
+    fail_unless_equals_int (n, strlen (vectors[i][0]));
+    fail_unless (memcmp (buf, vectors[i][0], n) == 0);
+  }
+
+  /* padding is allowed but not needed; a stray character is not */
+  fail_unless (gnet_base64_decode_into ("Zg==", 4, buf, &n,
+          GNET_BASE64_FLAG_URL));
+  fail_unless_equals_int (n, 1);
+  fail_if (gnet_base64_decode_into ("Zh", 2, buf, &n, GNET_BASE64_FLAG_URL));
+  fail_if (gnet_base64_decode_into ("Zm9vY", 5, buf, &n,
+          GNET_BASE64_FLAG_URL));
+  fail_if (gnet_base64_decode_into ("Zg", 2, buf, &n, 0));
+
+  /* + and / are not base64url, and - and _ are not base64 */
+  fail_if (gnet_base64_decode_into ("+/8", 3, buf, &n, GNET_BASE64_FLAG_URL));
+  fail_if (gnet_base64_decode_into ("-_8=", 4, buf, &n, 0));
+
+  /* a piece at a time */
+  encoder = gnet_base64_encoder_new_full (GNET_BASE64_FLAG_URL);
+  n = gnet_base64_encoder_update (encoder, "foo", 3, buf);
+  n += gnet_base64_encoder_update (encoder, "ba", 2, buf + n);
+  n += gnet_base64_encoder_final (encoder, buf + n);
+  gnet_base64_encoder_delete (encoder);
+  fail_unless_equals_int (n, 7);
+  fail_unless (memcmp (buf, "Zm9vYmE", 7) == 0);
+
+  decoder = gnet_base64_decoder_new_full (GNET_BASE64_FLAG_URL);
+  fail_unless (gnet_base64_decoder_update (decoder, "Zm9vY", 5, buf, &n));
+  fail_unless (gnet_base64_decoder_update (decoder, "mE", 2, buf + n, &len));
+  fail_unless (gnet_base64_decoder_final (decoder));
+  gnet_base64_decoder_delete (decoder);
+  fail_unless_equals_int (n + len, 5);
+  fail_unless (memcmp (buf, "fooba", 5) == 0);
+}
+
+GNET_END_TEST;
+
 static Suite *
 gnetbase64_suite (void)
 {
@@ -125,6 +449,11 @@ gnetbase64_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_base64);
   tcase_add_test (tc_chain, test_base64_8bit);
+  tcase_add_test (tc_chain, test_base64_lengths);
+  tcase_add_test (tc_chain, test_base64_decode_liberal);
+  tcase_add_test (tc_chain, test_base64_stream);
+  tcase_add_test (tc_chain, test_base64_into);
+  tcase_add_test (tc_chain, test_base64_url);
   return s;
 }
 
@@ -24,6 +24,7 @@
 #endif
 
 #include <string.h>
+#include <stdlib.h>
 
 static void
 conn_fail_cb (GConn * conn, GConnEvent * event, gpointer data)
@@ -244,6 +245,1023 @@ GNET_START_TEST (test_conn_new_socket)
 }
 GNET_END_TEST;
 
+GNET_START_TEST (test_conn_bytes)
+{
+  GConnBytes *bytes;
+  GConn *conn1, *conn2;
+  gchar *data;
+
+  bytes = gnet_conn_bytes_new ("hello", 5);
+  fail_unless (bytes != NULL);
+  fail_unless_equals_int (gnet_conn_bytes_get_length (bytes), 5);
+  fail_unless (memcmp (gnet_conn_bytes_get_data (bytes), "hello", 5) == 0);
+
+  /* writes queued on unconnected conns hold a reference until the conns
+   * are disconnected */
+  conn1 = gnet_conn_new ("localhost", 7, conn_cb, NULL);
+  conn2 = gnet_conn_new ("localhost", 7, conn_cb, NULL);
+  gnet_conn_write_bytes (conn1, bytes);
+  gnet_conn_write_bytes (conn2, bytes);
+  gnet_conn_bytes_ref (bytes);
+  gnet_conn_bytes_unref (bytes);
+  gnet_conn_unref (conn1);
+  gnet_conn_unref (conn2);
+  fail_unless (memcmp (gnet_conn_bytes_get_data (bytes), "hello", 5) == 0);
+  gnet_conn_bytes_unref (bytes);
+
+  data = g_strdup ("taken");
+  bytes = gnet_conn_bytes_new_take (data, 5);
+  fail_unless (gnet_conn_bytes_get_data (bytes) == data);
+  fail_unless_equals_int (gnet_conn_bytes_get_length (bytes), 5);
+  gnet_conn_bytes_unref (bytes);
+
+  ASSERT_CRITICAL (gnet_conn_bytes_new (NULL, 5));
+  ASSERT_CRITICAL (gnet_conn_write_bytes (NULL, NULL));
+}
+GNET_END_TEST;
+
+#define BROADCAST_CLIENTS 4
+/* more than the receive buffers of an io_uring */
+#define BROADCAST_MANY_CLIENTS 100
+
+static GConnBytes *broadcast_bytes = NULL;
+static GList *broadcast_conns = NULL;
+static gint broadcast_received = 0;
+
+static void
+broadcast_server_conn_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  /* nothing to do, the clients check what they received */
+}
+
+static void
+broadcast_server_func (GServer * srv, GConn * conn, gpointer user_data)
+{
+  fail_unless (conn != NULL, "Can't set up server, some error occured");
+
+  broadcast_conns = g_list_prepend (broadcast_conns, conn);
+  gnet_conn_set_callback (conn, broadcast_server_conn_cb, NULL);
+}
+
+static void
+broadcast_client_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  switch (event->type) {
+    case GNET_CONN_CONNECT:
+      gnet_conn_readn (conn, gnet_conn_bytes_get_length (broadcast_bytes));
+      break;
+    case GNET_CONN_READ:
+      fail_unless_equals_int (event->length,
+          gnet_conn_bytes_get_length (broadcast_bytes));
+      fail_unless (memcmp (event->buffer,
+          gnet_conn_bytes_get_data (broadcast_bytes), event->length) == 0);
+      ++broadcast_received;
+      break;
+    default:
+      g_error ("Unexpected event type %d", event->type);
+      break;
+  }
+}
+
+static void
+run_broadcast (gint n_clients)
+{
+  GConn **clients;
+  GInetAddr *ia;
+  GServer *srv;
+  GList *l;
+  gchar *msg;
+  gint i;
+
+  gnet_socks_set_enabled (FALSE);
+
+  msg = g_malloc (64 * 1024);
+  for (i = 0; i < 64 * 1024; ++i)
+    msg[i] = (gchar) (i % 251);
+  broadcast_bytes = gnet_conn_bytes_new_take (msg, 64 * 1024);
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  fail_unless (ia != NULL);
+  srv = gnet_server_new (ia, 0, broadcast_server_func, NULL);
+  fail_unless (srv != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_set_port (ia, srv->port);
+
+  /* connect a few at a time, the listen backlog is short */
+  clients = g_new (GConn *, n_clients);
+  for (i = 0; i < n_clients; ++i) {
+    clients[i] = gnet_conn_new_inetaddr (ia, broadcast_client_cb, NULL);
+    gnet_conn_connect (clients[i]);
+    if ((i + 1) % BROADCAST_CLIENTS == 0 || i + 1 == n_clients)
+      while (g_list_length (broadcast_conns) < (guint) i + 1)
+        g_main_context_iteration (NULL, TRUE);
+  }
+  gnet_inetaddr_unref (ia);
+
+  /* then send to all of them at once */
+  for (l = broadcast_conns; l != NULL; l = l->next)
+    gnet_conn_write_bytes ((GConn *) l->data, broadcast_bytes);
+
+  while (broadcast_received < n_clients)
+    g_main_context_iteration (NULL, TRUE);
+
+  for (i = 0; i < n_clients; ++i)
+    gnet_conn_unref (clients[i]);
+  g_free (clients);
+  for (l = broadcast_conns; l != NULL; l = l->next)
+    gnet_conn_unref ((GConn *) l->data);
+  g_list_free (broadcast_conns);
+  broadcast_conns = NULL;
+  gnet_server_unref (srv);
+
+  gnet_conn_bytes_unref (broadcast_bytes);
+  broadcast_bytes = NULL;
+  broadcast_received = 0;
+}
+
+GNET_START_TEST (test_conn_write_bytes_local)
+{
+  run_broadcast (BROADCAST_CLIENTS);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_conn_epoll_local)
+{
+  if (!gnet_set_io_backend (GNET_IO_BACKEND_EPOLL)) {
+    g_print ("epoll backend not available, skipping test.\n");
+    return;
+  }
+
+  fail_unless (gnet_get_io_backend () == GNET_IO_BACKEND_EPOLL);
+  run_broadcast (BROADCAST_CLIENTS);
+
+  fail_unless (gnet_set_io_backend (GNET_IO_BACKEND_GLIB));
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_conn_io_uring_local)
+{
+  if (!gnet_set_io_backend (GNET_IO_BACKEND_IO_URING)) {
+    g_print ("io_uring backend not available, skipping test.\n");
+    return;
+  }
+
+  fail_unless (gnet_get_io_backend () == GNET_IO_BACKEND_IO_URING);
+  run_broadcast (BROADCAST_CLIENTS);
+  run_broadcast (BROADCAST_MANY_CLIENTS);
+
+  fail_unless (gnet_set_io_backend (GNET_IO_BACKEND_GLIB));
+}
+GNET_END_TEST;
+
+/* more than the socket buffers hold, so the send stays in flight */
+#define CANCEL_WRITE_SIZE (32 * 1024 * 1024)
+
+static gboolean cancel_write_freed = FALSE;
+
+static void
+cancel_write_destroy (gpointer buffer)
+{
+  g_free (buffer);
+  cancel_write_freed = TRUE;
+}
+
+static void
+cancel_conn_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  /* nothing to do, the client never reads */
+}
+
+static void
+cancel_server_func (GServer * srv, GConn * conn, gpointer user_data)
+{
+  fail_unless (conn != NULL, "Can't set up server, some error occured");
+
+  gnet_conn_set_callback (conn, cancel_conn_cb, NULL);
+  *((GConn **) user_data) = conn;
+}
+
+GNET_START_TEST (test_conn_io_uring_cancel_local)
+{
+  GConn *server_conn = NULL;
+  GConn *client;
+  GInetAddr *ia;
+  GServer *srv;
+  gint i;
+
+  if (!gnet_set_io_backend (GNET_IO_BACKEND_IO_URING)) {
+    g_print ("io_uring backend not available, skipping test.\n");
+    return;
+  }
+
+  gnet_socks_set_enabled (FALSE);
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  fail_unless (ia != NULL);
+  srv = gnet_server_new (ia, 0, cancel_server_func, &server_conn);
+  fail_unless (srv != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_set_port (ia, srv->port);
+
+  client = gnet_conn_new_inetaddr (ia, cancel_conn_cb, NULL);
+  gnet_conn_connect (client);
+  gnet_inetaddr_unref (ia);
+
+  while (server_conn == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  /* a receive and a send the client never completes */
+  gnet_conn_read (server_conn);
+  gnet_conn_write_direct (server_conn, g_malloc0 (CANCEL_WRITE_SIZE),
+      CANCEL_WRITE_SIZE, cancel_write_destroy);
+
+  if (server_conn->recv_op == 0 || server_conn->send_op == 0) {
+    g_print ("io_uring operations not available, skipping test.\n");
+  } else {
+    for (i = 0; i < 10; ++i)
+      g_main_context_iteration (NULL, FALSE);
+    fail_if (cancel_write_freed);
+    fail_unless (server_conn->send_op != 0);
+  }
+
+  /* the write is freed once the kernel is done with it */
+  gnet_conn_unref (server_conn);
+  while (!cancel_write_freed)
+    g_main_context_iteration (NULL, TRUE);
+
+  gnet_conn_unref (client);
+  gnet_server_unref (srv);
+  cancel_write_freed = FALSE;
+
+  fail_unless (gnet_set_io_backend (GNET_IO_BACKEND_GLIB));
+}
+GNET_END_TEST;
+
+#define TIMEOUT_CONNS 64
+
+static gint timeout_fired = 0;
+static gint timeout_last = 0;
+
+static void
+timeout_conn_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  gint n = GPOINTER_TO_INT (data);
+
+  fail_unless_equals_int (event->type, GNET_CONN_TIMEOUT);
+  fail_unless (n % 2 == 0, "canceled timeout fired");
+  /* timers must expire in order */
+  fail_unless (n >= timeout_last);
+  timeout_last = n;
+  ++timeout_fired;
+}
+
+GNET_START_TEST (test_conn_timeout)
+{
+  GConn *conns[TIMEOUT_CONNS];
+  GConn *far;
+  gint i;
+
+  far = gnet_conn_new ("localhost", 1, timeout_conn_cb, GINT_TO_POINTER (1));
+  gnet_conn_timeout (far, 10 * 60 * 1000);
+
+  /* set up in reverse order, expire in order */
+  for (i = TIMEOUT_CONNS - 1; i >= 0; --i) {
+    conns[i] = gnet_conn_new ("localhost", 1, timeout_conn_cb,
+        GINT_TO_POINTER (i));
+    gnet_conn_timeout (conns[i], 1 + i * 5);
+  }
+
+  /* cancel the odd ones, and re-arm some of the even ones */
+  for (i = 1; i < TIMEOUT_CONNS; i += 2)
+    gnet_conn_timeout (conns[i], 0);
+  for (i = 0; i < TIMEOUT_CONNS; i += 8)
+    gnet_conn_timeout (conns[i], 1 + i * 5);
+
+  while (timeout_fired < TIMEOUT_CONNS / 2)
+    g_main_context_iteration (NULL, TRUE);
+
+  for (i = 0; i < TIMEOUT_CONNS; ++i)
+    gnet_conn_unref (conns[i]);
+  gnet_conn_unref (far);
+
+  timeout_fired = 0;
+  timeout_last = 0;
+}
+GNET_END_TEST;
+
+static gint idle_pings = 0;
+static gboolean idle_timed_out = FALSE;
+
+static void
+idle_server_conn_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  if (event->type == GNET_CONN_READ)
+    gnet_conn_read (conn);
+}
+
+static void
+idle_server_func (GServer * srv, GConn * conn, gpointer user_data)
+{
+  fail_unless (conn != NULL, "Can't set up server, some error occured");
+
+  *((GConn **) user_data) = conn;
+  gnet_conn_set_callback (conn, idle_server_conn_cb, NULL);
+  gnet_conn_read (conn);
+}
+
+static gboolean
+idle_ping_cb (gpointer data)
+{
+  GConn *conn = (GConn *) data;
+
+  gnet_conn_write (conn, "x", 1);
+  return (++idle_pings < 10);
+}
+
+static void
+idle_client_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  switch (event->type) {
+    case GNET_CONN_CONNECT:
+      gnet_conn_idle_timeout (conn, 150);
+      g_timeout_add (50, idle_ping_cb, conn);
+      break;
+    case GNET_CONN_WRITE:
+      break;
+    case GNET_CONN_TIMEOUT:
+      /* must not expire while there is traffic */
+      fail_unless_equals_int (idle_pings, 10);
+      idle_timed_out = TRUE;
+      break;
+    default:
+      g_error ("Unexpected event type %d", event->type);
+      break;
+  }
+}
+
+GNET_START_TEST (test_conn_idle_timeout_local)
+{
+  GConn *client, *server_conn = NULL;
+  GInetAddr *ia;
+  GServer *srv;
+
+  gnet_socks_set_enabled (FALSE);
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  fail_unless (ia != NULL);
+  srv = gnet_server_new (ia, 0, idle_server_func, &server_conn);
+  fail_unless (srv != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_set_port (ia, srv->port);
+
+  client = gnet_conn_new_inetaddr (ia, idle_client_cb, NULL);
+  gnet_conn_connect (client);
+  gnet_inetaddr_unref (ia);
+
+  while (!idle_timed_out)
+    g_main_context_iteration (NULL, TRUE);
+
+  gnet_conn_unref (client);
+  if (server_conn)
+    gnet_conn_unref (server_conn);
+  gnet_server_unref (srv);
+}
+GNET_END_TEST;
+
+#define PIPELINE_LINES 100
+
+static gint pipeline_lines = 0;
+
+static void
+pipeline_server_conn_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  /* nothing to do */
+}
+
+static void
+pipeline_server_func (GServer * srv, GConn * conn, gpointer user_data)
+{
+  GString *lines;
+  gint i;
+
+  fail_unless (conn != NULL, "Can't set up server, some error occured");
+
+  *((GConn **) user_data) = conn;
+  gnet_conn_set_callback (conn, pipeline_server_conn_cb, NULL);
+
+  /* all lines in one write, so they arrive in as few reads as possible */
+  lines = g_string_new (NULL);
+  for (i = 0; i < PIPELINE_LINES; ++i)
+    g_string_append_printf (lines, "line%d\n", i);
+  gnet_conn_write (conn, lines->str, lines->len);
+  g_string_free (lines, TRUE);
+}
+
+static gboolean
+pipeline_readline_idle (gpointer data)
+{
+  gnet_conn_readline ((GConn *) data);
+  return FALSE;
+}
+
+static void
+pipeline_client_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  gchar *expected;
+
+  switch (event->type) {
+    case GNET_CONN_CONNECT:
+      gnet_conn_readline (conn);
+      break;
+    case GNET_CONN_READ:
+      expected = g_strdup_printf ("line%d", pipeline_lines);
+      fail_unless (strcmp (event->buffer, expected) == 0);
+      g_free (expected);
+      ++pipeline_lines;
+      /* queue the next read from the callback, and every now and then
+       * from outside it, while the data is already buffered */
+      if (pipeline_lines % 10 != 0)
+        gnet_conn_readline (conn);
+      else if (pipeline_lines < PIPELINE_LINES)
+        g_idle_add (pipeline_readline_idle, conn);
+      break;
+    default:
+      g_error ("Unexpected event type %d", event->type);
+      break;
+  }
+}
+
+GNET_START_TEST (test_conn_readline_pipelined_local)
+{
+  GConn *client, *server_conn = NULL;
+  GInetAddr *ia;
+  GServer *srv;
+
+  gnet_socks_set_enabled (FALSE);
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  fail_unless (ia != NULL);
+  srv = gnet_server_new (ia, 0, pipeline_server_func, &server_conn);
+  fail_unless (srv != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_set_port (ia, srv->port);
+
+  client = gnet_conn_new_inetaddr (ia, pipeline_client_cb, NULL);
+  gnet_conn_connect (client);
+  gnet_inetaddr_unref (ia);
+
+  while (pipeline_lines < PIPELINE_LINES)
+    g_main_context_iteration (NULL, TRUE);
+
+  gnet_conn_unref (client);
+  if (server_conn)
+    gnet_conn_unref (server_conn);
+  gnet_server_unref (srv);
+}
+GNET_END_TEST;
+
+#define IN_PLACE_MESSAGES 100
+
+typedef struct
+{
+  GConn *server_conn;
+  GString *stream;
+  GPackFormat *header;
+  gint messages;
+  gint reads;
+  gint wanted;                  /* least length of the next read */
+} InPlaceData;
+
+static gboolean
+in_place_write_tail (gpointer data)
+{
+  InPlaceData *d = data;
+
+  gnet_conn_write (d->server_conn, d->stream->str + d->stream->len - 3, 3);
+  return FALSE;
+}
+
+static void
+in_place_server_func (GServer * srv, GConn * conn, gpointer user_data)
+{
+  InPlaceData *d = user_data;
+
+  fail_unless (conn != NULL, "Can't set up server, some error occured");
+
+  d->server_conn = conn;
+  gnet_conn_set_callback (conn, pipeline_server_conn_cb, NULL);
+
+  /* all but the end of the last message at once, the rest later */
+  gnet_conn_write (conn, d->stream->str, d->stream->len - 3);
+  g_timeout_add (100, in_place_write_tail, d);
+}
+
+static void
+in_place_client_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  InPlaceData *d = data;
+  GPackCursor cursor;
+  guint16 type, length;
+  const gchar *body;
+  gchar *expected;
+
+  switch (event->type) {
+    case GNET_CONN_CONNECT:
+      gnet_conn_read_in_place (conn);
+      break;
+    case GNET_CONN_READ:
+      fail_unless (event->length >= d->wanted);
+      ++d->reads;
+
+      gnet_pack_cursor_init (&cursor, event->buffer, event->length);
+      while (gnet_pack_cursor_unpack (&cursor, d->header, &type, &length) &&
+          (body = gnet_pack_cursor_read (&cursor, length)) != NULL) {
+        fail_unless_equals_int (type, d->messages);
+        expected = g_strdup_printf ("message %d", d->messages);
+        fail_unless_equals_int (length, strlen (expected));
+        fail_unless (memcmp (body, expected, length) == 0);
+        g_free (expected);
+        ++d->messages;
+        gnet_pack_cursor_commit (&cursor);
+      }
+      fail_unless (gnet_pack_cursor_get_needed (&cursor) > 0);
+
+      /* the partial message stays buffered, and the next read waits
+       * for the rest of what it needs */
+      d->wanted = event->length - gnet_pack_cursor_get_committed (&cursor) +
+          gnet_pack_cursor_get_needed (&cursor);
+      gnet_conn_read_consume (conn, gnet_pack_cursor_get_committed (&cursor),
+          gnet_pack_cursor_get_needed (&cursor));
+      if (d->messages < IN_PLACE_MESSAGES)
+        gnet_conn_read_in_place (conn);
+      break;
+    default:
+      g_error ("Unexpected event type %d", event->type);
+      break;
+  }
+}
+
+GNET_START_TEST (test_conn_read_in_place_local)
+{
+  InPlaceData d;
+  GConn *client;
+  GInetAddr *ia;
+  GServer *srv;
+  gchar header[4];
+  gint i;
+
+  gnet_socks_set_enabled (FALSE);
+
+  memset (&d, 0, sizeof (d));
+  d.header = gnet_pack_format_new ("!HH");
+  d.stream = g_string_new (NULL);
+  for (i = 0; i < IN_PLACE_MESSAGES; ++i) {
+    gchar *body = g_strdup_printf ("message %d", i);
+
+    gnet_pack_format_pack (d.header, header, sizeof (header), i,
+        (gint) strlen (body));
+    g_string_append_len (d.stream, header, sizeof (header));
+    g_string_append (d.stream, body);
+    g_free (body);
+  }
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  fail_unless (ia != NULL);
+  srv = gnet_server_new (ia, 0, in_place_server_func, &d);
+  fail_unless (srv != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_set_port (ia, srv->port);
+
+  client = gnet_conn_new_inetaddr (ia, in_place_client_cb, &d);
+  gnet_conn_connect (client);
+  gnet_inetaddr_unref (ia);
+
+  while (d.messages < IN_PLACE_MESSAGES)
+    g_main_context_iteration (NULL, TRUE);
+
+  /* many messages per callback, and the split one waited for */
+  fail_unless (d.reads >= 2);
+  fail_unless (d.reads < IN_PLACE_MESSAGES / 2);
+
+  gnet_conn_unref (client);
+  if (d.server_conn)
+    gnet_conn_unref (d.server_conn);
+  gnet_server_unref (srv);
+  gnet_pack_format_free (d.header);
+  g_string_free (d.stream, TRUE);
+}
+GNET_END_TEST;
+
+static gint fast_open_replies = 0;
+
+static void
+fast_open_server_conn_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  switch (event->type) {
+    case GNET_CONN_READ:
+      gnet_conn_write (conn, event->buffer, event->length);
+      gnet_conn_write (conn, "\n", 1);
+      break;
+    case GNET_CONN_WRITE:
+    case GNET_CONN_CLOSE:
+      break;
+    default:
+      g_error ("Unexpected event type %d", event->type);
+      break;
+  }
+}
+
+static void
+fast_open_server_func (GServer * srv, GConn * conn, gpointer user_data)
+{
+  fail_unless (conn != NULL, "Can't set up server, some error occured");
+
+  *((GList **) user_data) = g_list_prepend (*((GList **) user_data), conn);
+  gnet_conn_set_callback (conn, fast_open_server_conn_cb, NULL);
+  gnet_conn_readline (conn);
+}
+
+static void
+fast_open_client_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  switch (event->type) {
+    case GNET_CONN_CONNECT:
+      /* with TCP Fast Open the request may ride on the SYN */
+      gnet_conn_write (conn, "hello", 5);
+      gnet_conn_write (conn, "\n", 1);
+      gnet_conn_readline (conn);
+      break;
+    case GNET_CONN_WRITE:
+      break;
+    case GNET_CONN_READ:
+      fail_unless (strcmp (event->buffer, "hello") == 0);
+      ++fast_open_replies;
+      break;
+    default:
+      g_error ("Unexpected event type %d", event->type);
+      break;
+  }
+}
+
+/* TRUE if the kernel does TCP Fast Open for both clients and servers */
+static gboolean
+fast_open_enabled (void)
+{
+  gchar *contents = NULL;
+  gint flags = 0;
+
+  if (g_file_get_contents ("/proc/sys/net/ipv4/tcp_fastopen", &contents,
+          NULL, NULL))
+    flags = atoi (contents);
+  g_free (contents);
+
+  return (flags & 3) == 3;
+}
+
+GNET_START_TEST (test_conn_fast_open_local)
+{
+  GList *server_conns = NULL, *l;
+  GConn *client;
+  GInetAddr *ia;
+  GServer *srv;
+  guint i, count;
+
+  gnet_socks_set_enabled (FALSE);
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  fail_unless (ia != NULL);
+  srv = gnet_server_new (ia, 0, fast_open_server_func, &server_conns);
+  fail_unless (srv != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_set_port (ia, srv->port);
+
+  /* the first connect fetches a cookie, the second may use it; both
+   * must work whether or not the kernel supports Fast Open */
+  for (i = 0; i < 2; ++i) {
+    client = gnet_conn_new_inetaddr (ia, fast_open_client_cb, NULL);
+    gnet_conn_set_fast_open (client, TRUE);
+    count = gnet_tcp_socket_get_fast_open_count ();
+    gnet_conn_connect (client);
+
+    while (fast_open_replies <= i)
+      g_main_context_iteration (NULL, TRUE);
+
+    /* the second connect has a cookie, and is counted once the reply
+     * is read, before the socket is freed */
+    if (i == 1 && fast_open_enabled ())
+      fail_unless (gnet_tcp_socket_get_fast_open_count () > count);
+
+    gnet_conn_unref (client);
+  }
+
+  fail_unless_equals_int (fast_open_replies, 2);
+
+  gnet_inetaddr_unref (ia);
+  for (l = server_conns; l != NULL; l = l->next)
+    gnet_conn_unref ((GConn *) l->data);
+  g_list_free (server_conns);
+  gnet_server_unref (srv);
+}
+GNET_END_TEST;
+
+static void
+set_option_server_func (GServer * srv, GConn * conn, gpointer user_data)
+{
+  fail_unless (conn != NULL, "Can't set up server, some error occured");
+
+  *((GList **) user_data) = g_list_prepend (*((GList **) user_data), conn);
+}
+
+static void
+set_option_client_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  gint value;
+
+  switch (event->type) {
+    case GNET_CONN_CONNECT:
+      /* set before connecting, and again after reconnecting */
+      fail_unless (gnet_conn_get_option (conn, GNET_SOCKET_OPTION_RCVBUF,
+              &value));
+      fail_unless (value >= 32768);
+      fail_unless (gnet_conn_get_option (conn,
+              GNET_SOCKET_OPTION_TCP_NODELAY, &value));
+      fail_unless (value != 0);
+      ++*((gint *) data);
+      break;
+    default:
+      g_error ("Unexpected event type %d", event->type);
+      break;
+  }
+}
+
+GNET_START_TEST (test_conn_set_option_local)
+{
+  GList *server_conns = NULL, *l;
+  GConn *client;
+  GInetAddr *ia;
+  GServer *srv;
+  gint connects = 0;
+
+  gnet_socks_set_enabled (FALSE);
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  fail_unless (ia != NULL);
+  srv = gnet_server_new (ia, 0, set_option_server_func, &server_conns);
+  fail_unless (srv != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_set_port (ia, srv->port);
+
+  client = gnet_conn_new_inetaddr (ia, set_option_client_cb, &connects);
+  fail_unless (gnet_conn_set_option (client, GNET_SOCKET_OPTION_RCVBUF,
+          32768));
+  fail_unless (gnet_conn_set_option (client, GNET_SOCKET_OPTION_TCP_NODELAY,
+          1));
+
+  gnet_conn_connect (client);
+  while (connects < 1)
+    g_main_context_iteration (NULL, TRUE);
+
+  gnet_conn_disconnect (client);
+  gnet_conn_connect (client);
+  while (connects < 2)
+    g_main_context_iteration (NULL, TRUE);
+
+  gnet_conn_unref (client);
+  gnet_inetaddr_unref (ia);
+  for (l = server_conns; l != NULL; l = l->next)
+    gnet_conn_unref ((GConn *) l->data);
+  g_list_free (server_conns);
+  gnet_server_unref (srv);
+}
+GNET_END_TEST;
+
+#define RATE_LIMIT 40000
+#define RATE_BYTES 20000
+
+typedef struct
+{
+  GList *server_conns;
+  gint server_read_bps;
+  gint received;
+  GList *done;                  /* clients in the order they finished */
+} RateData;
+
+static void
+rate_server_conn_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  RateData *d = data;
+
+  switch (event->type) {
+    case GNET_CONN_READ:
+      d->received += event->length;
+      gnet_conn_read (conn);
+      break;
+    case GNET_CONN_CLOSE:
+      break;
+    default:
+      g_error ("Unexpected event type %d", event->type);
+      break;
+  }
+}
+
+static void
+rate_server_func (GServer * srv, GConn * conn, gpointer user_data)
+{
+  RateData *d = user_data;
+
+  fail_unless (conn != NULL, "Can't set up server, some error occured");
+
+  d->server_conns = g_list_prepend (d->server_conns, conn);
+  gnet_conn_set_callback (conn, rate_server_conn_cb, d);
+  gnet_conn_set_rate_limit (conn, d->server_read_bps, 0);
+  gnet_conn_read (conn);
+}
+
+static void
+rate_client_cb (GConn * conn, GConnEvent * event, gpointer data)
+{
+  RateData *d = data;
+
+  switch (event->type) {
+    case GNET_CONN_CONNECT:
+      break;
+    case GNET_CONN_WRITE:
+      d->done = g_list_append (d->done, conn);
+      break;
+    default:
+      g_error ("Unexpected event type %d", event->type);
+      break;
+  }
+}
+
+static gdouble
+rate_seconds_since (GTimeVal * start)
+{
+  GTimeVal now;
+
+  g_get_current_time (&now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+/* Sends @length bytes from each client and returns the seconds it took
+ * until the server read them all */
+static gdouble
+rate_run (RateData * d, GConn ** clients, gint n_clients, gint length)
+{
+  GTimeVal start;
+  gchar *data;
+  gint i;
+
+  data = g_malloc0 (length);
+  g_get_current_time (&start);
+  for (i = 0; i < n_clients; ++i)
+    gnet_conn_write (clients[i], data, length);
+  g_free (data);
+
+  while (d->received < n_clients * length)
+    g_main_context_iteration (NULL, TRUE);
+  fail_unless_equals_int (d->received, n_clients * length);
+
+  return rate_seconds_since (&start);
+}
+
+static GServer *
+rate_server_new (RateData * d, GInetAddr ** ia)
+{
+  GServer *srv;
+
+  *ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  fail_unless (*ia != NULL);
+  srv = gnet_server_new (*ia, 0, rate_server_func, d);
+  fail_unless (srv != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_set_port (*ia, srv->port);
+
+  return srv;
+}
+
+static void
+rate_cleanup (RateData * d, GServer * srv, GInetAddr * ia,
+    GConn ** clients, gint n_clients)
+{
+  GList *l;
+  gint i;
+
+  for (i = 0; i < n_clients; ++i)
+    gnet_conn_unref (clients[i]);
+  for (l = d->server_conns; l != NULL; l = l->next)
+    gnet_conn_unref ((GConn *) l->data);
+  g_list_free (d->server_conns);
+  g_list_free (d->done);
+  gnet_inetaddr_unref (ia);
+  gnet_server_unref (srv);
+}
+
+GNET_START_TEST (test_conn_rate_limit_local)
+{
+  RateData d = { NULL, 0, 0, NULL };
+  GConn *client;
+  GInetAddr *ia;
+  GServer *srv;
+  gdouble secs;
+
+  gnet_socks_set_enabled (FALSE);
+
+  /* limited writes; the first tenth of a second comes at once */
+  srv = rate_server_new (&d, &ia);
+  client = gnet_conn_new_inetaddr (ia, rate_client_cb, &d);
+  gnet_conn_set_rate_limit (client, 0, RATE_LIMIT);
+  gnet_conn_connect (client);
+
+  secs = rate_run (&d, &client, 1, RATE_BYTES);
+  fail_unless (secs > 0.8 * (RATE_BYTES - RATE_LIMIT / 10) / RATE_LIMIT,
+      "wrote too fast: %f s", secs);
+
+  /* no limit */
+  d.received = 0;
+  gnet_conn_set_rate_limit (client, 0, 0);
+  secs = rate_run (&d, &client, 1, RATE_BYTES);
+  fail_unless (secs < 0.2, "wrote too slowly: %f s", secs);
+  rate_cleanup (&d, srv, ia, &client, 1);
+
+  /* limited reads */
+  memset (&d, 0, sizeof (d));
+  d.server_read_bps = RATE_LIMIT;
+  srv = rate_server_new (&d, &ia);
+  client = gnet_conn_new_inetaddr (ia, rate_client_cb, &d);
+  gnet_conn_connect (client);
+
+  secs = rate_run (&d, &client, 1, RATE_BYTES);
+  fail_unless (secs > 0.8 * (RATE_BYTES - RATE_LIMIT / 10) / RATE_LIMIT,
+      "read too fast: %f s", secs);
+  rate_cleanup (&d, srv, ia, &client, 1);
+}
+GNET_END_TEST;
+
+#define GROUP_LIMIT 400000
+#define GROUP_BYTES 100000
+
+GNET_START_TEST (test_conn_rate_group_local)
+{
+  RateData d = { NULL, 0, 0, NULL };
+  GConnRateGroup *group;
+  GConn *clients[2];
+  GInetAddr *ia;
+  GServer *srv;
+  gdouble secs;
+  gint i;
+
+  gnet_socks_set_enabled (FALSE);
+
+  srv = rate_server_new (&d, &ia);
+  group = gnet_conn_rate_group_new (0, GROUP_LIMIT);
+  gnet_conn_rate_group_set_policy (group, GNET_CONN_RATE_WEIGHTED_FAIR);
+  for (i = 0; i < 2; ++i) {
+    clients[i] = gnet_conn_new_inetaddr (ia, rate_client_cb, &d);
+    gnet_conn_set_rate_group (clients[i], group);
+    gnet_conn_connect (clients[i]);
+  }
+  /* the group holds on to itself while it has connections */
+  gnet_conn_rate_group_unref (group);
+
+  /* the second client gets three times the bandwidth of the first */
+  gnet_conn_set_rate_weight (clients[1], 3);
+
+  secs = rate_run (&d, clients, 2, GROUP_BYTES);
+  fail_unless (secs > 0.8 * (2 * GROUP_BYTES - GROUP_LIMIT / 10) / GROUP_LIMIT,
+      "wrote too fast: %f s", secs);
+  fail_unless_equals_int (g_list_length (d.done), 2);
+  fail_unless (d.done->data == clients[1]);
+
+  /* a connection's own limit applies inside the group */
+  gnet_conn_set_rate_limit (clients[0], 0, RATE_LIMIT);
+  gnet_conn_set_rate_group (clients[1], NULL);
+  d.received = 0;
+  secs = rate_run (&d, clients, 1, RATE_BYTES);
+  fail_unless (secs > 0.8 * (RATE_BYTES - RATE_LIMIT / 10) / RATE_LIMIT,
+      "wrote too fast: %f s", secs);
+
+  rate_cleanup (&d, srv, ia, clients, 2);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_conn_rate_group_context)
+{
+  GConnRateGroup *group;
+  GMainContext *context;
+  GConn *conn;
+
+  context = g_main_context_new ();
+  group = gnet_conn_rate_group_new_full (0, GROUP_LIMIT, context);
+  conn = gnet_conn_new ("localhost", 80, rate_client_cb, NULL);
+
+  /* the group's context does not follow its connections */
+  ASSERT_CRITICAL (gnet_conn_set_rate_group (conn, group));
+  fail_unless (gnet_conn_set_main_context (conn, context));
+  gnet_conn_set_rate_group (conn, group);
+  ASSERT_CRITICAL (gnet_conn_set_main_context (conn, NULL));
+
+  gnet_conn_set_rate_group (conn, NULL);
+  fail_unless (gnet_conn_set_main_context (conn, NULL));
+
+  gnet_conn_unref (conn);
+  gnet_conn_rate_group_unref (group);
+  g_main_context_unref (context);
+}
+GNET_END_TEST;
+
 static Suite *
 gnetconn_suite (void)
 {
@@ -254,6 +1272,21 @@ gnetconn_suite (void)
 
   suite_add_tcase (s, tc_chain);
 
+  tcase_add_test (tc_chain, test_conn_bytes);
+  tcase_add_test (tc_chain, test_conn_write_bytes_local);
+  tcase_add_test (tc_chain, test_conn_epoll_local);
+  tcase_add_test (tc_chain, test_conn_io_uring_local);
+  tcase_add_test (tc_chain, test_conn_io_uring_cancel_local);
+  tcase_add_test (tc_chain, test_conn_timeout);
+  tcase_add_test (tc_chain, test_conn_idle_timeout_local);
+  tcase_add_test (tc_chain, test_conn_readline_pipelined_local);
+  tcase_add_test (tc_chain, test_conn_read_in_place_local);
+  tcase_add_test (tc_chain, test_conn_fast_open_local);
+  tcase_add_test (tc_chain, test_conn_set_option_local);
+  tcase_add_test (tc_chain, test_conn_rate_limit_local);
+  tcase_add_test (tc_chain, test_conn_rate_group_local);
+  tcase_add_test (tc_chain, test_conn_rate_group_context);
+
 #ifdef GNET_ENABLE_NETWORK_TESTS
   tcase_add_test (tc_chain, test_conn_new);
   tcase_add_test (tc_chain, test_conn_new_inetaddr);
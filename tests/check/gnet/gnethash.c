@@ -1,4 +1,4 @@
-/* GNet unit test for MD5/SHA routines
+/* GNet unit test for MD5/SHA/BLAKE2b routines
  * Copyright (C) 2000, 2002  David Helder
  * Copyright (C) 2007 Tim-Philipp Müller  <tim centricular net>
  *
@@ -21,6 +21,8 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 GNET_START_TEST (test_md5)
 {
@@ -93,6 +95,378 @@ GNET_START_TEST (test_sha1)
 
 GNET_END_TEST;
 
+static const struct
+{
+  const gchar *message;
+  const gchar *digest;
+} sha1_vectors[] = {
+  { "", "da39a3ee5e6b4b0d3255bfef95601890afd80709" },
+  { "abc", "a9993e364706816aba3e25717850c26c9cd0d89d" },
+  { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    "84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+  { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+    "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+    "a49b2446a02c645bf419f995b67091253a04a259" }
+};
+
+GNET_START_TEST (test_sha1_vectors)
+{
+  gchar *buffer;
+  gchar *str;
+  GSHA *sha, *shab;
+  guint i, split, length;
+
+  for (i = 0; i < G_N_ELEMENTS (sha1_vectors); ++i) {
+    sha = gnet_sha_new (sha1_vectors[i].message,
+        strlen (sha1_vectors[i].message));
+    str = gnet_sha_get_string (sha);
+    fail_unless_equals_string (str, sha1_vectors[i].digest);
+    g_free (str);
+    gnet_sha_delete (sha);
+  }
+
+  /* a million a's, in pieces that straddle the blocks */
+  sha = gnet_sha_new_incremental ();
+  buffer = g_malloc (1000);
+  memset (buffer, 'a', 1000);
+  for (i = 0; i < 1000; ++i)
+    gnet_sha_update (sha, buffer, 1000);
+  gnet_sha_final (sha);
+  str = gnet_sha_get_string (sha);
+  fail_unless_equals_string (str, "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+  g_free (str);
+  gnet_sha_delete (sha);
+  g_free (buffer);
+
+  /* incremental updates split anywhere give the same hash */
+  length = 1000;
+  buffer = g_malloc (length);
+  for (i = 0; i < length; ++i)
+    buffer[i] = (gchar) (i * 7 + (i >> 3));
+  sha = gnet_sha_new (buffer, length);
+  for (split = 0; split <= 200; ++split) {
+    shab = gnet_sha_new_incremental ();
+    gnet_sha_update (shab, buffer, split);
+    gnet_sha_update (shab, buffer + split, 64 + split % 3);
+    gnet_sha_update (shab, buffer + 64 + split + split % 3,
+        length - 64 - split - split % 3);
+    gnet_sha_final (shab);
+    fail_unless (gnet_sha_equal (sha, shab));
+    gnet_sha_delete (shab);
+  }
+  gnet_sha_delete (sha);
+  g_free (buffer);
+}
+
+GNET_END_TEST;
+
+#define FILE_LENGTH 300000
+
+GNET_START_TEST (test_hash_file)
+{
+  gchar *buffer;
+  gchar *filename;
+  GSHA *sha, *shab;
+  GMD5 *md5, *md5b;
+  gint fd, fds[2];
+  guint i;
+
+  buffer = g_malloc (FILE_LENGTH);
+  for (i = 0; i < FILE_LENGTH; ++i)
+    buffer[i] = (gchar) (i * 13 + (i >> 9));
+
+  fd = g_file_open_tmp ("gnethashXXXXXX", &filename, NULL);
+  fail_unless (fd >= 0);
+  fail_unless_equals_int (write (fd, buffer, FILE_LENGTH), FILE_LENGTH);
+  close (fd);
+
+  /* the gsize variants agree with the guint ones */
+  sha = gnet_sha_new (buffer, FILE_LENGTH);
+  shab = gnet_sha_new_large (buffer, FILE_LENGTH);
+  fail_unless (gnet_sha_equal (sha, shab));
+  gnet_sha_delete (shab);
+  shab = gnet_sha_new_incremental ();
+  gnet_sha_update_large (shab, buffer, 1000);
+  gnet_sha_update_large (shab, buffer + 1000, FILE_LENGTH - 1000);
+  gnet_sha_final (shab);
+  fail_unless (gnet_sha_equal (sha, shab));
+  gnet_sha_delete (shab);
+
+  md5 = gnet_md5_new (buffer, FILE_LENGTH);
+  md5b = gnet_md5_new_large (buffer, FILE_LENGTH);
+  fail_unless (gnet_md5_equal (md5, md5b));
+  gnet_md5_delete (md5b);
+  md5b = gnet_md5_new_incremental ();
+  gnet_md5_update_large (md5b, buffer, 1000);
+  gnet_md5_update_large (md5b, buffer + 1000, FILE_LENGTH - 1000);
+  gnet_md5_final (md5b);
+  fail_unless (gnet_md5_equal (md5, md5b));
+  gnet_md5_delete (md5b);
+
+  /* a file by name */
+  shab = gnet_sha_new_file (filename);
+  fail_unless (shab != NULL);
+  fail_unless (gnet_sha_equal (sha, shab));
+  gnet_sha_delete (shab);
+  md5b = gnet_md5_new_file (filename);
+  fail_unless (md5b != NULL);
+  fail_unless (gnet_md5_equal (md5, md5b));
+  gnet_md5_delete (md5b);
+  gnet_sha_delete (sha);
+  gnet_md5_delete (md5);
+
+  /* a file descriptor, from its offset to the end */
+  fd = open (filename, O_RDONLY);
+  fail_unless (fd >= 0);
+  fail_unless (lseek (fd, 1000, SEEK_SET) == 1000);
+  sha = gnet_sha_new (buffer + 1000, FILE_LENGTH - 1000);
+  shab = gnet_sha_new_fd (fd);
+  fail_unless (shab != NULL);
+  fail_unless (gnet_sha_equal (sha, shab));
+  fail_unless (lseek (fd, 0, SEEK_CUR) == FILE_LENGTH);
+  gnet_sha_delete (shab);
+  gnet_sha_delete (sha);
+  close (fd);
+
+  /* a pipe is read */
+  fail_unless (pipe (fds) == 0);
+  fail_unless_equals_int (write (fds[1], buffer, 4000), 4000);
+  close (fds[1]);
+  md5 = gnet_md5_new (buffer, 4000);
+  md5b = gnet_md5_new_fd (fds[0]);
+  fail_unless (md5b != NULL);
+  fail_unless (gnet_md5_equal (md5, md5b));
+  gnet_md5_delete (md5b);
+  gnet_md5_delete (md5);
+  close (fds[0]);
+
+  /* files that report no size, like those in /proc, are read */
+  if (g_file_test ("/proc/version", G_FILE_TEST_EXISTS))
+    {
+      gchar* contents;
+      gsize length;
+
+      fail_unless (g_file_get_contents ("/proc/version", &contents,
+					&length, NULL));
+      fail_unless (length > 0);
+      sha = gnet_sha_new (contents, length);
+      shab = gnet_sha_new_file ("/proc/version");
+      fail_unless (shab != NULL);
+      fail_unless (gnet_sha_equal (sha, shab));
+      gnet_sha_delete (shab);
+      gnet_sha_delete (sha);
+      g_free (contents);
+    }
+
+  unlink (filename);
+  fail_unless (gnet_sha_new_file (filename) == NULL);
+  fail_unless (gnet_md5_new_file (filename) == NULL);
+  g_free (filename);
+  g_free (buffer);
+}
+
+GNET_END_TEST;
+
+#define BATCH_N 100
+
+GNET_START_TEST (test_hash_batch)
+{
+  const gchar *buffers[BATCH_N];
+  gsize lengths[BATCH_N];
+  gchar *data;
+  gchar *digests;
+  guint i, n;
+
+  /* lengths around the block and padding boundaries, and a few long
+     messages so the lanes get out of step */
+  data = g_malloc (5000);
+  for (i = 0; i < 5000; ++i)
+    data[i] = (gchar) (i * 31 + (i >> 7));
+  for (i = 0; i < BATCH_N; ++i) {
+    buffers[i] = data + i;
+    lengths[i] = (i * 37) % 140;
+    if (i % 17 == 5)
+      lengths[i] = 3000 + i;
+  }
+
+  digests = g_malloc (BATCH_N * GNET_SHA_HASH_LENGTH);
+
+  for (n = 0; n <= BATCH_N; n += (n < 10) ? 1 : 23) {
+    memset (digests, 0, BATCH_N * GNET_SHA_HASH_LENGTH);
+    gnet_md5_digest_batch (buffers, lengths, n, digests);
+    for (i = 0; i < n; ++i) {
+      GMD5 *md5 = gnet_md5_new (buffers[i], lengths[i]);
+      gchar *digest = gnet_md5_get_digest (md5);
+
+      fail_unless (memcmp (digests + i * GNET_MD5_HASH_LENGTH, digest,
+              GNET_MD5_HASH_LENGTH) == 0);
+      gnet_md5_delete (md5);
+    }
+
+    memset (digests, 0, BATCH_N * GNET_SHA_HASH_LENGTH);
+    gnet_sha_digest_batch (buffers, lengths, n, digests);
+    for (i = 0; i < n; ++i) {
+      GSHA *sha = gnet_sha_new (buffers[i], lengths[i]);
+      gchar *digest = gnet_sha_get_digest (sha);
+
+      fail_unless (memcmp (digests + i * GNET_SHA_HASH_LENGTH, digest,
+              GNET_SHA_HASH_LENGTH) == 0);
+      gnet_sha_delete (sha);
+    }
+  }
+
+  g_free (digests);
+  g_free (data);
+}
+
+GNET_END_TEST;
+
+/* The SHA-2 and BLAKE2b types all have the same functions */
+typedef struct
+{
+  gpointer (*new) (const gchar * buffer, gsize length);
+  gpointer (*new_string) (const gchar * str);
+  gpointer (*new_incremental) (void);
+  void (*update) (gpointer hash, const gchar * buffer, gsize length);
+  void (*final) (gpointer hash);
+  void (*delete) (gpointer hash);
+  gboolean (*equal) (gconstpointer p1, gconstpointer p2);
+  gchar *(*get_string) (gconstpointer hash);
+  const gchar *digests[5];      /* of hash_vectors and a million a's */
+} HashFuncs;
+
+#define HASH_FUNCS(name)                                          \
+  (gpointer) gnet_ ## name ## _new,                               \
+  (gpointer) gnet_ ## name ## _new_string,                        \
+  (gpointer) gnet_ ## name ## _new_incremental,                   \
+  (gpointer) gnet_ ## name ## _update,                            \
+  (gpointer) gnet_ ## name ## _final,                             \
+  (gpointer) gnet_ ## name ## _delete,                            \
+  gnet_ ## name ## _equal,                                        \
+  (gpointer) gnet_ ## name ## _get_string
+
+static const gchar *hash_vectors[] = {
+  "",
+  "abc",
+  "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+  "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+      "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu"
+};
+
+static void
+check_hash (const HashFuncs * f)
+{
+  gpointer hash, hashb;
+  gchar *buffer;
+  gchar *str;
+  guint i, split, length;
+
+  for (i = 0; i < G_N_ELEMENTS (hash_vectors); ++i) {
+    hash = f->new (hash_vectors[i], strlen (hash_vectors[i]));
+    str = f->get_string (hash);
+    fail_unless_equals_string (str, f->digests[i]);
+
+    /* and back from the string */
+    hashb = f->new_string (str);
+    fail_unless (f->equal (hash, hashb));
+    f->delete (hashb);
+    g_free (str);
+    f->delete (hash);
+  }
+
+  /* a million a's, in pieces that straddle the blocks */
+  hash = f->new_incremental ();
+  buffer = g_malloc (1000);
+  memset (buffer, 'a', 1000);
+  for (i = 0; i < 1000; ++i)
+    f->update (hash, buffer, 1000);
+  f->final (hash);
+  str = f->get_string (hash);
+  fail_unless_equals_string (str, f->digests[4]);
+  g_free (str);
+  f->delete (hash);
+  g_free (buffer);
+
+  /* incremental updates split anywhere give the same hash */
+  length = 1000;
+  buffer = g_malloc (length);
+  for (i = 0; i < length; ++i)
+    buffer[i] = (gchar) (i * 7 + (i >> 3));
+  hash = f->new (buffer, length);
+  for (split = 0; split <= 300; ++split) {
+    hashb = f->new_incremental ();
+    f->update (hashb, buffer, split);
+    f->update (hashb, buffer + split, 128 + split % 3);
+    f->update (hashb, buffer + 128 + split + split % 3,
+        length - 128 - split - split % 3);
+    f->final (hashb);
+    fail_unless (f->equal (hash, hashb));
+    f->delete (hashb);
+  }
+  f->delete (hash);
+  g_free (buffer);
+
+  ASSERT_CRITICAL (f->new_string ("not a digest"));
+}
+
+GNET_START_TEST (test_sha256)
+{
+  static const HashFuncs funcs = {
+    HASH_FUNCS (sha256),
+    {"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+     "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+     "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1",
+     "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"}
+  };
+
+  check_hash (&funcs);
+}
+
+GNET_END_TEST;
+
+GNET_START_TEST (test_sha512)
+{
+  static const HashFuncs funcs = {
+    HASH_FUNCS (sha512),
+    {"cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+     "47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e",
+     "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+     "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f",
+     "204a8fc6dda82f0a0ced7beb8e08a41657c16ef468b228a8279be331a703c335"
+     "96fd15c13b1b07f9aa1d3bea57789ca031ad85c7a71dd70354ec631238ca3445",
+     "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+     "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909",
+     "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973eb"
+     "de0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b"}
+  };
+
+  check_hash (&funcs);
+}
+
+GNET_END_TEST;
+
+GNET_START_TEST (test_blake2b)
+{
+  static const HashFuncs funcs = {
+    HASH_FUNCS (blake2b),
+    {"786a02f742015903c6c6fd852552d272912f4740e15847618a86e217f71f5419"
+     "d25e1031afee585313896444934eb04b903a685b1448b755d56f701afe9be2ce",
+     "ba80a53f981c4d0d6a2797b69f12f6e94c212f14685ac4b74b12bb6fdbffa2d1"
+     "7d87c5392aab792dc252d5de4533cc9518d38aa8dbf1925ab92386edd4009923",
+     "7285ff3e8bd768d69be62b3bf18765a325917fa9744ac2f582a20850bc2b1141"
+     "ed1b3e4528595acc90772bdf2d37dc8a47130b44f33a02e8730e5ad8e166e888",
+     "ce741ac5930fe346811175c5227bb7bfcd47f42612fae46c0809514f9e0e3a11"
+     "ee1773287147cdeaeedff50709aa716341fe65240f4ad6777d6bfaf9726e5e52",
+     "98fb3efb7206fd19ebf69b6f312cf7b64e3b94dbe1a17107913975a793f177e1"
+     "d077609d7fba363cbba00d05f7aa4e4fa8715d6428104c0a75643b0ff3fd3eaf"}
+  };
+
+  check_hash (&funcs);
+}
+
+GNET_END_TEST;
+
 static Suite *
 gnethash_suite (void)
 {
@@ -104,6 +478,12 @@ gnethash_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_md5);
   tcase_add_test (tc_chain, test_sha1);
+  tcase_add_test (tc_chain, test_sha1_vectors);
+  tcase_add_test (tc_chain, test_hash_file);
+  tcase_add_test (tc_chain, test_hash_batch);
+  tcase_add_test (tc_chain, test_sha256);
+  tcase_add_test (tc_chain, test_sha512);
+  tcase_add_test (tc_chain, test_blake2b);
   return s;
 }
 
@@ -64,6 +64,7 @@ test_bytes (int line_num, char * s_binary, int len, char * answer_ascii)
     G_STMT_START {                                      \
       char buffer[SIZE];                                \
       char *str;                                        \
+      GPackFormat *pf;                                  \
       int len, calclen;                                 \
       g_assert (SIZE == strlen(ANSWER)/2);              \
       calclen = gnet_calcsize (FORMAT);                 \
@@ -77,12 +78,25 @@ test_bytes (int line_num, char * s_binary, int len, char * answer_ascii)
       len = gnet_pack_strdup (FORMAT, &str);            \
       test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
       g_free (str);                                     \
+      pf = gnet_pack_format_new (FORMAT);               \
+      fail_unless (pf != NULL);                         \
+      fail_unless_equals_int (gnet_pack_format_calcsize (pf), calclen);\
+      memset (buffer, 0xaa, SIZE);                      \
+      len = gnet_pack_format_pack (pf, buffer, SIZE);   \
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
+      len = gnet_pack_format_pack_strdup (pf, &str);    \
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, str, SIZE, ANSWER);         \
+      g_free (str);                                     \
+      gnet_pack_format_free (pf);                       \
     } G_STMT_END;
 
 #define TEST1(NUM, ANSWER, FORMAT, SIZE, ARG1)          \
     G_STMT_START {                                      \
       char buffer[SIZE];                                \
       char *str;                                        \
+      GPackFormat *pf;                                  \
       int len, calclen;                                 \
       g_assert (SIZE == strlen(ANSWER)/2);              \
       calclen = gnet_calcsize (FORMAT, ARG1);           \
@@ -96,12 +110,25 @@ test_bytes (int line_num, char * s_binary, int len, char * answer_ascii)
       len = gnet_pack_strdup (FORMAT, &str, ARG1);      \
       test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
       g_free (str);                                     \
+      pf = gnet_pack_format_new (FORMAT);               \
+      fail_unless (pf != NULL);                         \
+      fail_unless_equals_int (gnet_pack_format_calcsize (pf, ARG1), calclen);\
+      memset (buffer, 0xaa, SIZE);                      \
+      len = gnet_pack_format_pack (pf, buffer, SIZE, ARG1);\
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
+      len = gnet_pack_format_pack_strdup (pf, &str, ARG1);\
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, str, SIZE, ANSWER);         \
+      g_free (str);                                     \
+      gnet_pack_format_free (pf);                       \
     } G_STMT_END;
 
 #define TEST2(NUM, ANSWER, FORMAT, SIZE, ARG1, ARG2)    \
     G_STMT_START {                                      \
       char buffer[SIZE];                                \
       char *str;                                        \
+      GPackFormat *pf;                                  \
       int len, calclen;                                 \
       g_assert (SIZE == strlen(ANSWER)/2);              \
       calclen = gnet_calcsize (FORMAT, ARG1, ARG2);     \
@@ -115,12 +142,25 @@ test_bytes (int line_num, char * s_binary, int len, char * answer_ascii)
       len = gnet_pack_strdup (FORMAT, &str, ARG1, ARG2);\
       test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
       g_free (str);                                     \
+      pf = gnet_pack_format_new (FORMAT);               \
+      fail_unless (pf != NULL);                         \
+      fail_unless_equals_int (gnet_pack_format_calcsize (pf, ARG1, ARG2), calclen);\
+      memset (buffer, 0xaa, SIZE);                      \
+      len = gnet_pack_format_pack (pf, buffer, SIZE, ARG1, ARG2);\
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
+      len = gnet_pack_format_pack_strdup (pf, &str, ARG1, ARG2);\
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, str, SIZE, ANSWER);         \
+      g_free (str);                                     \
+      gnet_pack_format_free (pf);                       \
     } G_STMT_END;
 
 #define TEST3(NUM, ANSWER, FORMAT, SIZE, ARG1, ARG2, ARG3) \
     G_STMT_START {                                      \
       char buffer[SIZE];                                \
       char *str;                                        \
+      GPackFormat *pf;                                  \
       int len, calclen;                                 \
       g_assert (SIZE == strlen(ANSWER)/2);              \
       calclen = gnet_calcsize (FORMAT, ARG1, ARG2, ARG3);\
@@ -134,12 +174,25 @@ test_bytes (int line_num, char * s_binary, int len, char * answer_ascii)
       len = gnet_pack_strdup (FORMAT, &str, ARG1, ARG2, ARG3);\
       test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
       g_free (str);                                     \
+      pf = gnet_pack_format_new (FORMAT);               \
+      fail_unless (pf != NULL);                         \
+      fail_unless_equals_int (gnet_pack_format_calcsize (pf, ARG1, ARG2, ARG3), calclen);\
+      memset (buffer, 0xaa, SIZE);                      \
+      len = gnet_pack_format_pack (pf, buffer, SIZE, ARG1, ARG2, ARG3);\
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
+      len = gnet_pack_format_pack_strdup (pf, &str, ARG1, ARG2, ARG3);\
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, str, SIZE, ANSWER);         \
+      g_free (str);                                     \
+      gnet_pack_format_free (pf);                       \
     } G_STMT_END;
 
 #define TEST4(NUM, ANSWER, FORMAT, SIZE, ARG1, ARG2, ARG3, ARG4) \
     G_STMT_START {                                      \
       char buffer[SIZE];                                \
       char *str;                                        \
+      GPackFormat *pf;                                  \
       int len, calclen;                                 \
       g_assert (SIZE == strlen(ANSWER)/2);              \
       calclen = gnet_calcsize (FORMAT, ARG1, ARG2, ARG3, ARG4);\
@@ -153,12 +206,25 @@ test_bytes (int line_num, char * s_binary, int len, char * answer_ascii)
       len = gnet_pack_strdup (FORMAT, &str, ARG1, ARG2, ARG3, ARG4);\
       test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
       g_free (str);                                     \
+      pf = gnet_pack_format_new (FORMAT);               \
+      fail_unless (pf != NULL);                         \
+      fail_unless_equals_int (gnet_pack_format_calcsize (pf, ARG1, ARG2, ARG3, ARG4), calclen);\
+      memset (buffer, 0xaa, SIZE);                      \
+      len = gnet_pack_format_pack (pf, buffer, SIZE, ARG1, ARG2, ARG3, ARG4);\
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, buffer, SIZE, ANSWER);      \
+      len = gnet_pack_format_pack_strdup (pf, &str, ARG1, ARG2, ARG3, ARG4);\
+      fail_unless_equals_int (len, calclen);            \
+      test_bytes (__LINE__, str, SIZE, ANSWER);         \
+      g_free (str);                                     \
+      gnet_pack_format_free (pf);                       \
     } G_STMT_END;
 
 #define MEMTEST1(NUM, FORMAT, SIZE, ARG1) \
     G_STMT_START {                                      \
       char buffer[SIZE];                                \
       char *str;                                        \
+      GPackFormat *pf;                                  \
       int len, calclen;                                 \
       calclen = gnet_calcsize (FORMAT, ARG1);           \
       fail_unless_equals_int (SIZE, calclen);           \
@@ -167,6 +233,16 @@ test_bytes (int line_num, char * s_binary, int len, char * answer_ascii)
       len = gnet_pack_strdup (FORMAT, &str, ARG1);      \
       fail_unless_equals_int (len, calclen);            \
       g_free (str);                                     \
+      pf = gnet_pack_format_new (FORMAT);               \
+      fail_unless (pf != NULL);                         \
+      fail_unless_equals_int (gnet_pack_format_calcsize (pf, ARG1), calclen);\
+      memset (buffer, 0xaa, SIZE);                      \
+      len = gnet_pack_format_pack (pf, buffer, SIZE, ARG1);\
+      fail_unless_equals_int (len, calclen);            \
+      len = gnet_pack_format_pack_strdup (pf, &str, ARG1);\
+      fail_unless_equals_int (len, calclen);            \
+      g_free (str);                                     \
+      gnet_pack_format_free (pf);                       \
     } G_STMT_END;
 
 /*** FAILURES (these cause warnings) ***/
@@ -195,6 +271,261 @@ GNET_START_TEST (test_pack_failures)
   ASSERT_CRITICAL (gnet_pack ("4R4R", buffer, 7, "efgh", "abcd"));
   ASSERT_CRITICAL (gnet_pack ("p", buffer, 4, "abcd"));
   ASSERT_CRITICAL (gnet_pack ("2p", buffer, 9, "efgh", "abcd"));
+  ASSERT_CRITICAL (gnet_pack ("q", buffer, 7, G_GINT64_CONSTANT (0)));
+  ASSERT_CRITICAL (gnet_pack ("W", buffer, 1, G_GUINT64_CONSTANT (128)));
+  ASSERT_CRITICAL (gnet_pack ("w", buffer, 9, G_MININT64));
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_pack_format)
+{
+  GPackFormat *pf;
+  gchar buffer[256];
+  gchar *str;
+
+  /* fixed-size fields are merged into one size */
+  pf = gnet_pack_format_new ("!HH 2I x4R");
+  fail_unless (pf != NULL);
+  fail_unless_equals_int (gnet_pack_format_get_size (pf), 17);
+  fail_unless_equals_int (gnet_pack_format_pack (pf, buffer, 17, 0x0102,
+          0x0304, 0x05060708, 0x090a0b0c, "abcd"), 17);
+  test_bytes (__LINE__, buffer, 17,
+      "0102030405060708090a0b0c0061626364");
+  ASSERT_CRITICAL (gnet_pack_format_pack (pf, buffer, 16, 0x0102, 0x0304,
+          0x05060708, 0x090a0b0c, "abcd"));
+  gnet_pack_format_free (pf);
+
+  /* varints make the size variable */
+  pf = gnet_pack_format_new ("!QW");
+  fail_unless_equals_int (gnet_pack_format_get_size (pf), -1);
+  fail_unless_equals_int (gnet_pack_format_calcsize (pf,
+          G_GUINT64_CONSTANT (1), G_GUINT64_CONSTANT (300)), 10);
+  gnet_pack_format_free (pf);
+
+  /* variable-size fields between runs */
+  pf = gnet_pack_format_new ("<Hs2pB");
+  fail_unless_equals_int (gnet_pack_format_get_size (pf), -1);
+  fail_unless_equals_int (gnet_pack_format_calcsize (pf, 0x0102, "ab",
+          "c", "", 0x03), 9);
+  fail_unless_equals_int (gnet_pack_format_pack_strdup (pf, &str, 0x0102,
+          "ab", "c", "", 0x03), 9);
+  test_bytes (__LINE__, str, 9, "020161620001630003");
+  g_free (str);
+  ASSERT_CRITICAL (gnet_pack_format_pack (pf, buffer, 8, 0x0102, "ab",
+          "c", "", 0x03));
+  gnet_pack_format_free (pf);
+
+  ASSERT_CRITICAL (gnet_pack_format_new ("by"));
+  ASSERT_CRITICAL (gnet_pack_format_new ("R"));
+}
+GNET_END_TEST;
+
+/*** VARINTS ***/
+
+GNET_START_TEST (test_pack_varint)
+{
+  TEST1 (50000, "00", "W", 1, G_GUINT64_CONSTANT (0));
+  TEST1 (50010, "7f", "W", 1, G_GUINT64_CONSTANT (127));
+  TEST1 (50020, "8001", "W", 2, G_GUINT64_CONSTANT (128));
+  TEST1 (50030, "ac02", "W", 2, G_GUINT64_CONSTANT (300));
+  TEST1 (50040, "ffffffffffffffffff01", "W", 10, G_MAXUINT64);
+
+  TEST1 (50100, "00", "w", 1, G_GINT64_CONSTANT (0));
+  TEST1 (50110, "01", "w", 1, G_GINT64_CONSTANT (-1));
+  TEST1 (50120, "02", "w", 1, G_GINT64_CONSTANT (1));
+  TEST1 (50130, "03", "w", 1, G_GINT64_CONSTANT (-2));
+  TEST1 (50140, "feffffffffffffffff01", "w", 10, G_MAXINT64);
+  TEST1 (50150, "ffffffffffffffffff01", "w", 10, G_MININT64);
+
+  /* byte order does not apply to varints */
+  TEST3 (50200, "0001ac0202", ">HWw", 5, 0x0001, G_GUINT64_CONSTANT (300),
+      G_GINT64_CONSTANT (1));
+  TEST2 (50210, "7f8001", "2W", 3, G_GUINT64_CONSTANT (127),
+      G_GUINT64_CONSTANT (128));
+}
+GNET_END_TEST;
+
+/*** ARRAYS ***/
+
+typedef struct
+{
+  guint16 a;
+  guint16 b;
+  guint32 c;
+} Record8;
+
+typedef struct
+{
+  guint8  a;
+  guint32 b;
+  guint16 c;
+  guint8  extra;
+} Record7;
+
+typedef struct
+{
+  guint64 a;
+  gint32  b;
+  guint64 c;
+  gdouble d;
+} Record28;
+
+#define N_RECORDS 1000
+
+/* pack and unpack arrays of several lengths so that every code path
+ * and its tail is run; compare with packing one record at a time */
+GNET_START_TEST (test_pack_array)
+{
+  static const gsize offsets8[] = { G_STRUCT_OFFSET (Record8, a),
+      G_STRUCT_OFFSET (Record8, b), G_STRUCT_OFFSET (Record8, c) };
+  static const gsize offsets7[] = { G_STRUCT_OFFSET (Record7, a),
+      G_STRUCT_OFFSET (Record7, b), G_STRUCT_OFFSET (Record7, c) };
+  static const gsize offsets28[] = { G_STRUCT_OFFSET (Record28, a),
+      G_STRUCT_OFFSET (Record28, b), G_STRUCT_OFFSET (Record28, c),
+      G_STRUCT_OFFSET (Record28, d) };
+  static const guint counts[] = { 0, 1, 2, 3, 5, 17, 33, N_RECORDS };
+  GPackFormat *pf8, *pf7, *pf28;
+  Record8 *r8, *u8;
+  Record7 *r7, *u7;
+  Record28 *r28, *u28;
+  gchar *buffer, *expected;
+  guint i, c;
+
+  pf8 = gnet_pack_format_new ("!HHI");
+  pf7 = gnet_pack_format_new ("<BIH");
+  pf28 = gnet_pack_format_new (">QiQd");
+
+  r8 = g_new (Record8, N_RECORDS);
+  r7 = g_new (Record7, N_RECORDS);
+  r28 = g_new (Record28, N_RECORDS);
+  u8 = g_new (Record8, N_RECORDS);
+  u7 = g_new (Record7, N_RECORDS);
+  u28 = g_new (Record28, N_RECORDS);
+  buffer = g_malloc (N_RECORDS * 28);
+  expected = g_malloc (N_RECORDS * 28);
+
+  for (i = 0; i < N_RECORDS; ++i) {
+    r8[i].a = i;
+    r8[i].b = i * 7;
+    r8[i].c = i * 0x01020304;
+    r7[i].a = i;
+    r7[i].b = i * 0x01020304;
+    r7[i].c = i * 3;
+    r7[i].extra = 0x5a;
+    r28[i].a = i * G_GUINT64_CONSTANT (0x0102030405060708);
+    r28[i].b = -(gint32) i;
+    r28[i].c = ~r28[i].a;
+    r28[i].d = i / 4.0;
+  }
+
+  for (c = 0; c < G_N_ELEMENTS (counts); ++c) {
+    guint n = counts[c];
+
+    /* dense records */
+    for (i = 0; i < n; ++i)
+      gnet_pack_format_pack (pf8, expected + i * 8, 8, r8[i].a, r8[i].b,
+          r8[i].c);
+    fail_unless_equals_int (gnet_pack_format_pack_array (pf8, buffer,
+            N_RECORDS * 8, r8, sizeof (Record8), offsets8, n), n * 8);
+    fail_unless (memcmp (buffer, expected, n * 8) == 0);
+    memset (u8, 0, N_RECORDS * sizeof (Record8));
+    fail_unless_equals_int (gnet_pack_format_unpack_array (pf8, buffer,
+            n * 8, u8, sizeof (Record8), offsets8, n), n * 8);
+    fail_unless (memcmp (u8, r8, n * sizeof (Record8)) == 0);
+
+    /* a record per shuffle; struct bytes that are not fields stay */
+    for (i = 0; i < n; ++i)
+      gnet_pack_format_pack (pf7, expected + i * 7, 7, r7[i].a, r7[i].b,
+          r7[i].c);
+    fail_unless_equals_int (gnet_pack_format_pack_array (pf7, buffer,
+            N_RECORDS * 7, r7, sizeof (Record7), offsets7, n), n * 7);
+    fail_unless (memcmp (buffer, expected, n * 7) == 0);
+    memset (u7, 0xee, N_RECORDS * sizeof (Record7));
+    fail_unless_equals_int (gnet_pack_format_unpack_array (pf7, buffer,
+            n * 7, u7, sizeof (Record7), offsets7, n), n * 7);
+    for (i = 0; i < n; ++i) {
+      fail_unless (u7[i].a == r7[i].a && u7[i].b == r7[i].b &&
+          u7[i].c == r7[i].c);
+      fail_unless (u7[i].extra == 0xee);
+    }
+    if (n < N_RECORDS)
+      fail_unless (u7[n].a == 0xee && u7[n].extra == 0xee);
+
+    /* records too large to shuffle */
+    for (i = 0; i < n; ++i)
+      gnet_pack_format_pack (pf28, expected + i * 28, 28, r28[i].a, r28[i].b,
+          r28[i].c, r28[i].d);
+    fail_unless_equals_int (gnet_pack_format_pack_array (pf28, buffer,
+            N_RECORDS * 28, r28, sizeof (Record28), offsets28, n), n * 28);
+    fail_unless (memcmp (buffer, expected, n * 28) == 0);
+    memset (u28, 0, N_RECORDS * sizeof (Record28));
+    fail_unless_equals_int (gnet_pack_format_unpack_array (pf28, buffer,
+            n * 28, u28, sizeof (Record28), offsets28, n), n * 28);
+    for (i = 0; i < n; ++i)
+      fail_unless (u28[i].a == r28[i].a && u28[i].b == r28[i].b &&
+          u28[i].c == r28[i].c && u28[i].d == r28[i].d);
+  }
+
+  ASSERT_CRITICAL (gnet_pack_format_pack_array (pf8, buffer, 15, r8,
+          sizeof (Record8), offsets8, 2));
+  ASSERT_CRITICAL (gnet_pack_format_unpack_array (pf8, buffer, 16, u8,
+          6, offsets8, 2));
+
+  gnet_pack_format_free (pf8);
+  gnet_pack_format_free (pf7);
+  gnet_pack_format_free (pf28);
+  g_free (r8);
+  g_free (r7);
+  g_free (r28);
+  g_free (u8);
+  g_free (u7);
+  g_free (u28);
+  g_free (buffer);
+  g_free (expected);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_pack_array_layout)
+{
+  GPackFormat *pf;
+  gchar record[8];
+  gchar buffer[16];
+  gchar out[16];
+  guint16 h;
+
+  /* without offsets the struct has the packed layout; padding is
+   * zeroed when packing and left alone when unpacking */
+  pf = gnet_pack_format_new ("!Hx2BxH");
+  h = 0x0201;
+  memset (record, 0x11, sizeof (record));
+  memcpy (record, &h, 2);
+  record[3] = 0x03;
+  record[4] = 0x04;
+  h = 0x0605;
+  memcpy (record + 6, &h, 2);
+  fail_unless_equals_int (gnet_pack_format_pack_array (pf, buffer,
+          sizeof (buffer), record, 8, NULL, 1), 8);
+  test_bytes (__LINE__, buffer, 8, "0201000304000605");
+
+  memset (out, 0x22, sizeof (out));
+  fail_unless_equals_int (gnet_pack_format_unpack_array (pf, buffer, 8,
+          out, 8, NULL, 1), 8);
+  memcpy (&h, out, 2);
+  fail_unless_equals_int (h, 0x0201);
+  test_bytes (__LINE__, out + 2, 4, "22030422");
+  memcpy (&h, out + 6, 2);
+  fail_unless_equals_int (h, 0x0605);
+  gnet_pack_format_free (pf);
+
+  /* only fixed-size number fields */
+  pf = gnet_pack_format_new ("Hs");
+  ASSERT_CRITICAL (gnet_pack_format_pack_array (pf, buffer,
+          sizeof (buffer), record, 8, NULL, 1));
+  gnet_pack_format_free (pf);
+  pf = gnet_pack_format_new ("H4S");
+  ASSERT_CRITICAL (gnet_pack_format_unpack_array (pf, buffer,
+          sizeof (buffer), out, 8, NULL, 1));
+  gnet_pack_format_free (pf);
 }
 GNET_END_TEST;
 
@@ -252,6 +583,12 @@ GNET_START_TEST (test_pack_little_endian)
   TEST1 (20910, "040302f1", "<L", 4, 0xf1020304);
   TEST1 (20920, "f4030201", "<L", 4, 0x010203f4);
 
+  TEST1 (20930, "0807060504030201", "<q", 8,
+      G_GINT64_CONSTANT (0x0102030405060708));
+  TEST1 (20940, "f8ffffffffffffff", "<q", 8, G_GINT64_CONSTANT (-8));
+  TEST1 (20950, "08070605040302f1", "<Q", 8,
+      G_GUINT64_CONSTANT (0xf102030405060708));
+
   /* these should always be native size and endianness */
   /* CHECKME: do floats not get promoted to doubles in vararg functions?! */
   MEMTEST1 (21000, "<f", sizeof(float),  23.43);
@@ -299,6 +636,14 @@ GNET_START_TEST (test_pack_big_endian)
   TEST1 (30910, "f1020304", ">L", 4, 0xf1020304);
   TEST1 (30920, "010203f4", ">L", 4, 0x010203f4);
 
+  TEST1 (30930, "0102030405060708", ">q", 8,
+      G_GINT64_CONSTANT (0x0102030405060708));
+  TEST1 (30940, "fffffffffffffff8", ">q", 8, G_GINT64_CONSTANT (-8));
+  TEST1 (30950, "f102030405060708", ">Q", 8,
+      G_GUINT64_CONSTANT (0xf102030405060708));
+  TEST3 (30960, "01000000000000000203", ">bQb", 10, 0x01,
+      G_GUINT64_CONSTANT (0x02), 0x03);
+
   /* these should always be native size and endianness */
   /* CHECKME: do floats not get promoted to doubles in vararg functions?! */
   MEMTEST1 (31000, ">f", sizeof(float),  23.43);
@@ -410,6 +755,11 @@ GNET_START_TEST (test_pack_native_little_endian)
 # error "sizeof(void *) neither 4 nor 8!?"
 #endif
 
+  TEST1 (11130, "0807060504030201", "q", 8,
+      G_GINT64_CONSTANT (0x0102030405060708));
+  TEST1 (11140, "0807060504030201", "Q", 8,
+      G_GUINT64_CONSTANT (0x0102030405060708));
+
   TEST3 (11200, "00010002",         "bhb", 4,  0x00, 0x0001, 0x02);
   TEST2 (11210, "0403020108070605", "ii",  8, 0x01020304, 0x05060708);
   TEST2 (11220, "0403020108070605", "2i",  8, 0x01020304, 0x05060708);
@@ -497,6 +847,11 @@ GNET_START_TEST (test_pack_native_big_endian)
 # error "sizeof(void *) neither 4 nor 8!?"
 #endif
 
+  TEST1 (11130, "0102030405060708", "q", 8,
+      G_GINT64_CONSTANT (0x0102030405060708));
+  TEST1 (11140, "0102030405060708", "Q", 8,
+      G_GUINT64_CONSTANT (0x0102030405060708));
+
   TEST3 (11200, "00000102", "bhb", 4,  0x00, 0x0001, 0x02);
   TEST2 (11201, "0102030405060708", "ii", 8, 0x01020304, 0x05060708);
   TEST2 (11202, "0102030405060708", "2i", 8, 0x01020304, 0x05060708);
@@ -514,6 +869,7 @@ gnetpack_suite (void)
   suite_add_tcase (s, tc_chain);
 
   tcase_add_test (tc_chain, test_pack_strings);
+  tcase_add_test (tc_chain, test_pack_varint);
   tcase_add_test (tc_chain, test_pack_native_common);
   if (G_BYTE_ORDER == G_LITTLE_ENDIAN) {
     tcase_add_test (tc_chain, test_pack_native_little_endian);
@@ -523,6 +879,9 @@ gnetpack_suite (void)
   tcase_add_test (tc_chain, test_pack_big_endian);
   tcase_add_test (tc_chain, test_pack_little_endian);
   tcase_add_test (tc_chain, test_pack_failures);
+  tcase_add_test (tc_chain, test_pack_format);
+  tcase_add_test (tc_chain, test_pack_array);
+  tcase_add_test (tc_chain, test_pack_array_layout);
 
   return s;
 }
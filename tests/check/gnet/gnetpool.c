@@ -0,0 +1,259 @@
+/* GNet GPacketPool unit test
+ * Copyright (C) 2000, 2002  David Helder
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "config.h"
+#include "gnetcheck.h"
+
+#include <string.h>
+
+#define N_SLOTS   64
+#define SLOT_SIZE 1500
+
+GNET_START_TEST (test_pool_alloc)
+{
+  GPacketPool *pool;
+  gchar *buffers[N_SLOTS];
+  gint i, j;
+
+  pool = gnet_packet_pool_new (SLOT_SIZE, N_SLOTS);
+  fail_unless (pool != NULL);
+  fail_unless_equals_int (gnet_packet_pool_get_slot_size (pool), SLOT_SIZE);
+  fail_unless_equals_int (gnet_packet_pool_get_n_slots (pool), N_SLOTS);
+
+  /* every buffer once, aligned and not overlapping */
+  for (i = 0; i < N_SLOTS; ++i) {
+    buffers[i] = gnet_packet_pool_alloc (pool);
+    fail_unless (buffers[i] != NULL);
+    fail_unless ((GPOINTER_TO_UINT (buffers[i]) & 15) == 0);
+    memset (buffers[i], i, SLOT_SIZE);
+  }
+  fail_unless (gnet_packet_pool_alloc (pool) == NULL);
+
+  for (i = 0; i < N_SLOTS; ++i) {
+    for (j = 0; j < SLOT_SIZE; ++j)
+      fail_unless (buffers[i][j] == (gchar) i);
+  }
+
+  /* a buffer goes back when its last reference is dropped */
+  gnet_packet_buffer_ref (buffers[0]);
+  gnet_packet_buffer_unref (buffers[0]);
+  fail_unless (gnet_packet_pool_alloc (pool) == NULL);
+  gnet_packet_buffer_unref (buffers[0]);
+  buffers[0] = gnet_packet_pool_alloc (pool);
+  fail_unless (buffers[0] != NULL);
+
+  /* the buffers keep the pool alive */
+  gnet_packet_pool_unref (pool);
+  for (i = 0; i < N_SLOTS; ++i)
+    gnet_packet_buffer_unref (buffers[i]);
+
+  ASSERT_CRITICAL (gnet_packet_pool_new (0, N_SLOTS));
+  ASSERT_CRITICAL (gnet_packet_pool_new (SLOT_SIZE, 0));
+  ASSERT_CRITICAL (gnet_packet_pool_new (SLOT_SIZE, 65536));
+}
+GNET_END_TEST;
+
+#define THREADS     4
+#define ITERATIONS  100000
+
+static gpointer
+pool_thread (gpointer data)
+{
+  GPacketPool *pool = data;
+  gchar *held[4];
+  gint i, j;
+
+  for (i = 0; i < ITERATIONS; ++i) {
+    /* each buffer must be ours alone until it is released */
+    for (j = 0; j < 4; ++j) {
+      held[j] = gnet_packet_pool_alloc (pool);
+      fail_unless (held[j] != NULL);
+      *((gpointer *) held[j]) = g_thread_self ();
+    }
+    for (j = 0; j < 4; ++j) {
+      fail_unless (*((gpointer *) held[j]) == g_thread_self ());
+      gnet_packet_buffer_unref (held[j]);
+    }
+  }
+
+  return NULL;
+}
+
+GNET_START_TEST (test_pool_threads)
+{
+  GPacketPool *pool;
+  GThread *threads[THREADS];
+  gchar *buffers[N_SLOTS];
+  gint i;
+
+  pool = gnet_packet_pool_new (SLOT_SIZE, THREADS * 4);
+
+  for (i = 0; i < THREADS; ++i) {
+    threads[i] = g_thread_create (pool_thread, pool, TRUE, NULL);
+    fail_unless (threads[i] != NULL);
+  }
+  for (i = 0; i < THREADS; ++i)
+    g_thread_join (threads[i]);
+
+  /* all the buffers are back */
+  for (i = 0; i < THREADS * 4; ++i)
+    fail_unless ((buffers[i] = gnet_packet_pool_alloc (pool)) != NULL);
+  fail_unless (gnet_packet_pool_alloc (pool) == NULL);
+  for (i = 0; i < THREADS * 4; ++i)
+    gnet_packet_buffer_unref (buffers[i]);
+
+  gnet_packet_pool_unref (pool);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_pool_udp_local)
+{
+  GUdpSocket *sender, *receiver;
+  GPacketPool *pool;
+  GInetAddr *ia, *dst;
+  GUdpPacket packets[8];
+  gint i, n;
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  sender = gnet_udp_socket_new_full (ia, 0);
+  receiver = gnet_udp_socket_new_full (ia, 0);
+  fail_unless (sender != NULL && receiver != NULL);
+  gnet_inetaddr_unref (ia);
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+
+  /* fewer buffers than packets: the rest stay queued */
+  pool = gnet_packet_pool_new (SLOT_SIZE, 5);
+  for (i = 0; i < 8; ++i) {
+    gchar c = 'a' + i;
+
+    fail_unless_equals_int (gnet_udp_socket_send (sender, &c, 1, dst), 0);
+  }
+
+  memset (packets, 0, sizeof (packets));
+  n = gnet_udp_socket_receive_batch_pooled (receiver, pool, packets, 8);
+  fail_unless_equals_int (n, 5);
+  for (i = 0; i < 5; ++i) {
+    fail_unless_equals_int (packets[i].received, 1);
+    fail_unless (packets[i].buffer[0] == 'a' + i);
+  }
+  for (i = 5; i < 8; ++i)
+    fail_unless (packets[i].buffer == NULL);
+
+  fail_unless_equals_int (gnet_udp_socket_receive_batch_pooled (receiver,
+          pool, packets + 5, 3), 0);
+
+  for (i = 0; i < 5; ++i)
+    gnet_packet_buffer_unref (packets[i].buffer);
+
+  n = gnet_udp_socket_receive_batch_pooled (receiver, pool, packets, 8);
+  fail_unless_equals_int (n, 3);
+  for (i = 0; i < 3; ++i) {
+    fail_unless (packets[i].buffer[0] == 'f' + i);
+    gnet_packet_buffer_unref (packets[i].buffer);
+  }
+
+  gnet_packet_pool_unref (pool);
+  gnet_inetaddr_unref (dst);
+  gnet_udp_socket_unref (sender);
+  gnet_udp_socket_unref (receiver);
+}
+GNET_END_TEST;
+
+typedef struct
+{
+  GList *kept;
+  gint received;
+} PooledData;
+
+static void
+pooled_receive_cb (GUdpSocket * socket, gchar * buffer, gint length,
+    GInetAddr * src, gpointer data)
+{
+  PooledData *d = data;
+
+  fail_unless (buffer != NULL);
+  fail_unless_equals_int (length, 4);
+  ++d->received;
+
+  /* keep every other buffer beyond the callback */
+  if (d->received % 2 == 0) {
+    gnet_packet_buffer_ref (buffer);
+    d->kept = g_list_prepend (d->kept, buffer);
+  }
+}
+
+GNET_START_TEST (test_pool_udp_async_local)
+{
+  GUdpSocket *sender, *receiver;
+  GPacketPool *pool;
+  GInetAddr *ia, *dst;
+  PooledData d = { NULL, 0 };
+  GList *l;
+  gint i;
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  sender = gnet_udp_socket_new_full (ia, 0);
+  receiver = gnet_udp_socket_new_full (ia, 0);
+  fail_unless (sender != NULL && receiver != NULL);
+  gnet_inetaddr_unref (ia);
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+
+  pool = gnet_packet_pool_new (SLOT_SIZE, 32);
+  gnet_udp_socket_receive_async_pooled (receiver, pool, pooled_receive_cb,
+      &d, NULL, NULL, G_PRIORITY_DEFAULT);
+
+  for (i = 0; i < 40; ++i) {
+    fail_unless_equals_int (gnet_udp_socket_send (sender, "ping", 4, dst), 0);
+    while (d.received <= i)
+      g_main_context_iteration (NULL, TRUE);
+  }
+
+  /* the kept buffers are still intact, the others went back */
+  fail_unless_equals_int (g_list_length (d.kept), 20);
+  for (l = d.kept; l != NULL; l = l->next)
+    fail_unless (memcmp (l->data, "ping", 4) == 0);
+
+  gnet_udp_socket_receive_async_cancel (receiver);
+  for (l = d.kept; l != NULL; l = l->next)
+    gnet_packet_buffer_unref (l->data);
+  g_list_free (d.kept);
+
+  gnet_packet_pool_unref (pool);
+  gnet_inetaddr_unref (dst);
+  gnet_udp_socket_unref (sender);
+  gnet_udp_socket_unref (receiver);
+}
+GNET_END_TEST;
+
+static Suite *
+gnetpool_suite (void)
+{
+  Suite *s = suite_create ("GPacketPool");
+  TCase *tc_chain = tcase_create ("pool");
+
+  tcase_set_timeout (tc_chain, 0);
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_pool_alloc);
+  tcase_add_test (tc_chain, test_pool_threads);
+  tcase_add_test (tc_chain, test_pool_udp_local);
+  tcase_add_test (tc_chain, test_pool_udp_async_local);
+  return s;
+}
+
+GNET_CHECK_MAIN (gnetpool);
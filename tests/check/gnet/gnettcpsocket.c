@@ -187,6 +187,57 @@ GNET_START_TEST (test_tcp_socket_async_connect_cancel)
 
 GNET_END_TEST;
 
+GNET_START_TEST (test_tcp_socket_options_local)
+{
+  GTcpSocket *server, *client, *accepted;
+  GInetAddr *addr;
+  gint value;
+
+  addr = gnet_inetaddr_new ("127.0.0.1", 0);
+  server = gnet_tcp_socket_server_new_full (addr, 0);
+  fail_unless (server != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_set_port (addr, gnet_tcp_socket_get_port (server));
+
+  /* applied to every accepted socket; setting again replaces the value */
+  gnet_tcp_socket_server_set_accept_option (server,
+      GNET_SOCKET_OPTION_TCP_NODELAY, 0);
+  gnet_tcp_socket_server_set_accept_option (server,
+      GNET_SOCKET_OPTION_TCP_NODELAY, 1);
+  gnet_tcp_socket_server_set_accept_option (server,
+      GNET_SOCKET_OPTION_SNDBUF, 65536);
+
+  client = gnet_tcp_socket_new_direct (addr);
+  fail_unless (client != NULL);
+  accepted = gnet_tcp_socket_server_accept (server);
+  fail_unless (accepted != NULL);
+
+  fail_unless (gnet_tcp_socket_get_option (accepted,
+          GNET_SOCKET_OPTION_TCP_NODELAY, &value));
+  fail_unless (value != 0);
+  fail_unless (gnet_tcp_socket_get_option (accepted,
+          GNET_SOCKET_OPTION_SNDBUF, &value));
+  fail_unless (value >= 65536);
+
+  /* not set on the client */
+  fail_unless (gnet_tcp_socket_get_option (client,
+          GNET_SOCKET_OPTION_TCP_NODELAY, &value));
+  fail_unless_equals_int (value, 0);
+  fail_unless (gnet_tcp_socket_set_option (client,
+          GNET_SOCKET_OPTION_TCP_NODELAY, 1));
+  fail_unless (gnet_tcp_socket_get_option (client,
+          GNET_SOCKET_OPTION_TCP_NODELAY, &value));
+  fail_unless (value != 0);
+
+  ASSERT_CRITICAL (gnet_tcp_socket_get_option (client,
+          GNET_SOCKET_OPTION_TCP_NODELAY, NULL));
+
+  gnet_tcp_socket_delete (accepted);
+  gnet_tcp_socket_delete (client);
+  gnet_tcp_socket_delete (server);
+  gnet_inetaddr_delete (addr);
+}
+GNET_END_TEST;
+
 static Suite *
 gnettcpsocket_suite (void)
 {
@@ -197,6 +248,7 @@ gnettcpsocket_suite (void)
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_tcp_socket_async_connect_cancel);
+  tcase_add_test (tc_chain, test_tcp_socket_options_local);
   return s;
 }
 
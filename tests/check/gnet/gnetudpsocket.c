@@ -0,0 +1,716 @@
+/* GNet GUdpSocket unit test
+ * Copyright (C) 2006 Tim-Philipp Müller  <tim centricular net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "config.h"
+#include "gnetcheck.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define BATCH_PACKETS 100
+#define PACKET_SIZE   512
+
+static GUdpSocket *
+udp_socket_new_local (void)
+{
+  GInetAddr *ia;
+  GUdpSocket *s;
+
+  ia = gnet_inetaddr_new ("127.0.0.1", 0);
+  fail_unless (ia != NULL);
+  s = gnet_udp_socket_new_full (ia, 0);
+  fail_unless (s != NULL, "Could not bind to 127.0.0.1, check your setup");
+  gnet_inetaddr_unref (ia);
+
+  return s;
+}
+
+/* Sends BATCH_PACKETS numbered packets from @sender to @dst */
+static void
+send_numbered_batch (GUdpSocket * sender, GInetAddr * dst)
+{
+  GUdpPacket packets[BATCH_PACKETS];
+  gint i;
+
+  for (i = 0; i < BATCH_PACKETS; ++i) {
+    packets[i].buffer = g_strdup_printf ("packet %d", i);
+    packets[i].length = strlen (packets[i].buffer) + 1;
+    packets[i].received = 0;
+    packets[i].addr = dst;
+  }
+
+  fail_unless_equals_int (gnet_udp_socket_send_batch (sender, packets,
+          BATCH_PACKETS), BATCH_PACKETS);
+
+  for (i = 0; i < BATCH_PACKETS; ++i)
+    g_free (packets[i].buffer);
+}
+
+/* Receives the packets sent by send_numbered_batch() */
+static void
+receive_numbered_batch (GUdpSocket * receiver, GMcastSocket * mcast,
+    gint sender_port)
+{
+  GUdpPacket packets[BATCH_PACKETS];
+  gint received = 0;
+  gint i;
+
+  for (i = 0; i < BATCH_PACKETS; ++i) {
+    packets[i].buffer = g_malloc (PACKET_SIZE);
+    packets[i].length = PACKET_SIZE;
+    packets[i].received = 0;
+    packets[i].addr = gnet_inetaddr_new ("0.0.0.0", 0);
+  }
+
+  while (received < BATCH_PACKETS) {
+    gint n;
+
+    if (mcast)
+      n = gnet_mcast_socket_receive_batch (mcast, packets + received,
+          BATCH_PACKETS - received);
+    else
+      n = gnet_udp_socket_receive_batch (receiver, packets + received,
+          BATCH_PACKETS - received);
+    fail_unless (n > 0);
+    received += n;
+  }
+
+  for (i = 0; i < BATCH_PACKETS; ++i) {
+    gchar *expected = g_strdup_printf ("packet %d", i);
+
+    fail_unless_equals_int (packets[i].received, strlen (expected) + 1);
+    fail_unless (strcmp (packets[i].buffer, expected) == 0);
+    fail_unless_equals_int (gnet_inetaddr_get_port (packets[i].addr),
+        sender_port);
+    fail_unless (gnet_inetaddr_is_loopback (packets[i].addr));
+
+    g_free (expected);
+    g_free (packets[i].buffer);
+    gnet_inetaddr_unref (packets[i].addr);
+  }
+}
+
+GNET_START_TEST (test_udp_socket_batch_local)
+{
+  GUdpSocket *sender, *receiver;
+  GInetAddr *dst, *src;
+  GUdpPacket packet;
+  gchar buf[1];
+  gint n;
+
+  sender = udp_socket_new_local ();
+  receiver = udp_socket_new_local ();
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+  src = gnet_udp_socket_get_local_inetaddr (sender);
+
+  send_numbered_batch (sender, dst);
+  receive_numbered_batch (receiver, NULL, gnet_inetaddr_get_port (src));
+
+  /* nothing to do */
+  fail_unless_equals_int (gnet_udp_socket_send_batch (sender, NULL, 0), 0);
+  fail_unless_equals_int (gnet_udp_socket_receive_batch (receiver, NULL, 0),
+      0);
+
+  /* a packet without destination stops the batch */
+  packet.buffer = buf;
+  packet.length = 1;
+  packet.addr = NULL;
+  fail_unless_equals_int (gnet_udp_socket_send_batch (sender, &packet, 1),
+      -1);
+
+  /* socket options; TCP options do not apply */
+  fail_unless (gnet_udp_socket_set_option (receiver,
+          GNET_SOCKET_OPTION_RCVBUF, 65536));
+  fail_unless (gnet_udp_socket_get_option (receiver,
+          GNET_SOCKET_OPTION_RCVBUF, &n));
+  fail_unless (n >= 65536);
+  fail_unless (!gnet_udp_socket_set_option (receiver,
+          GNET_SOCKET_OPTION_TCP_NODELAY, 1));
+
+  ASSERT_CRITICAL (gnet_udp_socket_send_batch (NULL, &packet, 1));
+  ASSERT_CRITICAL (gnet_udp_socket_receive_batch (receiver, NULL, 1));
+
+  gnet_inetaddr_unref (src);
+  gnet_inetaddr_unref (dst);
+  gnet_udp_socket_unref (sender);
+  gnet_udp_socket_unref (receiver);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_mcast_socket_batch_local)
+{
+  GMcastSocket *mcast;
+  GUdpSocket *sender;
+  GInetAddr *dst, *src;
+
+  mcast = gnet_mcast_socket_new_with_port (0);
+  fail_unless (mcast != NULL);
+  sender = udp_socket_new_local ();
+
+  src = gnet_mcast_socket_get_local_inetaddr (mcast);
+  dst = gnet_inetaddr_new ("127.0.0.1", gnet_inetaddr_get_port (src));
+  gnet_inetaddr_unref (src);
+  src = gnet_udp_socket_get_local_inetaddr (sender);
+
+  send_numbered_batch (sender, dst);
+  receive_numbered_batch (NULL, mcast, gnet_inetaddr_get_port (src));
+
+  gnet_inetaddr_unref (src);
+  gnet_inetaddr_unref (dst);
+  gnet_udp_socket_unref (sender);
+  gnet_mcast_socket_unref (mcast);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_udp_socket_receive_into_local)
+{
+  GUdpSocket *senders[2], *receiver;
+  GInetAddr *dst, *src;
+  GHashTable *counts;
+  gchar buf[PACKET_SIZE];
+  gint i;
+
+  receiver = udp_socket_new_local ();
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+
+  /* count packets per source, keyed by the senders' addresses */
+  counts = g_hash_table_new (gnet_inetaddr_hash, gnet_inetaddr_equal);
+  for (i = 0; i < 2; ++i) {
+    senders[i] = udp_socket_new_local ();
+    g_hash_table_insert (counts,
+        gnet_udp_socket_get_local_inetaddr (senders[i]), GINT_TO_POINTER (0));
+  }
+
+  for (i = 0; i < 20; ++i)
+    fail_unless_equals_int (gnet_udp_socket_send (senders[i % 2], "x", 1,
+            dst), 0);
+
+  /* one address, reused for every datagram */
+  src = gnet_inetaddr_new_bytes ("\0\0\0\0", 4);
+  for (i = 0; i < 20; ++i) {
+    gpointer key, value;
+
+    fail_unless_equals_int (gnet_udp_socket_receive_into (receiver, buf,
+            sizeof (buf), src), 1);
+    fail_unless (g_hash_table_lookup_extended (counts, src, &key, &value));
+    g_hash_table_insert (counts, key, GINT_TO_POINTER (GPOINTER_TO_INT (value)
+            + 1));
+  }
+
+  for (i = 0; i < 2; ++i) {
+    GInetAddr *ia = gnet_udp_socket_get_local_inetaddr (senders[i]);
+
+    fail_unless_equals_int (GPOINTER_TO_INT (g_hash_table_lookup (counts,
+                ia)), 10);
+    gnet_inetaddr_unref (ia);
+  }
+
+  /* the source is optional */
+  fail_unless_equals_int (gnet_udp_socket_send (senders[0], "yz", 2, dst), 0);
+  fail_unless_equals_int (gnet_udp_socket_receive_into (receiver, buf,
+          sizeof (buf), NULL), 2);
+
+  g_hash_table_foreach (counts, (GHFunc) gnet_inetaddr_unref, NULL);
+  g_hash_table_destroy (counts);
+  gnet_inetaddr_unref (src);
+  gnet_inetaddr_unref (dst);
+  for (i = 0; i < 2; ++i)
+    gnet_udp_socket_unref (senders[i]);
+  gnet_udp_socket_unref (receiver);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_udp_socket_segments_local)
+{
+  GUdpSocket *sender, *receiver;
+  GInetAddr *dst, *src;
+  GUdpPacket packets[16];
+  gchar out[10 * 100 + 42];
+  gchar *buf;
+  gint received = 0;
+  gint i;
+
+  sender = udp_socket_new_local ();
+  receiver = udp_socket_new_local ();
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+  src = gnet_inetaddr_new_bytes ("\0\0\0\0", 4);
+
+  /* works whether the kernel supports offload or not */
+  gnet_udp_socket_set_receive_offload (receiver, TRUE);
+
+  for (i = 0; i < sizeof (out); ++i)
+    out[i] = i / 100;
+  fail_unless_equals_int (gnet_udp_socket_send_segments (sender, out,
+          sizeof (out), 100, dst), 0);
+
+  buf = g_malloc (65535);
+  while (received < 11) {
+    gint length, segment_size, n;
+
+    length = gnet_udp_socket_receive_segments (receiver, buf, 65535, src,
+        &segment_size);
+    fail_unless (length > 0);
+    fail_unless (gnet_inetaddr_is_loopback (src));
+    fail_unless_equals_int (segment_size, (length == 42) ? 42 : 100);
+
+    n = gnet_udp_segments_split (buf, length, segment_size, packets, 16);
+    fail_unless (n >= 1 && received + n <= 11);
+    for (i = 0; i < n; ++i, ++received) {
+      fail_unless_equals_int (packets[i].received,
+          (received == 10) ? 42 : 100);
+      fail_unless (memcmp (packets[i].buffer, out + received * 100,
+              packets[i].received) == 0);
+    }
+  }
+  g_free (buf);
+
+  /* splitting */
+  buf = out;
+  fail_unless_equals_int (gnet_udp_segments_split (buf, 250, 100, NULL, 0),
+      3);
+  fail_unless_equals_int (gnet_udp_segments_split (buf, 250, 100, packets,
+          2), 3);
+  fail_unless (packets[1].buffer == buf + 100);
+  fail_unless_equals_int (packets[1].length, 100);
+  fail_unless_equals_int (gnet_udp_segments_split (buf, 0, 100, packets, 2),
+      0);
+
+  ASSERT_CRITICAL (gnet_udp_socket_send_segments (sender, out, sizeof (out),
+          0, dst));
+
+  gnet_inetaddr_unref (src);
+  gnet_inetaddr_unref (dst);
+  gnet_udp_socket_unref (sender);
+  gnet_udp_socket_unref (receiver);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_udp_socket_segments_too_large)
+{
+#ifdef IPV6_MTU
+  GUdpSocket *sender, *receiver;
+  GInetAddr *ia, *dst;
+  gchar out[3 * 1400 + 100], buf[2000];
+  gint i, mtu = 1280;
+
+  ia = gnet_inetaddr_new ("::1", 0);
+  fail_unless (ia != NULL);
+  sender = gnet_udp_socket_new_full (ia, 0);
+  receiver = gnet_udp_socket_new_full (ia, 0);
+  gnet_inetaddr_unref (ia);
+  if (sender == NULL || receiver == NULL) {
+    /* no IPv6 */
+    if (sender)
+      gnet_udp_socket_unref (sender);
+    if (receiver)
+      gnet_udp_socket_unref (receiver);
+    return;
+  }
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+
+  /* The segments are larger than the path allows, so segmentation
+     offload rejects them; sent one by one they are fragmented. */
+  fail_unless (setsockopt (g_io_channel_unix_get_fd
+          (gnet_udp_socket_get_io_channel (sender)), IPPROTO_IPV6,
+          IPV6_MTU, &mtu, sizeof (mtu)) == 0);
+
+  for (i = 0; i < sizeof (out); ++i)
+    out[i] = i / 1400;
+  fail_unless_equals_int (gnet_udp_socket_send_segments (sender, out,
+          sizeof (out), 1400, dst), 0);
+
+  for (i = 0; i < 4; ++i) {
+    fail_unless_equals_int (gnet_udp_socket_receive_into (receiver, buf,
+            sizeof (buf), NULL), (i == 3) ? 100 : 1400);
+    fail_unless (memcmp (buf, out + i * 1400, (i == 3) ? 100 : 1400) == 0);
+  }
+
+  gnet_inetaddr_unref (dst);
+  gnet_udp_socket_unref (sender);
+  gnet_udp_socket_unref (receiver);
+#endif
+}
+GNET_END_TEST;
+
+typedef struct
+{
+  GMainLoop *loop;
+  gint received;
+  gint last;
+  gint cancel_after;
+  gint sender_port;
+  gboolean notified;
+} AsyncReceiveData;
+
+static void
+async_receive_cb (GUdpSocket * socket, gchar * buffer, gint length,
+    GInetAddr * src, gpointer data)
+{
+  AsyncReceiveData *d = data;
+  gint n;
+
+  fail_unless (buffer != NULL);
+  fail_unless_equals_int (length, strlen (buffer) + 1);
+  fail_unless_equals_int (gnet_inetaddr_get_port (src), d->sender_port);
+
+  /* in order */
+  fail_unless (sscanf (buffer, "packet %d", &n) == 1);
+  fail_unless (n > d->last);
+  d->last = n;
+
+  if (++d->received == d->cancel_after || n == BATCH_PACKETS - 1) {
+    gnet_udp_socket_receive_async_cancel (socket);
+    g_main_loop_quit (d->loop);
+  }
+}
+
+static void
+async_receive_notify (gpointer data)
+{
+  ((AsyncReceiveData *) data)->notified = TRUE;
+}
+
+static gboolean
+async_receive_timeout_cb (gpointer data)
+{
+  g_main_loop_quit (((AsyncReceiveData *) data)->loop);
+  return FALSE;
+}
+
+GNET_START_TEST (test_udp_socket_receive_async_local)
+{
+  GUdpSocket *sender, *receiver;
+  GInetAddr *dst, *src;
+  AsyncReceiveData d = { NULL, 0, -1, 0, 0, FALSE };
+  GMainContext *context;
+  GSource *timeout;
+
+  sender = udp_socket_new_local ();
+  receiver = udp_socket_new_local ();
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+  src = gnet_udp_socket_get_local_inetaddr (sender);
+  d.sender_port = gnet_inetaddr_get_port (src);
+
+  /* all the waiting datagrams are delivered */
+  context = g_main_context_new ();
+  d.loop = g_main_loop_new (context, FALSE);
+  timeout = g_timeout_source_new (5000);
+  g_source_set_callback (timeout, async_receive_timeout_cb, &d, NULL);
+  g_source_attach (timeout, context);
+
+  send_numbered_batch (sender, dst);
+  gnet_udp_socket_receive_async_full (receiver, async_receive_cb, &d,
+      async_receive_notify, PACKET_SIZE, context, G_PRIORITY_HIGH);
+  ASSERT_CRITICAL (gnet_udp_socket_receive_async (receiver, async_receive_cb,
+          &d));
+  g_main_loop_run (d.loop);
+
+  fail_unless_equals_int (d.received, BATCH_PACKETS);
+  fail_unless (d.notified);
+
+  g_source_destroy (timeout);
+  g_source_unref (timeout);
+  g_main_loop_unref (d.loop);
+  g_main_context_unref (context);
+
+  /* canceling from the callback stops delivery at once */
+  d.loop = g_main_loop_new (NULL, FALSE);
+  d.received = 0;
+  d.last = -1;
+  d.cancel_after = 10;
+  d.notified = FALSE;
+  send_numbered_batch (sender, dst);
+  gnet_udp_socket_receive_async (receiver, async_receive_cb, &d);
+  g_main_loop_run (d.loop);
+  fail_unless_equals_int (d.received, 10);
+  fail_unless (!d.notified);
+  while (g_main_context_iteration (NULL, FALSE));
+  fail_unless_equals_int (d.received, 10);
+
+  /* receiving can be restarted */
+  d.cancel_after = 0;
+  gnet_udp_socket_receive_async (receiver, async_receive_cb, &d);
+  g_main_loop_run (d.loop);
+  fail_unless_equals_int (d.last, BATCH_PACKETS - 1);
+  g_main_loop_unref (d.loop);
+
+  /* unreffing the socket stops receiving */
+  d.notified = FALSE;
+  gnet_udp_socket_receive_async_full (receiver, async_receive_cb, &d,
+      async_receive_notify, 0, NULL, G_PRIORITY_DEFAULT);
+  gnet_udp_socket_receive_async_cancel (sender);
+  gnet_inetaddr_unref (src);
+  gnet_inetaddr_unref (dst);
+  gnet_udp_socket_unref (sender);
+  gnet_udp_socket_unref (receiver);
+  fail_unless (d.notified);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_udp_socket_timestamps_local)
+{
+  GUdpSocket *sender, *receiver;
+  GInetAddr *dst;
+  GUdpPacketInfo info;
+  GTimeVal now;
+  gchar buf[PACKET_SIZE];
+  guint64 sent;
+  gint i;
+
+  sender = udp_socket_new_local ();
+  receiver = udp_socket_new_local ();
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+  info.dst = NULL;
+
+  /* nothing is reported unless asked for */
+  fail_unless_equals_int (gnet_udp_socket_send (sender, "x", 1, dst), 0);
+  fail_unless_equals_int (gnet_udp_socket_receive_with_info (receiver, buf,
+          sizeof (buf), NULL, &info), 1);
+  fail_unless (info.timestamp == 0);
+  fail_unless_equals_int (info.drops, 0);
+
+  if (!gnet_udp_socket_set_option (receiver,
+          GNET_SOCKET_OPTION_TIMESTAMPNS, 1) ||
+      !gnet_udp_socket_set_option (receiver, GNET_SOCKET_OPTION_RXQ_OVFL, 1))
+    goto done;
+
+  g_get_current_time (&now);
+  sent = (guint64) now.tv_sec * 1000000000 + now.tv_usec * 1000;
+  fail_unless_equals_int (gnet_udp_socket_send (sender, "x", 1, dst), 0);
+  fail_unless_equals_int (gnet_udp_socket_receive_with_info (receiver, buf,
+          sizeof (buf), NULL, &info), 1);
+  fail_unless (info.timestamp + 1000000 >= sent);
+  fail_unless (info.timestamp < sent + 10 * (guint64) 1000000000);
+  fail_unless_equals_int (info.drops, 0);
+
+  /* overflow a small receive buffer; the next datagram reports the
+   * drops */
+  gnet_udp_socket_set_option (receiver, GNET_SOCKET_OPTION_RCVBUF, 1);
+  for (i = 0; i < BATCH_PACKETS; ++i)
+    gnet_udp_socket_send (sender, buf, PACKET_SIZE, dst);
+  while (gnet_udp_socket_has_packet (receiver))
+    gnet_udp_socket_receive_with_info (receiver, buf, sizeof (buf), NULL,
+        &info);
+  fail_unless_equals_int (gnet_udp_socket_send (sender, "x", 1, dst), 0);
+  fail_unless_equals_int (gnet_udp_socket_receive_with_info (receiver, buf,
+          sizeof (buf), NULL, &info), 1);
+  fail_unless (info.drops > 0);
+  fail_unless (info.drops < BATCH_PACKETS);
+
+done:
+  gnet_inetaddr_unref (dst);
+  gnet_udp_socket_unref (sender);
+  gnet_udp_socket_unref (receiver);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_udp_socket_receive_async_icmp_error)
+{
+  GUdpSocket *sender, *receiver, *closed;
+  GInetAddr *dst, *src, *ia;
+  AsyncReceiveData d = { NULL, 0, -1, 0, 0, FALSE };
+  struct sockaddr_in sa;
+  gint fd;
+
+  sender = udp_socket_new_local ();
+  receiver = udp_socket_new_local ();
+  dst = gnet_udp_socket_get_local_inetaddr (receiver);
+  src = gnet_udp_socket_get_local_inetaddr (sender);
+  d.sender_port = gnet_inetaddr_get_port (src);
+
+  /* Send to a closed port: the ICMP error is left pending on the
+     socket, which then only polls G_IO_ERR.  Connecting to the
+     sender afterwards keeps the error pending. */
+  closed = udp_socket_new_local ();
+  ia = gnet_udp_socket_get_local_inetaddr (closed);
+  memset (&sa, 0, sizeof (sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  sa.sin_port = htons (gnet_inetaddr_get_port (ia));
+  gnet_inetaddr_unref (ia);
+  gnet_udp_socket_unref (closed);
+
+  fd = g_io_channel_unix_get_fd (gnet_udp_socket_get_io_channel (receiver));
+  fail_unless (connect (fd, (struct sockaddr *) &sa, sizeof (sa)) == 0);
+  fail_unless (send (fd, "x", 1, 0) == 1);
+  sa.sin_port = htons (d.sender_port);
+  fail_unless (connect (fd, (struct sockaddr *) &sa, sizeof (sa)) == 0);
+
+  /* the error does not stop receiving */
+  d.loop = g_main_loop_new (NULL, FALSE);
+  gnet_udp_socket_receive_async (receiver, async_receive_cb, &d);
+  while (g_main_context_iteration (NULL, FALSE));
+  send_numbered_batch (sender, dst);
+  g_main_loop_run (d.loop);
+  fail_unless_equals_int (d.last, BATCH_PACKETS - 1);
+  g_main_loop_unref (d.loop);
+
+  gnet_inetaddr_unref (src);
+  gnet_inetaddr_unref (dst);
+  gnet_udp_socket_unref (sender);
+  gnet_udp_socket_unref (receiver);
+}
+GNET_END_TEST;
+
+typedef struct
+{
+  GInetAddr *group;
+  gint count;
+  gboolean notified;
+} GroupData;
+
+static void
+group_func (GMcastSocket * socket, gchar * buffer, gint length,
+    GInetAddr * src, const GUdpPacketInfo * info, gpointer data)
+{
+  GroupData *d = data;
+
+  fail_unless_equals_int (length, 1);
+  fail_unless (info->ifindex > 0);
+  if (d->group)
+    fail_unless (gnet_inetaddr_noport_equal (info->dst, d->group));
+  ++d->count;
+}
+
+static void
+group_notify (gpointer data)
+{
+  ((GroupData *) data)->notified = TRUE;
+}
+
+GNET_START_TEST (test_mcast_socket_group_dispatch_local)
+{
+  GMcastSocket *mcast;
+  GUdpSocket *sender;
+  GInetAddr *local, *dst, *src;
+  GroupData groups[3];
+  GUdpPacketInfo info;
+  gchar buf[16];
+  gint port, i;
+
+  mcast = gnet_mcast_socket_new_with_port (0);
+  fail_unless (mcast != NULL);
+  sender = udp_socket_new_local ();
+  local = gnet_mcast_socket_get_local_inetaddr (mcast);
+  port = gnet_inetaddr_get_port (local);
+  gnet_inetaddr_unref (local);
+
+  /* the destination address and interface of a datagram */
+  dst = gnet_inetaddr_new ("127.0.0.1", port);
+  fail_unless_equals_int (gnet_udp_socket_send (sender, "x", 1, dst), 0);
+  src = gnet_inetaddr_new_bytes ("\0\0\0\0", 4);
+  info.dst = gnet_inetaddr_new_bytes ("\0\0\0\0", 4);
+  fail_unless_equals_int (gnet_mcast_socket_receive_with_info (mcast, buf,
+          sizeof (buf), src, &info), 1);
+  fail_unless (gnet_inetaddr_equal (info.dst, dst));
+  fail_unless (info.ifindex > 0);
+  gnet_inetaddr_unref (info.dst);
+  gnet_inetaddr_unref (src);
+  gnet_inetaddr_unref (dst);
+
+  /* route by destination; the loopback addresses stand in for groups,
+   * the third one has no callback of its own */
+  memset (groups, 0, sizeof (groups));
+  groups[0].group = gnet_inetaddr_new ("127.0.0.1", 0);
+  groups[1].group = gnet_inetaddr_new ("127.0.0.2", 0);
+  gnet_mcast_socket_add_group_func (mcast, groups[0].group, group_func,
+      &groups[0], NULL);
+  gnet_mcast_socket_add_group_func (mcast, groups[1].group, group_func,
+      &groups[1], NULL);
+  gnet_mcast_socket_add_group_func (mcast, NULL, group_func, &groups[2],
+      group_notify);
+
+  for (i = 0; i < 15; ++i) {
+    gchar *name = g_strdup_printf ("127.0.0.%d", i % 3 + 1);
+
+    dst = gnet_inetaddr_new (name, port);
+    fail_unless_equals_int (gnet_udp_socket_send (sender, "x", 1, dst), 0);
+    gnet_inetaddr_unref (dst);
+    g_free (name);
+  }
+
+  while (groups[0].count + groups[1].count + groups[2].count < 15)
+    g_main_context_iteration (NULL, TRUE);
+
+  for (i = 0; i < 3; ++i)
+    fail_unless_equals_int (groups[i].count, 5);
+
+  fail_unless (gnet_mcast_socket_remove_group_func (mcast, groups[1].group));
+  fail_unless (!gnet_mcast_socket_remove_group_func (mcast, groups[1].group));
+
+  /* the remaining callbacks are freed with the socket */
+  gnet_mcast_socket_unref (mcast);
+  fail_unless (groups[2].notified);
+
+  gnet_inetaddr_unref (groups[0].group);
+  gnet_inetaddr_unref (groups[1].group);
+  gnet_udp_socket_unref (sender);
+}
+GNET_END_TEST;
+
+#ifdef GNET_ENABLE_NETWORK_TESTS
+GNET_START_TEST (test_mcast_socket_source_group)
+{
+  GMcastSocket *mcast;
+  GInetAddr *group, *source;
+
+  mcast = gnet_mcast_socket_new_with_port (0);
+  fail_unless (mcast != NULL);
+  group = gnet_inetaddr_new ("232.1.2.3", 0);
+  source = gnet_inetaddr_new ("192.0.2.1", 0);
+
+  fail_unless_equals_int (gnet_mcast_socket_join_source_group (mcast, group,
+          source), 0);
+  fail_unless_equals_int (gnet_mcast_socket_leave_source_group (mcast, group,
+          source), 0);
+
+  gnet_inetaddr_unref (source);
+  gnet_inetaddr_unref (group);
+  gnet_mcast_socket_unref (mcast);
+}
+GNET_END_TEST;
+#endif
+
+static Suite *
+gnetudpsocket_suite (void)
+{
+  Suite *s = suite_create ("GUdpSocket");
+  TCase *tc_chain = tcase_create ("udpsocket");
+
+  tcase_set_timeout (tc_chain, 0);
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_udp_socket_batch_local);
+  tcase_add_test (tc_chain, test_mcast_socket_batch_local);
+  tcase_add_test (tc_chain, test_udp_socket_receive_into_local);
+  tcase_add_test (tc_chain, test_udp_socket_segments_local);
+  tcase_add_test (tc_chain, test_udp_socket_segments_too_large);
+  tcase_add_test (tc_chain, test_udp_socket_receive_async_local);
+  tcase_add_test (tc_chain, test_udp_socket_receive_async_icmp_error);
+  tcase_add_test (tc_chain, test_mcast_socket_group_dispatch_local);
+  tcase_add_test (tc_chain, test_udp_socket_timestamps_local);
+
+#ifdef GNET_ENABLE_NETWORK_TESTS
+  tcase_add_test (tc_chain, test_mcast_socket_source_group);
+#endif
+  return s;
+}
+
+GNET_CHECK_MAIN (gnetudpsocket);
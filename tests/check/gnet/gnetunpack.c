@@ -26,25 +26,46 @@
 #define PTR_CONSTANT(p)  ((void*)((gulong)(p)))
 
 #define TEST1(NUM, ANS, FORMAT, ADDR, LEN, ARG1)   do {\
+  GPackFormat *pf = gnet_pack_format_new (FORMAT);	\
   ARG1 = 0;						\
   gnet_unpack (FORMAT, ADDR, LEN, &ARG1);		\
-  fail_unless (ARG1 == ANS);	} while (0)
+  fail_unless (ARG1 == ANS);				\
+  ARG1 = 0;						\
+  gnet_pack_format_unpack (pf, ADDR, LEN, &ARG1);	\
+  fail_unless (ARG1 == ANS);				\
+  gnet_pack_format_free (pf);	} while (0)
 
 #define TEST2(NUM, ANS, ANS2, FORMAT, ADDR, LEN, ARG1, ARG2)   do {\
+  GPackFormat *pf = gnet_pack_format_new (FORMAT);	\
   ARG1 = 0;						\
   ARG2 = 0;						\
   gnet_unpack (FORMAT, ADDR, LEN, &ARG1, &ARG2);	\
   fail_unless (ARG1 == ANS);  			\
-  fail_unless (ARG2 == ANS2);	} while (0)
+  fail_unless (ARG2 == ANS2);				\
+  ARG1 = 0;						\
+  ARG2 = 0;						\
+  gnet_pack_format_unpack (pf, ADDR, LEN, &ARG1, &ARG2);	\
+  fail_unless (ARG1 == ANS);  			\
+  fail_unless (ARG2 == ANS2);				\
+  gnet_pack_format_free (pf);	} while (0)
 
 #define TEST3(NUM, ANS, ANS2, ANS3, FORMAT, ADDR, LEN, ARG1, ARG2, ARG3) do {\
+  GPackFormat *pf = gnet_pack_format_new (FORMAT);	\
   ARG1 = 0;						\
   ARG2 = 0;						\
   ARG3 = 0;						\
   gnet_unpack (FORMAT, ADDR, LEN, &ARG1, &ARG2, &ARG3);	\
   fail_unless (ARG1 == ANS);  			\
   fail_unless (ARG2 == ANS2); 			\
-  fail_unless (ARG3 == ANS3); 	} while (0)
+  fail_unless (ARG3 == ANS3); 			\
+  ARG1 = 0;						\
+  ARG2 = 0;						\
+  ARG3 = 0;						\
+  gnet_pack_format_unpack (pf, ADDR, LEN, &ARG1, &ARG2, &ARG3);	\
+  fail_unless (ARG1 == ANS);  			\
+  fail_unless (ARG2 == ANS2); 			\
+  fail_unless (ARG3 == ANS3); 			\
+  gnet_pack_format_free (pf);	} while (0)
 
 const char buf[12] =  { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 
                         0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b};
@@ -55,17 +76,30 @@ const char bufh[12] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5,
 /*** STRINGS ***/
 
 #define TEST1S(NUM, ANS, FORMAT, BUF, LEN, ARG1)   do { \
+  GPackFormat *pf = gnet_pack_format_new (FORMAT);	\
   ARG1 = NULL;						\
   gnet_unpack (FORMAT, BUF, LEN, &ARG1);		\
   fail_unless_equals_string (ARG1, ANS);		\
-  g_free(ARG1);			} while (0)
+  g_free(ARG1);						\
+  ARG1 = NULL;						\
+  gnet_pack_format_unpack (pf, BUF, LEN, &ARG1);	\
+  fail_unless_equals_string (ARG1, ANS);		\
+  g_free(ARG1);						\
+  gnet_pack_format_free (pf);	} while (0)
 
 #define TEST2S(NUM, ANS, ANS2, FORMAT, BUF, LEN, ARG1, ARG2)   do {\
+  GPackFormat *pf = gnet_pack_format_new (FORMAT);	\
   ARG1 = NULL;						\
   ARG2 = NULL;						\
   gnet_unpack (FORMAT, BUF, LEN, &ARG1, &ARG2);		\
   fail_unless_equals_string (ARG1, ANS);  g_free(ARG1); \
   fail_unless_equals_string (ARG2, ANS2); g_free(ARG2); \
+  ARG1 = NULL;						\
+  ARG2 = NULL;						\
+  gnet_pack_format_unpack (pf, BUF, LEN, &ARG1, &ARG2);	\
+  fail_unless_equals_string (ARG1, ANS);  g_free(ARG1); \
+  fail_unless_equals_string (ARG2, ANS2); g_free(ARG2); \
+  gnet_pack_format_free (pf);				\
   } while (0)
 
 GNET_START_TEST (test_unpack_strings)
@@ -253,6 +287,8 @@ GNET_START_TEST (test_unpack_little_endian)
   unsigned short iguint16;
   int  igint32, igint32_2;
   unsigned int iguint32;
+  gint64 igint64;
+  guint64 iguint64;
   double doubley;
   float floaty;
 
@@ -288,6 +324,13 @@ GNET_START_TEST (test_unpack_little_endian)
   TEST1 (20800, 0x04030201, "<L", &buf[1], 4, iguint32);
   TEST1 (20810, 0xf4f3f2f1, "<L", &bufh[1], 4, iguint32);
 
+  TEST1 (20900, G_GINT64_CONSTANT (0x0807060504030201), "<q", &buf[1], 8,
+      igint64);
+  TEST1 (20910, G_GINT64_CONSTANT (-0x0708090a0b0c0d0f), "<q", &bufh[1], 8,
+      igint64);
+  TEST1 (20920, G_GUINT64_CONSTANT (0xf8f7f6f5f4f3f2f1), "<Q", &bufh[1], 8,
+      iguint64);
+
   gnet_unpack ("<f", &buf[1], sizeof(float), &floaty);
   gnet_unpack ("<d", &bufh[1], sizeof(double), &doubley);
 
@@ -307,6 +350,8 @@ GNET_START_TEST (test_unpack_big_endian)
   unsigned short iguint16;
   int  igint32, igint32_2;
   unsigned int iguint32;
+  gint64 igint64;
+  guint64 iguint64;
   double doubley;
   float floaty;
 
@@ -342,6 +387,13 @@ GNET_START_TEST (test_unpack_big_endian)
   TEST1 (30800, 0x01020304, ">L", &buf[1], 4, iguint32);
   TEST1 (30810, 0xf1f2f3f4, ">L", &bufh[1], 4, iguint32);
 
+  TEST1 (30900, G_GINT64_CONSTANT (0x0102030405060708), ">q", &buf[1], 8,
+      igint64);
+  TEST1 (30910, G_GINT64_CONSTANT (-0x0e0d0c0b0a090808), ">q", &bufh[1], 8,
+      igint64);
+  TEST1 (30920, G_GUINT64_CONSTANT (0xf1f2f3f4f5f6f7f8), ">Q", &bufh[1], 8,
+      iguint64);
+
   gnet_unpack (">f", &buf[1], sizeof(float), &floaty);
   gnet_unpack (">d", &bufh[1], sizeof(double), &doubley);
 
@@ -351,6 +403,163 @@ GNET_START_TEST (test_unpack_big_endian)
 }
 GNET_END_TEST;
 
+/*** VARINTS ***/
+
+GNET_START_TEST (test_unpack_varint)
+{
+  const gchar varints[] = { 0x00, 0x7f, 0x80, 0x01, 0xac, 0x02,
+                            0xff, 0xff, 0xff, 0xff, 0xff,
+                            0xff, 0xff, 0xff, 0xff, 0x01 };
+  const gchar overlong[] = { 0xff, 0xff, 0xff, 0xff, 0xff,
+                             0xff, 0xff, 0xff, 0xff, 0x02 };
+  guint64 u1, u2;
+  gint64 i1, i2;
+  guint8 b;
+
+  TEST1 (50000, 0, "W", varints, 1, u1);
+  TEST1 (50010, 127, "W", varints + 1, 1, u1);
+  TEST2 (50020, 128, 300, "2W", varints + 2, 4, u1, u2);
+  TEST1 (50030, G_MAXUINT64, "W", varints + 6, 10, u1);
+
+  TEST1 (50100, 0, "w", varints, 1, i1);
+  TEST1 (50110, -64, "w", varints + 1, 1, i1);
+  TEST2 (50120, 64, 150, "ww", varints + 2, 4, i1, i2);
+  TEST1 (50130, G_MININT64, "w", varints + 6, 10, i1);
+
+  fail_unless_equals_int (gnet_unpack ("WBW", varints + 1, 5, &u1, &b, &u2),
+      3);
+  fail_unless (u1 == 127 && b == 0x80 && u2 == 1);
+
+  /* truncated, and more than 64 bits */
+  ASSERT_CRITICAL (gnet_unpack ("W", varints + 2, 1, &u1));
+  ASSERT_CRITICAL (gnet_unpack ("W", varints + 6, 9, &u1));
+  ASSERT_CRITICAL (gnet_unpack ("W", overlong, 10, &u1));
+  ASSERT_CRITICAL (gnet_unpack ("w", overlong, 10, &i1));
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_unpack_format)
+{
+  GPackFormat *pf;
+  gchar buffer[64];
+  guint16 h1, h2;
+  guint32 i1;
+  gchar *s1, *s2;
+  gint len;
+
+  pf = gnet_pack_format_new ("!2Hs I p");
+  len = gnet_pack_format_pack (pf, buffer, sizeof (buffer), 0x0102, 0xf0f1,
+      "hello", 0x01020304, "there");
+  fail_unless_equals_int (len, 4 + 6 + 4 + 6);
+
+  fail_unless_equals_int (gnet_pack_format_unpack (pf, buffer, len, &h1, &h2,
+          &s1, &i1, &s2), len);
+  fail_unless_equals_int (h1, 0x0102);
+  fail_unless_equals_int (h2, 0xf0f1);
+  fail_unless_equals_int (i1, 0x01020304);
+  fail_unless_equals_string (s1, "hello");
+  fail_unless_equals_string (s2, "there");
+  g_free (s1);
+  g_free (s2);
+
+  /* short buffers fail in the fixed-size runs and in the strings */
+  ASSERT_CRITICAL (gnet_pack_format_unpack (pf, buffer, 3, &h1, &h2, &s1,
+          &i1, &s2));
+  s1 = NULL;
+  ASSERT_CRITICAL (gnet_pack_format_unpack (pf, buffer, 13, &h1, &h2, &s1,
+          &i1, &s2));
+  fail_unless_equals_string (s1, "hello");
+  g_free (s1);
+  gnet_pack_format_free (pf);
+}
+GNET_END_TEST;
+
+GNET_START_TEST (test_unpack_cursor)
+{
+  const gchar overlong[] = { 0xff, 0xff, 0xff, 0xff, 0xff,
+                             0xff, 0xff, 0xff, 0xff, 0x02 };
+  GPackCursor cursor;
+  GPackFormat *pf;
+  gchar buffer[64];
+  guint16 h1, h2;
+  guint32 i1;
+  guint64 u1;
+  gchar *s1, *s2;
+  const gchar *p;
+  gint len, n, messages;
+
+  pf = gnet_pack_format_new ("!2Hs I p");
+  len = gnet_pack_format_pack (pf, buffer, sizeof (buffer), 0x0102, 0xf0f1,
+      "hello", 0x01020304, "there");
+  fail_unless_equals_int (len, 20);
+  memcpy (buffer + len, buffer, len);
+
+  /* every prefix of two messages: the whole ones are read, the partial
+   * one is not, and the bytes it needs are never overstated */
+  for (n = 0; n <= 2 * len; ++n) {
+    gnet_pack_cursor_init (&cursor, buffer, n);
+    messages = 0;
+    while (gnet_pack_cursor_unpack (&cursor, pf, &h1, &h2, &s1, &i1, &s2)) {
+      fail_unless_equals_int (i1, 0x01020304);
+      fail_unless_equals_string (s2, "there");
+      g_free (s1);
+      g_free (s2);
+      gnet_pack_cursor_commit (&cursor);
+      ++messages;
+    }
+    fail_unless_equals_int (messages, n / len);
+    fail_unless_equals_int (gnet_pack_cursor_get_committed (&cursor),
+        messages * len);
+    fail_unless (gnet_pack_cursor_get_needed (&cursor) > 0);
+    fail_unless (n + gnet_pack_cursor_get_needed (&cursor) <=
+        (messages + 1) * len);
+  }
+
+  /* the fixed-size runs are needed whole, strings a byte at a time */
+  gnet_pack_cursor_init (&cursor, buffer, 0);
+  fail_if (gnet_pack_cursor_unpack (&cursor, pf, &h1, &h2, &s1, &i1, &s2));
+  fail_unless_equals_int (gnet_pack_cursor_get_needed (&cursor), 4);
+  gnet_pack_cursor_init (&cursor, buffer, 7);
+  fail_if (gnet_pack_cursor_unpack (&cursor, pf, &h1, &h2, &s1, &i1, &s2));
+  fail_unless_equals_int (gnet_pack_cursor_get_needed (&cursor), 1);
+  gnet_pack_cursor_init (&cursor, buffer, 11);
+  fail_if (gnet_pack_cursor_unpack (&cursor, pf, &h1, &h2, &s1, &i1, &s2));
+  fail_unless_equals_int (gnet_pack_cursor_get_needed (&cursor), 3);
+  gnet_pack_cursor_init (&cursor, buffer, 15);
+  fail_if (gnet_pack_cursor_unpack (&cursor, pf, &h1, &h2, &s1, &i1, &s2));
+  fail_unless_equals_int (gnet_pack_cursor_get_needed (&cursor), 5);
+  gnet_pack_format_free (pf);
+
+  /* a header and a body read in place; a short body rewinds to the
+   * last commit */
+  pf = gnet_pack_format_new ("!H");
+  gnet_pack_format_pack (pf, buffer, sizeof (buffer), 5);
+  memcpy (buffer + 2, "hello", 5);
+  gnet_pack_cursor_init (&cursor, buffer, 6);
+  fail_unless (gnet_pack_cursor_unpack (&cursor, pf, &h1));
+  fail_unless (gnet_pack_cursor_read (&cursor, h1) == NULL);
+  fail_unless_equals_int (gnet_pack_cursor_get_needed (&cursor), 1);
+  fail_unless (gnet_pack_cursor_unpack (&cursor, pf, &h1));
+  gnet_pack_cursor_init (&cursor, buffer, 7);
+  fail_unless (gnet_pack_cursor_unpack (&cursor, pf, &h1));
+  p = gnet_pack_cursor_read (&cursor, h1);
+  fail_unless (p == buffer + 2);
+  gnet_pack_cursor_commit (&cursor);
+  fail_unless_equals_int (gnet_pack_cursor_get_committed (&cursor), 7);
+  gnet_pack_format_free (pf);
+
+  /* a truncated varint needs more, one that is too long is malformed */
+  pf = gnet_pack_format_new ("W");
+  gnet_pack_cursor_init (&cursor, overlong, 9);
+  fail_if (gnet_pack_cursor_unpack (&cursor, pf, &u1));
+  fail_unless_equals_int (gnet_pack_cursor_get_needed (&cursor), 1);
+  gnet_pack_cursor_init (&cursor, overlong, 10);
+  fail_if (gnet_pack_cursor_unpack (&cursor, pf, &u1));
+  fail_unless_equals_int (gnet_pack_cursor_get_needed (&cursor), 0);
+  gnet_pack_format_free (pf);
+}
+GNET_END_TEST;
+
 static Suite *
 gnetunpack_suite (void)
 {
@@ -370,6 +579,9 @@ gnetunpack_suite (void)
   }
   tcase_add_test (tc_chain, test_unpack_big_endian);
   tcase_add_test (tc_chain, test_unpack_little_endian);
+  tcase_add_test (tc_chain, test_unpack_varint);
+  tcase_add_test (tc_chain, test_unpack_format);
+  tcase_add_test (tc_chain, test_unpack_cursor);
 
   return s;
 }
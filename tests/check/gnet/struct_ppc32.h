@@ -9,5 +9,7 @@ GNetCheckABIStruct list[] = {
   {"GConnHttpEventError", sizeof (GConnHttpEventError), 48},
   {"GServer", sizeof (GServer), 24},
   {"GURI", sizeof (GURI), 28},
+  {"GUdpPacket", sizeof (GUdpPacket), 16},
+  {"GUdpPacketInfo", sizeof (GUdpPacketInfo), 24},
   {NULL, 0, 0}
 };
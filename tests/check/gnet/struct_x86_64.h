@@ -9,5 +9,7 @@ GNetCheckABIStruct list[] = {
   {"GConnHttpEventError", sizeof (GConnHttpEventError), 96},
   {"GServer", sizeof (GServer), 48},
   {"GURI", sizeof (GURI), 56},
+  {"GUdpPacket", sizeof (GUdpPacket), 24},
+  {"GUdpPacketInfo", sizeof (GUdpPacketInfo), 24},
   {NULL, 0, 0}
 };